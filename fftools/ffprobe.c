@@ -42,9 +42,11 @@
 #include "libavutil/spherical.h"
 #include "libavutil/stereo3d.h"
 #include "libavutil/dict.h"
+#include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/libm.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/threadmessage.h"
 #include "libavutil/timecode.h"
 #include "libavutil/timestamp.h"
 #include "libavdevice/avdevice.h"
@@ -70,6 +72,12 @@ typedef struct InputStream {
     AVStream *st;
 
     AVCodecContext *dec_ctx;
+
+#if HAVE_THREADS
+    pthread_t thread;
+    AVThreadMessageQueue *in_queue;  ///< packets to decode
+    AVThreadMessageQueue *out_queue; ///< decoded frames, a NULL frame ends each packet
+#endif
 } InputStream;
 
 typedef struct InputFile {
@@ -77,6 +85,8 @@ typedef struct InputFile {
 
     InputStream *streams;
     int       nb_streams;
+
+    AVFifoBuffer *pending; ///< stream index of each packet sent to a decoder thread
 } InputFile;
 
 const char program_name[] = "ffprobe";
@@ -102,6 +112,8 @@ static int do_show_pixel_formats = 0;
 static int do_show_pixel_format_flags = 0;
 static int do_show_pixel_format_components = 0;
 static int do_show_log = 0;
+static int stream_threads = 0;
+static int flush_output = 1;
 
 static int do_show_chapter_tags = 0;
 static int do_show_format_tags = 0;
@@ -2099,7 +2111,8 @@ static void show_packet(WriterContext *w, InputFile *ifile, AVPacket *pkt, int p
     writer_print_section_footer(w);
 
     av_bprint_finalize(&pbuf, NULL);
-    fflush(stdout);
+    if (flush_output)
+        fflush(stdout);
 }
 
 static void show_subtitle(WriterContext *w, AVSubtitle *sub, AVStream *stream,
@@ -2122,7 +2135,8 @@ static void show_subtitle(WriterContext *w, AVSubtitle *sub, AVStream *stream,
     writer_print_section_footer(w);
 
     av_bprint_finalize(&pbuf, NULL);
-    fflush(stdout);
+    if (flush_output)
+        fflush(stdout);
 }
 
 static void show_frame(WriterContext *w, AVFrame *frame, AVStream *stream,
@@ -2268,23 +2282,19 @@ static void show_frame(WriterContext *w, AVFrame *frame, AVStream *stream,
     writer_print_section_footer(w);
 
     av_bprint_finalize(&pbuf, NULL);
-    fflush(stdout);
+    if (flush_output)
+        fflush(stdout);
 }
 
-static av_always_inline int process_frame(WriterContext *w,
-                                          InputFile *ifile,
-                                          AVFrame *frame, AVPacket *pkt,
-                                          int *packet_new)
+static int decode_packet(InputStream *ist, AVFrame *frame, AVSubtitle *sub,
+                         AVPacket *pkt, int *packet_new, int *got_frame)
 {
-    AVFormatContext *fmt_ctx = ifile->fmt_ctx;
-    AVCodecContext *dec_ctx = ifile->streams[pkt->stream_index].dec_ctx;
-    AVCodecParameters *par = ifile->streams[pkt->stream_index].st->codecpar;
-    AVSubtitle sub;
-    int ret = 0, got_frame = 0;
+    AVCodecContext *dec_ctx = ist->dec_ctx;
+    int ret = 0;
 
-    clear_log(1);
+    *got_frame = 0;
     if (dec_ctx && dec_ctx->codec) {
-        switch (par->codec_type) {
+        switch (ist->st->codecpar->codec_type) {
         case AVMEDIA_TYPE_VIDEO:
         case AVMEDIA_TYPE_AUDIO:
             if (*packet_new) {
@@ -2299,7 +2309,7 @@ static av_always_inline int process_frame(WriterContext *w,
             if (ret >= 0) {
                 ret = avcodec_receive_frame(dec_ctx, frame);
                 if (ret >= 0) {
-                    got_frame = 1;
+                    *got_frame = 1;
                 } else if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
                     ret = 0;
                 }
@@ -2308,7 +2318,7 @@ static av_always_inline int process_frame(WriterContext *w,
 
         case AVMEDIA_TYPE_SUBTITLE:
             if (*packet_new)
-                ret = avcodec_decode_subtitle2(dec_ctx, &sub, &got_frame, pkt);
+                ret = avcodec_decode_subtitle2(dec_ctx, sub, got_frame, pkt);
             *packet_new = 0;
             break;
         default:
@@ -2318,6 +2328,22 @@ static av_always_inline int process_frame(WriterContext *w,
         *packet_new = 0;
     }
 
+    return ret;
+}
+
+static av_always_inline int process_frame(WriterContext *w,
+                                          InputFile *ifile,
+                                          AVFrame *frame, AVPacket *pkt,
+                                          int *packet_new)
+{
+    AVFormatContext *fmt_ctx = ifile->fmt_ctx;
+    AVCodecParameters *par = ifile->streams[pkt->stream_index].st->codecpar;
+    AVSubtitle sub;
+    int ret, got_frame;
+
+    clear_log(1);
+    ret = decode_packet(&ifile->streams[pkt->stream_index], frame, &sub,
+                        pkt, packet_new, &got_frame);
     if (ret < 0)
         return ret;
     if (got_frame) {
@@ -2334,6 +2360,174 @@ static av_always_inline int process_frame(WriterContext *w,
     return got_frame || *packet_new;
 }
 
+#if HAVE_THREADS
+/* maximum number of packets sent to the decoder threads and not printed yet */
+#define MAX_PENDING_PACKETS 32
+/* maximum number of decoded frames waiting to be printed, per stream */
+#define MAX_QUEUED_FRAMES    4
+
+static void *decoder_thread(void *arg)
+{
+    InputStream *ist = arg;
+    AVFrame *frame = av_frame_alloc(), *out;
+    AVPacket pkt;
+    int ret = 0;
+
+    while (frame && ret >= 0 &&
+           av_thread_message_queue_recv(ist->in_queue, &pkt, 0) >= 0) {
+        int packet_new = 1, got_frame;
+
+        /* same calls as process_frame(), so that the frames come out
+         * exactly as with the serial decoding */
+        while (decode_packet(ist, frame, NULL, &pkt, &packet_new, &got_frame) >= 0 &&
+               (got_frame || packet_new)) {
+            if (!got_frame)
+                continue;
+            if (!(out = av_frame_alloc())) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            av_frame_move_ref(out, frame);
+            if ((ret = av_thread_message_queue_send(ist->out_queue, &out, 0)) < 0) {
+                av_frame_free(&out);
+                break;
+            }
+        }
+        av_packet_unref(&pkt);
+
+        out = NULL;
+        if (ret >= 0)
+            ret = av_thread_message_queue_send(ist->out_queue, &out, 0);
+    }
+    if (ret < 0 || !frame)
+        av_thread_message_queue_set_err_recv(ist->out_queue, frame ? ret : AVERROR(ENOMEM));
+    else
+        av_thread_message_queue_set_err_recv(ist->out_queue, AVERROR_EOF);
+    av_frame_free(&frame);
+    return NULL;
+}
+
+static void free_queued_packet(void *msg)
+{
+    av_packet_unref(msg);
+}
+
+static void free_queued_frame(void *msg)
+{
+    av_frame_free(msg);
+}
+
+static void stop_decoder_threads(InputFile *ifile)
+{
+    int i;
+
+    for (i = 0; i < ifile->nb_streams; i++) {
+        InputStream *ist = &ifile->streams[i];
+
+        if (!ist->in_queue)
+            continue;
+        av_thread_message_queue_set_err_recv(ist->in_queue, AVERROR_EOF);
+        av_thread_message_queue_set_err_send(ist->out_queue, AVERROR_EOF);
+        pthread_join(ist->thread, NULL);
+        av_thread_message_queue_free(&ist->in_queue);
+        av_thread_message_queue_free(&ist->out_queue);
+    }
+    av_fifo_freep(&ifile->pending);
+}
+
+static int start_decoder_threads(InputFile *ifile)
+{
+    int i, ret;
+
+    if (!(ifile->pending = av_fifo_alloc_array(MAX_PENDING_PACKETS, sizeof(int))))
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < ifile->nb_streams; i++) {
+        InputStream *ist = &ifile->streams[i];
+        enum AVMediaType type = ist->st->codecpar->codec_type;
+
+        if (!selected_streams[i] || !ist->dec_ctx || !ist->dec_ctx->codec ||
+            (type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO))
+            continue;
+
+        if ((ret = av_thread_message_queue_alloc(&ist->in_queue, MAX_PENDING_PACKETS,
+                                                 sizeof(AVPacket))) < 0 ||
+            (ret = av_thread_message_queue_alloc(&ist->out_queue, MAX_QUEUED_FRAMES,
+                                                 sizeof(AVFrame *))) < 0)
+            goto fail;
+        av_thread_message_queue_set_free_func(ist->in_queue, free_queued_packet);
+        av_thread_message_queue_set_free_func(ist->out_queue, free_queued_frame);
+
+        if ((ret = pthread_create(&ist->thread, NULL, decoder_thread, ist))) {
+            av_log(NULL, AV_LOG_ERROR, "Could not create the decoder thread for stream %d: %s\n",
+                   i, av_err2str(AVERROR(ret)));
+            ret = AVERROR(ret);
+            goto fail;
+        }
+    }
+    return 0;
+
+fail:
+    av_thread_message_queue_free(&ifile->streams[i].in_queue);
+    av_thread_message_queue_free(&ifile->streams[i].out_queue);
+    stop_decoder_threads(ifile);
+    return ret;
+}
+
+/* Print the frames of the oldest packets sent to the decoder threads, in the
+ * order the packets were read, until at most nb_left of them are pending. */
+static int print_decoded_frames(WriterContext *w, InputFile *ifile, int nb_left)
+{
+    AVFrame *frame;
+    int stream_index, ret;
+
+    while (ifile->pending && av_fifo_size(ifile->pending) > nb_left * sizeof(int)) {
+        InputStream *ist;
+
+        av_fifo_generic_read(ifile->pending, &stream_index, sizeof(stream_index), NULL);
+        ist = &ifile->streams[stream_index];
+        while ((ret = av_thread_message_queue_recv(ist->out_queue, &frame, 0)) >= 0 && frame) {
+            nb_streams_frames[stream_index]++;
+            if (do_show_frames)
+                show_frame(w, frame, ist->st, ifile->fmt_ctx);
+            av_frame_free(&frame);
+        }
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+#endif
+
+static int read_frames(WriterContext *w, InputFile *ifile,
+                       AVFrame *frame, AVPacket *pkt)
+{
+    int packet_new = 1;
+#if HAVE_THREADS
+    InputStream *ist = &ifile->streams[pkt->stream_index];
+    int ret;
+
+    if (ist->in_queue) {
+        AVPacket queued;
+
+        if ((ret = print_decoded_frames(w, ifile, MAX_PENDING_PACKETS - 1)) < 0)
+            return ret;
+        av_packet_move_ref(&queued, pkt);
+        if ((ret = av_thread_message_queue_send(ist->in_queue, &queued, 0)) < 0) {
+            av_packet_unref(&queued);
+            return ret;
+        }
+        av_fifo_generic_write(ifile->pending, &ist->st->index, sizeof(int), NULL);
+        return 0;
+    }
+    /* streams decoded here must not overtake the threaded ones */
+    if ((ret = print_decoded_frames(w, ifile, 0)) < 0)
+        return ret;
+#endif
+    while (process_frame(w, ifile, frame, pkt, &packet_new) > 0);
+    return 0;
+}
+
 static void log_read_interval(const ReadInterval *interval, void *log_ctx, int log_level)
 {
     av_log(log_ctx, log_level, "id:%d", interval->id);
@@ -2438,20 +2632,23 @@ static int read_interval_packets(WriterContext *w, InputFile *ifile,
                     show_packet(w, ifile, &pkt, i++);
                 nb_streams_packets[pkt.stream_index]++;
             }
-            if (do_read_frames) {
-                int packet_new = 1;
-                while (process_frame(w, ifile, frame, &pkt, &packet_new) > 0);
-            }
+            if (do_read_frames && (ret = read_frames(w, ifile, frame, &pkt)) < 0)
+                break;
         }
         av_packet_unref(&pkt);
     }
     av_packet_unref(&pkt);
+    if (ret < 0)
+        goto end;
     //Flush remaining frames that are cached in the decoder
     for (i = 0; i < fmt_ctx->nb_streams; i++) {
         pkt.stream_index = i;
-        if (do_read_frames)
-            while (process_frame(w, ifile, frame, &pkt, &(int){1}) > 0);
+        if (do_read_frames && (ret = read_frames(w, ifile, frame, &pkt)) < 0)
+            goto end;
     }
+#if HAVE_THREADS
+    ret = print_decoded_frames(w, ifile, 0);
+#endif
 
 end:
     av_frame_free(&frame);
@@ -3035,6 +3232,20 @@ static int probe_file(WriterContext *wctx, const char *filename,
             section_id = SECTION_ID_PACKETS;
         else // (!do_show_packets && do_show_frames)
             section_id = SECTION_ID_FRAMES;
+        if (stream_threads && do_read_frames) {
+#if HAVE_THREADS
+            if (do_show_log || (do_show_frames && do_show_packets)) {
+                av_log(NULL, AV_LOG_WARNING, "-stream_threads is ignored with "
+                       "-show_log or when showing both packets and frames\n");
+            } else {
+                ret = start_decoder_threads(&ifile);
+                CHECK_END;
+            }
+#else
+            av_log(NULL, AV_LOG_WARNING, "-stream_threads is not supported "
+                   "without threads, decoding serially\n");
+#endif
+        }
         if (do_show_frames || do_show_packets)
             writer_print_section_header(wctx, section_id);
         ret = read_packets(wctx, &ifile);
@@ -3062,6 +3273,9 @@ static int probe_file(WriterContext *wctx, const char *filename,
     }
 
 end:
+#if HAVE_THREADS
+    stop_decoder_threads(&ifile);
+#endif
     if (ifile.fmt_ctx)
         close_input_file(&ifile);
     av_freep(&nb_streams_frames);
@@ -3564,6 +3778,8 @@ static const OptionDef real_options[] = {
     { "show_library_versions", 0, { .func_arg = &opt_show_library_versions }, "show library versions" },
     { "show_versions",         0, { .func_arg = &opt_show_versions }, "show program and library versions" },
     { "show_pixel_formats", 0, { .func_arg = &opt_show_pixel_formats }, "show pixel format descriptions" },
+    { "stream_threads", OPT_BOOL, { &stream_threads }, "decode each selected stream on its own thread" },
+    { "flush_output", OPT_BOOL, { &flush_output }, "flush the output after each packet or frame" },
     { "show_private_data", OPT_BOOL, { &show_private_data }, "show private data" },
     { "private",           OPT_BOOL, { &show_private_data }, "same as show_private_data" },
     { "bitexact", OPT_BOOL, {&do_bitexact}, "force bitexact output" },
@@ -3625,6 +3841,9 @@ int main(int argc, char **argv)
 
     if (do_show_log)
         av_log_set_callback(log_callback);
+    /* a fixed size buffer keeps the memory bounded with long packet or frame listings */
+    if (!flush_output)
+        setvbuf(stdout, NULL, _IOFBF, 1 << 16);
 
     /* mark things to show, based on -show_entries */
     SET_DO_SHOW(CHAPTERS, chapters);
@@ -26,6 +26,7 @@
 #include "bytestream.h"
 #include "avcodec.h"
 #include "internal.h"
+#include "thread.h"
 
 static unsigned int read16(const uint8_t **ptr, int is_big)
 {
@@ -124,6 +125,7 @@ static int decode_frame(AVCodecContext *avctx,
     const uint8_t *buf = avpkt->data;
     int buf_size       = avpkt->size;
     AVFrame *const p = data;
+    ThreadFrame frame = { .f = data };
     uint8_t *ptr[AV_NUM_DATA_POINTERS];
     uint32_t header_version, version = 0;
     char creator[101];
@@ -379,7 +381,7 @@ static int decode_frame(AVCodecContext *avctx,
 
     ff_set_sar(avctx, avctx->sample_aspect_ratio);
 
-    if ((ret = ff_get_buffer(avctx, p, 0)) < 0)
+    if ((ret = ff_thread_get_buffer(avctx, &frame, 0)) < 0)
         return ret;
 
     av_strlcpy(creator, avpkt->data + 160, 100);
@@ -502,5 +504,5 @@ AVCodec ff_dpx_decoder = {
     .type           = AVMEDIA_TYPE_VIDEO,
     .id             = AV_CODEC_ID_DPX,
     .decode         = decode_frame,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS,
 };
@@ -788,6 +788,11 @@ int ff_filter_get_nb_threads(AVFilterContext *ctx)
     return ctx->graph->nb_threads;
 }
 
+void ff_filter_count_frame_copy(AVFilterContext *ctx)
+{
+    ctx->internal->nb_frame_copies++;
+}
+
 static int process_options(AVFilterContext *ctx, AVDictionary **options,
                            const char *args)
 {
@@ -1526,6 +1531,7 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
     if (av_frame_is_writable(frame))
         return 0;
     av_log(link->dst, AV_LOG_DEBUG, "Copying data in avfilter.\n");
+    ff_filter_count_frame_copy(link->dst);
 
     switch (link->type) {
     case AVMEDIA_TYPE_VIDEO:
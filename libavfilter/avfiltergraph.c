@@ -117,11 +117,30 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
     }
 }
 
+static void log_frame_copies(AVFilterGraph *graph)
+{
+    int64_t total = 0;
+    int i;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+
+        if (filter->internal->nb_frame_copies)
+            av_log(filter, AV_LOG_VERBOSE, "%"PRId64" frames copied\n",
+                   filter->internal->nb_frame_copies);
+        total += filter->internal->nb_frame_copies;
+    }
+    if (total)
+        av_log(graph, AV_LOG_VERBOSE, "%"PRId64" frames copied in the graph\n", total);
+}
+
 void avfilter_graph_free(AVFilterGraph **graph)
 {
     if (!*graph)
         return;
 
+    log_frame_copies(*graph);
+
     while ((*graph)->nb_filters)
         avfilter_free((*graph)->filters[0]);
 
@@ -142,6 +142,12 @@ struct AVFilterGraphInternal {
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+
+    /**
+     * Number of frames whose data was duplicated for this filter because
+     * they could not be used in place, reported when the graph is freed.
+     */
+    int64_t nb_frame_copies;
 };
 
 /**
@@ -391,6 +397,12 @@ static inline int ff_norm_qscale(int qscale, int type)
  */
 int ff_filter_get_nb_threads(AVFilterContext *ctx);
 
+/**
+ * Account for a frame whose data the filter had to copy into a new buffer
+ * instead of passing it on or modifying it in place.
+ */
+void ff_filter_count_frame_copy(AVFilterContext *ctx);
+
 /**
  * Generic processing of user supplied commands that are set
  * in the same way as the filter options.
@@ -0,0 +1,56 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavfilter/vf_colorspace.c"
+
+#undef printf
+
+int main(void)
+{
+    static const double nits[] = { 0.0, 0.1, 1.0, 100.0, 203.0, 1000.0, 4000.0, 10000.0 };
+    double max_err = 0.0, prev = -1.0;
+    int i, ret = 0;
+
+    /* signal values for some luminance levels */
+    for (i = 0; i < FF_ARRAY_ELEMS(nits); i++)
+        printf("%7.1f cd/m2: %.6f\n", nits[i], pq_inverse_eotf(nits[i] / REFERENCE_WHITE));
+
+    /* decoding and encoding again must give back every 10-bit code value */
+    for (i = 0; i < 1024; i++) {
+        double v = i / 1023.0, l = pq_eotf(v);
+
+        if (l <= prev) {
+            printf("pq_eotf() is not increasing at %d\n", i);
+            ret = 1;
+        }
+        prev = l;
+        if (lrint(pq_inverse_eotf(l) * 1023) != i) {
+            printf("code value %d does not round trip\n", i);
+            ret = 1;
+        }
+        max_err = FFMAX(max_err, fabs(pq_inverse_eotf(l) - v));
+    }
+    /* 0 decodes to 0, which encodes to PQ_C1^PQ_M2 = 7.3e-7 */
+    if (max_err > 1e-6) {
+        printf("round trip error %g\n", max_err);
+        ret = 1;
+    }
+    printf("round trip %s\n", ret ? "failed" : "ok");
+
+    return ret;
+}
@@ -0,0 +1,163 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Runs crop/pad/flip chains and prints how many frames each filter had to
+ * copy, once with frames handed over to the graph and once with frames the
+ * caller keeps a reference to, as decoders do for reference frames.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/frame.h"
+#include "libavutil/mem.h"
+
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavfilter/internal.h"
+
+#define WIDTH   64
+#define HEIGHT  48
+#define FRAMES  5
+
+static const char *const chains[] = {
+    "crop=iw-32:ih-32,pad=iw+32:ih+32:16:16",
+    "crop=iw-32:ih-32,vflip,pad=iw+32:ih+32:16:16",
+    "fillborders=left=8:right=8:top=8:bottom=8,pad=iw+32:ih+32:16:16",
+    "hflip,vflip,pad=iw+32:ih+32:16:16,fillborders=left=8:right=8:top=8:bottom=8",
+};
+
+static AVFrame *make_frame(int n)
+{
+    AVFrame *frame = av_frame_alloc();
+    int plane, x, y;
+
+    if (!frame)
+        return NULL;
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width  = WIDTH;
+    frame->height = HEIGHT;
+    frame->pts    = n;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return NULL;
+    }
+    for (plane = 0; plane < 3; plane++) {
+        int w = plane ? WIDTH  / 2 : WIDTH;
+        int h = plane ? HEIGHT / 2 : HEIGHT;
+        for (y = 0; y < h; y++)
+            for (x = 0; x < w; x++)
+                frame->data[plane][y * frame->linesize[plane] + x] = x + 3 * y + 50 * plane + n;
+    }
+    return frame;
+}
+
+static unsigned long checksum(unsigned long sum, const AVFrame *frame)
+{
+    int plane, y;
+
+    for (plane = 0; plane < 3; plane++) {
+        int w = plane ? frame->width  / 2 : frame->width;
+        int h = plane ? frame->height / 2 : frame->height;
+        for (y = 0; y < h; y++)
+            sum = av_adler32_update(sum, frame->data[plane] + y * frame->linesize[plane], w);
+    }
+    return sum;
+}
+
+static int run_chain(const char *chain, int keep_ref, unsigned long *sum)
+{
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterContext *src = NULL, *sink = NULL;
+    AVFrame *frame = av_frame_alloc();
+    char desc[512];
+    int64_t total = 0;
+    int i, n, ret;
+
+    if (!graph || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    snprintf(desc, sizeof(desc),
+             "buffer=video_size=%dx%d:pix_fmt=yuv420p:time_base=1/25:pixel_aspect=1/1,"
+             "%s,buffersink", WIDTH, HEIGHT, chain);
+    if ((ret = avfilter_graph_parse_ptr(graph, desc, NULL, NULL, NULL)) < 0 ||
+        (ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto end;
+    for (i = 0; i < graph->nb_filters; i++) {
+        if (!strcmp(graph->filters[i]->filter->name, "buffer"))
+            src = graph->filters[i];
+        else if (!strcmp(graph->filters[i]->filter->name, "buffersink"))
+            sink = graph->filters[i];
+    }
+
+    *sum = 1;
+    for (n = 0; n < FRAMES; n++) {
+        AVFrame *in = make_frame(n);
+        if (!in) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        /* a kept reference stays alive while the graph filters the frame */
+        ret = av_buffersrc_add_frame_flags(src, in, keep_ref ? AV_BUFFERSRC_FLAG_KEEP_REF : 0);
+        while (ret >= 0 && (ret = av_buffersink_get_frame(sink, frame)) >= 0) {
+            *sum = checksum(*sum, frame);
+            av_frame_unref(frame);
+        }
+        av_frame_free(&in);
+        if (ret != AVERROR(EAGAIN))
+            goto end;
+    }
+
+    printf("  %s:", keep_ref ? "shared frames" : "owned frames ");
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+
+        if (filter == src || filter == sink)
+            continue;
+        printf(" %s %"PRId64, filter->filter->name, filter->internal->nb_frame_copies);
+        total += filter->internal->nb_frame_copies;
+    }
+    printf(", %"PRId64" copies\n", total);
+    ret = 0;
+
+end:
+    av_frame_free(&frame);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+int main(void)
+{
+    unsigned long owned, shared;
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(chains); i++) {
+        printf("%s\n", chains[i]);
+        if (run_chain(chains[i], 0, &owned) < 0 ||
+            run_chain(chains[i], 1, &shared) < 0)
+            return 1;
+        printf("  output 0x%08lx%s\n", owned, owned == shared ? "" : ", differs with shared frames");
+    }
+
+    return 0;
+}
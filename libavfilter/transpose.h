@@ -45,6 +45,7 @@ typedef struct TransVtable {
                             int w, int h);
 } TransVtable;
 
+void ff_transpose_init(TransVtable *v, int pixstep);
 void ff_transpose_init_x86(TransVtable *v, int pixstep);
 
 #endif
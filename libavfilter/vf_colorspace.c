@@ -23,11 +23,18 @@
  * Convert between colorspaces.
  */
 
+#include <float.h>
+
 #include "libavutil/avassert.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/pixfmt.h"
 
+#if CONFIG_SWSCALE
+#include "libswscale/swscale.h"
+#endif
+
 #include "avfilter.h"
 #include "colorspacedsp.h"
 #include "formats.h"
@@ -62,6 +69,17 @@ enum Whitepoint {
     WP_NB,
 };
 
+enum TonemapAlgorithm {
+    TONEMAP_NONE,
+    TONEMAP_LINEAR,
+    TONEMAP_GAMMA,
+    TONEMAP_CLIP,
+    TONEMAP_REINHARD,
+    TONEMAP_HABLE,
+    TONEMAP_MOBIUS,
+    TONEMAP_NB,
+};
+
 enum WhitepointAdaptation {
     WP_ADAPT_BRADFORD,
     WP_ADAPT_VON_KRIES,
@@ -118,6 +136,12 @@ struct TransferCharacteristics {
     double alpha, beta, gamma, delta;
 };
 
+/* intermediate buffers of one slice job */
+typedef struct ColorSpaceTile {
+    int16_t *rgb[3];
+    int *dither_scratch[3][2], *dither_scratch_base[3][2];
+} ColorSpaceTile;
+
 typedef struct ColorSpaceContext {
     const AVClass *class;
 
@@ -132,11 +156,23 @@ typedef struct ColorSpaceContext {
     int fast_mode;
     enum DitherMode dither;
     enum WhitepointAdaptation wp_adapt;
+    enum TonemapAlgorithm tonemap;
+    double tonemap_param, user_peak;
 
-    int16_t *rgb[3];
+    ColorSpaceTile *tiles;      ///< one per slice job
+    int nb_tiles;
+    int tile_h;                 ///< rows converted through the tile buffers at once
+    int buf_w, buf_h;           ///< frame size the tile buffers are allocated for
     ptrdiff_t rgb_stride;
-    unsigned rgb_sz;
-    int *dither_scratch[3][2], *dither_scratch_base[3][2];
+
+#if CONFIG_SWSCALE
+    int scale_w, scale_h;
+    char *scale_flags;
+    struct SwsContext *sws;     ///< scales the converted frame band by band
+    uint8_t *band[4];           ///< converted rows not scaled yet
+    int band_linesize[4];
+    int band_h;
+#endif
 
     const struct ColorPrimaries *in_primaries, *out_primaries;
     int lrgb2lrgb_passthrough;
@@ -145,6 +181,7 @@ typedef struct ColorSpaceContext {
     const struct TransferCharacteristics *in_txchr, *out_txchr;
     int rgb2rgb_passthrough;
     int16_t *lin_lut, *delin_lut;
+    double tonemap_peak;        ///< signal peak the lin_lut was built for
 
     const struct LumaCoefficients *in_lumacoef, *out_lumacoef;
     int yuv2yuv_passthrough, yuv2yuv_fastmode;
@@ -183,8 +220,32 @@ static const struct TransferCharacteristics transfer_characteristics[AVCOL_TRC_N
     [AVCOL_TRC_IEC61966_2_4] = { 1.099, 0.018, 0.45, 4.5 },
     [AVCOL_TRC_BT2020_10] = { 1.099,  0.018,  0.45, 4.5 },
     [AVCOL_TRC_BT2020_12] = { 1.0993, 0.0181, 0.45, 4.5 },
+    // not a power curve, see pq_eotf() and pq_inverse_eotf()
+    [AVCOL_TRC_SMPTE2084] = { 1.0,    0.0,    0.0,  0.0 },
 };
 
+/* SMPTE ST 2084, with linear 1.0 at REFERENCE_WHITE */
+#define PQ_M1   (2610.0 / 16384.0)
+#define PQ_M2   (2523.0 / 4096.0 * 128.0)
+#define PQ_C1   (3424.0 / 4096.0)
+#define PQ_C2   (2413.0 / 4096.0 * 32.0)
+#define PQ_C3   (2392.0 / 4096.0 * 32.0)
+#define PQ_PEAK (10000.0 / REFERENCE_WHITE)
+
+static double pq_eotf(double v)
+{
+    double p = pow(FFMAX(v, 0.0), 1.0 / PQ_M2);
+
+    return PQ_PEAK * pow(FFMAX(p - PQ_C1, 0.0) / (PQ_C2 - PQ_C3 * p), 1.0 / PQ_M1);
+}
+
+static double pq_inverse_eotf(double l)
+{
+    double p = pow(FFMAX(l, 0.0) / PQ_PEAK, PQ_M1);
+
+    return pow((PQ_C1 + PQ_C2 * p) / (1.0 + PQ_C3 * p), PQ_M2);
+}
+
 static const struct TransferCharacteristics *
     get_transfer_characteristics(enum AVColorTransferCharacteristic trc)
 {
@@ -233,6 +294,55 @@ static const struct ColorPrimaries *get_color_primaries(enum AVColorPrimaries pr
     return p;
 }
 
+static double hable(double in)
+{
+    double a = 0.15, b = 0.50, c = 0.10, d = 0.20, e = 0.02, f = 0.30;
+    return (in * (in * a + b * c) + d * e) / (in * (in * a + b) + d * f) - e / f;
+}
+
+static double mobius(double in, double j, double peak)
+{
+    double a, b;
+
+    if (in <= j)
+        return in;
+
+    a = -j * j * (peak - 1.0) / (j * j - 2.0 * j + peak);
+    b = (j * j - 2.0 * j * peak + peak) / FFMAX(peak - 1.0, 1e-6);
+
+    return (b * b + 2.0 * b * j + j * j) / (b - a) * (in + a) / (in + b);
+}
+
+/*
+ * Same curves as the tonemap filter, but applied to each linear RGB
+ * component on its own, so they can be folded into lin_lut.
+ */
+static double tonemap(const ColorSpaceContext *s, double sig)
+{
+    double peak = s->tonemap_peak, param = s->tonemap_param;
+
+    if (sig <= 0.0)
+        return sig;
+
+    switch (s->tonemap) {
+    case TONEMAP_LINEAR:
+        return sig * param / peak;
+    case TONEMAP_GAMMA:
+        return sig > 0.05 ? pow(sig / peak, 1.0 / param)
+                          : sig * pow(0.05 / peak, 1.0 / param) / 0.05;
+    case TONEMAP_CLIP:
+        return av_clipd(sig * param, 0.0, 1.0);
+    case TONEMAP_REINHARD:
+        return sig / (sig + param) * (peak + param) / peak;
+    case TONEMAP_HABLE:
+        return hable(sig) / hable(peak);
+    case TONEMAP_MOBIUS:
+        return mobius(sig, param, peak);
+    default:
+        return sig;
+    }
+}
+
 static int fill_gamma_table(ColorSpaceContext *s)
 {
     int n;
@@ -250,7 +360,9 @@ static int fill_gamma_table(ColorSpaceContext *s)
         double v = (n - 2048.0) / 28672.0, d, l;
 
         // delinearize
-        if (v <= -out_beta) {
+        if (s->out_trc == AVCOL_TRC_SMPTE2084) {
+            d = pq_inverse_eotf(v);
+        } else if (v <= -out_beta) {
             d = -out_alpha * pow(-v, out_gamma) + (out_alpha - 1.0);
         } else if (v < out_beta) {
             d = out_delta * v;
@@ -260,13 +372,17 @@ static int fill_gamma_table(ColorSpaceContext *s)
         s->delin_lut[n] = av_clip_int16(lrint(d * 28672.0));
 
         // linearize
-        if (v <= -in_beta * in_delta) {
+        if (s->in_trc == AVCOL_TRC_SMPTE2084) {
+            l = pq_eotf(v);
+        } else if (v <= -in_beta * in_delta) {
             l = -pow((1.0 - in_alpha - v) * in_ialpha, in_igamma);
         } else if (v < in_beta * in_delta) {
             l = v * in_idelta;
         } else {
             l = pow((v + in_alpha - 1.0) * in_ialpha, in_igamma);
         }
+        if (s->tonemap != TONEMAP_NONE)
+            l = tonemap(s, l);
         s->lin_lut[n] = av_clip_int16(lrint(l * 28672.0));
     }
 
@@ -331,75 +447,85 @@ static void apply_lut(int16_t *buf[3], ptrdiff_t stride,
     }
 }
 
+/* bytes of intermediate RGB a slice job converts at once */
+#define TILE_SIZE (192 * 1024)
+
+/* rows of the converted frame that are scaled at once */
+#define BAND_HEIGHT 64
+
 typedef struct ThreadData {
-    AVFrame *in, *out;
+    AVFrame *in;
+    uint8_t **out_data;
     ptrdiff_t in_linesize[3], out_linesize[3];
     int in_ss_h, out_ss_h;
+    int y, h;                   ///< input rows to convert, written from the first output row
 } ThreadData;
 
 static int convert(AVFilterContext *ctx, void *data, int job_nr, int n_jobs)
 {
     const ThreadData *td = data;
     ColorSpaceContext *s = ctx->priv;
+    ColorSpaceTile *tile = &s->tiles[job_nr];
     uint8_t *in_data[3], *out_data[3];
-    int16_t *rgb[3];
-    int h_in = (td->in->height + 1) >> 1;
+    int h_in = (td->h + 1) >> 1;
     int h1 = 2 * (job_nr * h_in / n_jobs), h2 = 2 * ((job_nr + 1) * h_in / n_jobs);
-    int w = td->in->width, h = h2 - h1;
-
-    in_data[0]  = td->in->data[0]  + td->in_linesize[0]  *  h1;
-    in_data[1]  = td->in->data[1]  + td->in_linesize[1]  * (h1 >> td->in_ss_h);
-    in_data[2]  = td->in->data[2]  + td->in_linesize[2]  * (h1 >> td->in_ss_h);
-    out_data[0] = td->out->data[0] + td->out_linesize[0] *  h1;
-    out_data[1] = td->out->data[1] + td->out_linesize[1] * (h1 >> td->out_ss_h);
-    out_data[2] = td->out->data[2] + td->out_linesize[2] * (h1 >> td->out_ss_h);
-    rgb[0]      = s->rgb[0]        + s->rgb_stride       *  h1;
-    rgb[1]      = s->rgb[1]        + s->rgb_stride       *  h1;
-    rgb[2]      = s->rgb[2]        + s->rgb_stride       *  h1;
+    int w = td->in->width, y, h, tile_h;
 
     // FIXME for simd, also make sure we do pictures with negative stride
     // top-down so we don't overwrite lines with padding of data before it
     // in the same buffer (same as swscale)
 
-    if (s->yuv2yuv_fastmode) {
-        // FIXME possibly use a fast mode in case only the y range changes?
-        // since in that case, only the diagonal entries in yuv2yuv_coeffs[]
-        // are non-zero
-        s->yuv2yuv(out_data, td->out_linesize, in_data, td->in_linesize, w, h,
-                   s->yuv2yuv_coeffs, s->yuv_offset);
-    } else {
-        // FIXME maybe (for caching efficiency) do pipeline per-line instead of
-        // full buffer per function? (Or, since yuv2rgb requires 2 lines: per
-        // 2 lines, for yuv420.)
-        /*
-         * General design:
-         * - yuv2rgb converts from whatever range the input was ([16-235/240] or
-         *   [0,255] or the 10/12bpp equivalents thereof) to an integer version
-         *   of RGB in psuedo-restricted 15+sign bits. That means that the float
-         *   range [0.0,1.0] is in [0,28762], and the remainder of the int16_t
-         *   range is used for overflow/underflow outside the representable
-         *   range of this RGB type. rgb2yuv is the exact opposite.
-         * - gamma correction is done using a LUT since that appears to work
-         *   fairly fast.
-         * - If the input is chroma-subsampled (420/422), the yuv2rgb conversion
-         *   (or rgb2yuv conversion) uses nearest-neighbour sampling to read
-         *   read chroma pixels at luma resolution. If you want some more fancy
-         *   filter, you can use swscale to convert to yuv444p.
-         * - all coefficients are 14bit (so in the [-2.0,2.0] range).
-         */
-        s->yuv2rgb(rgb, s->rgb_stride, in_data, td->in_linesize, w, h,
+    /*
+     * General design:
+     * - yuv2rgb converts from whatever range the input was ([16-235/240] or
+     *   [0,255] or the 10/12bpp equivalents thereof) to an integer version
+     *   of RGB in psuedo-restricted 15+sign bits. That means that the float
+     *   range [0.0,1.0] is in [0,28762], and the remainder of the int16_t
+     *   range is used for overflow/underflow outside the representable
+     *   range of this RGB type. rgb2yuv is the exact opposite.
+     * - gamma correction is done using a LUT since that appears to work
+     *   fairly fast. Tone mapping is folded into the linearization LUT.
+     * - If the input is chroma-subsampled (420/422), the yuv2rgb conversion
+     *   (or rgb2yuv conversion) uses nearest-neighbour sampling to read
+     *   read chroma pixels at luma resolution. If you want some more fancy
+     *   filter, you can use swscale to convert to yuv444p.
+     * - all coefficients are 14bit (so in the [-2.0,2.0] range).
+     * - the slice is converted tile_h rows at a time, so the intermediate
+     *   RGB stays in cache between the steps of the pipeline.
+     */
+    tile_h = s->yuv2yuv_fastmode ? h2 - h1 : s->tile_h;
+    for (y = h1; y < h2; y += h) {
+        h = FFMIN(tile_h, h2 - y);
+
+        in_data[0]  = td->in->data[0] + td->in_linesize[0] *  (td->y + y);
+        in_data[1]  = td->in->data[1] + td->in_linesize[1] * ((td->y + y) >> td->in_ss_h);
+        in_data[2]  = td->in->data[2] + td->in_linesize[2] * ((td->y + y) >> td->in_ss_h);
+        out_data[0] = td->out_data[0] + td->out_linesize[0] *  y;
+        out_data[1] = td->out_data[1] + td->out_linesize[1] * (y >> td->out_ss_h);
+        out_data[2] = td->out_data[2] + td->out_linesize[2] * (y >> td->out_ss_h);
+
+        if (s->yuv2yuv_fastmode) {
+            // FIXME possibly use a fast mode in case only the y range changes?
+            // since in that case, only the diagonal entries in yuv2yuv_coeffs[]
+            // are non-zero
+            s->yuv2yuv(out_data, td->out_linesize, in_data, td->in_linesize, w, h,
+                       s->yuv2yuv_coeffs, s->yuv_offset);
+            continue;
+        }
+
+        s->yuv2rgb(tile->rgb, s->rgb_stride, in_data, td->in_linesize, w, h,
                    s->yuv2rgb_coeffs, s->yuv_offset[0]);
         if (!s->rgb2rgb_passthrough) {
-            apply_lut(rgb, s->rgb_stride, w, h, s->lin_lut);
+            apply_lut(tile->rgb, s->rgb_stride, w, h, s->lin_lut);
             if (!s->lrgb2lrgb_passthrough)
-                s->dsp.multiply3x3(rgb, s->rgb_stride, w, h, s->lrgb2lrgb_coeffs);
-            apply_lut(rgb, s->rgb_stride, w, h, s->delin_lut);
+                s->dsp.multiply3x3(tile->rgb, s->rgb_stride, w, h, s->lrgb2lrgb_coeffs);
+            apply_lut(tile->rgb, s->rgb_stride, w, h, s->delin_lut);
         }
         if (s->dither == DITHER_FSB) {
-            s->rgb2yuv_fsb(out_data, td->out_linesize, rgb, s->rgb_stride, w, h,
-                           s->rgb2yuv_coeffs, s->yuv_offset[1], s->dither_scratch);
+            s->rgb2yuv_fsb(out_data, td->out_linesize, tile->rgb, s->rgb_stride, w, h,
+                           s->rgb2yuv_coeffs, s->yuv_offset[1], tile->dither_scratch);
         } else {
-            s->rgb2yuv(out_data, td->out_linesize, rgb, s->rgb_stride, w, h,
+            s->rgb2yuv(out_data, td->out_linesize, tile->rgb, s->rgb_stride, w, h,
                        s->rgb2yuv_coeffs, s->yuv_offset[1]);
         }
     }
@@ -438,7 +564,7 @@ static int get_range_off(AVFilterContext *ctx, int *off,
 }
 
 static int create_filtergraph(AVFilterContext *ctx,
-                              const AVFrame *in, const AVFrame *out)
+                              AVFrame *in, const AVFrame *out)
 {
     ColorSpaceContext *s = ctx->priv;
     const AVPixFmtDescriptor *in_desc  = av_pix_fmt_desc_get(in->format);
@@ -579,7 +705,21 @@ static int create_filtergraph(AVFilterContext *ctx,
         }
     }
 
+    if (s->tonemap != TONEMAP_NONE) {
+        double peak = s->user_peak;
+
+        if (!peak)
+            peak = in->color_trc == AVCOL_TRC_SMPTE2084 ? ff_determine_signal_peak(in) :
+                   s->in_trc     == AVCOL_TRC_SMPTE2084 ? PQ_PEAK : 1.0;
+        if (peak != s->tonemap_peak) {
+            av_log(ctx, AV_LOG_DEBUG, "Computed signal peak: %f\n", peak);
+            av_freep(&s->lin_lut);
+            s->tonemap_peak = peak;
+        }
+    }
+
     s->rgb2rgb_passthrough = s->fast_mode || (s->lrgb2lrgb_passthrough &&
+                             s->tonemap == TONEMAP_NONE &&
                              !memcmp(s->in_txchr, s->out_txchr, sizeof(*s->in_txchr)));
     if (!s->rgb2rgb_passthrough && !s->lin_lut) {
         res = fill_gamma_table(s);
@@ -738,26 +878,143 @@ static av_cold int init(AVFilterContext *ctx)
 
     ff_colorspacedsp_init(&s->dsp);
 
+    if (s->fast_mode && s->tonemap != TONEMAP_NONE) {
+        av_log(ctx, AV_LOG_ERROR, "Tone mapping is not supported in fast mode\n");
+        return AVERROR(EINVAL);
+    }
+
+    switch (s->tonemap) {
+    case TONEMAP_GAMMA:
+        if (isnan(s->tonemap_param))
+            s->tonemap_param = 1.8;
+        break;
+    case TONEMAP_REINHARD:
+        if (!isnan(s->tonemap_param))
+            s->tonemap_param = (1.0 - s->tonemap_param) / s->tonemap_param;
+        break;
+    case TONEMAP_MOBIUS:
+        if (isnan(s->tonemap_param))
+            s->tonemap_param = 0.3;
+        break;
+    }
+
+    if (isnan(s->tonemap_param))
+        s->tonemap_param = 1.0;
+
     return 0;
 }
 
-static void uninit(AVFilterContext *ctx)
+static void free_tiles(ColorSpaceContext *s)
+{
+    int n, i;
+
+    for (n = 0; n < s->nb_tiles; n++) {
+        ColorSpaceTile *tile = &s->tiles[n];
+
+        for (i = 0; i < 3; i++) {
+            av_freep(&tile->rgb[i]);
+            av_freep(&tile->dither_scratch_base[i][0]);
+            av_freep(&tile->dither_scratch_base[i][1]);
+        }
+    }
+    av_freep(&s->tiles);
+    s->nb_tiles = 0;
+    s->buf_w = s->buf_h = 0;
+}
+
+static int alloc_tiles(AVFilterContext *ctx, int w, int h, int uvw)
 {
     ColorSpaceContext *s = ctx->priv;
+    int conv_h = h, nb_jobs, slice_h, n, i;
+
+#if CONFIG_SWSCALE
+    if (s->sws)
+        conv_h = FFMIN(h, s->band_h);
+#endif
+    nb_jobs = FFMIN((conv_h + 1) >> 1, ff_filter_get_nb_threads(ctx));
+    slice_h = 2 * ((((conv_h + 1) >> 1) + nb_jobs - 1) / nb_jobs);
+
+    free_tiles(s);
+    s->rgb_stride = FFALIGN(w * sizeof(int16_t), 32) / sizeof(int16_t);
+    // dithering restarts on every call, so dithered slices are done at once
+    if (s->dither == DITHER_FSB)
+        s->tile_h = slice_h;
+    else
+        s->tile_h = FFMIN(slice_h, FFMAX(2, TILE_SIZE / (3 * s->rgb_stride * sizeof(int16_t)) & ~1));
+
+    s->tiles = av_mallocz_array(nb_jobs, sizeof(*s->tiles));
+    if (!s->tiles)
+        return AVERROR(ENOMEM);
+    s->nb_tiles = nb_jobs;
+
+    for (n = 0; n < nb_jobs; n++) {
+        ColorSpaceTile *tile = &s->tiles[n];
+
+        for (i = 0; i < 3; i++) {
+            int scratch_w = (i ? uvw : w) + 4;
+
+            tile->rgb[i] = av_malloc(s->rgb_stride * sizeof(int16_t) * s->tile_h);
+            tile->dither_scratch_base[i][0] =
+                av_malloc_array(scratch_w, sizeof(*tile->dither_scratch_base[i][0]));
+            tile->dither_scratch_base[i][1] =
+                av_malloc_array(scratch_w, sizeof(*tile->dither_scratch_base[i][1]));
+            if (!tile->rgb[i] ||
+                !tile->dither_scratch_base[i][0] || !tile->dither_scratch_base[i][1])
+                return AVERROR(ENOMEM);
+            tile->dither_scratch[i][0] = &tile->dither_scratch_base[i][0][1];
+            tile->dither_scratch[i][1] = &tile->dither_scratch_base[i][1][1];
+        }
+    }
+    s->buf_w = w;
+    s->buf_h = h;
 
-    av_freep(&s->rgb[0]);
-    av_freep(&s->rgb[1]);
-    av_freep(&s->rgb[2]);
-    s->rgb_sz = 0;
-    av_freep(&s->dither_scratch_base[0][0]);
-    av_freep(&s->dither_scratch_base[0][1]);
-    av_freep(&s->dither_scratch_base[1][0]);
-    av_freep(&s->dither_scratch_base[1][1]);
-    av_freep(&s->dither_scratch_base[2][0]);
-    av_freep(&s->dither_scratch_base[2][1]);
+    return 0;
+}
 
+static void uninit(AVFilterContext *ctx)
+{
+    ColorSpaceContext *s = ctx->priv;
+
+    free_tiles(s);
     av_freep(&s->lin_lut);
+
+#if CONFIG_SWSCALE
+    sws_freeContext(s->sws);
+    s->sws = NULL;
+    av_freep(&s->band[0]);
+#endif
+}
+
+#if CONFIG_SWSCALE
+static int convert_scale(AVFilterContext *ctx, ThreadData *td, AVFrame *out)
+{
+    ColorSpaceContext *s = ctx->priv;
+    int h = td->in->height, nb_threads = ff_filter_get_nb_threads(ctx);
+    int ret;
+
+    if (s->yuv2yuv_passthrough) {
+        ret = sws_scale(s->sws, (const uint8_t * const *)td->in->data, td->in->linesize,
+                        0, h, out->data, out->linesize);
+        return FFMIN(ret, 0);
+    }
+
+    td->out_data = s->band;
+    td->out_linesize[0] = s->band_linesize[0];
+    td->out_linesize[1] = s->band_linesize[1];
+    td->out_linesize[2] = s->band_linesize[2];
+    for (td->y = 0; td->y < h; td->y += s->band_h) {
+        td->h = FFMIN(s->band_h, h - td->y);
+        ctx->internal->execute(ctx, convert, td, NULL,
+                               FFMIN((td->h + 1) >> 1, nb_threads));
+        ret = sws_scale(s->sws, (const uint8_t * const *)s->band, s->band_linesize,
+                        td->y, td->h, out->data, out->linesize);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
 }
+#endif
 
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
@@ -769,8 +1026,6 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     // and out_* are identical (not just their respective properties)
     AVFrame *out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     int res;
-    ptrdiff_t rgb_stride = FFALIGN(in->width * sizeof(int16_t), 32);
-    unsigned rgb_sz = rgb_stride * in->height;
     ThreadData td;
 
     if (!out) {
@@ -799,52 +1054,17 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
                            default_csp[FFMIN(s->user_all, CS_NB)] : s->user_csp;
     out->color_range     = s->user_rng == AVCOL_RANGE_UNSPECIFIED ?
                            in->color_range : s->user_rng;
-    if (rgb_sz != s->rgb_sz) {
+    if (in->width != s->buf_w || in->height != s->buf_h) {
         const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(out->format);
-        int uvw = in->width >> desc->log2_chroma_w;
-
-        av_freep(&s->rgb[0]);
-        av_freep(&s->rgb[1]);
-        av_freep(&s->rgb[2]);
-        s->rgb_sz = 0;
-        av_freep(&s->dither_scratch_base[0][0]);
-        av_freep(&s->dither_scratch_base[0][1]);
-        av_freep(&s->dither_scratch_base[1][0]);
-        av_freep(&s->dither_scratch_base[1][1]);
-        av_freep(&s->dither_scratch_base[2][0]);
-        av_freep(&s->dither_scratch_base[2][1]);
-
-        s->rgb[0] = av_malloc(rgb_sz);
-        s->rgb[1] = av_malloc(rgb_sz);
-        s->rgb[2] = av_malloc(rgb_sz);
-        s->dither_scratch_base[0][0] =
-            av_malloc(sizeof(*s->dither_scratch_base[0][0]) * (in->width + 4));
-        s->dither_scratch_base[0][1] =
-            av_malloc(sizeof(*s->dither_scratch_base[0][1]) * (in->width + 4));
-        s->dither_scratch_base[1][0] =
-            av_malloc(sizeof(*s->dither_scratch_base[1][0]) * (uvw + 4));
-        s->dither_scratch_base[1][1] =
-            av_malloc(sizeof(*s->dither_scratch_base[1][1]) * (uvw + 4));
-        s->dither_scratch_base[2][0] =
-            av_malloc(sizeof(*s->dither_scratch_base[2][0]) * (uvw + 4));
-        s->dither_scratch_base[2][1] =
-            av_malloc(sizeof(*s->dither_scratch_base[2][1]) * (uvw + 4));
-        s->dither_scratch[0][0] = &s->dither_scratch_base[0][0][1];
-        s->dither_scratch[0][1] = &s->dither_scratch_base[0][1][1];
-        s->dither_scratch[1][0] = &s->dither_scratch_base[1][0][1];
-        s->dither_scratch[1][1] = &s->dither_scratch_base[1][1][1];
-        s->dither_scratch[2][0] = &s->dither_scratch_base[2][0][1];
-        s->dither_scratch[2][1] = &s->dither_scratch_base[2][1][1];
-        if (!s->rgb[0] || !s->rgb[1] || !s->rgb[2] ||
-            !s->dither_scratch_base[0][0] || !s->dither_scratch_base[0][1] ||
-            !s->dither_scratch_base[1][0] || !s->dither_scratch_base[1][1] ||
-            !s->dither_scratch_base[2][0] || !s->dither_scratch_base[2][1]) {
-            uninit(ctx);
+
+        res = alloc_tiles(ctx, in->width, in->height,
+                          in->width >> desc->log2_chroma_w);
+        if (res < 0) {
+            free_tiles(s);
             av_frame_free(&in);
             av_frame_free(&out);
-            return AVERROR(ENOMEM);
+            return res;
         }
-        s->rgb_sz = rgb_sz;
     }
     res = create_filtergraph(ctx, in, out);
     if (res < 0) {
@@ -852,9 +1072,8 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         av_frame_free(&out);
         return res;
     }
-    s->rgb_stride = rgb_stride / sizeof(int16_t);
     td.in = in;
-    td.out = out;
+    td.out_data = out->data;
     td.in_linesize[0] = in->linesize[0];
     td.in_linesize[1] = in->linesize[1];
     td.in_linesize[2] = in->linesize[2];
@@ -863,18 +1082,25 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     td.out_linesize[2] = out->linesize[2];
     td.in_ss_h = av_pix_fmt_desc_get(in->format)->log2_chroma_h;
     td.out_ss_h = av_pix_fmt_desc_get(out->format)->log2_chroma_h;
+    td.y = 0;
+    td.h = in->height;
+#if CONFIG_SWSCALE
+    if (s->sws) {
+        res = convert_scale(ctx, &td, out);
+        out->sample_aspect_ratio = outlink->sample_aspect_ratio;
+    } else
+#endif
     if (s->yuv2yuv_passthrough) {
         res = av_frame_copy(out, in);
-        if (res < 0) {
-            av_frame_free(&in);
-            av_frame_free(&out);
-            return res;
-        }
     } else {
         ctx->internal->execute(ctx, convert, &td, NULL,
                                FFMIN((in->height + 1) >> 1, ff_filter_get_nb_threads(ctx)));
     }
     av_frame_free(&in);
+    if (res < 0) {
+        av_frame_free(&out);
+        return res;
+    }
 
     return ff_filter_frame(outlink, out);
 }
@@ -907,10 +1133,60 @@ static int query_formats(AVFilterContext *ctx)
     return ff_formats_ref(formats, &ctx->outputs[0]->in_formats);
 }
 
+#if CONFIG_SWSCALE
+static av_cold int init_scale(AVFilterContext *ctx, int w, int h)
+{
+    ColorSpaceContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    int ret;
+
+    sws_freeContext(s->sws);
+    s->sws = NULL;
+    av_freep(&s->band[0]);
+    // the number of slice jobs depends on whether the frame is scaled
+    free_tiles(s);
+
+    if ((!s->scale_w || s->scale_w == w) && (!s->scale_h || s->scale_h == h))
+        return 0;
+
+    if (ctx->enable_str) {
+        av_log(ctx, AV_LOG_ERROR, "Scaling is not supported with timeline editing\n");
+        return AVERROR(EINVAL);
+    }
+
+    s->sws = sws_alloc_context();
+    if (!s->sws)
+        return AVERROR(ENOMEM);
+    av_opt_set_int(s->sws, "srcw", w, 0);
+    av_opt_set_int(s->sws, "srch", h, 0);
+    av_opt_set_int(s->sws, "src_format", outlink->format, 0);
+    av_opt_set_int(s->sws, "dstw", s->scale_w ? s->scale_w : w, 0);
+    av_opt_set_int(s->sws, "dsth", s->scale_h ? s->scale_h : h, 0);
+    av_opt_set_int(s->sws, "dst_format", outlink->format, 0);
+    if ((ret = av_opt_set(s->sws, "sws_flags", s->scale_flags, 0)) < 0 ||
+        (ret = sws_init_context(s->sws, NULL, NULL)) < 0)
+        return ret;
+
+    // error diffusion restarts in every band, so dithered frames are
+    // converted whole
+    s->band_h = s->dither == DITHER_FSB ? h : BAND_HEIGHT;
+    ret = av_image_alloc(s->band, s->band_linesize, w, s->band_h,
+                         outlink->format, 32);
+    if (ret < 0)
+        return ret;
+
+    outlink->w = s->scale_w ? s->scale_w : w;
+    outlink->h = s->scale_h ? s->scale_h : h;
+    outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * w, outlink->w * h },
+                                            outlink->sample_aspect_ratio);
+    return 0;
+}
+#endif
+
 static int config_props(AVFilterLink *outlink)
 {
-    AVFilterContext *ctx = outlink->dst;
-    AVFilterLink *inlink = outlink->src->inputs[0];
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
 
     if (inlink->w % 2 || inlink->h % 2) {
         av_log(ctx, AV_LOG_ERROR, "Invalid odd size (%dx%d)\n",
@@ -923,7 +1199,11 @@ static int config_props(AVFilterLink *outlink)
     outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
     outlink->time_base = inlink->time_base;
 
+#if CONFIG_SWSCALE
+    return init_scale(ctx, inlink->w, inlink->h);
+#else
     return 0;
+#endif
 }
 
 #define OFFSET(x) offsetof(ColorSpaceContext, x)
@@ -996,6 +1276,7 @@ static const AVOption colorspace_options[] = {
     ENUM("iec61966-2-4", AVCOL_TRC_IEC61966_2_4, "trc"),
     ENUM("bt2020-10",    AVCOL_TRC_BT2020_10,    "trc"),
     ENUM("bt2020-12",    AVCOL_TRC_BT2020_12,    "trc"),
+    ENUM("smpte2084",    AVCOL_TRC_SMPTE2084,    "trc"),
 
     { "format",   "Output pixel format",
       OFFSET(user_format), AV_OPT_TYPE_INT,  { .i64 = AV_PIX_FMT_NONE },
@@ -1043,6 +1324,35 @@ static const AVOption colorspace_options[] = {
       OFFSET(user_itrc),  AV_OPT_TYPE_INT, { .i64 = AVCOL_TRC_UNSPECIFIED },
       AVCOL_TRC_RESERVED0, AVCOL_TRC_NB - 1, FLAGS, "trc" },
 
+    { "tonemap",    "Tone mapping algorithm",
+      OFFSET(tonemap),    AV_OPT_TYPE_INT, { .i64 = TONEMAP_NONE },
+      TONEMAP_NONE, TONEMAP_NB - 1, FLAGS, "tonemap" },
+    ENUM("none",     TONEMAP_NONE,     "tonemap"),
+    ENUM("linear",   TONEMAP_LINEAR,   "tonemap"),
+    ENUM("gamma",    TONEMAP_GAMMA,    "tonemap"),
+    ENUM("clip",     TONEMAP_CLIP,     "tonemap"),
+    ENUM("reinhard", TONEMAP_REINHARD, "tonemap"),
+    ENUM("hable",    TONEMAP_HABLE,    "tonemap"),
+    ENUM("mobius",   TONEMAP_MOBIUS,   "tonemap"),
+    { "tonemap_param", "Tone mapping parameter",
+      OFFSET(tonemap_param), AV_OPT_TYPE_DOUBLE, { .dbl = NAN },
+      DBL_MIN, DBL_MAX, FLAGS },
+    { "peak",       "Signal peak override",
+      OFFSET(user_peak),  AV_OPT_TYPE_DOUBLE, { .dbl = 0 },
+      0, DBL_MAX, FLAGS },
+
+#if CONFIG_SWSCALE
+    { "scale_w",    "Scale the converted video to this width",
+      OFFSET(scale_w),    AV_OPT_TYPE_INT, { .i64 = 0 },
+      0, 16384, FLAGS },
+    { "scale_h",    "Scale the converted video to this height",
+      OFFSET(scale_h),    AV_OPT_TYPE_INT, { .i64 = 0 },
+      0, 16384, FLAGS },
+    { "scale_flags", "libswscale flags for scaling",
+      OFFSET(scale_flags), AV_OPT_TYPE_STRING, { .str = "bilinear" },
+      .flags = FLAGS },
+#endif
+
     { NULL }
 };
 
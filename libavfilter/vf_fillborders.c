@@ -378,11 +378,12 @@ AVFILTER_DEFINE_CLASS(fillborders);
 
 static const AVFilterPad fillborders_inputs[] = {
     {
-        .name           = "default",
-        .type           = AVMEDIA_TYPE_VIDEO,
-        .config_props   = config_input,
-        .filter_frame   = filter_frame,
-        .needs_writable = 1,
+        .name             = "default",
+        .type             = AVMEDIA_TYPE_VIDEO,
+        .config_props     = config_input,
+        .filter_frame     = filter_frame,
+        .get_video_buffer = ff_null_get_video_buffer,
+        .needs_writable   = 1,
     },
     { NULL }
 };
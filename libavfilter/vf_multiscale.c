@@ -0,0 +1,363 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scale one input to several output sizes at once
+ */
+
+#include <inttypes.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+typedef struct MultiScaleContext {
+    const AVClass *class;
+    char *sizes_str;
+    char *flags_str;
+    double param[2];
+    int cascade;
+
+    int nb_outputs;
+    int *w, *h;
+    int flags;
+
+    struct SwsMultiContext *sws;
+    int src_w, src_h;
+    enum AVPixelFormat src_format;
+    uint8_t *(*dst)[4];
+    int (*dst_stride)[4];
+} MultiScaleContext;
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    MultiScaleContext *s = ctx->priv;
+    int idx = FF_OUTLINK_IDX(outlink);
+
+    outlink->w = s->w[idx];
+    outlink->h = s->h[idx];
+
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+    char *sizes, *p, *saveptr = NULL;
+    int i, ret;
+
+    if (s->flags_str) {
+        const AVClass *class = sws_get_class();
+        const AVOption    *o = av_opt_find(&class, "sws_flags", NULL, 0,
+                                           AV_OPT_SEARCH_FAKE_OBJ);
+        ret = av_opt_eval_flags(&class, o, s->flags_str, &s->flags);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (!s->sizes_str || !*s->sizes_str) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified.\n");
+        return AVERROR(EINVAL);
+    }
+
+    sizes = av_strdup(s->sizes_str);
+    if (!sizes)
+        return AVERROR(ENOMEM);
+
+    for (p = sizes; (p = strchr(p, '|')); p++)
+        s->nb_outputs++;
+    s->nb_outputs++;
+
+    s->w          = av_calloc(s->nb_outputs, sizeof(*s->w));
+    s->h          = av_calloc(s->nb_outputs, sizeof(*s->h));
+    s->dst        = av_calloc(s->nb_outputs, sizeof(*s->dst));
+    s->dst_stride = av_calloc(s->nb_outputs, sizeof(*s->dst_stride));
+    if (!s->w || !s->h || !s->dst || !s->dst_stride) {
+        av_free(sizes);
+        return AVERROR(ENOMEM);
+    }
+
+    for (i = 0, p = av_strtok(sizes, "|", &saveptr); p;
+         i++, p = av_strtok(NULL, "|", &saveptr)) {
+        if ((ret = av_parse_video_size(&s->w[i], &s->h[i], p)) < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid output size '%s'.\n", p);
+            av_free(sizes);
+            return ret;
+        }
+    }
+    av_free(sizes);
+    if (i != s->nb_outputs) {
+        av_log(ctx, AV_LOG_ERROR, "Empty output size in '%s'.\n", s->sizes_str);
+        return AVERROR(EINVAL);
+    }
+
+    for (i = 0; i < s->nb_outputs; i++) {
+        AVFilterPad pad = { 0 };
+
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = config_output;
+        pad.name         = av_asprintf("output%d", i);
+        if (!pad.name)
+            return AVERROR(ENOMEM);
+
+        if ((ret = ff_insert_outpad(ctx, i, &pad)) < 0) {
+            av_freep(&pad.name);
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+    int i;
+
+    sws_multi_freeContext(s->sws);
+    s->sws = NULL;
+    for (i = 0; i < ctx->nb_outputs; i++)
+        av_freep(&ctx->output_pads[i].name);
+    av_freep(&s->w);
+    av_freep(&s->h);
+    av_freep(&s->dst);
+    av_freep(&s->dst_stride);
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    AVFilterFormats *formats;
+    const AVPixFmtDescriptor *desc;
+    enum AVPixelFormat pix_fmt;
+    int i, ret;
+
+    formats = NULL;
+    desc    = NULL;
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        pix_fmt = av_pix_fmt_desc_get_id(desc);
+        if (sws_isSupportedInput(pix_fmt) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+    if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->out_formats)) < 0)
+        return ret;
+
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        formats = NULL;
+        desc    = NULL;
+        while ((desc = av_pix_fmt_desc_next(desc))) {
+            pix_fmt = av_pix_fmt_desc_get_id(desc);
+            if (sws_isSupportedOutput(pix_fmt) &&
+                (ret = ff_add_format(&formats, pix_fmt)) < 0)
+                return ret;
+        }
+        if ((ret = ff_formats_ref(formats, &ctx->outputs[i]->in_formats)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int64_t image_size(int w, int h, enum AVPixelFormat format)
+{
+    return FFMAX(av_image_get_buffer_size(format, w, h, 1), 0);
+}
+
+static int init_scaler(AVFilterContext *ctx, int w, int h, enum AVPixelFormat format)
+{
+    MultiScaleContext *s = ctx->priv;
+    enum AVPixelFormat *formats;
+    enum AVPixelFormat shared;
+    int64_t src_size = image_size(w, h, format), read = 0, split = 0;
+    int i;
+
+    sws_multi_freeContext(s->sws);
+
+    formats = av_malloc_array(s->nb_outputs, sizeof(*formats));
+    if (!formats)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < s->nb_outputs; i++)
+        formats[i] = ctx->outputs[i]->format;
+
+    s->sws = sws_multi_getContext(w, h, format, s->nb_outputs, s->w, s->h,
+                                  formats, s->flags, s->param,
+                                  ff_filter_get_nb_threads(ctx),
+                                  s->cascade ? SWS_MULTI_CASCADE : 0);
+    av_free(formats);
+    if (!s->sws)
+        return AVERROR(EINVAL);
+
+    s->src_w      = w;
+    s->src_h      = h;
+    s->src_format = format;
+
+    /* source-side bytes read per frame, against one scaler per output */
+    shared = sws_multi_get_shared_format(s->sws);
+    if (shared != AV_PIX_FMT_NONE) {
+        av_log(ctx, AV_LOG_VERBOSE, "input converted once to %s\n",
+               av_get_pix_fmt_name(shared));
+        read += src_size;
+        src_size = image_size(w, h, shared);
+    }
+    for (i = 0; i < s->nb_outputs; i++) {
+        AVFilterLink *outlink = ctx->outputs[i];
+        int src = sws_multi_get_source(s->sws, i);
+
+        if (src >= 0) {
+            av_log(ctx, AV_LOG_VERBOSE, "output%d: %dx%d %s from output%d\n",
+                   i, outlink->w, outlink->h,
+                   av_get_pix_fmt_name(outlink->format), src);
+            read += image_size(s->w[src], s->h[src], ctx->outputs[src]->format);
+        } else {
+            av_log(ctx, AV_LOG_VERBOSE, "output%d: %dx%d %s from input\n",
+                   i, outlink->w, outlink->h,
+                   av_get_pix_fmt_name(outlink->format));
+            read += src_size;
+        }
+        split += image_size(w, h, format);
+    }
+    av_log(ctx, AV_LOG_VERBOSE, "%"PRId64" bytes read per frame, "
+           "%"PRId64" with one scaler per output\n", read, split);
+
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    MultiScaleContext *s = ctx->priv;
+    AVFrame **out;
+    int i, j, ret = 0;
+
+    if (!s->sws || in->width != s->src_w || in->height != s->src_h ||
+        in->format != s->src_format) {
+        if ((ret = init_scaler(ctx, in->width, in->height, in->format)) < 0) {
+            av_frame_free(&in);
+            return ret;
+        }
+    }
+
+    out = av_calloc(s->nb_outputs, sizeof(*out));
+    if (!out) {
+        av_frame_free(&in);
+        return AVERROR(ENOMEM);
+    }
+
+    /* outputs that are closed are still scaled, other outputs may be
+     * derived from them */
+    for (i = 0; i < s->nb_outputs; i++) {
+        AVFilterLink *outlink = ctx->outputs[i];
+
+        out[i] = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out[i]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        av_frame_copy_props(out[i], in);
+        out[i]->width  = outlink->w;
+        out[i]->height = outlink->h;
+        if (in->sample_aspect_ratio.num)
+            av_reduce(&out[i]->sample_aspect_ratio.num, &out[i]->sample_aspect_ratio.den,
+                      (int64_t)in->sample_aspect_ratio.num * outlink->h * in->width,
+                      (int64_t)in->sample_aspect_ratio.den * outlink->w * in->height,
+                      INT_MAX);
+        for (j = 0; j < 4; j++) {
+            s->dst[i][j]        = out[i]->data[j];
+            s->dst_stride[i][j] = out[i]->linesize[j];
+        }
+    }
+
+    ret = sws_multi_scale(s->sws, (const uint8_t *const *)in->data, in->linesize,
+                          s->dst, (const int (*)[4])s->dst_stride);
+    if (ret < 0)
+        goto end;
+
+    ret = AVERROR_EOF;
+    for (i = 0; i < s->nb_outputs; i++) {
+        if (ff_outlink_get_status(ctx->outputs[i]))
+            continue;
+        ret = ff_filter_frame(ctx->outputs[i], out[i]);
+        out[i] = NULL;
+        if (ret < 0)
+            break;
+    }
+
+end:
+    for (i = 0; i < s->nb_outputs; i++)
+        av_frame_free(&out[i]);
+    av_free(out);
+    av_frame_free(&in);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(MultiScaleContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption multiscale_options[] = {
+    { "sizes",   "set the '|'-separated output sizes", OFFSET(sizes_str), AV_OPT_TYPE_STRING, { .str = NULL }, .flags = FLAGS },
+    { "flags",   "Flags to pass to libswscale", OFFSET(flags_str), AV_OPT_TYPE_STRING, { .str = "bilinear" }, .flags = FLAGS },
+    { "cascade", "scale each output from the nearest larger output", OFFSET(cascade), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { "param0",  "Scaler param 0", OFFSET(param[0]), AV_OPT_TYPE_DOUBLE, { .dbl = SWS_PARAM_DEFAULT }, INT_MIN, INT_MAX, FLAGS },
+    { "param1",  "Scaler param 1", OFFSET(param[1]), AV_OPT_TYPE_DOUBLE, { .dbl = SWS_PARAM_DEFAULT }, INT_MIN, INT_MAX, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(multiscale);
+
+static const AVFilterPad multiscale_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_multiscale = {
+    .name          = "multiscale",
+    .description   = NULL_IF_CONFIG_SMALL("Scale the input video to several output sizes."),
+    .priv_size     = sizeof(MultiScaleContext),
+    .priv_class    = &multiscale_class,
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = multiscale_inputs,
+    .outputs       = NULL,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+};
@@ -258,6 +258,7 @@ static AVFrame *get_video_buffer(AVFilterLink *inlink, int w, int h)
 static int buffer_needs_copy(PadContext *s, AVFrame *frame, AVBufferRef *buf)
 {
     int planes[4] = { -1, -1, -1, -1}, *p = planes;
+    ptrdiff_t start[4], end[4];
     int i, j;
 
     /* get all planes in this buffer */
@@ -266,43 +267,33 @@ static int buffer_needs_copy(PadContext *s, AVFrame *frame, AVBufferRef *buf)
             *p++ = i;
     }
 
-    /* for each plane in this buffer, check that it can be padded without
-     * going over buffer bounds or other planes */
+    /* for each plane in this buffer, find the range of the buffer the padded
+     * plane covers and check that it is within the buffer bounds; planes
+     * stored bottom-up (e.g. by vflip) have a negative linesize */
     for (i = 0; i < FF_ARRAY_ELEMS(planes) && planes[i] >= 0; i++) {
         int hsub = s->draw.hsub[planes[i]];
         int vsub = s->draw.vsub[planes[i]];
-
-        uint8_t *start = frame->data[planes[i]];
-        uint8_t *end   = start + (frame->height >> vsub) *
-                                 frame->linesize[planes[i]];
-
-        /* amount of free space needed before the start and after the end
-         * of the plane */
-        ptrdiff_t req_start = (s->x >> hsub) * s->draw.pixelstep[planes[i]] +
-                              (s->y >> vsub) * frame->linesize[planes[i]];
-        ptrdiff_t req_end   = ((s->w - s->x - frame->width) >> hsub) *
-                              s->draw.pixelstep[planes[i]] +
-                              ((s->h - s->y - frame->height) >> vsub) * frame->linesize[planes[i]];
-
-        if (frame->linesize[planes[i]] < (s->w >> hsub) * s->draw.pixelstep[planes[i]])
-            return 1;
-        if (start - buf->data < req_start ||
-            (buf->data + buf->size) - end < req_end)
+        ptrdiff_t linesize = frame->linesize[planes[i]];
+        ptrdiff_t width    = (s->w >> hsub) * s->draw.pixelstep[planes[i]];
+        ptrdiff_t first    = frame->data[planes[i]] - buf->data -
+                             (s->x >> hsub) * s->draw.pixelstep[planes[i]] -
+                             (s->y >> vsub) * linesize;
+        ptrdiff_t last     = first + ((s->h >> vsub) - 1) * linesize;
+
+        if (FFABS(linesize) < width)
             return 1;
 
-        for (j = 0; j < FF_ARRAY_ELEMS(planes) && planes[j] >= 0; j++) {
-            int vsub1 = s->draw.vsub[planes[j]];
-            uint8_t *start1 = frame->data[planes[j]];
-            uint8_t *end1   = start1 + (frame->height >> vsub1) *
-                                       frame->linesize[planes[j]];
-            if (i == j)
-                continue;
+        start[i] = FFMIN(first, last);
+        end[i]   = FFMAX(first, last) + width;
+        if (start[i] < 0 || end[i] > buf->size)
+            return 1;
+    }
 
-            if (FFSIGN(start - end1) != FFSIGN(start - end1 - req_start) ||
-                FFSIGN(end - start1) != FFSIGN(end - start1 + req_end))
+    /* the padded planes must not overlap each other */
+    for (i = 0; i < FF_ARRAY_ELEMS(planes) && planes[i] >= 0; i++)
+        for (j = 0; j < i; j++)
+            if (start[i] < end[j] && start[j] < end[i])
                 return 1;
-        }
-    }
 
     return 0;
 }
@@ -355,6 +346,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 
     if (needs_copy) {
         av_log(inlink->dst, AV_LOG_DEBUG, "Direct padding impossible allocating new frame\n");
+        ff_filter_count_frame_copy(inlink->dst);
         out = ff_get_video_buffer(inlink->dst->outputs[0],
                                   FFMAX(inlink->w, s->w),
                                   FFMAX(inlink->h, s->h));
@@ -33,6 +33,9 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#if CONFIG_SWSCALE
+#include "libswscale/swscale.h"
+#endif
 
 #include "avfilter.h"
 #include "formats.h"
@@ -49,9 +52,22 @@ typedef struct TransContext {
     int passthrough;    ///< PassthroughType, landscape passthrough mode enabled
     int dir;            ///< TransposeDir
 
+    int tile;           ///< side of the square tiles the planes are walked in
+
     TransVtable vtables[4];
+
+#if CONFIG_SWSCALE
+    int scale_w, scale_h;
+    char *scale_flags;
+    struct SwsContext *sws;     ///< scales the transposed frame band by band
+    uint8_t *band[4];           ///< transposed rows not scaled yet
+    int band_linesize[4];
+#endif
 } TransContext;
 
+/* rows of the transposed frame that are scaled at once */
+#define BAND_HEIGHT 64
+
 static int query_formats(AVFilterContext *ctx)
 {
     AVFilterFormats *pix_fmts = NULL;
@@ -174,6 +190,67 @@ static void transpose_8x8_64_c(uint8_t *src, ptrdiff_t src_linesize,
     transpose_block_64_c(src, src_linesize, dst, dst_linesize, 8, 8);
 }
 
+av_cold void ff_transpose_init(TransVtable *v, int pixstep)
+{
+    switch (pixstep) {
+    case 1: v->transpose_block = transpose_block_8_c;
+            v->transpose_8x8   = transpose_8x8_8_c;  break;
+    case 2: v->transpose_block = transpose_block_16_c;
+            v->transpose_8x8   = transpose_8x8_16_c; break;
+    case 3: v->transpose_block = transpose_block_24_c;
+            v->transpose_8x8   = transpose_8x8_24_c; break;
+    case 4: v->transpose_block = transpose_block_32_c;
+            v->transpose_8x8   = transpose_8x8_32_c; break;
+    case 6: v->transpose_block = transpose_block_48_c;
+            v->transpose_8x8   = transpose_8x8_48_c; break;
+    case 8: v->transpose_block = transpose_block_64_c;
+            v->transpose_8x8   = transpose_8x8_64_c; break;
+    }
+
+    if (ARCH_X86)
+        ff_transpose_init_x86(v, pixstep);
+}
+
+#if CONFIG_SWSCALE
+static av_cold int init_scale(AVFilterContext *ctx, int w, int h)
+{
+    TransContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    int ret;
+
+    sws_freeContext(s->sws);
+    s->sws = NULL;
+    av_freep(&s->band[0]);
+
+    if ((!s->scale_w || s->scale_w == w) && (!s->scale_h || s->scale_h == h))
+        return 0;
+
+    s->sws = sws_alloc_context();
+    if (!s->sws)
+        return AVERROR(ENOMEM);
+    av_opt_set_int(s->sws, "srcw", w, 0);
+    av_opt_set_int(s->sws, "srch", h, 0);
+    av_opt_set_int(s->sws, "src_format", outlink->format, 0);
+    av_opt_set_int(s->sws, "dstw", s->scale_w ? s->scale_w : w, 0);
+    av_opt_set_int(s->sws, "dsth", s->scale_h ? s->scale_h : h, 0);
+    av_opt_set_int(s->sws, "dst_format", outlink->format, 0);
+    if ((ret = av_opt_set(s->sws, "sws_flags", s->scale_flags, 0)) < 0 ||
+        (ret = sws_init_context(s->sws, NULL, NULL)) < 0)
+        return ret;
+
+    ret = av_image_alloc(s->band, s->band_linesize, w, BAND_HEIGHT,
+                         outlink->format, 32);
+    if (ret < 0)
+        return ret;
+
+    outlink->w = s->scale_w ? s->scale_w : w;
+    outlink->h = s->scale_h ? s->scale_h : h;
+    outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * w, outlink->w * h },
+                                            outlink->sample_aspect_ratio);
+    return 0;
+}
+#endif
+
 static int config_props_output(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
@@ -194,6 +271,12 @@ static int config_props_output(AVFilterLink *outlink)
         av_log(ctx, AV_LOG_VERBOSE,
                "w:%d h:%d -> w:%d h:%d (passthrough mode)\n",
                inlink->w, inlink->h, inlink->w, inlink->h);
+#if CONFIG_SWSCALE
+        if (s->scale_w || s->scale_h) {
+            av_log(ctx, AV_LOG_ERROR, "Scaling is not supported in passthrough mode\n");
+            return AVERROR(EINVAL);
+        }
+#endif
         return 0;
     } else {
         s->passthrough = TRANSPOSE_PT_TYPE_NONE;
@@ -217,31 +300,19 @@ static int config_props_output(AVFilterLink *outlink)
     else
         outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
 
-    for (int i = 0; i < 4; i++) {
-        TransVtable *v = &s->vtables[i];
-        switch (s->pixsteps[i]) {
-        case 1: v->transpose_block = transpose_block_8_c;
-                v->transpose_8x8   = transpose_8x8_8_c;  break;
-        case 2: v->transpose_block = transpose_block_16_c;
-                v->transpose_8x8   = transpose_8x8_16_c; break;
-        case 3: v->transpose_block = transpose_block_24_c;
-                v->transpose_8x8   = transpose_8x8_24_c; break;
-        case 4: v->transpose_block = transpose_block_32_c;
-                v->transpose_8x8   = transpose_8x8_32_c; break;
-        case 6: v->transpose_block = transpose_block_48_c;
-                v->transpose_8x8   = transpose_8x8_48_c; break;
-        case 8: v->transpose_block = transpose_block_64_c;
-                v->transpose_8x8   = transpose_8x8_64_c; break;
-        }
-    }
+    for (int i = 0; i < 4; i++)
+        ff_transpose_init(&s->vtables[i], s->pixsteps[i]);
 
-    if (ARCH_X86) {
-        for (int i = 0; i < 4; i++) {
-            TransVtable *v = &s->vtables[i];
+    /* keep the source and destination of a tile within about 16 kB */
+    s->tile = s->pixsteps[0] <= 2 ? 64 : 32;
 
-            ff_transpose_init_x86(v, s->pixsteps[i]);
-        }
+#if CONFIG_SWSCALE
+    {
+        int ret = init_scale(ctx, outlink->w, outlink->h);
+        if (ret < 0)
+            return ret;
     }
+#endif
 
     av_log(ctx, AV_LOG_VERBOSE,
            "w:%d h:%d dir:%d -> w:%d h:%d rotation:%s vflip:%d\n",
@@ -264,6 +335,72 @@ typedef struct ThreadData {
     AVFrame *in, *out;
 } ThreadData;
 
+static void transpose_tile(TransVtable *v, int pixstep,
+                           uint8_t *src, ptrdiff_t srclinesize,
+                           uint8_t *dst, ptrdiff_t dstlinesize, int w, int h)
+{
+    int x, y;
+
+    for (y = 0; y <= h - 8; y += 8) {
+        for (x = 0; x <= w - 8; x += 8)
+            v->transpose_8x8(src + x * srclinesize + y * pixstep, srclinesize,
+                             dst + y * dstlinesize + x * pixstep, dstlinesize);
+        if (x < w)
+            v->transpose_block(src + x * srclinesize + y * pixstep, srclinesize,
+                               dst + y * dstlinesize + x * pixstep, dstlinesize,
+                               w - x, 8);
+    }
+    if (y < h)
+        v->transpose_block(src + y * pixstep, srclinesize,
+                           dst + y * dstlinesize, dstlinesize, w, h - y);
+}
+
+/**
+ * Write rows start to end of a plane of the transposed frame to dst, which
+ * points to row start.
+ */
+static void transpose_rows(TransContext *s, int plane, const AVFrame *in,
+                           uint8_t *dst, int dstlinesize, int start, int end)
+{
+    int hsub    = plane == 1 || plane == 2 ? s->hsub : 0;
+    int vsub    = plane == 1 || plane == 2 ? s->vsub : 0;
+    int pixstep = s->pixsteps[plane];
+    int inh     = AV_CEIL_RSHIFT(in->height, vsub);
+    int outw    = AV_CEIL_RSHIFT(in->height, hsub);
+    int outh    = AV_CEIL_RSHIFT(in->width,  vsub);
+    TransVtable *v = &s->vtables[plane];
+    uint8_t *src = in->data[plane];
+    int srclinesize = in->linesize[plane];
+    int x, y;
+
+    if (s->dir & 1) {
+        src         += in->linesize[plane] * (inh - 1);
+        srclinesize *= -1;
+    }
+
+    /* row y of the transposed plane comes from column y of the source,
+     * with a vertical flip it is written to row outh - 1 - y */
+    if (s->dir & 2) {
+        int tmp = start;
+        start        = outh - end;
+        end          = outh - tmp;
+        dst         += dstlinesize * (end - start - 1);
+        dstlinesize *= -1;
+    }
+
+    /* walk the plane in tiles which fit in the cache for both the source
+     * columns and the destination rows */
+    for (y = start; y < end; y += s->tile) {
+        int h = FFMIN(s->tile, end - y);
+
+        for (x = 0; x < outw; x += s->tile)
+            transpose_tile(v, pixstep,
+                           src + x * srclinesize + y * pixstep, srclinesize,
+                           dst + (y - start) * dstlinesize + x * pixstep, dstlinesize,
+                           FFMIN(s->tile, outw - x), h);
+    }
+}
+
 static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr,
                         int nb_jobs)
 {
@@ -274,57 +411,43 @@ static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr,
     int plane;
 
     for (plane = 0; plane < s->planes; plane++) {
-        int hsub    = plane == 1 || plane == 2 ? s->hsub : 0;
-        int vsub    = plane == 1 || plane == 2 ? s->vsub : 0;
-        int pixstep = s->pixsteps[plane];
-        int inh     = AV_CEIL_RSHIFT(in->height, vsub);
-        int outw    = AV_CEIL_RSHIFT(out->width,  hsub);
-        int outh    = AV_CEIL_RSHIFT(out->height, vsub);
-        int start   = (outh *  jobnr   ) / nb_jobs;
-        int end     = (outh * (jobnr+1)) / nb_jobs;
-        uint8_t *dst, *src;
-        int dstlinesize, srclinesize;
-        int x, y;
-        TransVtable *v = &s->vtables[plane];
-
-        dstlinesize = out->linesize[plane];
-        dst         = out->data[plane] + start * dstlinesize;
-        src         = in->data[plane];
-        srclinesize = in->linesize[plane];
-
-        if (s->dir & 1) {
-            src         += in->linesize[plane] * (inh - 1);
-            srclinesize *= -1;
-        }
+        int vsub  = plane == 1 || plane == 2 ? s->vsub : 0;
+        int outh  = AV_CEIL_RSHIFT(out->height, vsub);
+        /* slices start on 8 row boundaries so no block is split */
+        int start = (outh * jobnr / nb_jobs) & ~7;
+        int end   = jobnr == nb_jobs - 1 ? outh : (outh * (jobnr + 1) / nb_jobs) & ~7;
+
+        transpose_rows(s, plane, in, out->data[plane] + start * out->linesize[plane],
+                       out->linesize[plane], start, end);
+    }
 
-        if (s->dir & 2) {
-            dst          = out->data[plane] + dstlinesize * (outh - start - 1);
-            dstlinesize *= -1;
-        }
+    return 0;
+}
 
-        for (y = start; y < end - 7; y += 8) {
-            for (x = 0; x < outw - 7; x += 8) {
-                v->transpose_8x8(src + x * srclinesize + y * pixstep,
-                                 srclinesize,
-                                 dst + (y - start) * dstlinesize + x * pixstep,
-                                 dstlinesize);
-            }
-            if (outw - x > 0 && end - y > 0)
-                v->transpose_block(src + x * srclinesize + y * pixstep,
-                                   srclinesize,
-                                   dst + (y - start) * dstlinesize + x * pixstep,
-                                   dstlinesize, outw - x, end - y);
-        }
+#if CONFIG_SWSCALE
+static int transpose_scale(TransContext *s, const AVFrame *in, AVFrame *out)
+{
+    int h = in->width;
+    int y, plane, ret;
+
+    for (y = 0; y < h; y += BAND_HEIGHT) {
+        int band_h = FFMIN(BAND_HEIGHT, h - y);
 
-        if (end - y > 0)
-            v->transpose_block(src + 0 * srclinesize + y * pixstep,
-                               srclinesize,
-                               dst + (y - start) * dstlinesize + 0 * pixstep,
-                               dstlinesize, outw, end - y);
+        for (plane = 0; plane < s->planes; plane++) {
+            int vsub = plane == 1 || plane == 2 ? s->vsub : 0;
+
+            transpose_rows(s, plane, in, s->band[plane], s->band_linesize[plane],
+                           y >> vsub, AV_CEIL_RSHIFT(y + band_h, vsub));
+        }
+        ret = sws_scale(s->sws, (const uint8_t * const *)s->band, s->band_linesize,
+                        y, band_h, out->data, out->linesize);
+        if (ret < 0)
+            return ret;
     }
 
     return 0;
 }
+#endif
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
@@ -351,12 +474,37 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         out->sample_aspect_ratio.den = in->sample_aspect_ratio.num;
     }
 
+#if CONFIG_SWSCALE
+    if (s->sws) {
+        int ret = transpose_scale(s, in, out);
+        out->sample_aspect_ratio = outlink->sample_aspect_ratio;
+        av_frame_free(&in);
+        if (ret < 0) {
+            av_frame_free(&out);
+            return ret;
+        }
+        return ff_filter_frame(outlink, out);
+    }
+#endif
+
     td.in = in, td.out = out;
-    ctx->internal->execute(ctx, filter_slice, &td, NULL, FFMIN(outlink->h, ff_filter_get_nb_threads(ctx)));
+    ctx->internal->execute(ctx, filter_slice, &td, NULL,
+                           FFMIN(AV_CEIL_RSHIFT(outlink->h, 4), ff_filter_get_nb_threads(ctx)));
     av_frame_free(&in);
     return ff_filter_frame(outlink, out);
 }
 
+static av_cold void uninit(AVFilterContext *ctx)
+{
+#if CONFIG_SWSCALE
+    TransContext *s = ctx->priv;
+
+    sws_freeContext(s->sws);
+    s->sws = NULL;
+    av_freep(&s->band[0]);
+#endif
+}
+
 #define OFFSET(x) offsetof(TransContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
 
@@ -373,6 +521,12 @@ static const AVOption transpose_options[] = {
         { "portrait",  "preserve portrait geometry",   0, AV_OPT_TYPE_CONST, {.i64=TRANSPOSE_PT_TYPE_PORTRAIT},  INT_MIN, INT_MAX, FLAGS, "passthrough" },
         { "landscape", "preserve landscape geometry",  0, AV_OPT_TYPE_CONST, {.i64=TRANSPOSE_PT_TYPE_LANDSCAPE}, INT_MIN, INT_MAX, FLAGS, "passthrough" },
 
+#if CONFIG_SWSCALE
+    { "scale_w", "scale the transposed video to this width",  OFFSET(scale_w), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 16384, FLAGS },
+    { "scale_h", "scale the transposed video to this height", OFFSET(scale_h), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 16384, FLAGS },
+    { "scale_flags", "set libswscale flags for scaling", OFFSET(scale_flags), AV_OPT_TYPE_STRING, { .str = "bilinear" }, .flags = FLAGS },
+#endif
+
     { NULL }
 };
 
@@ -402,6 +556,7 @@ AVFilter ff_vf_transpose = {
     .description   = NULL_IF_CONFIG_SMALL("Transpose input video."),
     .priv_size     = sizeof(TransContext),
     .priv_class    = &transpose_class,
+    .uninit        = uninit,
     .query_formats = query_formats,
     .inputs        = avfilter_vf_transpose_inputs,
     .outputs       = avfilter_vf_transpose_outputs,
@@ -1494,6 +1494,7 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_FAST_SEEK   0x80000 ///< Enable fast, but inaccurate seeks for some formats
 #define AVFMT_FLAG_SHORTEST   0x100000 ///< Stop muxing when the shortest stream stops.
 #define AVFMT_FLAG_AUTO_BSF   0x200000 ///< Add bitstream filters as requested by the muxer
+#define AVFMT_FLAG_PROBE_SELECTED 0x400000 ///< Ignore streams discarded with AVDISCARD_ALL in avformat_find_stream_info()
 
     /**
      * Maximum size of the data read from input for determining
@@ -1951,6 +1952,23 @@ typedef struct AVFormatContext {
      * - decoding: set by user
      */
     int max_probe_packets;
+
+    /**
+     * Number of threads used by avformat_find_stream_info() to decode
+     * packets of different streams concurrently, 0 for one thread per
+     * CPU. 1 decodes on the calling thread.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int probe_threads;
+
+    /**
+     * Maximum wall clock time in microseconds avformat_find_stream_info()
+     * spends reading packets, 0 for no limit.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int64_t analyze_timeout;
 } AVFormatContext;
 
 #if FF_API_FORMAT_GET_SET
@@ -2845,6 +2863,62 @@ int av_index_search_timestamp(AVStream *st, int64_t timestamp, int flags);
 int av_add_index_entry(AVStream *st, int64_t pos, int64_t timestamp,
                        int size, int distance, int flags);
 
+/**
+ * Add several index entries at once, in any order. The result is the same
+ * as adding them one by one with av_add_index_entry(), but the index is
+ * sorted and merged in a single pass instead of moving its tail for every
+ * entry inserted in front of it.
+ *
+ * @param st         stream whose index is updated
+ * @param entries    entries to add, with timestamps in the time base of st;
+ *                   min_distance is the distance argument of
+ *                   av_add_index_entry()
+ * @param nb_entries number of entries
+ * @return 0 on success, a negative AVERROR code on error, in which case the
+ *         index is not modified
+ */
+int av_add_index_entries(AVStream *st, const AVIndexEntry *entries, int nb_entries);
+
+/**
+ * Get the index entry count for the given AVStream.
+ *
+ * @param st stream
+ * @return the number of index entries in the stream
+ */
+int avformat_index_get_entries_count(AVStream *st);
+
+/**
+ * Get the AVIndexEntry corresponding to the given index.
+ *
+ * @param st          Stream containing the requested AVIndexEntry.
+ * @param idx         The desired index.
+ * @return A pointer to the requested AVIndexEntry if it exists, NULL otherwise.
+ *
+ * @note The pointer returned by this function is only guaranteed to be valid
+ *       until any function that takes the stream or the parent AVFormatContext
+ *       as input argument is called.
+ */
+const AVIndexEntry *avformat_index_get_entry(AVStream *st, int idx);
+
+/**
+ * Get the AVIndexEntry corresponding to the given timestamp.
+ *
+ * @param st          Stream containing the requested AVIndexEntry.
+ * @param wanted_timestamp Timestamp to retrieve the index entry for.
+ * @param flags       If AVSEEK_FLAG_BACKWARD then the returned entry will correspond
+ *                    to the timestamp which is <= the requested one, if backward
+ *                    is 0, then it will be >=
+ *                    if AVSEEK_FLAG_ANY seek to any frame, only keyframes otherwise.
+ * @return A pointer to the requested AVIndexEntry if it exists, NULL otherwise.
+ *
+ * @note The pointer returned by this function is only guaranteed to be valid
+ *       until any function that takes the stream or the parent AVFormatContext
+ *       as input argument is called.
+ */
+const AVIndexEntry *avformat_index_get_entry_from_timestamp(AVStream *st,
+                                                            int64_t wanted_timestamp,
+                                                            int flags);
+
 
 /**
  * Split a URL string into components.
@@ -23,16 +23,19 @@
 
 /**
  * @TODO
- *      support keeping files
- *      support filling with a background thread
+ *      support filling the temporary file with a background thread
  */
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/hash.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
+#include "libavutil/random_seed.h"
+#include "libavutil/thread.h"
 #include "libavutil/tree.h"
 #include "avformat.h"
+#include "internal.h"
 #include <fcntl.h>
 #if HAVE_IO_H
 #include <io.h>
@@ -40,11 +43,19 @@
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if HAVE_DIRENT_H
+#include <dirent.h>
+#include <utime.h>
+#endif
 #include <sys/stat.h>
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
 
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
 typedef struct CacheEntry {
     int64_t logical_pos;
     int64_t physical_pos;
@@ -64,6 +75,33 @@ typedef struct Context {
     URLContext *inner;
     int64_t cache_hit, cache_miss;
     int read_ahead_limit;
+
+    /* persistent block cache, used when cache_dir is set */
+    char *cache_dir;
+    int block_size;
+    int64_t max_cache_size;
+    int prefetch;
+    char *key_dir;              ///< cache_dir/<hash of the resource key>
+    int64_t size;               ///< size of the resource
+    uint8_t *block;             ///< block holding the read position
+    int64_t block_index;        ///< index of the block in memory, -1 if none
+    int block_len;
+    int64_t stored_bytes;       ///< bytes stored since the last eviction pass
+#if HAVE_THREADS
+    char *url;
+    AVDictionary *inner_options;
+    URLContext *prefetch_inner;
+    int64_t prefetch_pos;
+    uint8_t *prefetch_block;
+    int64_t prefetch_next;      ///< next block to prefetch
+    int64_t prefetch_end;       ///< last block to prefetch
+    int64_t prefetch_busy;      ///< block being prefetched, -1 if none
+    int abort_request;
+    int thread_started;
+    pthread_t prefetch_thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
 } Context;
 
 static int cmp(const void *key, const void *node)
@@ -71,6 +109,9 @@ static int cmp(const void *key, const void *node)
     return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
 }
 
+static int block_cache_open(URLContext *h, const char *url);
+static void block_cache_close(URLContext *h);
+
 static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     int ret;
@@ -79,9 +120,30 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "cache:", &arg);
 
+#if HAVE_THREADS
+    if (c->cache_dir && c->prefetch && options)
+        av_dict_copy(&c->inner_options, *options, 0);
+#endif
+    ret = ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
+                               options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0)
+        return ret;
+
+    if (c->cache_dir) {
+        if (!c->inner->is_streamed && ffurl_size(c->inner) >= 0) {
+            if ((ret = block_cache_open(h, arg)) < 0)
+                block_cache_close(h);
+            return ret;
+        }
+        av_log(h, AV_LOG_WARNING, "Input is not seekable or has an unknown size, "
+               "not using the persistent cache\n");
+        av_freep(&c->cache_dir);
+    }
+
     c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
     if (c->fd < 0){
         av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
+        ffurl_closep(&c->inner);
         return c->fd;
     }
 
@@ -92,8 +154,458 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
     else
         c->filename = buffername;
 
-    return ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
-                                options, h->protocol_whitelist, h->protocol_blacklist, h);
+    return 0;
+}
+
+/* Persistent block cache: the resource is stored as files of block_size
+ * bytes in a directory named after a hash of the URL and validators.
+ * Blocks are written to a temporary file and renamed, so that processes
+ * sharing the directory only ever see complete blocks. */
+
+/* length of the key directory name, a SHA256 in hex */
+#define KEY_NAME_LEN   (2 * 32)
+/* length of a block file name, see block_path() */
+#define BLOCK_NAME_LEN 16
+
+static char *block_path(Context *c, int64_t index)
+{
+    return av_asprintf("%s/%016"PRIx64, c->key_dir, index);
+}
+
+static int block_expected_len(Context *c, int64_t index)
+{
+    return FFMIN(c->block_size, c->size - index * c->block_size);
+}
+
+/* Load a block from the cache directory, return its length or AVERROR(ENOENT). */
+static int block_load(URLContext *h, int64_t index, uint8_t *buf)
+{
+    Context *c = h->priv_data;
+    char *path = block_path(c, index);
+    int fd, len = 0, ret;
+
+    if (!path)
+        return AVERROR(ENOMEM);
+    fd = avpriv_open(path, O_RDONLY | O_BINARY);
+    if (fd < 0) {
+        av_free(path);
+        return AVERROR(ENOENT);
+    }
+    while (len < c->block_size) {
+        ret = read(fd, buf + len, c->block_size - len);
+        if (ret <= 0)
+            break;
+        len += ret;
+    }
+    close(fd);
+#if HAVE_DIRENT_H
+    /* the modification time orders blocks for eviction */
+    utime(path, NULL);
+#endif
+    av_free(path);
+
+    return len == block_expected_len(c, index) ? len : AVERROR(ENOENT);
+}
+
+static int block_exists(Context *c, int64_t index)
+{
+    struct stat st;
+    char *path = block_path(c, index);
+    int ret;
+
+    if (!path)
+        return 0;
+    ret = !stat(path, &st);
+    av_free(path);
+    return ret;
+}
+
+static int block_store(URLContext *h, int64_t index, const uint8_t *buf, int len)
+{
+    Context *c = h->priv_data;
+    char *path = block_path(c, index);
+    char *tmp  = path ? av_asprintf("%s.%08x.tmp", path, av_get_random_seed()) : NULL;
+    int fd, ret = 0;
+
+    if (!tmp) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    fd = avpriv_open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_BINARY, 0644);
+    if (fd < 0) {
+        ret = AVERROR(errno);
+        goto end;
+    }
+    if (write(fd, buf, len) != len)
+        ret = AVERROR(EIO);
+    close(fd);
+    if (!ret && rename(tmp, path) < 0)
+        ret = AVERROR(errno);
+    if (ret < 0)
+        unlink(tmp);
+
+end:
+    if (ret < 0)
+        av_log(h, AV_LOG_WARNING, "Failed to store cache block %s: %s\n",
+               path ? path : "", av_err2str(ret));
+    av_free(path);
+    av_free(tmp);
+    return ret;
+}
+
+/* Read one block from the given inner context, return its length. */
+static int block_fetch(URLContext *h, URLContext *inner, int64_t *inner_pos,
+                       int64_t index, uint8_t *buf)
+{
+    Context *c = h->priv_data;
+    int64_t pos = index * c->block_size;
+    int len = 0, expected = block_expected_len(c, index), ret;
+
+    if (*inner_pos != pos) {
+        int64_t r = ffurl_seek(inner, pos, SEEK_SET);
+        if (r < 0) {
+            av_log(h, AV_LOG_ERROR, "Failed to perform internal seek\n");
+            return r;
+        }
+        *inner_pos = r;
+    }
+    while (len < expected) {
+        ret = ffurl_read(inner, buf + len, expected - len);
+        if (!ret || ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            return ret;
+        len += ret;
+        *inner_pos += ret;
+    }
+    return len;
+}
+
+#if HAVE_DIRENT_H
+typedef struct CacheFile {
+    char *path;
+    int64_t size;
+    time_t mtime;
+} CacheFile;
+
+static int cmp_mtime(const void *a, const void *b)
+{
+    const CacheFile *fa = a, *fb = b;
+    return FFDIFFSIGN(fa->mtime, fb->mtime);
+}
+
+/* Check that name is exactly len lowercase hex digits. */
+static int is_cache_name(const char *name, size_t len)
+{
+    return strlen(name) == len && strspn(name, "0123456789abcdef") == len;
+}
+
+/* Delete the least recently used blocks until the cache directory
+ * is below 90% of max_cache_size. Only complete blocks in key directories
+ * are considered: the directory may be shared with other files, and
+ * temporary blocks belong to writers that are still running. */
+static void cache_evict(URLContext *h)
+{
+    Context *c = h->priv_data;
+    CacheFile *files = NULL;
+    int nb_files = 0, i;
+    int64_t total = 0;
+    DIR *dir, *subdir;
+    struct dirent *entry, *subentry;
+
+    if (!(dir = opendir(c->cache_dir)))
+        return;
+    while ((entry = readdir(dir))) {
+        char *dirpath;
+
+        if (!is_cache_name(entry->d_name, KEY_NAME_LEN))
+            continue;
+        if (!(dirpath = av_asprintf("%s/%s", c->cache_dir, entry->d_name)))
+            break;
+        if ((subdir = opendir(dirpath))) {
+            while ((subentry = readdir(subdir))) {
+                CacheFile file = { 0 };
+                struct stat st;
+
+                if (!is_cache_name(subentry->d_name, BLOCK_NAME_LEN))
+                    continue;
+                file.path = av_asprintf("%s/%s", dirpath, subentry->d_name);
+                if (!file.path)
+                    break;
+                if (stat(file.path, &st) < 0 || !S_ISREG(st.st_mode) ||
+                    av_reallocp_array(&files, nb_files + 1, sizeof(*files)) < 0) {
+                    av_free(file.path);
+                    continue;
+                }
+                file.size = st.st_size;
+                file.mtime = st.st_mtime;
+                files[nb_files++] = file;
+                total += file.size;
+            }
+            closedir(subdir);
+        }
+        av_free(dirpath);
+    }
+    closedir(dir);
+
+    if (total > c->max_cache_size) {
+        int64_t target = c->max_cache_size / 10 * 9;
+
+        qsort(files, nb_files, sizeof(*files), cmp_mtime);
+        for (i = 0; i < nb_files && total > target; i++)
+            if (!unlink(files[i].path))
+                total -= files[i].size;
+        av_log(h, AV_LOG_VERBOSE, "Evicted %d cache blocks\n", i);
+    }
+
+    for (i = 0; i < nb_files; i++)
+        av_free(files[i].path);
+    av_free(files);
+}
+#else
+static void cache_evict(URLContext *h)
+{
+}
+#endif
+
+static void block_stored(URLContext *h, int len)
+{
+    Context *c = h->priv_data;
+    int evict;
+
+#if HAVE_THREADS
+    if (c->thread_started)
+        pthread_mutex_lock(&c->mutex);
+#endif
+    c->stored_bytes += len;
+    evict = c->max_cache_size && c->stored_bytes > c->max_cache_size / 16;
+    if (evict)
+        c->stored_bytes = 0;
+#if HAVE_THREADS
+    if (c->thread_started)
+        pthread_mutex_unlock(&c->mutex);
+#endif
+    if (evict)
+        cache_evict(h);
+}
+
+#if HAVE_THREADS
+static int prefetch_check_interrupt(void *arg)
+{
+    URLContext *h = arg;
+    Context    *c = h->priv_data;
+
+    return c->abort_request || ff_check_interrupt(&h->interrupt_callback);
+}
+
+static void *prefetch_task(void *arg)
+{
+    URLContext *h = arg;
+    Context    *c = h->priv_data;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->abort_request) {
+        int64_t index;
+        int ret = 0;
+
+        if (c->prefetch_next > c->prefetch_end ||
+            c->prefetch_next * c->block_size >= c->size) {
+            pthread_cond_wait(&c->cond, &c->mutex);
+            continue;
+        }
+        index = c->prefetch_next++;
+        c->prefetch_busy = index;
+        pthread_mutex_unlock(&c->mutex);
+
+        if (!block_exists(c, index)) {
+            if (!c->prefetch_inner) {
+                AVIOInterruptCB interrupt_callback = { prefetch_check_interrupt, h };
+                AVDictionary *options = NULL;
+
+                av_dict_copy(&options, c->inner_options, 0);
+                ret = ffurl_open_whitelist(&c->prefetch_inner, c->url, AVIO_FLAG_READ,
+                                           &interrupt_callback, &options,
+                                           h->protocol_whitelist, h->protocol_blacklist, h);
+                av_dict_free(&options);
+                c->prefetch_pos = 0;
+            }
+            if (ret >= 0)
+                ret = block_fetch(h, c->prefetch_inner, &c->prefetch_pos,
+                                  index, c->prefetch_block);
+            if (ret == block_expected_len(c, index) && block_store(h, index, c->prefetch_block, ret) >= 0)
+                block_stored(h, ret);
+        }
+
+        pthread_mutex_lock(&c->mutex);
+        if (ret < 0 && ret != AVERROR_EXIT) {
+            av_log(h, AV_LOG_WARNING, "Prefetching stopped: %s\n", av_err2str(ret));
+            c->prefetch_end = -1;
+        }
+        c->prefetch_busy = -1;
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+#endif
+
+static int block_cache_open(URLContext *h, const char *url)
+{
+    Context *c = h->priv_data;
+    struct AVHashContext *hash;
+    uint8_t key[KEY_NAME_LEN + 1];
+    char *validator = NULL;
+    static const char *const validators[] = { "etag", "last_modified" };
+    int i, ret;
+
+    c->size        = ffurl_size(c->inner);
+    c->block_index = -1;
+    h->is_streamed = 0;
+
+    if ((ret = av_hash_alloc(&hash, "SHA256")) < 0)
+        return ret;
+    av_hash_init(hash);
+    av_hash_update(hash, url, strlen(url) + 1);
+    av_hash_update(hash, (const uint8_t *)&c->size, sizeof(c->size));
+    av_hash_update(hash, (const uint8_t *)&c->block_size, sizeof(c->block_size));
+    for (i = 0; i < FF_ARRAY_ELEMS(validators); i++) {
+        if (av_opt_get(c->inner, validators[i], AV_OPT_SEARCH_CHILDREN,
+                       (uint8_t **)&validator) >= 0 && validator) {
+            av_hash_update(hash, validator, strlen(validator) + 1);
+            av_freep(&validator);
+        }
+    }
+    av_hash_final_hex(hash, key, sizeof(key));
+    av_hash_freep(&hash);
+
+    c->key_dir = av_asprintf("%s/%s", c->cache_dir, key);
+    c->block   = av_malloc(c->block_size);
+    if (!c->key_dir || !c->block)
+        return AVERROR(ENOMEM);
+    if (ff_mkdir_p(c->key_dir) < 0 && errno != EEXIST) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Failed to create cache directory %s\n", c->key_dir);
+        return ret;
+    }
+    if (c->max_cache_size)
+        cache_evict(h);
+
+#if HAVE_THREADS
+    if (c->prefetch) {
+        c->url            = av_strdup(url);
+        c->prefetch_block = av_malloc(c->block_size);
+        if (!c->url || !c->prefetch_block)
+            return AVERROR(ENOMEM);
+        c->prefetch_end  = -1;
+        c->prefetch_busy = -1;
+        if ((ret = pthread_mutex_init(&c->mutex, NULL)))
+            return AVERROR(ret);
+        if ((ret = pthread_cond_init(&c->cond, NULL))) {
+            pthread_mutex_destroy(&c->mutex);
+            return AVERROR(ret);
+        }
+        if ((ret = pthread_create(&c->prefetch_thread, NULL, prefetch_task, h))) {
+            pthread_cond_destroy(&c->cond);
+            pthread_mutex_destroy(&c->mutex);
+            return AVERROR(ret);
+        }
+        c->thread_started = 1;
+    }
+#endif
+
+    return 0;
+}
+
+static void block_cache_close(URLContext *h)
+{
+    Context *c = h->priv_data;
+
+#if HAVE_THREADS
+    if (c->thread_started) {
+        pthread_mutex_lock(&c->mutex);
+        c->abort_request = 1;
+        pthread_cond_signal(&c->cond);
+        pthread_mutex_unlock(&c->mutex);
+        pthread_join(c->prefetch_thread, NULL);
+        pthread_cond_destroy(&c->cond);
+        pthread_mutex_destroy(&c->mutex);
+        c->thread_started = 0;
+    }
+    ffurl_closep(&c->prefetch_inner);
+    av_dict_free(&c->inner_options);
+    av_freep(&c->prefetch_block);
+    av_freep(&c->url);
+#endif
+    av_freep(&c->key_dir);
+    av_freep(&c->block);
+    ffurl_closep(&c->inner);
+}
+
+static int block_cache_read(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c = h->priv_data;
+    int64_t index = c->logical_pos / c->block_size;
+    int off = c->logical_pos % c->block_size;
+    int ret;
+
+    if (c->logical_pos >= c->size)
+        return AVERROR_EOF;
+
+    if (index != c->block_index) {
+        c->block_index = -1;
+#if HAVE_THREADS
+        if (c->thread_started) {
+            pthread_mutex_lock(&c->mutex);
+            while (c->prefetch_busy == index)
+                pthread_cond_wait(&c->cond, &c->mutex);
+            /* keep prefetch blocks ahead of sequential reads */
+            if (c->prefetch_next <= index || c->prefetch_next > index + c->prefetch)
+                c->prefetch_next = index + 1;
+            c->prefetch_end = index + c->prefetch;
+            pthread_cond_signal(&c->cond);
+            pthread_mutex_unlock(&c->mutex);
+        }
+#endif
+        ret = block_load(h, index, c->block);
+        if (ret >= 0) {
+            c->cache_hit++;
+        } else {
+            c->cache_miss++;
+            ret = block_fetch(h, c->inner, &c->inner_pos, index, c->block);
+            if (ret < 0)
+                return ret;
+            if (ret == block_expected_len(c, index) && block_store(h, index, c->block, ret) >= 0)
+                block_stored(h, ret);
+        }
+        c->block_index = index;
+        c->block_len   = ret;
+    }
+
+    if (off >= c->block_len)
+        return AVERROR_EOF;
+    size = FFMIN(size, c->block_len - off);
+    memcpy(buf, c->block + off, size);
+    c->logical_pos += size;
+    return size;
+}
+
+static int64_t block_cache_seek(URLContext *h, int64_t pos, int whence)
+{
+    Context *c = h->priv_data;
+
+    if (whence == AVSEEK_SIZE)
+        return c->size;
+    else if (whence == SEEK_CUR)
+        pos += c->logical_pos;
+    else if (whence == SEEK_END)
+        pos += c->size;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if (pos < 0)
+        return AVERROR(EINVAL);
+    c->logical_pos = pos;
+    return pos;
 }
 
 static int add_entry(URLContext *h, const unsigned char *buf, int size)
@@ -165,6 +677,9 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
     CacheEntry *entry, *next[2] = {NULL, NULL};
     int64_t r;
 
+    if (c->cache_dir)
+        return block_cache_read(h, buf, size);
+
     entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
 
     if (!entry)
@@ -229,6 +744,9 @@ static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
     Context *c= h->priv_data;
     int64_t ret;
 
+    if (c->cache_dir)
+        return block_cache_seek(h, pos, whence);
+
     if (whence == AVSEEK_SIZE) {
         pos= ffurl_seek(c->inner, pos, whence);
         if(pos <= 0){
@@ -303,6 +821,11 @@ static int cache_close(URLContext *h)
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
+    if (c->cache_dir) {
+        block_cache_close(h);
+        return 0;
+    }
+
     close(c->fd);
     if (c->filename) {
         ret = unlink(c->filename);
@@ -322,6 +845,10 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "cache_dir", "Directory keeping cached blocks across contexts and processes", OFFSET(cache_dir), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "block_size", "Size of the blocks stored in cache_dir", OFFSET(block_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, 1 << 28, D },
+    { "max_cache_size", "Maximum size of cache_dir, 0 for unlimited", OFFSET(max_cache_size), AV_OPT_TYPE_INT64, { .i64 = 1LL << 30 }, 0, INT64_MAX, D },
+    { "prefetch", "Number of blocks to fetch ahead of sequential reads", OFFSET(prefetch), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1024, D },
     {NULL},
 };
 
@@ -24,6 +24,8 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "libavutil/timestamp.h"
 #include "avformat.h"
 #include "internal.h"
@@ -34,6 +36,12 @@ typedef enum ConcatMatchMode {
     MATCH_EXACT_ID,
 } ConcatMatchMode;
 
+typedef enum ConcatPrefetchState {
+    PREFETCH_NONE,
+    PREFETCH_BUSY,
+    PREFETCH_READY,
+} ConcatPrefetchState;
+
 typedef struct ConcatStream {
     AVBSFContext *bsf;
     int out_stream_index;
@@ -52,6 +60,10 @@ typedef struct {
     int64_t outpoint;
     AVDictionary *metadata;
     int nb_streams;
+    ff_const59 AVInputFormat *iformat;  ///< format found when the file was opened
+    AVFormatContext *prefetched;
+    int prefetch_ret;
+    ConcatPrefetchState prefetch_state;
 } ConcatFile;
 
 typedef struct {
@@ -66,6 +78,19 @@ typedef struct {
     ConcatMatchMode stream_match_mode;
     unsigned auto_convert;
     int segment_time_metadata;
+    int prefetch;
+    int reuse_format;
+    unsigned nb_boundaries;
+    int64_t stall_total;
+    int64_t stall_max;
+#if HAVE_THREADS
+    pthread_t prefetch_thread;
+    pthread_mutex_t prefetch_lock;
+    pthread_cond_t prefetch_cond;
+    int prefetch_started;
+    int prefetch_exit;
+    unsigned prefetch_base;     ///< file being read, the next ones are prefetched
+#endif
 } ConcatContext;
 
 static int concat_probe(const AVProbeData *probe)
@@ -325,31 +350,207 @@ static int64_t get_best_effort_duration(ConcatFile *file, AVFormatContext *avf)
     return AV_NOPTS_VALUE;
 }
 
-static int open_file(AVFormatContext *avf, unsigned fileno)
+static int same_extension(const char *a, const char *b)
+{
+    const char *ext_a = strrchr(a, '.'), *ext_b = strrchr(b, '.');
+
+    return ext_a && ext_b && !strchr(ext_a, '/') && !strchr(ext_b, '/') &&
+           !av_strcasecmp(ext_a, ext_b);
+}
+
+/* Format to try first for a file, the one of the previous file if both share an extension. */
+static ff_const59 AVInputFormat *format_hint(ConcatContext *cat, unsigned fileno)
+{
+    ConcatFile *prev = fileno ? &cat->files[fileno - 1] : NULL;
+
+    if (!cat->reuse_format || !prev || !prev->iformat ||
+        !same_extension(prev->url, cat->files[fileno].url))
+        return NULL;
+    return prev->iformat;
+}
+
+static int open_input(AVFormatContext *avf, ConcatFile *file,
+                      ff_const59 AVInputFormat *fmt, AVFormatContext **pctx)
+{
+    AVFormatContext *ctx;
+    int ret;
+
+    while (1) {
+        ctx = avformat_alloc_context();
+        if (!ctx)
+            return AVERROR(ENOMEM);
+
+        ctx->flags |= avf->flags & ~AVFMT_FLAG_CUSTOM_IO;
+        ctx->interrupt_callback = avf->interrupt_callback;
+
+        if ((ret = ff_copy_whiteblacklists(ctx, avf)) < 0) {
+            avformat_free_context(ctx);
+            return ret;
+        }
+
+        ret = avformat_open_input(&ctx, file->url, fmt, NULL);
+        if (ret >= 0 || !fmt)
+            break;
+        av_log(avf, AV_LOG_DEBUG, "'%s' could not be opened as %s, probing it\n",
+               file->url, fmt->name);
+        fmt = NULL;
+    }
+    if (ret < 0 || (ret = avformat_find_stream_info(ctx, NULL)) < 0) {
+        av_log(avf, AV_LOG_ERROR, "Impossible to open '%s'\n", file->url);
+        avformat_close_input(&ctx);
+        return ret;
+    }
+    *pctx = ctx;
+    return 0;
+}
+
+#if HAVE_THREADS
+static void *prefetch_worker(void *arg)
+{
+    AVFormatContext *avf = arg;
+    ConcatContext *cat = avf->priv_data;
+
+    pthread_mutex_lock(&cat->prefetch_lock);
+    while (!cat->prefetch_exit) {
+        ff_const59 AVInputFormat *fmt;
+        AVFormatContext *ctx = NULL;
+        ConcatFile *file = NULL;
+        unsigned i, end = FFMIN(cat->nb_files, cat->prefetch_base + 1 + cat->prefetch);
+        int ret;
+
+        for (i = cat->prefetch_base + 1; i < end && !file; i++)
+            if (cat->files[i].prefetch_state == PREFETCH_NONE)
+                file = &cat->files[i];
+        if (!file) {
+            pthread_cond_wait(&cat->prefetch_cond, &cat->prefetch_lock);
+            continue;
+        }
+        file->prefetch_state = PREFETCH_BUSY;
+        fmt = format_hint(cat, file - cat->files);
+        pthread_mutex_unlock(&cat->prefetch_lock);
+
+        ret = open_input(avf, file, fmt, &ctx);
+
+        pthread_mutex_lock(&cat->prefetch_lock);
+        if (ctx)
+            file->iformat = ctx->iformat;
+        file->prefetched     = ctx;
+        file->prefetch_ret   = ret;
+        file->prefetch_state = PREFETCH_READY;
+        pthread_cond_broadcast(&cat->prefetch_cond);
+    }
+    pthread_mutex_unlock(&cat->prefetch_lock);
+    return NULL;
+}
+
+static void prefetch_start(AVFormatContext *avf)
+{
+    ConcatContext *cat = avf->priv_data;
+
+    if (pthread_mutex_init(&cat->prefetch_lock, NULL))
+        goto fail;
+    if (pthread_cond_init(&cat->prefetch_cond, NULL)) {
+        pthread_mutex_destroy(&cat->prefetch_lock);
+        goto fail;
+    }
+    if (pthread_create(&cat->prefetch_thread, NULL, prefetch_worker, avf)) {
+        pthread_cond_destroy(&cat->prefetch_cond);
+        pthread_mutex_destroy(&cat->prefetch_lock);
+        goto fail;
+    }
+    cat->prefetch_started = 1;
+    return;
+fail:
+    av_log(avf, AV_LOG_WARNING, "Could not start the prefetch thread, "
+           "files will be opened when they are reached\n");
+}
+
+static void prefetch_stop(AVFormatContext *avf)
+{
+    ConcatContext *cat = avf->priv_data;
+
+    if (!cat->prefetch_started)
+        return;
+    pthread_mutex_lock(&cat->prefetch_lock);
+    cat->prefetch_exit = 1;
+    pthread_cond_broadcast(&cat->prefetch_cond);
+    pthread_mutex_unlock(&cat->prefetch_lock);
+    pthread_join(cat->prefetch_thread, NULL);
+    pthread_cond_destroy(&cat->prefetch_cond);
+    pthread_mutex_destroy(&cat->prefetch_lock);
+    cat->prefetch_started = 0;
+}
+
+/*
+ * Get the file from the prefetch thread, waiting for it if it is being
+ * opened, and move the prefetch window after it.
+ */
+static int take_prefetched(AVFormatContext *avf, unsigned fileno, AVFormatContext **pctx)
 {
     ConcatContext *cat = avf->priv_data;
     ConcatFile *file = &cat->files[fileno];
+    ff_const59 AVInputFormat *fmt;
+    unsigned i;
     int ret;
 
-    if (cat->avf)
-        avformat_close_input(&cat->avf);
+    pthread_mutex_lock(&cat->prefetch_lock);
+    cat->prefetch_base = fileno;
+    /* drop what is out of the window, e.g. after a seek */
+    for (i = 0; i < cat->nb_files; i++) {
+        if (cat->files[i].prefetch_state == PREFETCH_READY &&
+            (i < fileno || i > fileno + cat->prefetch)) {
+            avformat_close_input(&cat->files[i].prefetched);
+            cat->files[i].prefetch_state = PREFETCH_NONE;
+        }
+    }
+    pthread_cond_broadcast(&cat->prefetch_cond);
+
+    while (file->prefetch_state == PREFETCH_BUSY)
+        pthread_cond_wait(&cat->prefetch_cond, &cat->prefetch_lock);
+    if (file->prefetch_state == PREFETCH_READY) {
+        file->prefetch_state = PREFETCH_NONE;
+        if (file->prefetch_ret >= 0) {
+            *pctx = file->prefetched;
+            file->prefetched = NULL;
+            pthread_mutex_unlock(&cat->prefetch_lock);
+            return 0;
+        }
+        /* try again, the error may have been temporary */
+    }
+    fmt = format_hint(cat, fileno);
+    pthread_mutex_unlock(&cat->prefetch_lock);
 
-    cat->avf = avformat_alloc_context();
-    if (!cat->avf)
-        return AVERROR(ENOMEM);
+    ret = open_input(avf, file, fmt, pctx);
 
-    cat->avf->flags |= avf->flags & ~AVFMT_FLAG_CUSTOM_IO;
-    cat->avf->interrupt_callback = avf->interrupt_callback;
+    pthread_mutex_lock(&cat->prefetch_lock);
+    if (ret >= 0)
+        file->iformat = (*pctx)->iformat;
+    pthread_mutex_unlock(&cat->prefetch_lock);
+    return ret;
+}
+#endif
 
-    if ((ret = ff_copy_whiteblacklists(cat->avf, avf)) < 0)
-        return ret;
+static int open_file(AVFormatContext *avf, unsigned fileno)
+{
+    ConcatContext *cat = avf->priv_data;
+    ConcatFile *file = &cat->files[fileno];
+    int ret;
 
-    if ((ret = avformat_open_input(&cat->avf, file->url, NULL, NULL)) < 0 ||
-        (ret = avformat_find_stream_info(cat->avf, NULL)) < 0) {
-        av_log(avf, AV_LOG_ERROR, "Impossible to open '%s'\n", file->url);
+    if (cat->avf)
         avformat_close_input(&cat->avf);
-        return ret;
+
+#if HAVE_THREADS
+    if (cat->prefetch_started)
+        ret = take_prefetched(avf, fileno, &cat->avf);
+    else
+#endif
+    {
+        ret = open_input(avf, file, format_hint(cat, fileno), &cat->avf);
+        if (ret >= 0)
+            file->iformat = cat->avf->iformat;
     }
+    if (ret < 0)
+        return ret;
     cat->cur_file = file;
     file->start_time = !fileno ? 0 :
                        cat->files[fileno - 1].start_time +
@@ -378,7 +579,16 @@ static int concat_read_close(AVFormatContext *avf)
     ConcatContext *cat = avf->priv_data;
     unsigned i, j;
 
+#if HAVE_THREADS
+    prefetch_stop(avf);
+#endif
+    if (cat->nb_boundaries)
+        av_log(avf, AV_LOG_VERBOSE, "%u file boundaries, stalled %"PRId64" ms "
+               "in total, %"PRId64" ms at most\n", cat->nb_boundaries,
+               cat->stall_total / 1000, cat->stall_max / 1000);
+
     for (i = 0; i < cat->nb_files; i++) {
+        avformat_close_input(&cat->files[i].prefetched);
         av_freep(&cat->files[i].url);
         for (j = 0; j < cat->files[i].nb_streams; j++) {
             if (cat->files[i].streams[j].bsf)
@@ -508,6 +718,13 @@ static int concat_read_header(AVFormatContext *avf)
 
     cat->stream_match_mode = avf->nb_streams ? MATCH_EXACT_ID :
                                                MATCH_ONE_TO_ONE;
+    if (cat->prefetch > 0 && cat->nb_files > 1) {
+#if HAVE_THREADS
+        prefetch_start(avf);
+#else
+        av_log(avf, AV_LOG_WARNING, "prefetch requires thread support, ignoring it\n");
+#endif
+    }
     if ((ret = open_file(avf, 0)) < 0)
         goto fail;
     av_bprint_finalize(&bp, NULL);
@@ -523,6 +740,8 @@ static int open_next_file(AVFormatContext *avf)
 {
     ConcatContext *cat = avf->priv_data;
     unsigned fileno = cat->cur_file - cat->files;
+    int64_t stall;
+    int ret;
 
     cat->cur_file->duration = get_best_effort_duration(cat->cur_file, cat->avf);
 
@@ -530,7 +749,16 @@ static int open_next_file(AVFormatContext *avf)
         cat->eof = 1;
         return AVERROR_EOF;
     }
-    return open_file(avf, fileno);
+
+    stall = av_gettime_relative();
+    ret = open_file(avf, fileno);
+    stall = av_gettime_relative() - stall;
+    cat->nb_boundaries++;
+    cat->stall_total += stall;
+    cat->stall_max    = FFMAX(cat->stall_max, stall);
+    av_log(avf, AV_LOG_VERBOSE, "Switching to '%s' stalled for %"PRId64" us\n",
+           cat->files[fileno].url, stall);
+    return ret;
 }
 
 static int filter_packet(AVFormatContext *avf, ConcatStream *cs, AVPacket *pkt)
@@ -764,6 +992,10 @@ static const AVOption options[] = {
       OFFSET(auto_convert), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, DEC },
     { "segment_time_metadata", "output file segment start time and duration as packet metadata",
       OFFSET(segment_time_metadata), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
+    { "prefetch", "number of files to open and probe in the background ahead of the current one",
+      OFFSET(prefetch), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, DEC },
+    { "reuse_format", "try the format of the previous file first for files with the same extension",
+      OFFSET(reuse_format), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
     { NULL }
 };
 
@@ -130,6 +130,7 @@ static void add_keyframes_index(AVFormatContext *s)
 {
     FLVContext *flv   = s->priv_data;
     AVStream *stream  = NULL;
+    AVIndexEntry *entries;
     unsigned int i    = 0;
 
     if (flv->last_keyframe_stream_index < 0) {
@@ -140,15 +141,27 @@ static void add_keyframes_index(AVFormatContext *s)
     av_assert0(flv->last_keyframe_stream_index <= s->nb_streams);
     stream = s->streams[flv->last_keyframe_stream_index];
 
-    if (stream->nb_index_entries == 0) {
+    if (stream->nb_index_entries) {
+        av_log(s, AV_LOG_WARNING, "Skipping duplicate index\n");
+    } else if ((entries = av_malloc_array(flv->keyframe_count, sizeof(*entries)))) {
+        int nb_entries = 0;
+
         for (i = 0; i < flv->keyframe_count; i++) {
+            AVIndexEntry *ie = &entries[nb_entries];
             av_log(s, AV_LOG_TRACE, "keyframe filepositions = %"PRId64" times = %"PRId64"\n",
                    flv->keyframe_filepositions[i], flv->keyframe_times[i] * 1000);
-            av_add_index_entry(stream, flv->keyframe_filepositions[i],
-                flv->keyframe_times[i] * 1000, 0, 0, AVINDEX_KEYFRAME);
+            ie->pos          = flv->keyframe_filepositions[i];
+            ie->timestamp    = flv->keyframe_times[i] * 1000;
+            ie->flags        = AVINDEX_KEYFRAME;
+            ie->size         = 0;
+            ie->min_distance = 0;
+            /* rejected by av_add_index_entry(), would fail the whole batch */
+            if (ie->timestamp != AV_NOPTS_VALUE)
+                nb_entries++;
         }
-    } else
-        av_log(s, AV_LOG_WARNING, "Skipping duplicate index\n");
+        av_add_index_entries(stream, entries, nb_entries);
+        av_free(entries);
+    }
 
     if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
         av_freep(&flv->keyframe_times);
@@ -71,6 +71,13 @@ typedef enum {
 #define HLS_MICROSECOND_UNIT   1000000
 #define POSTFIX_PATTERN "_%d"
 
+typedef struct HLSPart {
+    double duration; /* in seconds */
+    int64_t pos;
+    int64_t size;
+    int independent;
+} HLSPart;
+
 typedef struct HLSSegment {
     char filename[MAX_URL_SIZE];
     char sub_filename[MAX_URL_SIZE];
@@ -85,6 +92,9 @@ typedef struct HLSSegment {
     char key_uri[LINE_BUFFER_SIZE + 1];
     char iv_string[KEYSIZE*2 + 1];
 
+    HLSPart *parts;  /* partial segments, kept for the last segments only */
+    int nb_parts;
+
     struct HLSSegment *next;
 } HLSSegment;
 
@@ -167,6 +177,12 @@ typedef struct VariantStream {
     char key_string[KEYSIZE*2 + 1];
     char iv_string[KEYSIZE*2 + 1];
 
+    AVIOContext *part_out; /* segment being written part by part */
+    HLSPart *parts;        /* parts of the current segment */
+    int nb_parts;
+    int64_t part_pos;      /* bytes of the current segment written so far */
+    int part_independent;  /* current part starts with a keyframe, -1 if unknown */
+
     AVStream **streams;
     char codec_attr[128];
     CodecAttributeStatus attr_status;
@@ -193,6 +209,7 @@ typedef struct HLSContext {
 
     float time;            // Set by a private option.
     float init_time;       // Set by a private option.
+    float part_time;       // Set by a private option.
     int max_nb_segments;   // Set by a private option.
     int hls_delete_threshold; // Set by a private option.
 #if FF_API_HLS_WRAP
@@ -452,9 +469,12 @@ static int replace_int_data_in_filename(char **s, const char *filename, char pla
     return found_count;
 }
 
+/* size of the box written by write_styp() */
+#define STYP_SIZE 24
+
 static void write_styp(AVIOContext *pb)
 {
-    avio_wb32(pb, 24);
+    avio_wb32(pb, STYP_SIZE);
     ffio_wfourcc(pb, "styp");
     ffio_wfourcc(pb, "msdh");
     avio_wb32(pb, 0); /* minor */
@@ -489,6 +509,93 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
     avio_write(vs->out, vs->temp_buffer, *range_length);
 }
 
+/* Write out the fmp4 init section, which is all the buffer holds at the first flush. */
+static int flush_init_section(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int range_length;
+
+    range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+    oc->pb = NULL;
+    if (range_length <= 0)
+        return AVERROR(EINVAL);
+    avio_write(vs->out, vs->init_buffer, range_length);
+    if (!hls->resend_init_file)
+        av_freep(&vs->init_buffer);
+    vs->init_range_length = range_length;
+    vs->packets_written = 0;
+    vs->start_pos = range_length;
+    if (!byterange_mode) {
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+    }
+    return avio_open_dyn_buf(&oc->pb);
+}
+
+/*
+ * Close the current fragment and send it to the segment file right away
+ * as a partial segment. elapsed is the duration of the segment so far.
+ */
+static int hls_flush_part(AVFormatContext *s, VariantStream *vs, double elapsed)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    AVDictionary *options = NULL;
+    HLSPart *part;
+    uint8_t *buffer = NULL;
+    int i, ret, size;
+
+    av_write_frame(oc, NULL);
+    if (!vs->init_range_length) {
+        if ((ret = flush_init_section(s, vs)) < 0)
+            return ret;
+        /* the first flush only wrote the moov, the samples are still queued */
+        av_write_frame(oc, NULL);
+    }
+    if (!avio_tell(oc->pb))
+        return 0;
+
+    if (!vs->nb_parts) {
+        set_http_options(s, &options, hls);
+        ret = hlsenc_io_open(s, &vs->part_out, oc->url, &options);
+        av_dict_free(&options);
+        if (ret < 0) {
+            av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+                   "Failed to open file '%s'\n", oc->url);
+            if (!hls->ignore_io_errors)
+                return ret;
+        } else {
+            write_styp(vs->part_out);
+        }
+        vs->part_pos = STYP_SIZE;
+    }
+
+    part = av_realloc_array(vs->parts, vs->nb_parts + 1, sizeof(*vs->parts));
+    if (!part)
+        return AVERROR(ENOMEM);
+    vs->parts = part;
+    part = &vs->parts[vs->nb_parts++];
+    part->duration = elapsed;
+    for (i = 0; i < vs->nb_parts - 1; i++)
+        part->duration -= vs->parts[i].duration;
+    part->independent = vs->part_independent > 0;
+    vs->part_independent = -1;
+
+    size = avio_close_dyn_buf(oc->pb, &buffer);
+    oc->pb = NULL;
+    part->pos  = vs->part_pos;
+    part->size = size;
+    vs->part_pos += size;
+    if (vs->part_out) {
+        avio_write(vs->part_out, buffer, size);
+        avio_flush(vs->part_out);
+    }
+    av_free(buffer);
+
+    return avio_open_dyn_buf(&oc->pb);
+}
+
 #if HAVE_DOS_PATHS
 #define SEPARATOR '\\'
 #else
@@ -1042,11 +1149,14 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
     HLSSegment *en = av_malloc(sizeof(*en));
     const char  *filename;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
-    int ret;
+    int ret, i;
 
     if (!en)
         return AVERROR(ENOMEM);
 
+    en->parts    = NULL;
+    en->nb_parts = 0;
+
     en->var_stream_idx = vs->var_stream_idx;
     ret = sls_flags_filename_process(s, hls, vs, en, duration, pos, size);
     if (ret < 0) {
@@ -1088,6 +1198,11 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
         av_strlcpy(en->iv_string, vs->iv_string, sizeof(en->iv_string));
     }
 
+    en->parts    = vs->parts;
+    en->nb_parts = vs->nb_parts;
+    vs->parts    = NULL;
+    vs->nb_parts = 0;
+
     if (!vs->segments)
         vs->segments = en;
     else
@@ -1095,6 +1210,14 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
 
     vs->last_segment = en;
 
+    /* the playlist only lists the parts of the last three segments */
+    if (hls->part_time > 0) {
+        for (i = vs->nb_entries - 2, en = vs->segments; i > 0 && en; i--, en = en->next) {
+            av_freep(&en->parts);
+            en->nb_parts = 0;
+        }
+    }
+
     // EVENT or VOD playlists imply sliding window cannot be used
     if (hls->pl_type != PLAYLIST_TYPE_NONE)
         hls->max_nb_segments = 0;
@@ -1103,6 +1226,7 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
         en = vs->segments;
         vs->initial_prog_date_time += en->duration;
         vs->segments = en->next;
+        av_freep(&en->parts);
         if (en && hls->flags & HLS_DELETE_SEGMENTS &&
 #if FF_API_HLS_WRAP
                 !(hls->flags & HLS_SINGLE_FILE || hls->wrap)) {
@@ -1224,6 +1348,7 @@ static void hls_free_segments(HLSSegment *p)
     while (p) {
         en = p;
         p = p->next;
+        av_freep(&en->parts);
         av_freep(&en);
     }
 }
@@ -1450,7 +1575,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     HLSContext *hls = s->priv_data;
     HLSSegment *en;
     int target_duration = 0;
-    int ret = 0;
+    int ret = 0, i;
     char temp_filename[MAX_URL_SIZE];
     char temp_vtt_filename[MAX_URL_SIZE];
     int64_t sequence = FFMAX(hls->start_sequence, vs->sequence - vs->nb_entries);
@@ -1461,6 +1586,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     char *key_uri = NULL;
     char *iv_string = NULL;
     AVDictionary *options = NULL;
+    double part_target = hls->part_time;
     double prog_date_time = vs->initial_prog_date_time;
     double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
@@ -1493,7 +1619,14 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     for (en = vs->segments; en; en = en->next) {
         if (target_duration <= en->duration)
             target_duration = lrint(en->duration);
+        for (i = 0; i < en->nb_parts; i++)
+            part_target = FFMAX(part_target, en->parts[i].duration);
     }
+    for (i = 0; i < vs->nb_parts; i++)
+        part_target = FFMAX(part_target, vs->parts[i].duration);
+    /* parts of the first segment can be listed before it is complete */
+    if (!target_duration && hls->part_time > 0)
+        target_duration = FFMAX(lrint(hls->time), 1);
 
     vs->discontinuity_set = 0;
     ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
@@ -1506,6 +1639,10 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     if (vs->has_video && (hls->flags & HLS_INDEPENDENT_SEGMENTS)) {
         avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
     }
+    if (hls->part_time > 0) {
+        avio_printf(vs->out, "#EXT-X-PART-INF:PART-TARGET=%f\n", part_target);
+        avio_printf(vs->out, "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%f\n", 3 * part_target);
+    }
     for (en = vs->segments; en; en = en->next) {
         if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
                                     av_strcasecmp(en->iv_string, iv_string))) {
@@ -1522,6 +1659,11 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
                                    hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
         }
 
+        for (i = 0; i < en->nb_parts; i++)
+            ff_hls_write_part(vs->out, en->parts[i].duration, en->parts[i].size,
+                              en->parts[i].pos, hls->baseurl, en->filename,
+                              en->parts[i].independent);
+
         ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
                                       en->duration, hls->flags & HLS_ROUND_DURATIONS,
                                       en->size, en->pos, hls->baseurl,
@@ -1531,6 +1673,20 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
     }
 
+    if (vs->nb_parts && !last) {
+        /* the segment being written, see hls_append_segment() for its name */
+        const char *filename = hls->use_localtime_mkdir ? vs->avf->url : av_basename(vs->avf->url);
+
+        if (!vs->segments)
+            ff_hls_write_init_file(vs->out, vs->fmp4_init_filename, 0, vs->init_range_length, 0);
+        for (i = 0; i < vs->nb_parts; i++)
+            ff_hls_write_part(vs->out, vs->parts[i].duration, vs->parts[i].size,
+                              vs->parts[i].pos, hls->baseurl, filename,
+                              vs->parts[i].independent);
+        avio_printf(vs->out, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s%s\",BYTERANGE-START=%"PRId64"\n",
+                    hls->baseurl ? hls->baseurl : "", filename, vs->part_pos);
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
 
@@ -2357,19 +2513,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         avio_flush(oc->pb);
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             if (!vs->init_range_length) {
-                range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
-                if (range_length <= 0)
-                    return AVERROR(EINVAL);
-                avio_write(vs->out, vs->init_buffer, range_length);
-                if (!hls->resend_init_file)
-                    av_freep(&vs->init_buffer);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
-                vs->packets_written = 0;
-                vs->start_pos = range_length;
-                if (!byterange_mode) {
-                    hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
-                }
+                if ((ret = flush_init_section(s, vs)) < 0)
+                    return ret;
             }
         }
         if (!byterange_mode) {
@@ -2385,6 +2530,14 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
                 return ret;
             }
             vs->size = range_length;
+        } else if (hls->part_time > 0) {
+            ret = hls_flush_part(s, vs, (double)(pkt->pts - vs->end_pts) * st->time_base.num / st->time_base.den);
+            if (ret < 0)
+                return ret;
+            vs->size = vs->part_pos;
+            ret = hlsenc_io_close(s, &vs->part_out, oc->url);
+            if (ret < 0)
+                av_log(s, AV_LOG_WARNING, "upload of segment '%s' failed\n", oc->url);
         } else {
             if (oc->url[0]) {
                 proto = avio_find_protocol_name(oc->url);
@@ -2508,8 +2661,26 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             return ret;
         }
 
+    } else if (hls->part_time > 0 && is_ref_pkt && vs->packets_written &&
+               av_compare_ts(pkt->pts - vs->end_pts, st->time_base,
+                             (vs->nb_parts + 1) * (int64_t)(hls->part_time * AV_TIME_BASE),
+                             AV_TIME_BASE_Q) >= 0) {
+        ret = hls_flush_part(s, vs, (double)(pkt->pts - vs->end_pts) * st->time_base.num / st->time_base.den);
+        if (ret < 0)
+            return ret;
+        if (hls->pl_type != PLAYLIST_TYPE_VOD) {
+            if ((ret = hls_window(s, 0, vs)) < 0) {
+                av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
+                ff_format_io_close(s, &vs->out);
+                if ((ret = hls_window(s, 0, vs)) < 0)
+                    return ret;
+            }
+        }
     }
 
+    if (vs->part_independent < 0 && is_ref_pkt)
+        vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+
     vs->packets_written++;
     if (oc->pb) {
         ret = ff_write_chained(oc, stream_index, pkt, s, 0);
@@ -2545,6 +2716,8 @@ static void hls_deinit(AVFormatContext *s)
         avformat_free_context(vs->avf);
         if (hls->resend_init_file)
             av_freep(&vs->init_buffer);
+        ff_format_io_close(s, &vs->part_out);
+        av_freep(&vs->parts);
         hls_free_segments(vs->segments);
         hls_free_segments(vs->old_segments);
         av_freep(&vs->m3u8_name);
@@ -2616,19 +2789,28 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 }
             }
         }
+        if (hls->part_time > 0) {
+            ret = hls_flush_part(s, vs, vs->duration + vs->dpp);
+            if (ret < 0)
+                goto cleanup;
+            vs->size = vs->part_pos;
+            if (hlsenc_io_close(s, &vs->part_out, oc->url) < 0)
+                av_log(s, AV_LOG_WARNING, "Failed to upload file '%s' at the end.\n", oc->url);
+            goto cleanup;
+        }
         if (!(hls->flags & HLS_SINGLE_FILE)) {
             set_http_options(s, &options, hls);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
             if (ret < 0) {
                 av_log(s, AV_LOG_ERROR, "Failed to open file '%s'\n", oc->url);
-                goto failed;
+                goto cleanup;
             }
             if (hls->segment_type == SEGMENT_TYPE_FMP4)
                 write_styp(vs->out);
         }
         ret = flush_dynbuf(vs, &range_length);
         if (ret < 0)
-            goto failed;
+            goto cleanup;
 
         vs->size = range_length;
         hlsenc_io_close(s, &vs->out, filename);
@@ -2639,7 +2821,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
             if (ret < 0) {
                 av_log(s, AV_LOG_ERROR, "Failed to open file '%s'\n", oc->url);
-                goto failed;
+                goto cleanup;
             }
             reflush_dynbuf(vs, &range_length);
             ret = hlsenc_io_close(s, &vs->out, filename);
@@ -2647,7 +2829,8 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 av_log(s, AV_LOG_WARNING, "Failed to upload file '%s' at the end.\n", oc->url);
         }
 
-failed:
+        /* the last segment is done with, successfully or not */
+cleanup:
         av_freep(&vs->temp_buffer);
         av_dict_free(&options);
         av_freep(&filename);
@@ -2781,6 +2964,25 @@ static int hls_init(AVFormatContext *s)
 
     hls->recording_time = (hls->init_time ? hls->init_time : hls->time) * AV_TIME_BASE;
 
+    if (hls->part_time > 0) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4 ||
+            (hls->flags & HLS_SINGLE_FILE) || hls->max_seg_size > 0) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time requires fmp4 segments "
+                   "written to separate files\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->part_time > hls->time) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time must not exceed hls_time\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->flags & HLS_TEMP_FILE) {
+            /* parts have to be addressable while the segment is written */
+            av_log(s, AV_LOG_WARNING, "'temp_file' cannot be used with "
+                   "hls_part_time, disabling it\n");
+            hls->flags &= ~HLS_TEMP_FILE;
+        }
+    }
+
     if (hls->flags & HLS_SPLIT_BY_TIME && hls->flags & HLS_INDEPENDENT_SEGMENTS) {
         // Independent segments cannot be guaranteed when splitting by time
         hls->flags &= ~HLS_INDEPENDENT_SEGMENTS;
@@ -2799,6 +3001,7 @@ static int hls_init(AVFormatContext *s)
         vs->sequence  = hls->start_sequence;
         vs->start_pts = AV_NOPTS_VALUE;
         vs->end_pts   = AV_NOPTS_VALUE;
+        vs->part_independent = -1;
         vs->current_segment_final_filename_fmt[0] = '\0';
 
         if (hls->flags & HLS_PROGRAM_DATE_TIME) {
@@ -2942,6 +3145,7 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length in seconds",           OFFSET(time),    AV_OPT_TYPE_FLOAT,  {.dbl = 2},     0, FLT_MAX, E},
     {"hls_init_time", "set segment length in seconds at init list",           OFFSET(init_time),    AV_OPT_TYPE_FLOAT,  {.dbl = 0},     0, FLT_MAX, E},
+    {"hls_part_time", "set partial segment length in seconds, 0 to disable", OFFSET(part_time),    AV_OPT_TYPE_FLOAT,  {.dbl = 0},     0, FLT_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
     {"hls_ts_options","set hls mpegts list of options for the container format used for hls", OFFSET(format_options), AV_OPT_TYPE_DICT, {.str = NULL},  0, 0,    E},
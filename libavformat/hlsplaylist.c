@@ -186,6 +186,20 @@ int ff_hls_write_file_entry(AVIOContext *out, int insert_discont,
     return 0;
 }
 
+void ff_hls_write_part(AVIOContext *out, double duration, int64_t size, int64_t pos,
+                       const char *baseurl /* Ignored if NULL */,
+                       const char *filename, int independent)
+{
+    if (!out || !filename)
+        return;
+
+    avio_printf(out, "#EXT-X-PART:DURATION=%f,URI=\"%s%s\",BYTERANGE=\"%"PRId64"@%"PRId64"\"",
+                duration, baseurl ? baseurl : "", filename, size, pos);
+    if (independent)
+        avio_printf(out, ",INDEPENDENT=YES");
+    avio_printf(out, "\n");
+}
+
 void ff_hls_write_end_list(AVIOContext *out)
 {
     if (!out)
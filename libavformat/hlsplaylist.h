@@ -60,6 +60,9 @@ int ff_hls_write_file_entry(AVIOContext *out, int insert_discont,
                             const char *filename, double *prog_date_time,
                             int64_t video_keyframe_size, int64_t video_keyframe_pos,
                             int iframe_mode);
+void ff_hls_write_part(AVIOContext *out, double duration, int64_t size, int64_t pos,
+                       const char *baseurl /* Ignored if NULL */,
+                       const char *filename, int independent);
 void ff_hls_write_end_list (AVIOContext *out);
 
 #endif /* AVFORMAT_HLSPLAYLIST_H_ */
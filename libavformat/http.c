@@ -31,6 +31,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 
 #include "avformat.h"
 #include "http.h"
@@ -51,6 +52,7 @@
 #define HTTP_SINGLE   1
 #define HTTP_MUTLI    2
 #define MAX_EXPIRY    19
+#define PARALLEL_READ_SIZE (64 * 1024)
 #define WHITESPACES " \n\t\r"
 typedef enum {
     LOWER_PROTO,
@@ -76,6 +78,8 @@ typedef struct HTTPContext {
     char *headers;
     char *mime_type;
     char *http_version;
+    char *etag;
+    char *last_modified;
     char *user_agent;
     char *referer;
 #if FF_API_HTTP_USER_AGENT
@@ -127,6 +131,10 @@ typedef struct HTTPContext {
     int is_multi_client;
     HandshakeState handshake_step;
     int is_connected_server;
+    int connections;
+    int chunk_size;
+    int read_ahead;
+    struct HTTPParallel *parallel;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -149,6 +157,8 @@ static const AVOption options[] = {
     { "post_data", "set custom HTTP post data", OFFSET(post_data), AV_OPT_TYPE_BINARY, .flags = D | E },
     { "mime_type", "export the MIME type", OFFSET(mime_type), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "http_version", "export the http response version", OFFSET(http_version), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "etag", "export the entity tag of the resource", OFFSET(etag), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "last_modified", "export the last modification date of the resource", OFFSET(last_modified), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "cookies", "set cookies to be sent in applicable future requests, use newline delimited Set-Cookie HTTP field value syntax", OFFSET(cookies), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
     { "icy", "request ICY metadata", OFFSET(icy), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, D },
     { "icy_metadata_headers", "return ICY metadata headers", OFFSET(icy_metadata_headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT },
@@ -169,6 +179,9 @@ static const AVOption options[] = {
     { "listen", "listen on HTTP", OFFSET(listen), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 2, D | E },
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
+    { "connections", "number of parallel connections fetching byte ranges", OFFSET(connections), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, 64, D },
+    { "chunk_size", "size of the byte ranges fetched by parallel connections", OFFSET(chunk_size), AV_OPT_TYPE_INT, { .i64 = 4 * 1024 * 1024 }, 64 * 1024, INT_MAX / 2, D },
+    { "read_ahead", "number of byte ranges buffered ahead of the read position, 0 for twice the connections", OFFSET(read_ahead), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1024, D },
     { NULL }
 };
 
@@ -177,6 +190,12 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
                         const char *proxyauth, int *new_location);
 static int http_read_header(URLContext *h, int *new_location);
 static int http_shutdown(URLContext *h, int flags);
+#if HAVE_THREADS
+static int http_parallel_start(URLContext *h);
+static void http_parallel_stop(HTTPContext *s);
+static int http_parallel_read(URLContext *h, uint8_t *buf, int size);
+static int64_t http_parallel_seek(URLContext *h, int64_t off, int whence);
+#endif
 
 void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
 {
@@ -588,8 +607,29 @@ static int http_open(URLContext *h, const char *uri, int flags,
         return http_listen(h, uri, flags, options);
     }
     ret = http_open_cnx(h, options);
-    if (ret < 0)
+    if (ret < 0) {
         av_dict_free(&s->chained_options);
+        return ret;
+    }
+#if HAVE_THREADS
+    if (s->connections > 1 && !(flags & AVIO_FLAG_WRITE) && !s->post_data) {
+        int ranges = !h->is_streamed && s->filesize != UINT64_MAX && !s->icy_metaint;
+#if CONFIG_ZLIB
+        ranges &= !s->compressed;
+#endif
+        if (!ranges) {
+            av_log(h, AV_LOG_WARNING, "Resource does not allow parallel range "
+                   "requests, using a single connection\n");
+        } else {
+            /* The workers issue their own range requests, the reply to the
+             * initial one was only needed for the size and seekability. */
+            ffurl_closep(&s->hd);
+            ret = http_parallel_start(h);
+            if (ret < 0)
+                av_dict_free(&s->chained_options);
+        }
+    }
+#endif
     return ret;
 }
 
@@ -1035,6 +1075,12 @@ static int process_line(URLContext *h, char *line, int line_count,
         } else if (!av_strcasecmp(tag, "Content-Type")) {
             av_free(s->mime_type);
             s->mime_type = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "ETag")) {
+            av_free(s->etag);
+            s->etag = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "Last-Modified")) {
+            av_free(s->last_modified);
+            s->last_modified = av_strdup(p);
         } else if (!av_strcasecmp(tag, "Set-Cookie")) {
             if (parse_cookie(s, p, &s->cookie_dict))
                 av_log(h, AV_LOG_WARNING, "Unable to parse '%s'\n", p);
@@ -1626,6 +1672,10 @@ static int http_read(URLContext *h, uint8_t *buf, int size)
 {
     HTTPContext *s = h->priv_data;
 
+#if HAVE_THREADS
+    if (s->parallel)
+        return http_parallel_read(h, buf, size);
+#endif
     if (s->icy_metaint > 0) {
         size = store_icy(h, size);
         if (size < 0)
@@ -1703,6 +1753,10 @@ static int http_close(URLContext *h)
     inflateEnd(&s->inflate_stream);
     av_freep(&s->inflate_buffer);
 #endif /* CONFIG_ZLIB */
+#if HAVE_THREADS
+    if (s->parallel)
+        http_parallel_stop(s);
+#endif
 
     if (s->hd && !s->end_chunked_post)
         /* Close the write direction by sending the end of chunked encoding. */
@@ -1774,9 +1828,349 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
 
 static int64_t http_seek(URLContext *h, int64_t off, int whence)
 {
+#if HAVE_THREADS
+    HTTPContext *s = h->priv_data;
+
+    if (s->parallel)
+        return http_parallel_seek(h, off, whence);
+#endif
     return http_seek_internal(h, off, whence, 0);
 }
 
+#if HAVE_THREADS
+/* Parallel range reading: the resource is split in chunk_size byte ranges,
+ * fetched by one thread per connection over persistent connections into a
+ * window of read_ahead chunk buffers, and returned in order by http_read(). */
+
+typedef struct HTTPChunk {
+    uint8_t *data;
+    int64_t  index;     ///< chunk number in the resource, -1 if unused
+    int      size;
+    int      filled;    ///< bytes available to the reader
+    int      busy;      ///< a worker is writing to data
+    int      error;
+} HTTPChunk;
+
+typedef struct HTTPParallel {
+    URLContext      *h;
+    pthread_t       *workers;
+    int              nb_workers;
+    HTTPChunk       *chunks;
+    int              nb_chunks;
+    int64_t          nb_total_chunks;
+    int64_t          read_chunk;    ///< chunk holding the read position
+    int64_t          next_chunk;    ///< next chunk to hand to a worker
+    uint64_t         pos;
+    int              abort_request;
+    pthread_mutex_t  mutex;
+    pthread_cond_t   cond;
+} HTTPParallel;
+
+static int http_parallel_check_interrupt(void *arg)
+{
+    HTTPParallel *p = arg;
+
+    return p->abort_request || ff_check_interrupt(&p->h->interrupt_callback);
+}
+
+/* Wait for a change of the shared state. The wait is bounded so that an
+ * interrupt callback firing while the workers are stalled in I/O is seen. */
+static void http_parallel_wait(HTTPParallel *p)
+{
+    int64_t t = av_gettime() + 100000;
+    struct timespec tv = { .tv_sec  =  t / 1000000,
+                           .tv_nsec = (t % 1000000) * 1000 };
+
+    pthread_cond_timedwait(&p->cond, &p->mutex, &tv);
+}
+
+/* Request [off, end_off) on the worker connection, reusing it if possible. */
+static int http_parallel_request(HTTPParallel *p, URLContext **hd,
+                                 uint64_t off, uint64_t end_off)
+{
+    URLContext *h = p->h;
+    HTTPContext *s = h->priv_data;
+    AVIOInterruptCB interrupt_callback = { http_parallel_check_interrupt, p };
+    AVDictionary *options = NULL;
+    int ret;
+
+    if (*hd) {
+        HTTPContext *ws = (*hd)->priv_data;
+
+        /* the previous reply was read up to its end, send the next request
+         * on the same connection unless the server is going to close it */
+        if (ws->hd && !ws->willclose && ws->chunksize == UINT64_MAX) {
+            ws->off     = off;
+            ws->end_off = end_off;
+            ret = http_open_cnx(*hd, &options);
+            av_dict_free(&options);
+            if (ret >= 0)
+                return 0;
+        }
+        ffurl_closep(hd);
+    }
+
+    av_dict_copy(&options, s->chained_options, 0);
+    av_dict_set_int(&options, "offset",            off,     0);
+    av_dict_set_int(&options, "end_offset",        end_off, 0);
+    av_dict_set    (&options, "seekable",          "1",     0);
+    av_dict_set    (&options, "multiple_requests", "1",     0);
+    av_dict_set    (&options, "icy",               "0",     0);
+    av_dict_set    (&options, "user_agent",        s->user_agent, 0);
+    if (s->headers)
+        av_dict_set(&options, "headers",    s->headers,    0);
+    if (s->referer)
+        av_dict_set(&options, "referer",    s->referer,    0);
+    if (s->cookies)
+        av_dict_set(&options, "cookies",    s->cookies,    0);
+    if (s->http_proxy)
+        av_dict_set(&options, "http_proxy", s->http_proxy, 0);
+
+    ret = ffurl_open_whitelist(hd, s->location, AVIO_FLAG_READ,
+                               &interrupt_callback, &options,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+    av_dict_free(&options);
+    return ret;
+}
+
+static void *http_parallel_worker(void *arg)
+{
+    HTTPParallel *p = arg;
+    HTTPContext  *s = p->h->priv_data;
+    URLContext  *hd = NULL;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->abort_request) {
+        HTTPChunk *c;
+        int64_t index;
+        uint64_t start;
+        int filled = 0, abandoned = 0, attempts = 0, ret;
+
+        if (p->next_chunk >= p->nb_total_chunks ||
+            p->next_chunk >= p->read_chunk + p->nb_chunks ||
+            p->chunks[p->next_chunk % p->nb_chunks].busy) {
+            http_parallel_wait(p);
+            continue;
+        }
+        index     = p->next_chunk++;
+        start     = index * s->chunk_size;
+        c         = &p->chunks[index % p->nb_chunks];
+        c->index  = index;
+        c->size   = FFMIN(s->chunk_size, s->filesize - start);
+        c->filled = 0;
+        c->error  = 0;
+        c->busy   = 1;
+        pthread_mutex_unlock(&p->mutex);
+
+        do {
+            /* a persistent connection may have been closed by the server,
+             * retry once on a new one */
+            ret = http_parallel_request(p, &hd, start + filled, start + c->size);
+            while (ret >= 0 && filled < c->size) {
+                ret = ffurl_read(hd, c->data + filled,
+                                 FFMIN(c->size - filled, PARALLEL_READ_SIZE));
+                if (!ret || ret == AVERROR_EOF)
+                    ret = AVERROR(EIO);
+                if (ret < 0)
+                    break;
+                filled += ret;
+
+                pthread_mutex_lock(&p->mutex);
+                if (c->index == index) {
+                    c->filled = filled;
+                    pthread_cond_broadcast(&p->cond);
+                } else {
+                    abandoned = 1;
+                }
+                pthread_mutex_unlock(&p->mutex);
+                if (abandoned)
+                    break;
+            }
+            if (filled < c->size)
+                ffurl_closep(&hd);
+        } while (ret < 0 && ret != AVERROR_EXIT && !abandoned && !attempts++);
+
+        pthread_mutex_lock(&p->mutex);
+        if (ret < 0 && c->index == index) {
+            av_log(p->h, AV_LOG_ERROR, "Failed to fetch bytes %"PRIu64"-%"PRIu64": %s\n",
+                   start, start + c->size - 1, av_err2str(ret));
+            c->error = ret;
+        }
+        c->busy = 0;
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    ffurl_closep(&hd);
+    return NULL;
+}
+
+static int http_parallel_start(URLContext *h)
+{
+    HTTPContext  *s = h->priv_data;
+    HTTPParallel *p;
+    int i, ret;
+
+    p = s->parallel = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->h               = h;
+    p->nb_chunks       = s->read_ahead ? s->read_ahead : 2 * s->connections;
+    p->nb_total_chunks = (s->filesize + s->chunk_size - 1) / s->chunk_size;
+    p->pos             = s->off;
+    p->read_chunk      = p->pos / s->chunk_size;
+    p->next_chunk      = p->read_chunk;
+
+    p->chunks  = av_mallocz_array(p->nb_chunks, sizeof(*p->chunks));
+    p->workers = av_mallocz_array(s->connections, sizeof(*p->workers));
+    if (!p->chunks || !p->workers) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (i = 0; i < p->nb_chunks; i++) {
+        p->chunks[i].index = -1;
+        p->chunks[i].data  = av_malloc(s->chunk_size);
+        if (!p->chunks[i].data) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+
+    if ((ret = pthread_mutex_init(&p->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&p->cond, NULL))) {
+        pthread_mutex_destroy(&p->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    for (i = 0; i < s->connections; i++) {
+        if ((ret = pthread_create(&p->workers[i], NULL, http_parallel_worker, p))) {
+            av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", av_err2str(AVERROR(ret)));
+            if (!i) {
+                pthread_cond_destroy(&p->cond);
+                pthread_mutex_destroy(&p->mutex);
+                ret = AVERROR(ret);
+                goto fail;
+            }
+            break;
+        }
+        p->nb_workers++;
+    }
+
+    av_log(h, AV_LOG_VERBOSE, "Reading %"PRIu64" bytes over %d connections in %d byte ranges\n",
+           s->filesize, p->nb_workers, s->chunk_size);
+    return 0;
+
+fail:
+    if (p->chunks)
+        for (i = 0; i < p->nb_chunks; i++)
+            av_freep(&p->chunks[i].data);
+    av_freep(&p->chunks);
+    av_freep(&p->workers);
+    av_freep(&s->parallel);
+    return ret;
+}
+
+static void http_parallel_stop(HTTPContext *s)
+{
+    HTTPParallel *p = s->parallel;
+    int i;
+
+    pthread_mutex_lock(&p->mutex);
+    p->abort_request = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+
+    for (i = 0; i < p->nb_workers; i++)
+        pthread_join(p->workers[i], NULL);
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+
+    for (i = 0; i < p->nb_chunks; i++)
+        av_freep(&p->chunks[i].data);
+    av_freep(&p->chunks);
+    av_freep(&p->workers);
+    av_freep(&s->parallel);
+}
+
+/* Slide the window so that it starts at the chunk with the given index,
+ * chunks falling out of it are abandoned. Called with the mutex held. */
+static void http_parallel_move(HTTPParallel *p, int64_t index)
+{
+    int64_t i;
+
+    if (index < p->read_chunk || index >= p->read_chunk + p->nb_chunks) {
+        for (i = 0; i < p->nb_chunks; i++)
+            p->chunks[i].index = -1;
+        p->next_chunk = index;
+    } else {
+        for (i = p->read_chunk; i < index; i++)
+            p->chunks[i % p->nb_chunks].index = -1;
+        p->next_chunk = FFMAX(p->next_chunk, index);
+    }
+    p->read_chunk = index;
+    pthread_cond_broadcast(&p->cond);
+}
+
+static int http_parallel_read(URLContext *h, uint8_t *buf, int size)
+{
+    HTTPContext  *s = h->priv_data;
+    HTTPParallel *p = s->parallel;
+    HTTPChunk    *c;
+    int64_t index;
+    int off, ret;
+
+    if (p->pos >= s->filesize)
+        return AVERROR_EOF;
+    index = p->pos / s->chunk_size;
+    off   = p->pos % s->chunk_size;
+    c     = &p->chunks[index % p->nb_chunks];
+
+    pthread_mutex_lock(&p->mutex);
+    if (index != p->read_chunk)
+        http_parallel_move(p, index);
+    while (c->index != index || (c->filled <= off && !c->error)) {
+        if (http_parallel_check_interrupt(p)) {
+            pthread_mutex_unlock(&p->mutex);
+            return AVERROR_EXIT;
+        }
+        http_parallel_wait(p);
+    }
+    ret = c->filled > off ? FFMIN(size, c->filled - off) : c->error;
+    pthread_mutex_unlock(&p->mutex);
+
+    /* the filled part of a chunk is not modified until the window moves */
+    if (ret > 0) {
+        memcpy(buf, c->data + off, ret);
+        p->pos += ret;
+    }
+    return ret;
+}
+
+static int64_t http_parallel_seek(URLContext *h, int64_t off, int whence)
+{
+    HTTPContext  *s = h->priv_data;
+    HTTPParallel *p = s->parallel;
+
+    if (whence == AVSEEK_SIZE)
+        return s->filesize;
+    else if (whence == SEEK_CUR)
+        off += p->pos;
+    else if (whence == SEEK_END)
+        off += s->filesize;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if (off < 0)
+        return AVERROR(EINVAL);
+
+    /* the window follows the read position on the next read */
+    p->pos = off;
+    return off;
+}
+#endif /* HAVE_THREADS */
+
 static int http_get_file_handle(URLContext *h)
 {
     HTTPContext *s = h->priv_data;
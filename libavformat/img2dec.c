@@ -29,6 +29,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/intreadwrite.h"
+#include "libavutil/thread.h"
 #include "libavcodec/gif.h"
 #include "avformat.h"
 #include "avio_internal.h"
@@ -50,6 +51,29 @@
 
 #endif /* HAVE_GLOB */
 
+typedef struct ImagePrefetchSlot {
+    int number;             ///< image held or being read, -1 if unused
+    int ready;
+    int ret;
+    AVPacket pkt;
+} ImagePrefetchSlot;
+
+typedef struct ImagePrefetchContext {
+#if HAVE_THREADS
+    pthread_t *threads;
+    int nb_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+    AVFormatContext *s1;
+    AVBufferPool *pool;     ///< recycles the packets, images have similar sizes
+    int pool_size;
+    ImagePrefetchSlot *slots;
+    int nb_slots;
+    int next;               ///< image the demuxer returns next
+    int exit;
+} ImagePrefetchContext;
+
 static const int sizes[][2] = {
     { 640, 480 },
     { 720, 480 },
@@ -179,6 +203,278 @@ static int img_read_probe(const AVProbeData *p)
     return 0;
 }
 
+static int image_filename(VideoDemuxData *s, int number,
+                          char *buf, int buf_size, char **filename)
+{
+    *filename = buf;
+    if (s->pattern_type == PT_NONE) {
+        av_strlcpy(buf, s->path, buf_size);
+    } else if (s->use_glob) {
+#if HAVE_GLOB
+        *filename = s->globstate.gl_pathv[number];
+#endif
+    } else {
+        if (av_get_frame_filename(buf, buf_size, s->path, number) < 0 && number > 1)
+            return AVERROR(EIO);
+    }
+    return 0;
+}
+
+
+/**
+ * Number of the image k positions after the image start, -1 past the end.
+ */
+static int image_after(VideoDemuxData *s, int start, int k)
+{
+    int number = start + k;
+
+    if (number > s->img_last) {
+        if (!s->loop)
+            return -1;
+        number = s->img_first + (number - s->img_first) % (s->img_last - s->img_first + 1);
+    }
+    return number;
+}
+
+#if HAVE_THREADS
+/**
+ * Read a whole image file into a packet allocated from the prefetch pool.
+ */
+static int read_image_file(ImagePrefetchContext *p, const char *filename, AVPacket *pkt)
+{
+    AVFormatContext *s1 = p->s1;
+    AVIOContext *pb = NULL;
+    int64_t size;
+    int ret;
+
+    if (s1->io_open(s1, &pb, filename, AVIO_FLAG_READ, NULL) < 0)
+        return AVERROR(EIO);
+    size = avio_size(pb);
+    if (size <= 0 || size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
+        ret = size < 0 ? size : !size ? AVERROR_EOF : AVERROR(ERANGE);
+        goto end;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    if (p->pool_size < size + AV_INPUT_BUFFER_PADDING_SIZE) {
+        av_buffer_pool_uninit(&p->pool);
+        p->pool_size = size + AV_INPUT_BUFFER_PADDING_SIZE;
+        p->pool      = av_buffer_pool_init(p->pool_size, NULL);
+    }
+    pkt->buf = p->pool ? av_buffer_pool_get(p->pool) : NULL;
+    pthread_mutex_unlock(&p->lock);
+    if (!pkt->buf) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = avio_read(pb, pkt->buf->data, size);
+    if (ret > 0) {
+        pkt->data = pkt->buf->data;
+        pkt->size = ret;
+        memset(pkt->data + ret, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    } else {
+        av_packet_unref(pkt);
+        if (!ret)
+            ret = AVERROR_EOF;
+    }
+end:
+    ff_format_io_close(s1, &pb);
+    return ret;
+}
+
+static ImagePrefetchSlot *find_slot(ImagePrefetchContext *p, int number)
+{
+    int i;
+
+    for (i = 0; i < p->nb_slots; i++)
+        if (p->slots[i].number == number)
+            return &p->slots[i];
+    return NULL;
+}
+
+/* A slot that is unused or holds an image the demuxer will not return soon. */
+static ImagePrefetchSlot *free_slot(ImagePrefetchContext *p, VideoDemuxData *s)
+{
+    int i, k;
+
+    for (i = 0; i < p->nb_slots; i++) {
+        ImagePrefetchSlot *slot = &p->slots[i];
+
+        if (slot->number < 0)
+            return slot;
+        if (!slot->ready)
+            continue;
+        for (k = 0; k < p->nb_slots; k++)
+            if (image_after(s, p->next, k) == slot->number)
+                break;
+        if (k == p->nb_slots)
+            return slot;
+    }
+    return NULL;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    ImagePrefetchContext *p = arg;
+    AVFormatContext *s1 = p->s1;
+    VideoDemuxData *s = s1->priv_data;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->exit) {
+        ImagePrefetchSlot *slot = NULL;
+        char filename_bytes[1024];
+        char *filename;
+        int k, number = -1, ret;
+
+        for (k = 0; k < p->nb_slots; k++) {
+            int n = image_after(s, p->next, k);
+            if (n < 0)
+                break;
+            if (!find_slot(p, n)) {
+                number = n;
+                break;
+            }
+        }
+        if (number >= 0)
+            slot = free_slot(p, s);
+        if (!slot) {
+            pthread_cond_wait(&p->cond, &p->lock);
+            continue;
+        }
+        av_packet_unref(&slot->pkt);
+        slot->number = number;
+        slot->ready  = 0;
+        pthread_mutex_unlock(&p->lock);
+
+        ret = image_filename(s, number, filename_bytes, sizeof(filename_bytes), &filename);
+        if (ret >= 0)
+            ret = read_image_file(p, filename, &slot->pkt);
+
+        pthread_mutex_lock(&p->lock);
+        slot->ret   = ret;
+        slot->ready = 1;
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void prefetch_uninit(AVFormatContext *s1)
+{
+    VideoDemuxData *s = s1->priv_data;
+    ImagePrefetchContext *p = s->prefetch_ctx;
+    int i;
+
+    if (!p)
+        return;
+    pthread_mutex_lock(&p->lock);
+    p->exit = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    for (i = 0; i < p->nb_threads; i++)
+        pthread_join(p->threads[i], NULL);
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+    for (i = 0; i < p->nb_slots; i++)
+        av_packet_unref(&p->slots[i].pkt);
+    av_buffer_pool_uninit(&p->pool);
+    av_freep(&p->slots);
+    av_freep(&p->threads);
+    av_freep(&s->prefetch_ctx);
+}
+
+static int prefetch_init(AVFormatContext *s1)
+{
+    VideoDemuxData *s = s1->priv_data;
+    ImagePrefetchContext *p;
+    int i, ret;
+
+    p = s->prefetch_ctx = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->s1       = s1;
+    p->next     = s->img_number;
+    p->nb_slots = s->prefetch;
+    p->slots    = av_mallocz_array(p->nb_slots, sizeof(*p->slots));
+    p->threads  = av_mallocz_array(s->prefetch, sizeof(*p->threads));
+    if (!p->slots || !p->threads) {
+        av_freep(&p->slots);
+        av_freep(&p->threads);
+        av_freep(&s->prefetch_ctx);
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < p->nb_slots; i++)
+        p->slots[i].number = -1;
+
+    if ((ret = AVERROR(pthread_mutex_init(&p->lock, NULL)))) {
+        av_freep(&p->slots);
+        av_freep(&p->threads);
+        av_freep(&s->prefetch_ctx);
+        return ret;
+    }
+    if ((ret = AVERROR(pthread_cond_init(&p->cond, NULL)))) {
+        pthread_mutex_destroy(&p->lock);
+        av_freep(&p->slots);
+        av_freep(&p->threads);
+        av_freep(&s->prefetch_ctx);
+        return ret;
+    }
+    for (i = 0; i < s->prefetch; i++) {
+        if ((ret = AVERROR(pthread_create(&p->threads[i], NULL, prefetch_thread, p)))) {
+            prefetch_uninit(s1);
+            return ret;
+        }
+        p->nb_threads++;
+    }
+    return 0;
+}
+
+/**
+ * Take the image the demuxer returns next from the prefetch threads,
+ * waiting for it if it is still being read.
+ */
+static int prefetch_get(AVFormatContext *s1, AVPacket *pkt)
+{
+    VideoDemuxData *s = s1->priv_data;
+    ImagePrefetchContext *p = s->prefetch_ctx;
+    ImagePrefetchSlot *slot;
+    int ret;
+
+    pthread_mutex_lock(&p->lock);
+    if (p->next != s->img_number) {
+        p->next = s->img_number;
+        pthread_cond_broadcast(&p->cond);
+    }
+    while (!(slot = find_slot(p, s->img_number)) || !slot->ready)
+        pthread_cond_wait(&p->cond, &p->lock);
+    ret = slot->ret;
+    av_packet_move_ref(pkt, &slot->pkt);
+    slot->number = -1;
+    slot->ready  = 0;
+    p->next = s->img_number + 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    return ret;
+}
+#endif
+
+static void probe_image_codec(AVCodecParameters *par, uint8_t *buf, int size,
+                              const char *filename)
+{
+    AVProbeData pd = { 0 };
+    const AVInputFormat *ifmt;
+    int score = 0;
+
+    pd.buf      = buf;
+    pd.buf_size = size;
+    pd.filename = filename;
+
+    ifmt = av_probe_input_format3(&pd, 1, &score);
+    if (ifmt && ifmt->read_packet == ff_img_read_packet && ifmt->raw_codec_id)
+        par->codec_id = ifmt->raw_codec_id;
+}
+
 int ff_img_read_header(AVFormatContext *s1)
 {
     VideoDemuxData *s = s1->priv_data;
@@ -371,6 +667,20 @@ int ff_img_read_header(AVFormatContext *s1)
         pix_fmt != AV_PIX_FMT_NONE)
         st->codecpar->format = pix_fmt;
 
+    if (s->prefetch > 0 && !s->is_pipe) {
+        if (s->split_planes || (s1->pb && s->pattern_type == PT_NONE)) {
+            av_log(s1, AV_LOG_WARNING, "prefetch is not supported for this input, ignoring it\n");
+        } else {
+#if HAVE_THREADS
+            int ret = prefetch_init(s1);
+            if (ret < 0)
+                return ret;
+#else
+            av_log(s1, AV_LOG_WARNING, "prefetch requires thread support, ignoring it\n");
+#endif
+        }
+    }
+
     return 0;
 }
 
@@ -399,6 +709,36 @@ static int add_filename_as_pkt_side_data(char *filename, AVPacket *pkt) {
     return 0;
 }
 
+static int set_packet_props(AVFormatContext *s1, AVPacket *pkt, char *filename)
+{
+    VideoDemuxData *s = s1->priv_data;
+
+    pkt->stream_index = 0;
+    pkt->flags       |= AV_PKT_FLAG_KEY;
+    if (s->ts_from_file) {
+        struct stat img_stat;
+        if (stat(filename, &img_stat))
+            return AVERROR(EIO);
+        pkt->pts = (int64_t)img_stat.st_mtime;
+#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+        if (s->ts_from_file == 2)
+            pkt->pts = 1000000000*pkt->pts + img_stat.st_mtim.tv_nsec;
+#endif
+        av_add_index_entry(s1->streams[0], s->img_number, pkt->pts, 0, 0, AVINDEX_KEYFRAME);
+    } else if (!s->is_pipe) {
+        pkt->pts      = s->pts;
+    }
+
+    /*
+     * export_path_metadata must be explicitly enabled via
+     * command line options for path metadata to be exported
+     * as packet side_data.
+     */
+    if (!s->is_pipe && s->export_path_metadata == 1)
+        return add_filename_as_pkt_side_data(filename, pkt);
+    return 0;
+}
+
 int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
 {
     VideoDemuxData *s = s1->priv_data;
@@ -416,18 +756,31 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
         }
         if (s->img_number > s->img_last)
             return AVERROR_EOF;
-        if (s->pattern_type == PT_NONE) {
-            av_strlcpy(filename_bytes, s->path, sizeof(filename_bytes));
-        } else if (s->use_glob) {
-#if HAVE_GLOB
-            filename = s->globstate.gl_pathv[s->img_number];
-#endif
-        } else {
-        if (av_get_frame_filename(filename_bytes, sizeof(filename_bytes),
-                                  s->path,
-                                  s->img_number) < 0 && s->img_number > 1)
-            return AVERROR(EIO);
+        if ((res = image_filename(s, s->img_number, filename_bytes,
+                                  sizeof(filename_bytes), &filename)) < 0)
+            return res;
+#if HAVE_THREADS
+        if (s->prefetch_ctx) {
+            res = prefetch_get(s1, pkt);
+            if (res < 0) {
+                av_log(s1, AV_LOG_ERROR, "Could not read file : %s\n", filename);
+                return res;
+            }
+            if (par->codec_id == AV_CODEC_ID_NONE)
+                probe_image_codec(par, pkt->data, FFMIN(pkt->size, PROBE_BUF_MIN), filename);
+            if (par->codec_id == AV_CODEC_ID_RAWVIDEO && !par->width)
+                infer_size(&par->width, &par->height, pkt->size);
+            res = set_packet_props(s1, pkt, filename);
+            if (res < 0) {
+                av_packet_unref(pkt);
+                return res;
+            }
+            s->img_count++;
+            s->img_number++;
+            s->pts++;
+            return 0;
         }
+#endif
         for (i = 0; i < 3; i++) {
             if (s1->pb &&
                 !strcmp(filename_bytes, s->path) &&
@@ -449,24 +802,15 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
         }
 
         if (par->codec_id == AV_CODEC_ID_NONE) {
-            AVProbeData pd = { 0 };
-            const AVInputFormat *ifmt;
             uint8_t header[PROBE_BUF_MIN + AVPROBE_PADDING_SIZE];
             int ret;
-            int score = 0;
 
             ret = avio_read(f[0], header, PROBE_BUF_MIN);
             if (ret < 0)
                 return ret;
             memset(header + ret, 0, sizeof(header) - ret);
             avio_skip(f[0], -ret);
-            pd.buf = header;
-            pd.buf_size = ret;
-            pd.filename = filename;
-
-            ifmt = av_probe_input_format3(&pd, 1, &score);
-            if (ifmt && ifmt->read_packet == ff_img_read_packet && ifmt->raw_codec_id)
-                par->codec_id = ifmt->raw_codec_id;
+            probe_image_codec(par, header, ret, filename);
         }
 
         if (par->codec_id == AV_CODEC_ID_RAWVIDEO && !par->width)
@@ -490,38 +834,13 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
     if (res < 0) {
         goto fail;
     }
-    pkt->stream_index = 0;
-    pkt->flags       |= AV_PKT_FLAG_KEY;
-    if (s->ts_from_file) {
-        struct stat img_stat;
-        if (stat(filename, &img_stat)) {
-            res = AVERROR(EIO);
-            goto fail;
-        }
-        pkt->pts = (int64_t)img_stat.st_mtime;
-#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
-        if (s->ts_from_file == 2)
-            pkt->pts = 1000000000*pkt->pts + img_stat.st_mtim.tv_nsec;
-#endif
-        av_add_index_entry(s1->streams[0], s->img_number, pkt->pts, 0, 0, AVINDEX_KEYFRAME);
-    } else if (!s->is_pipe) {
-        pkt->pts      = s->pts;
-    }
+    res = set_packet_props(s1, pkt, filename);
+    if (res < 0)
+        goto fail;
 
     if (s->is_pipe)
         pkt->pos = avio_tell(f[0]);
 
-    /*
-     * export_path_metadata must be explicitly enabled via
-     * command line options for path metadata to be exported
-     * as packet side_data.
-     */
-    if (!s->is_pipe && s->export_path_metadata == 1) {
-        res = add_filename_as_pkt_side_data(filename, pkt);
-        if (res < 0)
-            goto fail;
-    }
-
     pkt->size = 0;
     for (i = 0; i < 3; i++) {
         if (f[i]) {
@@ -567,13 +886,18 @@ fail:
     return res;
 }
 
-static int img_read_close(struct AVFormatContext* s1)
+int ff_img_read_close(struct AVFormatContext* s1)
 {
+#if HAVE_THREADS
+    prefetch_uninit(s1);
+#endif
 #if HAVE_GLOB
+    {
     VideoDemuxData *s = s1->priv_data;
     if (s->use_glob) {
         globfree(&s->globstate);
     }
+    }
 #endif
     return 0;
 }
@@ -621,6 +945,7 @@ const AVOption ff_img_options[] = {
     { "sec",  "second precision",       0, AV_OPT_TYPE_CONST,    {.i64 = 1   }, 0, 2,       DEC, "ts_type" },
     { "ns",   "nano second precision",  0, AV_OPT_TYPE_CONST,    {.i64 = 2   }, 0, 2,       DEC, "ts_type" },
     { "export_path_metadata", "enable metadata containing input path information", OFFSET(export_path_metadata), AV_OPT_TYPE_BOOL,   {.i64 = 0   }, 0, 1,       DEC }, \
+    { "prefetch",     "number of files to read ahead in parallel", OFFSET(prefetch), AV_OPT_TYPE_INT, {.i64 = 0   }, 0, 256,     DEC },
     COMMON_OPTIONS
 };
 
@@ -637,7 +962,7 @@ AVInputFormat ff_image2_demuxer = {
     .read_probe     = img_read_probe,
     .read_header    = ff_img_read_header,
     .read_packet    = ff_img_read_packet,
-    .read_close     = img_read_close,
+    .read_close     = ff_img_read_close,
     .read_seek      = img_read_seek,
     .flags          = AVFMT_NOFILE,
     .priv_class     = &img2_class,
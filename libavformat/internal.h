@@ -142,6 +142,11 @@ struct AVFormatInternal {
      * Prefer the codec framerate for avg_frame_rate computation.
      */
     int prefer_codec_framerate;
+
+    /**
+     * Threads decoding packets for avformat_find_stream_info(), if any.
+     */
+    struct ProbeThreadContext *probe_threads;
 };
 
 struct AVStreamInternal {
@@ -155,6 +155,30 @@ typedef struct MOVIndexRange {
     int64_t end;
 } MOVIndexRange;
 
+/**
+ * Compact sample index: samples are resolved on demand from the stts, stsc,
+ * stsz and stco tables, and st->index_entries only holds the seek points.
+ */
+typedef struct MOVSampleIndex {
+    unsigned int nb_samples;
+    int all_keyframes;       ///< every sample is a sync sample
+    int key_off;             ///< offset of the stss/stps sample numbers
+    int64_t *stts_sample;    ///< first sample of each stts entry
+    int64_t *stts_dts;       ///< dts of the first sample of each stts entry
+    int64_t *stsc_sample;    ///< first sample of each stsc entry
+    int *entry_sample;       ///< sample number of each st->index_entries element
+    /* state of the sequential sample cursor */
+    unsigned int next_sample;
+    unsigned int chunk;
+    unsigned int chunk_sample;
+    unsigned int stsc_index;
+    unsigned int stts_index;
+    int64_t pos;
+    /* last resolved sample */
+    int64_t entry_index;
+    AVIndexEntry entry;
+} MOVSampleIndex;
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int pb_is_copied;
@@ -193,6 +217,7 @@ typedef struct MOVStreamContext {
     int64_t current_index;
     MOVIndexRange* index_ranges;
     MOVIndexRange* current_index_range;
+    MOVSampleIndex *sample_index; ///< compact index, NULL if samples are in st->index_entries
     unsigned int bytes_per_frame;
     unsigned int samples_per_frame;
     int dv_audio_container;
@@ -291,6 +316,7 @@ typedef struct MOVContext {
     int decryption_key_len;
     int enable_drefs;
     int32_t movie_display_matrix[3][3]; ///< display matrix from mvhd
+    int lazy_index;
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
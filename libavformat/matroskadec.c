@@ -44,6 +44,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time_internal.h"
 #include "libavutil/spherical.h"
+#include "libavutil/thread.h"
 
 #include "libavcodec/bytestream.h"
 #include "libavcodec/flac.h"
@@ -79,6 +80,9 @@
 #define UNKNOWN_EQUIV         50 * 1024 /* An unknown element is considered equivalent
                                          * to this many bytes of unknown data for the
                                          * SKIP_THRESHOLD check. */
+#define READAHEAD_MAX_SIZE (16 << 20) /* Larger clusters are not read ahead,
+                                         * so that at most cluster_threads + 1
+                                         * times this much data is buffered. */
 
 typedef enum {
     EBML_NONE,
@@ -332,6 +336,35 @@ typedef struct MatroskaCluster {
     int64_t pos;
 } MatroskaCluster;
 
+typedef struct MatroskaClusterBlock {
+    uint8_t *data;
+    int      size;
+    int64_t  pos;
+    uint64_t cluster_time;
+    uint64_t duration;
+    int      is_keyframe;
+    uint8_t *additional;
+    int      additional_size;
+    uint64_t additional_id;
+    int64_t  discard_padding;
+} MatroskaClusterBlock;
+
+/* A cluster read ahead, whose blocks are located by a worker thread. */
+typedef struct MatroskaClusterJob {
+    AVBufferRef *buf;
+    int      size;
+    int64_t  pos;       ///< position of the cluster element
+    int64_t  data_pos;  ///< position of the cluster contents
+    MatroskaClusterBlock *blocks;
+    unsigned blocks_allocated;
+    int      nb_blocks;
+    int      next_block; ///< index of the next block to queue
+    int      ret;
+    int      taken;
+    int      parsed;
+    struct MatroskaClusterJob *next;
+} MatroskaClusterJob;
+
 typedef struct MatroskaLevel1Element {
     int64_t  pos;
     uint32_t id;
@@ -388,6 +421,22 @@ typedef struct MatroskaDemuxContext {
 
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
+
+    /* Cluster read-ahead */
+    int cluster_threads;
+    MatroskaClusterJob *jobs;
+    MatroskaClusterJob *jobs_end;
+    int nb_jobs;
+    int readahead_ret;
+    int64_t readahead_end;  ///< input position after reading ahead
+#if HAVE_THREADS
+    pthread_t *threads;
+    int nb_threads;
+    int threads_exit;
+    pthread_mutex_t jobs_lock;
+    pthread_cond_t  jobs_cond;
+    pthread_cond_t  parsed_cond;
+#endif
 } MatroskaDemuxContext;
 
 #define CHILD_OF(parent) { .def = { .n = parent } }
@@ -771,6 +820,8 @@ static const CodecMime mkv_mime_tags[] = {
 static const char *const matroska_doctypes[] = { "matroska", "webm" };
 
 static int matroska_read_close(AVFormatContext *s);
+static void matroska_readahead_flush(MatroskaDemuxContext *matroska);
+static int matroska_readahead_init(MatroskaDemuxContext *matroska);
 
 /*
  * This function prepares the status for parsing of level 1 elements.
@@ -778,6 +829,8 @@ static int matroska_read_close(AVFormatContext *s);
 static int matroska_reset_status(MatroskaDemuxContext *matroska,
                                  uint32_t id, int64_t position)
 {
+    matroska_readahead_flush(matroska);
+
     if (position >= 0) {
         int64_t err = avio_seek(matroska->ctx->pb, position, SEEK_SET);
         if (err < 0)
@@ -1893,10 +1946,12 @@ static void matroska_execute_seekhead(MatroskaDemuxContext *matroska)
 
 static void matroska_add_index_entries(MatroskaDemuxContext *matroska)
 {
+    MatroskaTrack *tracks = matroska->tracks.elem;
     EbmlList *index_list;
     MatroskaIndex *index;
+    AVIndexEntry *entries;
     uint64_t index_scale = 1;
-    int i, j;
+    int i, j, k, nb_pos = 0;
 
     if (matroska->ctx->flags & AVFMT_FLAG_IGNIDX)
         return;
@@ -1909,19 +1964,40 @@ static void matroska_add_index_entries(MatroskaDemuxContext *matroska)
         av_log(matroska->ctx, AV_LOG_WARNING, "Dropping apparently-broken index.\n");
         return;
     }
-    for (i = 0; i < index_list->nb_elem; i++) {
-        EbmlList *pos_list    = &index[i].pos;
-        MatroskaIndexPos *pos = pos_list->elem;
-        for (j = 0; j < pos_list->nb_elem; j++) {
-            MatroskaTrack *track = matroska_find_track_by_num(matroska,
-                                                              pos[j].track);
-            if (track && track->stream)
-                av_add_index_entry(track->stream,
-                                   pos[j].pos + matroska->segment_start,
-                                   index[i].time / index_scale, 0, 0,
-                                   AVINDEX_KEYFRAME);
+
+    /* add the cue points of each track in one batch */
+    for (i = 0; i < index_list->nb_elem; i++)
+        nb_pos += index[i].pos.nb_elem;
+    entries = av_malloc_array(nb_pos, sizeof(*entries));
+    if (!entries)
+        return;
+    for (k = 0; k < matroska->tracks.nb_elem; k++) {
+        MatroskaTrack *track = &tracks[k];
+        int nb_entries = 0;
+
+        if (!track->stream)
+            continue;
+        for (i = 0; i < index_list->nb_elem; i++) {
+            EbmlList *pos_list    = &index[i].pos;
+            MatroskaIndexPos *pos = pos_list->elem;
+            for (j = 0; j < pos_list->nb_elem; j++) {
+                AVIndexEntry *ie = &entries[nb_entries];
+                if (pos[j].track != track->num ||
+                    matroska_find_track_by_num(matroska, pos[j].track) != track)
+                    continue;
+                ie->pos          = pos[j].pos + matroska->segment_start;
+                ie->timestamp    = index[i].time / index_scale;
+                ie->flags        = AVINDEX_KEYFRAME;
+                ie->size         = 0;
+                ie->min_distance = 0;
+                /* rejected by av_add_index_entry(), would fail the whole batch */
+                if (ie->timestamp != AV_NOPTS_VALUE)
+                    nb_entries++;
+            }
         }
+        av_add_index_entries(track->stream, entries, nb_entries);
     }
+    av_free(entries);
 }
 
 static void matroska_parse_cues(MatroskaDemuxContext *matroska) {
@@ -2978,6 +3054,9 @@ static int matroska_read_header(AVFormatContext *s)
 
     matroska_convert_tags(s);
 
+    if ((res = matroska_readahead_init(matroska)) < 0)
+        goto fail;
+
     return 0;
 fail:
     matroska_read_close(s);
@@ -3679,6 +3758,62 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
     return 0;
 }
 
+/*
+ * Read a SimpleBlock directly, without going through the syntax tables.
+ * Returns 1 if a SimpleBlock has been read into block, 0 if the next
+ * element has to be parsed by ebml_parse() and < 0 on error.
+ */
+static int matroska_read_simpleblock(MatroskaDemuxContext *matroska,
+                                     MatroskaBlock *block)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    MatroskaLevel *level = &matroska->levels[matroska->num_levels - 1];
+    int64_t pos = avio_tell(pb), pos_alt;
+    uint64_t length;
+    int res;
+
+    if (matroska->current_id)
+        return 0;
+    /* an ID byte and a length of up to 8 bytes might have to be read again */
+    if ((res = ffio_ensure_seekback(pb, 9)) < 0)
+        return res;
+    if (avio_r8(pb) != (MATROSKA_ID_SIMPLEBLOCK & 0xFF) || pb->eof_reached)
+        goto fallback;
+    if ((res = ebml_read_length(matroska, pb, &length)) < 0)
+        goto fallback;
+    pos_alt = pos + 1 + res;
+
+    if (length > 0x10000000 ||
+        (level->length != EBML_UNKNOWN_LENGTH &&
+         pos_alt + length > level->start + level->length))
+        goto fallback;
+
+    matroska->unknown_count = 0;
+    matroska->resync_pos    = pos;
+
+    res = ebml_read_binary(pb, length, pos_alt, &block->bin);
+    if (res < 0)
+        return res;
+    if (res == NEEDS_CHECKING) {
+        av_log(matroska->ctx, AV_LOG_ERROR, "File ended prematurely\n");
+        return pb->error ? pb->error : AVERROR(EIO);
+    }
+
+    pos = avio_tell(pb);
+    while (matroska->num_levels && level->length != EBML_UNKNOWN_LENGTH &&
+           pos == level->start + level->length) {
+        matroska->num_levels--;
+        level--;
+    }
+    return 1;
+
+fallback:
+    /* let ebml_parse() handle it and report the errors */
+    if ((res = avio_seek(pb, pos, SEEK_SET)) < 0)
+        return res;
+    return 0;
+}
+
 static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
 {
     MatroskaCluster *cluster = &matroska->current_cluster;
@@ -3702,7 +3837,9 @@ static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
 
     if (matroska->num_levels == 2) {
         /* We are inside a cluster. */
-        res = ebml_parse(matroska, matroska_cluster_parsing, cluster);
+        res = matroska_read_simpleblock(matroska, block);
+        if (!res)
+            res = ebml_parse(matroska, matroska_cluster_parsing, cluster);
 
         if (res >= 0 && block->bin.size > 0) {
             int is_keyframe = block->non_simple ? block->reference == INT64_MIN : -1;
@@ -3735,6 +3872,450 @@ static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
     return res;
 }
 
+static void matroska_cluster_job_free(MatroskaClusterJob **job)
+{
+    if (!*job)
+        return;
+    av_buffer_unref(&(*job)->buf);
+    av_freep(&(*job)->blocks);
+    av_freep(job);
+}
+
+/*
+ * Read the ID and the length of the next child element of a cluster
+ * read ahead and check that it fits into its parent ending at end.
+ */
+static int matroska_read_child(MatroskaDemuxContext *matroska, AVIOContext *pb,
+                               int64_t end, uint32_t *id, uint64_t *length)
+{
+    uint64_t num;
+    int res;
+
+    if ((res = ebml_read_num(matroska, pb, 4, &num, 1)) < 0)
+        return res;
+    *id = num | 1 << 7 * res;
+    if ((res = ebml_read_length(matroska, pb, length)) < 0)
+        return res;
+    if (*length > end - avio_tell(pb))
+        return AVERROR_INVALIDDATA;
+    return 0;
+}
+
+static int matroska_parse_blockgroup(MatroskaDemuxContext *matroska,
+                                     MatroskaClusterJob *job, AVIOContext *pb,
+                                     int64_t end, MatroskaClusterBlock *block)
+{
+    int64_t reference = INT64_MIN;
+    uint64_t length;
+    uint32_t id;
+    int res;
+
+    block->additional_id = 1;
+    while (avio_tell(pb) < end) {
+        int64_t start;
+
+        if ((res = matroska_read_child(matroska, pb, end, &id, &length)) < 0)
+            return res;
+        start = avio_tell(pb);
+        switch (id) {
+        case MATROSKA_ID_BLOCK:
+            block->data = job->buf->data + start;
+            block->size = length;
+            block->pos  = job->data_pos + start;
+            break;
+        case MATROSKA_ID_BLOCKDURATION:
+        case MATROSKA_ID_DISCARDPADDING:
+        case MATROSKA_ID_BLOCKREFERENCE:
+            if (length > 8)
+                return AVERROR_INVALIDDATA;
+            if (id == MATROSKA_ID_BLOCKDURATION)
+                ebml_read_uint(pb, length, &block->duration);
+            else if (id == MATROSKA_ID_DISCARDPADDING)
+                ebml_read_sint(pb, length, &block->discard_padding);
+            else
+                ebml_read_sint(pb, length, &reference);
+            break;
+        case MATROSKA_ID_BLOCKADDITIONS:
+            /* BlockMore elements; as with the syntax tables, the last one wins */
+            while (avio_tell(pb) < start + length) {
+                int64_t more_end;
+                uint64_t more_length;
+
+                if ((res = matroska_read_child(matroska, pb, start + length,
+                                               &id, &more_length)) < 0)
+                    return res;
+                more_end = avio_tell(pb) + more_length;
+                if (id != MATROSKA_ID_BLOCKMORE) {
+                    avio_skip(pb, more_length);
+                    continue;
+                }
+                block->additional_id = 1;
+                while (avio_tell(pb) < more_end) {
+                    uint64_t child_length;
+                    if ((res = matroska_read_child(matroska, pb, more_end,
+                                                   &id, &child_length)) < 0)
+                        return res;
+                    if (id == MATROSKA_ID_BLOCKADDID && child_length <= 8) {
+                        ebml_read_uint(pb, child_length, &block->additional_id);
+                    } else {
+                        if (id == MATROSKA_ID_BLOCKADDITIONAL) {
+                            block->additional      = job->buf->data + avio_tell(pb);
+                            block->additional_size = child_length;
+                        }
+                        avio_skip(pb, child_length);
+                    }
+                }
+            }
+            break;
+        }
+        avio_seek(pb, start + length, SEEK_SET);
+    }
+    block->is_keyframe = reference == INT64_MIN;
+    return 0;
+}
+
+/*
+ * Locate the blocks of a cluster read ahead. This does not touch the
+ * state of the demuxer, so that it can run on a worker thread.
+ */
+static int matroska_parse_cluster_job(MatroskaDemuxContext *matroska,
+                                      MatroskaClusterJob *job)
+{
+    AVIOContext pb;
+    uint64_t cluster_time = 0, length;
+    uint32_t id;
+    int res;
+
+    ffio_init_context(&pb, job->buf->data, job->size, 0, NULL, NULL, NULL, NULL);
+
+    while (avio_tell(&pb) < job->size) {
+        MatroskaClusterBlock *block;
+        int64_t start;
+
+        if ((res = matroska_read_child(matroska, &pb, job->size, &id, &length)) < 0)
+            return res;
+        start = avio_tell(&pb);
+
+        if (id == MATROSKA_ID_CLUSTERTIMECODE) {
+            if (length > 8)
+                return AVERROR_INVALIDDATA;
+            ebml_read_uint(&pb, length, &cluster_time);
+            continue;
+        } else if (id != MATROSKA_ID_SIMPLEBLOCK && id != MATROSKA_ID_BLOCKGROUP) {
+            avio_seek(&pb, start + length, SEEK_SET);
+            continue;
+        }
+
+        block = av_fast_realloc(job->blocks, &job->blocks_allocated,
+                                (job->nb_blocks + 1) * sizeof(*job->blocks));
+        if (!block)
+            return AVERROR(ENOMEM);
+        job->blocks = block;
+        block = &job->blocks[job->nb_blocks];
+        memset(block, 0, sizeof(*block));
+        block->cluster_time = cluster_time;
+
+        if (id == MATROSKA_ID_SIMPLEBLOCK) {
+            block->data        = job->buf->data + start;
+            block->size        = length;
+            block->pos         = job->data_pos + start;
+            block->is_keyframe = -1;
+        } else if ((res = matroska_parse_blockgroup(matroska, job, &pb,
+                                                    start + length, block)) < 0) {
+            return res;
+        }
+        if (block->size > 0)
+            job->nb_blocks++;
+        avio_seek(&pb, start + length, SEEK_SET);
+    }
+    return 0;
+}
+
+static void matroska_run_cluster_job(MatroskaDemuxContext *matroska,
+                                     MatroskaClusterJob *job)
+{
+    job->ret = matroska_parse_cluster_job(matroska, job);
+    if (job->ret < 0)
+        av_log(matroska->ctx, AV_LOG_ERROR, "Invalid data in the cluster at "
+               "pos. %"PRId64", %d blocks found before.\n", job->pos, job->nb_blocks);
+}
+
+#if HAVE_THREADS
+static void *matroska_cluster_worker(void *arg)
+{
+    MatroskaDemuxContext *matroska = arg;
+
+    pthread_mutex_lock(&matroska->jobs_lock);
+    while (!matroska->threads_exit) {
+        MatroskaClusterJob *job;
+
+        for (job = matroska->jobs; job && job->taken; job = job->next)
+            ;
+        if (!job) {
+            pthread_cond_wait(&matroska->jobs_cond, &matroska->jobs_lock);
+            continue;
+        }
+        job->taken = 1;
+        pthread_mutex_unlock(&matroska->jobs_lock);
+
+        matroska_run_cluster_job(matroska, job);
+
+        pthread_mutex_lock(&matroska->jobs_lock);
+        job->parsed = 1;
+        pthread_cond_broadcast(&matroska->parsed_cond);
+    }
+    pthread_mutex_unlock(&matroska->jobs_lock);
+    return NULL;
+}
+#endif
+
+/* Wait for the workers and drop all clusters read ahead. */
+static void matroska_readahead_flush(MatroskaDemuxContext *matroska)
+{
+    MatroskaClusterJob *job;
+
+#if HAVE_THREADS
+    if (matroska->nb_threads) {
+        pthread_mutex_lock(&matroska->jobs_lock);
+        /* keep the workers from taking further jobs */
+        for (job = matroska->jobs; job; job = job->next)
+            if (!job->taken)
+                job->taken = job->parsed = 1;
+        for (job = matroska->jobs; job; job = job->next)
+            while (!job->parsed)
+                pthread_cond_wait(&matroska->parsed_cond, &matroska->jobs_lock);
+    }
+#endif
+    while ((job = matroska->jobs)) {
+        matroska->jobs = job->next;
+        matroska_cluster_job_free(&job);
+    }
+    matroska->jobs_end      = NULL;
+    matroska->nb_jobs       = 0;
+    matroska->readahead_ret = 0;
+#if HAVE_THREADS
+    if (matroska->nb_threads)
+        pthread_mutex_unlock(&matroska->jobs_lock);
+#endif
+}
+
+static void matroska_readahead_close(MatroskaDemuxContext *matroska)
+{
+    matroska_readahead_flush(matroska);
+#if HAVE_THREADS
+    if (matroska->nb_threads) {
+        int i;
+        pthread_mutex_lock(&matroska->jobs_lock);
+        matroska->threads_exit = 1;
+        pthread_cond_broadcast(&matroska->jobs_cond);
+        pthread_mutex_unlock(&matroska->jobs_lock);
+        for (i = 0; i < matroska->nb_threads; i++)
+            pthread_join(matroska->threads[i], NULL);
+        pthread_cond_destroy(&matroska->parsed_cond);
+        pthread_cond_destroy(&matroska->jobs_cond);
+        pthread_mutex_destroy(&matroska->jobs_lock);
+        matroska->nb_threads = 0;
+    }
+    av_freep(&matroska->threads);
+#endif
+}
+
+static int matroska_readahead_init(MatroskaDemuxContext *matroska)
+{
+#if HAVE_THREADS
+    int i, nb_threads = matroska->cluster_threads;
+
+    if (nb_threads <= 0)
+        return 0;
+    matroska->threads = av_mallocz_array(nb_threads, sizeof(*matroska->threads));
+    if (!matroska->threads)
+        return AVERROR(ENOMEM);
+    pthread_mutex_init(&matroska->jobs_lock, NULL);
+    pthread_cond_init(&matroska->jobs_cond, NULL);
+    pthread_cond_init(&matroska->parsed_cond, NULL);
+    for (i = 0; i < nb_threads; i++) {
+        if (pthread_create(&matroska->threads[i], NULL,
+                           matroska_cluster_worker, matroska))
+            break;
+        matroska->nb_threads++;
+    }
+    if (!matroska->nb_threads) {
+        av_log(matroska->ctx, AV_LOG_WARNING, "Could not start the cluster "
+               "threads, clusters will be parsed on the demuxing thread.\n");
+        pthread_cond_destroy(&matroska->parsed_cond);
+        pthread_cond_destroy(&matroska->jobs_cond);
+        pthread_mutex_destroy(&matroska->jobs_lock);
+        av_freep(&matroska->threads);
+    }
+#endif
+    return 0;
+}
+
+/*
+ * Read the next cluster as a whole and queue it for the workers.
+ * Returns 1 if a cluster has been queued, 0 if the next element has to be
+ * parsed by matroska_parse_cluster() and < 0 on error.
+ */
+static int matroska_readahead_cluster(MatroskaDemuxContext *matroska)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    MatroskaLevel *segment = &matroska->levels[0];
+    MatroskaClusterJob *job;
+    int64_t pos;
+    uint64_t length;
+    int res;
+
+    do {
+        if (matroska->num_levels != 1)
+            return 0;
+        /* handles the level 1 elements between clusters */
+        res = ebml_parse(matroska, matroska_segment, NULL);
+        if (res < 0)
+            return res;
+    } while (res != 1);
+
+    /* Found a cluster, its ID has been read. */
+    pos = avio_tell(pb);
+    if ((res = ffio_ensure_seekback(pb, 8)) < 0 ||
+        (res = ebml_read_length(matroska, pb, &length)) < 0)
+        return res;
+    if (length > READAHEAD_MAX_SIZE ||
+        (segment->length != EBML_UNKNOWN_LENGTH &&
+         pos + res + length > segment->start + segment->length)) {
+        /* unknown-length, too large or invalid, leave it to
+         * matroska_parse_cluster() */
+        if ((res = avio_seek(pb, pos, SEEK_SET)) < 0)
+            return res;
+        return 0;
+    }
+
+    job = av_mallocz(sizeof(*job));
+    if (!job)
+        return AVERROR(ENOMEM);
+    job->pos      = pos - 4;
+    job->data_pos = pos + res;
+    job->buf      = av_buffer_alloc(length + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!job->buf) {
+        av_free(job);
+        return AVERROR(ENOMEM);
+    }
+    res = avio_read(pb, job->buf->data, length);
+    job->size = FFMAX(res, 0);
+    memset(job->buf->data + job->size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    matroska->current_id    = 0;
+    matroska->resync_pos    = job->pos;
+    if (segment->length != EBML_UNKNOWN_LENGTH &&
+        avio_tell(pb) == segment->start + segment->length)
+        matroska->num_levels = 0;
+
+#if HAVE_THREADS
+    if (matroska->nb_threads)
+        pthread_mutex_lock(&matroska->jobs_lock);
+#endif
+    if (matroska->jobs_end)
+        matroska->jobs_end->next = job;
+    else
+        matroska->jobs = job;
+    matroska->jobs_end = job;
+    matroska->nb_jobs++;
+#if HAVE_THREADS
+    if (matroska->nb_threads) {
+        pthread_cond_signal(&matroska->jobs_cond);
+        pthread_mutex_unlock(&matroska->jobs_lock);
+    }
+#endif
+    return 1;
+}
+
+/*
+ * Replacement for matroska_parse_cluster() in read-ahead mode: keep up to
+ * cluster_threads + 1 clusters read ahead and queue the packets of the
+ * oldest one.
+ */
+static int matroska_parse_cluster_readahead(MatroskaDemuxContext *matroska)
+{
+    MatroskaClusterJob *job;
+    int res;
+
+    /* the generic seeking code moves the input without telling us */
+    if (matroska->jobs && avio_tell(matroska->ctx->pb) != matroska->readahead_end)
+        matroska_readahead_flush(matroska);
+
+    while (!matroska->readahead_ret &&
+           matroska->nb_jobs <= matroska->cluster_threads) {
+        res = matroska_readahead_cluster(matroska);
+        if (res < 0)
+            matroska->readahead_ret = res;
+        if (res <= 0)
+            break;
+    }
+    matroska->readahead_end = avio_tell(matroska->ctx->pb);
+
+    if (!matroska->jobs) {
+        res = matroska->readahead_ret;
+        matroska->readahead_ret = 0;
+        return res < 0 ? res : matroska_parse_cluster(matroska);
+    }
+
+    job = matroska->jobs;
+#if HAVE_THREADS
+    if (matroska->nb_threads) {
+        pthread_mutex_lock(&matroska->jobs_lock);
+        if (!job->taken) {
+            job->taken = 1;
+            pthread_mutex_unlock(&matroska->jobs_lock);
+            matroska_run_cluster_job(matroska, job);
+            pthread_mutex_lock(&matroska->jobs_lock);
+            job->parsed = 1;
+        }
+        while (!job->parsed)
+            pthread_cond_wait(&matroska->parsed_cond, &matroska->jobs_lock);
+        pthread_mutex_unlock(&matroska->jobs_lock);
+    } else
+#endif
+    if (!job->parsed) {
+        matroska_run_cluster_job(matroska, job);
+        job->parsed = 1;
+    }
+
+    /* queue one block per call as matroska_parse_cluster() does, so that
+     * the index and the queued packets are the same at any time */
+    if (job->next_block < job->nb_blocks) {
+        MatroskaClusterBlock *block = &job->blocks[job->next_block++];
+        res = matroska_parse_block(matroska, job->buf, block->data, block->size,
+                                   block->pos, block->cluster_time,
+                                   block->duration, block->is_keyframe,
+                                   block->additional, block->additional_id,
+                                   block->additional_size, job->pos,
+                                   block->discard_padding);
+        if (res < 0)
+            matroska->resync_pos = job->pos;
+        return res;
+    }
+
+#if HAVE_THREADS
+    if (matroska->nb_threads)
+        pthread_mutex_lock(&matroska->jobs_lock);
+#endif
+    matroska->jobs = job->next;
+    if (!matroska->jobs)
+        matroska->jobs_end = NULL;
+    matroska->nb_jobs--;
+#if HAVE_THREADS
+    if (matroska->nb_threads)
+        pthread_mutex_unlock(&matroska->jobs_lock);
+#endif
+
+    /* errors are reported after the blocks found before them, with a resync
+     * after this cluster rather than the last one read ahead */
+    res = job->ret;
+    if (res < 0)
+        matroska->resync_pos = job->pos;
+    matroska_cluster_job_free(&job);
+    return res;
+}
+
 static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MatroskaDemuxContext *matroska = s->priv_data;
@@ -3746,9 +4327,12 @@ static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
     }
 
     while (matroska_deliver_packet(matroska, pkt)) {
+        int res;
         if (matroska->done)
             return (ret < 0) ? ret : AVERROR_EOF;
-        if (matroska_parse_cluster(matroska) < 0 && !matroska->done)
+        res = matroska->cluster_threads ? matroska_parse_cluster_readahead(matroska)
+                                        : matroska_parse_cluster(matroska);
+        if (res < 0 && !matroska->done)
             ret = matroska_resync(matroska, matroska->resync_pos);
     }
 
@@ -3826,6 +4410,7 @@ static int matroska_read_close(AVFormatContext *s)
     int n;
 
     matroska_clear_queue(matroska);
+    matroska_readahead_close(matroska);
 
     for (n = 0; n < matroska->tracks.nb_elem; n++)
         if (tracks[n].type == MATROSKA_TRACK_TYPE_AUDIO)
@@ -4248,6 +4833,18 @@ static const AVClass webm_dash_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+static const AVOption matroska_options[] = {
+    { "cluster_threads", "number of threads parsing clusters read ahead, 0 to parse them while reading", OFFSET(cluster_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "Matroska demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 AVInputFormat ff_matroska_demuxer = {
     .name           = "matroska,webm",
     .long_name      = NULL_IF_CONFIG_SMALL("Matroska / WebM"),
@@ -4258,7 +4855,8 @@ AVInputFormat ff_matroska_demuxer = {
     .read_packet    = matroska_read_packet,
     .read_close     = matroska_read_close,
     .read_seek      = matroska_read_seek,
-    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska"
+    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska",
+    .priv_class     = &matroska_class,
 };
 
 AVInputFormat ff_webm_dash_manifest_demuxer = {
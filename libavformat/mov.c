@@ -3362,6 +3362,450 @@ static int64_t add_ctts_entry(MOVStts** ctts_data, unsigned int* ctts_count, uns
     return *ctts_count;
 }
 
+/* Return the index of the last element of tab that is <= v, or -1. */
+static int search_sample_table(const int64_t *tab, unsigned int count, int64_t v)
+{
+    int lo = -1, hi = count;
+
+    while (hi - lo > 1) {
+        int mid = (lo + hi) >> 1;
+        if (tab[mid] <= v)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int sample_in_table(const unsigned *tab, unsigned int count, int64_t v)
+{
+    int lo = 0, hi = count;
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (tab[mid] == v)
+            return 1;
+        if (tab[mid] < v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return 0;
+}
+
+static int mov_sample_is_keyframe(const AVStream *st, unsigned int n)
+{
+    const MOVStreamContext *sc = st->priv_data;
+    const MOVSampleIndex *si = sc->sample_index;
+    int64_t num = (int64_t)n + si->key_off;
+
+    if (si->all_keyframes)
+        return 1;
+    if (!sc->keyframe_absent && sample_in_table((const unsigned *)sc->keyframes, sc->keyframe_count, num))
+        return 1;
+    if (sc->stps_count && sample_in_table(sc->stps_data, sc->stps_count, num))
+        return 1;
+    return sc->keyframe_absent && !sc->stps_count && !n;
+}
+
+static int64_t mov_sample_index_dts(const MOVStreamContext *sc, unsigned int n)
+{
+    const MOVSampleIndex *si = sc->sample_index;
+    int i = search_sample_table(si->stts_sample, sc->stts_count, n);
+
+    return si->stts_dts[i] + (n - si->stts_sample[i]) * sc->stts_data[i].duration;
+}
+
+/**
+ * Find the sample with the largest dts <= timestamp (backward) or the
+ * smallest dts >= timestamp.
+ */
+static int mov_sample_index_search(const MOVStreamContext *sc, int64_t timestamp, int backward)
+{
+    const MOVSampleIndex *si = sc->sample_index;
+    int i = search_sample_table(si->stts_dts, sc->stts_count, timestamp);
+    int64_t n, end;
+
+    if (i < 0)
+        return backward ? -1 : 0;
+
+    end = i + 1 < sc->stts_count ? si->stts_sample[i + 1] : si->nb_samples;
+    n   = end - 1;
+    if (sc->stts_data[i].duration)
+        n = FFMIN(n, si->stts_sample[i] + (timestamp - si->stts_dts[i]) / sc->stts_data[i].duration);
+    n = FFMIN(n, si->nb_samples - 1);
+
+    if (!backward && mov_sample_index_dts(sc, n) < timestamp)
+        n++;
+    return n < si->nb_samples ? n : -1;
+}
+
+static unsigned int mov_sample_size(const MOVStreamContext *sc, unsigned int n)
+{
+    return sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[n];
+}
+
+/* Move the sequential cursor to sample n. */
+static void mov_sample_index_seek(MOVStreamContext *sc, unsigned int n)
+{
+    MOVSampleIndex *si = sc->sample_index;
+    int64_t first, rel;
+    unsigned int i;
+
+    si->stsc_index   = search_sample_table(si->stsc_sample, sc->stsc_count, n);
+    rel              = n - si->stsc_sample[si->stsc_index];
+    si->chunk        = sc->stsc_data[si->stsc_index].first - 1 + rel / sc->stsc_data[si->stsc_index].count;
+    si->chunk_sample = rel % sc->stsc_data[si->stsc_index].count;
+    si->pos          = sc->chunk_offsets[si->chunk];
+
+    first = n - si->chunk_sample;
+    if (sc->stsz_sample_size > 0) {
+        si->pos += si->chunk_sample * (int64_t)sc->stsz_sample_size;
+    } else {
+        for (i = first; i < n; i++)
+            si->pos += (unsigned)sc->sample_sizes[i];
+    }
+
+    si->stts_index  = search_sample_table(si->stts_sample, sc->stts_count, n);
+    si->next_sample = n;
+}
+
+/* Resolve sample n and advance the cursor to the following sample. */
+static void mov_sample_index_get(AVStream *st, unsigned int n, AVIndexEntry *e)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVSampleIndex *si = sc->sample_index;
+    unsigned int size;
+
+    if (n != si->next_sample)
+        mov_sample_index_seek(sc, n);
+
+    size = mov_sample_size(sc, n);
+    e->pos          = si->pos;
+    e->timestamp    = si->stts_dts[si->stts_index] +
+                      (n - si->stts_sample[si->stts_index]) * sc->stts_data[si->stts_index].duration;
+    e->size         = size;
+    e->min_distance = 0;
+    e->flags        = mov_sample_is_keyframe(st, n) ? AVINDEX_KEYFRAME : 0;
+
+    si->next_sample++;
+    si->pos += size;
+    si->chunk_sample++;
+    while (si->chunk_sample >= sc->stsc_data[si->stsc_index].count &&
+           si->chunk + 1 < sc->chunk_count) {
+        si->chunk++;
+        si->chunk_sample = 0;
+        si->pos = sc->chunk_offsets[si->chunk];
+        while (mov_stsc_index_valid(si->stsc_index, sc->stsc_count) &&
+               si->chunk + 1 == sc->stsc_data[si->stsc_index + 1].first)
+            si->stsc_index++;
+    }
+    if (si->stts_index + 1 < sc->stts_count &&
+        si->next_sample == si->stts_sample[si->stts_index + 1])
+        si->stts_index++;
+}
+
+/* Return the entry of sample n; it stays valid until another sample is resolved. */
+static AVIndexEntry *mov_sample_index_entry(AVStream *st, unsigned int n)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVSampleIndex *si = sc->sample_index;
+
+    if (si->entry_index != n) {
+        mov_sample_index_get(st, n, &si->entry);
+        si->entry_index = n;
+    }
+    return &si->entry;
+}
+
+static void mov_free_sample_index(MOVStreamContext *sc)
+{
+    if (!sc->sample_index)
+        return;
+    av_freep(&sc->sample_index->stts_sample);
+    av_freep(&sc->sample_index->stts_dts);
+    av_freep(&sc->sample_index->stsc_sample);
+    av_freep(&sc->sample_index->entry_sample);
+    av_freep(&sc->sample_index);
+}
+
+static unsigned int mov_nb_samples(const AVStream *st)
+{
+    const MOVStreamContext *sc = st->priv_data;
+    return sc->sample_index ? sc->sample_index->nb_samples : st->nb_index_entries;
+}
+
+static int64_t mov_sample_timestamp(const AVStream *st, unsigned int n)
+{
+    const MOVStreamContext *sc = st->priv_data;
+    return sc->sample_index ? mov_sample_index_dts(sc, n) : st->index_entries[n].timestamp;
+}
+
+/**
+ * Check the constant stsz sample size against the stsd sample size and the
+ * room chunk i has before the next one.
+ * @return why the stsz sample size cannot be right, or NULL
+ */
+static const char *mov_check_stsz_sample_size(const MOVStreamContext *sc,
+                                              unsigned int i, unsigned int stsc_index)
+{
+    int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
+
+    if (next_offset > sc->chunk_offsets[i] && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
+        sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - sc->chunk_offsets[i])
+        return "too large";
+    if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size)
+        return "too small";
+    return NULL;
+}
+
+static void mov_reset_stsz_sample_size(MOVContext *mov, MOVStreamContext *sc, const char *reason)
+{
+    av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (%s), ignoring\n",
+           sc->stsz_sample_size, reason);
+    sc->stsz_sample_size = sc->sample_size;
+}
+
+static int mov_sample_index_usable(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    unsigned int i;
+
+    if (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+        st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+        return 0;
+    /* old uncompressed audio chunk demuxing */
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+        sc->stts_count == 1 && sc->stts_data[0].duration == 1)
+        return 0;
+    if (!sc->sample_count || sc->sample_count > INT_MAX || st->nb_index_entries ||
+        !sc->chunk_count || !sc->stts_count || !sc->stsc_count)
+        return 0;
+    /* edits are applied by rewriting the index */
+    if (sc->elst_count && mov->advanced_editlist && !mov->ignore_editlist)
+        return 0;
+    if (sc->rap_group_count && sc->rap_group)
+        return 0;
+    for (i = 0; i < sc->stts_count; i++)
+        if (sc->stts_data[i].duration < 0 ||
+            (!sc->stts_data[i].count && i + 1 < sc->stts_count))
+            return 0;
+    for (i = 0; i < sc->stsc_count; i++)
+        if (!sc->stsc_data[i].count || sc->stsc_data[i].first < 1 ||
+            (i && sc->stsc_data[i].first <= sc->stsc_data[i - 1].first) ||
+            (sc->pseudo_stream_id != -1 && sc->stsc_data[i].id - 1 != sc->pseudo_stream_id))
+            return 0;
+    if (!sc->keyframe_absent)
+        for (i = 1; i < sc->keyframe_count; i++)
+            if ((unsigned)sc->keyframes[i] <= (unsigned)sc->keyframes[i - 1])
+                return 0;
+    for (i = 1; i < sc->stps_count; i++)
+        if (sc->stps_data[i] <= sc->stps_data[i - 1])
+            return 0;
+    return 1;
+}
+
+/**
+ * Set up the compact sample index of a track. Only the seek points (the sync
+ * samples, or one sample per second if every sample is a sync sample) are
+ * added to st->index_entries.
+ *
+ * @return 0 on success, a negative value if the full index has to be built
+ */
+static int mov_build_sample_index(MOVContext *mov, AVStream *st, int64_t start_dts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVSampleIndex *si;
+    uint64_t nb_samples = 0, stream_size = 0;
+    int64_t dts = start_dts;
+    unsigned int i, j, k, max_entries;
+
+    if (!mov_sample_index_usable(mov, st))
+        return AVERROR(ENOSYS);
+
+    if (sc->stsz_sample_size > 0) {
+        unsigned int stsc_index = 0;
+        for (i = 0; i < sc->chunk_count; i++) {
+            const char *reason;
+            while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
+                   i + 1 == sc->stsc_data[stsc_index + 1].first)
+                stsc_index++;
+            if ((reason = mov_check_stsz_sample_size(sc, i, stsc_index))) {
+                /* mov_build_index() keeps the stsz size for the chunks
+                 * before this one, which a single size cannot express */
+                if (i)
+                    return AVERROR(ENOSYS);
+                mov_reset_stsz_sample_size(mov, sc, reason);
+                break;
+            }
+        }
+    }
+
+    si = sc->sample_index = av_mallocz(sizeof(*si));
+    if (!si)
+        return AVERROR(ENOMEM);
+    si->stts_sample = av_malloc_array(sc->stts_count, sizeof(*si->stts_sample));
+    si->stts_dts    = av_malloc_array(sc->stts_count, sizeof(*si->stts_dts));
+    si->stsc_sample = av_malloc_array(sc->stsc_count, sizeof(*si->stsc_sample));
+    if (!si->stts_sample || !si->stts_dts || !si->stsc_sample)
+        goto fail;
+
+    for (i = 0; i < sc->stsc_count; i++) {
+        si->stsc_sample[i] = nb_samples;
+        nb_samples += mov_get_stsc_samples(sc, i);
+    }
+    si->nb_samples = FFMIN(nb_samples, sc->sample_count);
+
+    nb_samples = 0;
+    for (i = 0; i < sc->stts_count; i++) {
+        si->stts_sample[i] = nb_samples;
+        si->stts_dts[i]    = dts;
+        nb_samples += sc->stts_data[i].count;
+        dts        += sc->stts_data[i].count * (int64_t)sc->stts_data[i].duration;
+    }
+
+    if (sc->stsz_sample_size > 0) {
+        if (sc->stsz_sample_size > 0x3FFFFFFF)
+            goto fail;
+        stream_size = si->nb_samples * (uint64_t)sc->stsz_sample_size;
+    } else {
+        for (i = 0; i < si->nb_samples; i++) {
+            if ((unsigned)sc->sample_sizes[i] > 0x3FFFFFFF)
+                goto fail;
+            stream_size += (unsigned)sc->sample_sizes[i];
+        }
+    }
+
+    si->key_off = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+    si->all_keyframes = (!sc->keyframe_absent && !sc->keyframe_count) ||
+                        (sc->keyframe_absent && !sc->stps_count &&
+                         st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO);
+    si->entry_index = -1;
+
+    if (si->all_keyframes) {
+        int64_t duration = mov_sample_index_dts(sc, si->nb_samples - 1) - start_dts;
+        max_entries = FFMIN(duration / sc->time_scale + 2, si->nb_samples);
+    } else {
+        max_entries = FFMIN(1 + (int64_t)(sc->keyframe_absent ? 0 : sc->keyframe_count) + sc->stps_count,
+                            si->nb_samples);
+    }
+    if (av_reallocp_array(&st->index_entries, max_entries, sizeof(*st->index_entries)) < 0 ||
+        !(si->entry_sample = av_malloc_array(max_entries, sizeof(*si->entry_sample))))
+        goto fail;
+    st->index_entries_allocated_size = max_entries * sizeof(*st->index_entries);
+
+#define ADD_SEEK_POINT(n) do {                                                   \
+        if (st->nb_index_entries < max_entries) {                                \
+            si->entry_sample[st->nb_index_entries] = n;                          \
+            mov_sample_index_get(st, n, &st->index_entries[st->nb_index_entries++]); \
+        }                                                                        \
+    } while (0)
+
+    ADD_SEEK_POINT(0);
+    if (si->all_keyframes) {
+        int n = 0;
+        for (;;) {
+            int next = mov_sample_index_search(sc, st->index_entries[st->nb_index_entries - 1].timestamp +
+                                                   sc->time_scale, 0);
+            if (next <= n)
+                break;
+            n = next;
+            ADD_SEEK_POINT(n);
+        }
+    } else {
+        unsigned int nb_keyframes = sc->keyframe_absent ? 0 : sc->keyframe_count;
+        int64_t last = 0;
+        /* merge the sync and partial sync sample tables */
+        for (j = k = 0; j < nb_keyframes || k < sc->stps_count;) {
+            int64_t n;
+            if (k == sc->stps_count ||
+                (j < nb_keyframes && (unsigned)sc->keyframes[j] < sc->stps_data[k]))
+                n = (int64_t)(unsigned)sc->keyframes[j++] - si->key_off;
+            else
+                n = (int64_t)sc->stps_data[k++] - si->key_off;
+            if (n <= last)
+                continue;
+            if (n >= si->nb_samples)
+                break;
+            ADD_SEEK_POINT(n);
+            last = n;
+        }
+    }
+#undef ADD_SEEK_POINT
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        for (i = 0; i < FFMIN(si->nb_samples, 99); i++)
+            ff_rfps_add_frame(mov->fc, st, mov_sample_index_dts(sc, i));
+
+    if (st->duration > 0)
+        st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
+
+    return 0;
+fail:
+    mov_free_sample_index(sc);
+    av_freep(&st->index_entries);
+    st->index_entries_allocated_size = 0;
+    st->nb_index_entries = 0;
+    return AVERROR(ENOMEM);
+}
+
+/**
+ * Replace the compact index by a full index, e.g. before fragments add
+ * samples to the track.
+ */
+static int mov_expand_sample_index(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVSampleIndex *si = sc->sample_index;
+    AVIndexEntry *entries;
+    MOVStts *ctts_data = NULL;
+    unsigned int i, j, ctts_count = 0, ctts_allocated_size = 0, distance = 0;
+
+    entries = av_malloc_array(si->nb_samples, sizeof(*entries));
+    if (!entries)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < si->nb_samples; i++) {
+        mov_sample_index_get(st, i, &entries[i]);
+        if (entries[i].flags & AVINDEX_KEYFRAME)
+            distance = 0;
+        entries[i].min_distance = distance++;
+    }
+
+    if (sc->ctts_data) {
+        // Expand ctts entries such that we have a 1-1 mapping with samples
+        ctts_data = av_fast_realloc(NULL, &ctts_allocated_size,
+                                    si->nb_samples * sizeof(*ctts_data));
+        if (!ctts_data) {
+            av_free(entries);
+            return AVERROR(ENOMEM);
+        }
+        for (i = 0; i < sc->ctts_count && ctts_count < si->nb_samples; i++)
+            for (j = 0; j < sc->ctts_data[i].count && ctts_count < si->nb_samples; j++)
+                add_ctts_entry(&ctts_data, &ctts_count, &ctts_allocated_size, 1,
+                               sc->ctts_data[i].duration);
+        av_free(sc->ctts_data);
+        sc->ctts_data           = ctts_data;
+        sc->ctts_count          = ctts_count;
+        sc->ctts_allocated_size = ctts_allocated_size;
+        sc->ctts_index          = sc->current_sample;
+        sc->ctts_sample         = 0;
+    }
+
+    av_free(st->index_entries);
+    st->index_entries                = entries;
+    st->nb_index_entries             = si->nb_samples;
+    st->index_entries_allocated_size = si->nb_samples * sizeof(*entries);
+
+    mov_free_sample_index(sc);
+    av_freep(&sc->chunk_offsets);
+    av_freep(&sc->sample_sizes);
+    av_freep(&sc->keyframes);
+    av_freep(&sc->stts_data);
+    av_freep(&sc->stps_data);
+    return 0;
+}
+
 #define MAX_REORDER_DELAY 16
 static void mov_estimate_video_delay(MOVContext *c, AVStream* st) {
     MOVStreamContext *msc = st->priv_data;
@@ -3378,14 +3822,14 @@ static void mov_estimate_video_delay(MOVContext *c, AVStream* st) {
     if (st->codecpar->video_delay <= 0 && msc->ctts_data &&
         st->codecpar->codec_id == AV_CODEC_ID_H264) {
         st->codecpar->video_delay = 0;
-        for(ind = 0; ind < st->nb_index_entries && ctts_ind < msc->ctts_count; ++ind) {
+        for(ind = 0; ind < mov_nb_samples(st) && ctts_ind < msc->ctts_count; ++ind) {
             // Point j to the last elem of the buffer and insert the current pts there.
             j = buf_start;
             buf_start = (buf_start + 1);
             if (buf_start == MAX_REORDER_DELAY + 1)
                 buf_start = 0;
 
-            pts_buf[j] = st->index_entries[ind].timestamp + msc->ctts_data[ctts_ind].duration;
+            pts_buf[j] = mov_sample_timestamp(st, ind) + msc->ctts_data[ctts_ind].duration;
 
             // The timestamps that are already in the sorted buffer, and are greater than the
             // current pts, are exactly the timestamps that need to be buffered to output PTS
@@ -3827,9 +4271,13 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             sc->start_pad = start_time;
     }
 
-    /* only use old uncompressed audio chunk demuxing when stts specifies it */
-    if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
-          sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
+    /* with lazy_index only the seek points are indexed up front; otherwise
+     * only use old uncompressed audio chunk demuxing when stts specifies it */
+    if (mov->lazy_index && !mov_build_sample_index(mov, st, current_dts - sc->dts_shift)) {
+        av_log(mov->fc, AV_LOG_DEBUG, "stream %d: compact index of %u samples, %d seek points\n",
+               st->index, sc->sample_index->nb_samples, st->nb_index_entries);
+    } else if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+                 sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
         unsigned int current_sample = 0;
         unsigned int stts_sample = 0;
         unsigned int sample_size;
@@ -3882,21 +4330,14 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         }
 
         for (i = 0; i < sc->chunk_count; i++) {
-            int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
+            const char *reason;
             current_offset = sc->chunk_offsets[i];
             while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
                 i + 1 == sc->stsc_data[stsc_index + 1].first)
                 stsc_index++;
 
-            if (next_offset > current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
-                sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - current_offset) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
-            if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
+            if ((reason = mov_check_stsz_sample_size(sc, i, stsc_index)))
+                mov_reset_stsz_sample_size(mov, sc, reason);
 
             for (j = 0; j < sc->stsc_data[stsc_index].count; j++) {
                 int keyframe = 0;
@@ -4330,12 +4771,14 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
+    /* Do not need those anymore, unless samples are resolved from them. */
+    if (!sc->sample_index) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
+    }
     av_freep(&sc->elst_data);
     av_freep(&sc->rap_group);
 
@@ -4785,6 +5228,12 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
 
+    if (sc->sample_index) {
+        int ret = mov_expand_sample_index(c, st);
+        if (ret < 0)
+            return ret;
+    }
+
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
     //
@@ -7373,6 +7822,7 @@ static int mov_read_close(AVFormatContext *s)
         av_freep(&sc->rap_group);
         av_freep(&sc->display_matrix);
         av_freep(&sc->index_ranges);
+        mov_free_sample_index(sc);
 
         if (sc->extradata)
             for (j = 0; j < sc->stsd_count; j++)
@@ -7772,8 +8222,10 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
+        if (msc->pb && msc->current_sample < mov_nb_samples(avst)) {
+            AVIndexEntry *current_sample = msc->sample_index ?
+                mov_sample_index_entry(avst, msc->current_sample) :
+                &avst->index_entries[msc->current_sample];
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) && current_sample->pos < sample->pos) ||
@@ -7952,8 +8404,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_dts = (sc->current_sample < mov_nb_samples(st)) ?
+            mov_sample_timestamp(st, sc->current_sample) : st->duration;
 
         if (next_dts >= pkt->dts)
             pkt->duration = next_dts - pkt->dts;
@@ -8032,7 +8484,17 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    if (sc->sample_index) {
+        if (sc->sample_index->all_keyframes || flags & AVSEEK_FLAG_ANY) {
+            sample = mov_sample_index_search(sc, timestamp, flags & AVSEEK_FLAG_BACKWARD);
+        } else {
+            sample = av_index_search_timestamp(st, timestamp, flags);
+            if (sample >= 0)
+                sample = sc->sample_index->entry_sample[sample];
+        }
+    } else {
+        sample = av_index_search_timestamp(st, timestamp, flags);
+    }
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
     if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
         sample = 0;
@@ -8089,7 +8551,7 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = st->index_entries[sample].timestamp;
+        int64_t seek_timestamp = mov_sample_timestamp(st, sample);
 
         for (i = 0; i < s->nb_streams; i++) {
             int64_t timestamp;
@@ -8167,6 +8629,8 @@ static const AVOption mov_options[] = {
     { "decryption_key", "The media decryption key (hex)", OFFSET(decryption_key), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "enable_drefs", "Enable external track support.", OFFSET(enable_drefs), AV_OPT_TYPE_BOOL,
         {.i64 = 0}, 0, 1, FLAGS },
+    { "lazy_index", "Only index seek points and resolve samples from the sample tables on demand",
+        OFFSET(lazy_index), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
 
     { NULL },
 };
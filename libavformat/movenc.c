@@ -107,6 +107,7 @@ static const AVOption options[] = {
     { "wallclock", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = MOV_PRFT_SRC_WALLCLOCK}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM, "prft"},
     { "pts", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = MOV_PRFT_SRC_PTS}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM, "prft"},
     { "empty_hdlr_name", "write zero-length name string in hdlr atoms within mdia and minf atoms", offsetof(MOVMuxContext, empty_hdlr_name), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+    { "faststart_reserve", "With faststart, reserve space for the moov atom and only move the data if it does not fit", offsetof(MOVMuxContext, faststart_reserve), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { NULL },
 };
 
@@ -6300,7 +6301,10 @@ static int mov_init(AVFormatContext *s)
     }
 
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
-        mov->reserved_moov_size = -1;
+        /* with faststart_reserve, moov_size overrides the estimate */
+        if (!mov->faststart_reserve || mov->flags & FF_MOV_FLAG_FRAGMENT ||
+            !mov->reserved_moov_size)
+            mov->reserved_moov_size = -1;
     }
 
     if (mov->use_editlist < 0) {
@@ -6582,6 +6586,59 @@ static int mov_init(AVFormatContext *s)
     return 0;
 }
 
+/*
+ * Estimate the moov size from the number of samples expected from the
+ * stream durations, for writing it in front of the data in a single pass.
+ * Returns 0 if the duration of a stream is not known.
+ */
+static int64_t estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    AVDictionaryEntry *t = NULL;
+    int64_t size = 1024, data_size = 0;
+    int i;
+
+    while ((t = av_dict_get(s->metadata, "", t, AV_DICT_IGNORE_SUFFIX)))
+        size += strlen(t->key) + strlen(t->value) + 32;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        AVCodecParameters *par = st->codecpar;
+        int64_t nb_samples = st->nb_frames;
+        AVRational rate = { 1, 1 };
+        int sample_size;
+
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+            rate = st->avg_frame_rate.num ? st->avg_frame_rate : st->r_frame_rate;
+            /* stsz and stco, and ctts for streams with reordering */
+            sample_size = 9 + (par->video_delay ? 8 : 0);
+        } else if (par->codec_type == AVMEDIA_TYPE_AUDIO) {
+            rate = (AVRational){ par->sample_rate, par->frame_size ? par->frame_size : 1024 };
+            sample_size = 8;
+        } else {
+            sample_size = 16;
+        }
+        if (nb_samples <= 0) {
+            if (st->duration <= 0 || rate.num <= 0 || rate.den <= 0)
+                return 0;
+            nb_samples = av_rescale_q_rnd(st->duration, st->time_base,
+                                          av_inv_q(rate), AV_ROUND_UP);
+        }
+        if (st->duration > 0 && par->bit_rate > 0)
+            data_size += av_rescale_q(st->duration, st->time_base,
+                                      (AVRational){ 8, par->bit_rate });
+
+        size += 1024 + par->extradata_size + nb_samples * sample_size;
+    }
+    /* chunk offsets need 64 bit entries in large files */
+    if (data_size > UINT32_MAX)
+        size += size / 2;
+    /* chapter, timecode and hint tracks */
+    size += (mov->nb_streams - s->nb_streams) * 1024;
+
+    return size + size / 8;
+}
+
 static int mov_write_header(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
@@ -6647,6 +6704,17 @@ static int mov_write_header(AVFormatContext *s)
             return ret;
     }
 
+    if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->faststart_reserve &&
+        !(mov->flags & FF_MOV_FLAG_FRAGMENT) && mov->reserved_moov_size < 0) {
+        int64_t size = estimate_moov_size(s);
+        if (size > 0 && size <= INT_MAX) {
+            av_log(s, AV_LOG_VERBOSE, "Reserving %"PRId64" bytes for the moov atom\n", size);
+            mov->reserved_moov_size = size;
+        } else
+            av_log(s, AV_LOG_WARNING, "Unknown stream durations, cannot "
+                   "reserve space for the moov atom\n");
+    }
+
     if (mov->reserved_moov_size){
         mov->reserved_header_pos = avio_tell(pb);
         if (mov->reserved_moov_size > 0)
@@ -6661,7 +6729,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -6793,28 +6861,21 @@ static int compute_sidx_size(AVFormatContext *s)
     return sidx_size;
 }
 
-static int shift_data(AVFormatContext *s)
+/* Move the data in [pos, pos_end) forward by shift bytes. */
+static int move_data(AVFormatContext *s, int64_t pos, int64_t pos_end, int shift)
 {
-    int ret = 0, moov_size;
-    MOVMuxContext *mov = s->priv_data;
-    int64_t pos, pos_end;
+    int ret = 0;
     uint8_t *buf, *read_buf[2];
     int read_buf_id = 0;
     int read_size[2];
+    int block_size = FFMAX(shift, 1 << 20);
     AVIOContext *read_pb;
 
-    if (mov->flags & FF_MOV_FLAG_FRAGMENT)
-        moov_size = compute_sidx_size(s);
-    else
-        moov_size = compute_moov_size(s);
-    if (moov_size < 0)
-        return moov_size;
-
-    buf = av_malloc(moov_size * 2);
+    buf = av_malloc(block_size * 2);
     if (!buf)
         return AVERROR(ENOMEM);
     read_buf[0] = buf;
-    read_buf[1] = buf + moov_size;
+    read_buf[1] = buf + block_size;
 
     /* Shift the data: the AVIO context of the output can only be used for
      * writing, so we re-open the same output, but for reading. It also avoids
@@ -6827,21 +6888,19 @@ static int shift_data(AVFormatContext *s)
         goto end;
     }
 
-    /* mark the end of the shift to up to the last data we wrote, and get ready
-     * for writing */
-    pos_end = avio_tell(s->pb);
-    avio_seek(s->pb, mov->reserved_header_pos + moov_size, SEEK_SET);
+    /* get ready for writing after the gap */
+    avio_seek(s->pb, pos + shift, SEEK_SET);
 
-    /* start reading at where the new moov will be placed */
-    avio_seek(read_pb, mov->reserved_header_pos, SEEK_SET);
-    pos = avio_tell(read_pb);
+    /* start reading at where the gap will be placed */
+    avio_seek(read_pb, pos, SEEK_SET);
 
-#define READ_BLOCK do {                                                             \
-    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], moov_size);  \
-    read_buf_id ^= 1;                                                               \
+#define READ_BLOCK do {                                                              \
+    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], block_size);  \
+    read_buf_id ^= 1;                                                                \
 } while (0)
 
-    /* shift data by chunk of at most moov_size */
+    /* shift data by chunk of at most block_size, reading one chunk ahead so
+     * that nothing is overwritten before it has been read */
     READ_BLOCK;
     do {
         int n;
@@ -6859,6 +6918,83 @@ end:
     return ret;
 }
 
+static int shift_data(AVFormatContext *s)
+{
+    int moov_size;
+    MOVMuxContext *mov = s->priv_data;
+
+    if (mov->flags & FF_MOV_FLAG_FRAGMENT)
+        moov_size = compute_sidx_size(s);
+    else
+        moov_size = compute_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+
+    /* move everything up to the last data we wrote */
+    return move_data(s, mov->reserved_header_pos, avio_tell(s->pb), moov_size);
+}
+
+/*
+ * Write the moov atom into the space reserved in front of the data,
+ * padded with a free atom. If it does not fit, only the data is moved by
+ * the missing number of bytes.
+ */
+static int write_reserved_moov(AVFormatContext *s, int64_t moov_pos)
+{
+    MOVMuxContext *mov = s->priv_data;
+    AVIOContext *pb = s->pb;
+    int64_t data_pos = mov->reserved_header_pos + mov->reserved_moov_size;
+    int64_t moved = 0;
+    int i, ret, moov_size, free_size;
+
+    moov_size = get_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+    free_size = mov->reserved_moov_size - moov_size;
+
+    if (free_size < 0 || (free_size > 0 && free_size < 8)) {
+        int shift = moov_size - mov->reserved_moov_size + (free_size > 0 ? 8 : 0);
+
+        av_log(s, AV_LOG_WARNING, "The moov atom of %d bytes does not fit "
+               "into the %d reserved bytes, moving the data\n",
+               moov_size, mov->reserved_moov_size);
+        for (i = 0; i < mov->nb_streams; i++)
+            mov->tracks[i].data_offset += shift;
+        /* the chunk offsets may have switched to 64 bits */
+        ret = get_moov_size(s);
+        if (ret < 0)
+            return ret;
+        if (ret > moov_size) {
+            for (i = 0; i < mov->nb_streams; i++)
+                mov->tracks[i].data_offset += ret - moov_size;
+            shift += ret - moov_size;
+            moov_size = ret;
+        }
+
+        ret = move_data(s, data_pos, moov_pos, shift);
+        if (ret < 0)
+            return ret;
+        moved     = moov_pos - data_pos;
+        moov_pos += shift;
+        free_size = mov->reserved_moov_size + shift - moov_size;
+    }
+
+    avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+    if ((ret = mov_write_moov_tag(pb, mov, s)) < 0)
+        return ret;
+    if (free_size) {
+        avio_wb32(pb, free_size);
+        ffio_wfourcc(pb, "free");
+        ffio_fill(pb, 0, free_size - 8);
+    }
+    avio_seek(pb, moov_pos, SEEK_SET);
+
+    av_log(s, AV_LOG_INFO, "faststart: wrote the moov atom of %d bytes in front of the data, "
+           "%"PRId64" bytes read and %"PRId64" bytes written again\n",
+           moov_size, moved, moved + moov_size + free_size);
+    return 0;
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -6924,7 +7060,11 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size > 0) {
+            if ((res = write_reserved_moov(s, moov_pos)) < 0)
+                return res;
+        } else if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+            int64_t data_size = moov_pos - mov->reserved_header_pos;
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res < 0)
@@ -6932,6 +7072,8 @@ static int mov_write_trailer(AVFormatContext *s)
             avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
+            av_log(s, AV_LOG_INFO, "faststart: %"PRId64" bytes read and %"PRId64" bytes written again\n",
+                   data_size, data_size + avio_tell(pb) - mov->reserved_header_pos);
         } else if (mov->reserved_moov_size > 0) {
             int64_t size;
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
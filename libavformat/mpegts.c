@@ -154,6 +154,11 @@ struct MpegTSContext {
     int resync_size;
     int merge_pmt_versions;
 
+    /** comma separated list of elementary stream PIDs to demux */
+    char *pids_str;
+    /** bitmap of allowed PIDs, NULL if all PIDs are allowed */
+    uint8_t *allowed_pids;
+
     /******************************************/
     /* private mpegts data */
     /* scan context */
@@ -185,6 +190,8 @@ static const AVOption options[] = {
      {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     {"merge_pmt_versions", "re-use streams when PMT's version/pids change", offsetof(MpegTSContext, merge_pmt_versions), AV_OPT_TYPE_BOOL,
      {.i64 = 0}, 0, 1,  AV_OPT_FLAG_DECODING_PARAM },
+    {"pids", "comma separated list of elementary stream PIDs to demux", offsetof(MpegTSContext, pids_str), AV_OPT_TYPE_STRING,
+     {.str = NULL}, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
     {"skip_changes", "skip changing / adding streams / programs", offsetof(MpegTSContext, skip_changes), AV_OPT_TYPE_BOOL,
      {.i64 = 0}, 0, 1, 0 },
     {"skip_clear", "skip clearing programs", offsetof(MpegTSContext, skip_clear), AV_OPT_TYPE_BOOL,
@@ -366,6 +373,37 @@ static void update_av_program_info(AVFormatContext *s, unsigned int programid,
     }
 }
 
+/**
+ * Check whether the elementary stream carried in pid was selected by the
+ * pids option. PSI PIDs are handled by section filters and always pass.
+ */
+static int pid_allowed(const MpegTSContext *ts, unsigned int pid)
+{
+    return !ts->allowed_pids || ts->allowed_pids[pid >> 3] & (1 << (pid & 7));
+}
+
+static int parse_allowed_pids(MpegTSContext *ts)
+{
+    const char *p = ts->pids_str;
+    char *end;
+
+    ts->allowed_pids = av_mallocz(NB_PID_MAX / 8);
+    if (!ts->allowed_pids)
+        return AVERROR(ENOMEM);
+
+    while (*p) {
+        long pid = strtol(p, &end, 0);
+        if (end == p || pid < 0 || pid >= NB_PID_MAX || (*end && *end != ',')) {
+            av_log(ts->stream, AV_LOG_ERROR, "Invalid PID list '%s'\n", ts->pids_str);
+            av_freep(&ts->allowed_pids);
+            return AVERROR(EINVAL);
+        }
+        ts->allowed_pids[pid >> 3] |= 1 << (pid & 7);
+        p = *end ? end + 1 : end;
+    }
+    return 0;
+}
+
 /**
  * @brief discard_pid() decides if the pid is to be discarded according
  *                      to caller's programs selection
@@ -2371,6 +2409,17 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
         if (pid == ts->current_pid)
             goto out;
 
+        if (!pid_allowed(ts, pid)) {
+            desc_list_len = get16(&p, p_end);
+            if (desc_list_len < 0)
+                goto out;
+            desc_list_len &= 0xfff;
+            if (desc_list_len > p_end - p)
+                goto out;
+            p += desc_list_len;
+            continue;
+        }
+
         if (ts->merge_pmt_versions)
             stream_identifier = parse_stream_identifier_desc(p, p_end);
 
@@ -2708,7 +2757,7 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
     pid = AV_RB16(packet + 1) & 0x1fff;
     is_start = packet[1] & 0x40;
     tss = ts->pids[pid];
-    if (ts->auto_guess && !tss && is_start) {
+    if (ts->auto_guess && !tss && is_start && pid_allowed(ts, pid)) {
         add_pes_stream(ts, pid, -1);
         tss = ts->pids[pid];
     }
@@ -2912,6 +2961,70 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+#define SCAN_BATCH 64
+
+/* Gather PID and payload_unit_start_indicator of up to nb packets,
+ * stopping at the first one without sync byte. */
+static int scan_packets(const uint8_t *buf, int nb, uint16_t *pids)
+{
+    int i;
+
+    for (i = 0; i < nb; i++) {
+        const uint8_t *p = buf + i * TS_PACKET_SIZE;
+        if (p[0] != 0x47)
+            break;
+        pids[i] = AV_RB16(p + 1) & 0x5fff;
+    }
+    return i;
+}
+
+/**
+ * Handle the packets already present in the I/O buffer in place. Packets of
+ * PIDs without filter, or of discarded PIDs, are dropped in bulk before any
+ * per-packet processing; behaviour is otherwise identical to feeding each
+ * packet to handle_packet().
+ *
+ * @return number of packets consumed (0 if resync or more data is needed),
+ *         or a negative error code
+ */
+static int handle_packets_buffered(MpegTSContext *ts, int max_packets)
+{
+    AVIOContext *pb    = ts->stream->pb;
+    const uint8_t *buf = pb->buf_ptr;
+    int64_t pos        = avio_tell(pb);
+    int avail = FFMIN((pb->buf_end - pb->buf_ptr) / TS_PACKET_SIZE, max_packets);
+    uint16_t pids[SCAN_BATCH];
+    int done = 0, ret = 0;
+
+    while (done < avail) {
+        int i, nb = FFMIN(avail - done, SCAN_BATCH);
+        int n = scan_packets(buf + done * TS_PACKET_SIZE, nb, pids);
+
+        for (i = 0; i < n; i++) {
+            int pid          = pids[i] & 0x1fff;
+            int is_start     = pids[i] & 0x4000;
+            MpegTSFilter *tss = ts->pids[pid];
+
+            if (tss ? !is_start && tss->discard
+                    : !(is_start && ts->auto_guess && pid_allowed(ts, pid)))
+                continue;
+
+            ret = handle_packet(ts, buf + (done + i) * TS_PACKET_SIZE,
+                                pos + (done + i + 1) * TS_PACKET_SIZE);
+            if (ret < 0 || ts->stop_parse) {
+                i++;
+                break;
+            }
+        }
+        done += i;
+        if (i < nb)
+            break;
+    }
+
+    avio_skip(pb, done * TS_PACKET_SIZE);
+    return ret < 0 ? ret : done;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
@@ -2953,6 +3066,18 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        if (ts->raw_packet_size == TS_PACKET_SIZE) {
+            int64_t max_packets = nb_packets ? nb_packets - packet_num : INT_MAX;
+            ret = handle_packets_buffered(ts, FFMIN(max_packets, INT_MAX));
+            if (ret < 0)
+                break;
+            if (ret > 0) {
+                packet_num += ret - 1;
+                ret = 0;
+                continue;
+            }
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -3066,6 +3191,12 @@ static int mpegts_read_header(AVFormatContext *s)
     if (s->iformat == &ff_mpegts_demuxer) {
         /* normal demux */
 
+        if (ts->pids_str) {
+            int ret = parse_allowed_pids(ts);
+            if (ret < 0)
+                return ret;
+        }
+
         /* first do a scan to get all the services */
         seek_back(s, pb, pos);
 
@@ -3237,6 +3368,8 @@ static void mpegts_free(MpegTSContext *ts)
     for (i = 0; i < NB_PID_MAX; i++)
         if (ts->pids[i])
             mpegts_close_filter(ts, ts->pids[i]);
+
+    av_freep(&ts->allowed_pids);
 }
 
 static int mpegts_read_close(AVFormatContext *s)
@@ -3280,10 +3413,57 @@ static av_unused int64_t mpegts_get_pcr(AVFormatContext *s, int stream_index,
     return AV_NOPTS_VALUE;
 }
 
+/* index entries collected by one mpegts_get_dts() call */
+#define INDEX_BATCH_SIZE 64
+
+typedef struct IndexBatch {
+    int nb_entries;
+    int stream_index[INDEX_BATCH_SIZE];
+    AVIndexEntry entries[INDEX_BATCH_SIZE];
+} IndexBatch;
+
+static void flush_index_batch(AVFormatContext *s, IndexBatch *batch)
+{
+    AVIndexEntry entries[INDEX_BATCH_SIZE];
+    int i, j, n;
+
+    for (i = 0; i < batch->nb_entries; i++) {
+        int stream_index = batch->stream_index[i];
+        if (stream_index < 0)
+            continue;
+        for (j = i, n = 0; j < batch->nb_entries; j++) {
+            if (batch->stream_index[j] == stream_index) {
+                entries[n++] = batch->entries[j];
+                batch->stream_index[j] = -1;
+            }
+        }
+        ff_reduce_index(s, stream_index);
+        av_add_index_entries(s->streams[stream_index], entries, n);
+    }
+    batch->nb_entries = 0;
+}
+
+static void add_index_entry(AVFormatContext *s, IndexBatch *batch,
+                            const AVPacket *pkt)
+{
+    AVIndexEntry *ie;
+
+    if (batch->nb_entries == INDEX_BATCH_SIZE)
+        flush_index_batch(s, batch);
+    ie = &batch->entries[batch->nb_entries];
+    batch->stream_index[batch->nb_entries++] = pkt->stream_index;
+    ie->pos          = pkt->pos;
+    ie->timestamp    = pkt->dts;
+    ie->flags        = AVINDEX_KEYFRAME; /* FIXME keyframe? */
+    ie->size         = 0;
+    ie->min_distance = 0;
+}
+
 static int64_t mpegts_get_dts(AVFormatContext *s, int stream_index,
                               int64_t *ppos, int64_t pos_limit)
 {
     MpegTSContext *ts = s->priv_data;
+    IndexBatch batch = { 0 };
     int64_t pos;
     int pos47 = ts->pos47_full % ts->raw_packet_size;
     pos = ((*ppos  + ts->raw_packet_size - 1 - pos47) / ts->raw_packet_size) * ts->raw_packet_size + pos47;
@@ -3296,14 +3476,14 @@ static int64_t mpegts_get_dts(AVFormatContext *s, int stream_index,
         av_init_packet(&pkt);
         ret = av_read_frame(s, &pkt);
         if (ret < 0)
-            return AV_NOPTS_VALUE;
+            break;
         if (pkt.dts != AV_NOPTS_VALUE && pkt.pos >= 0) {
-            ff_reduce_index(s, pkt.stream_index);
-            av_add_index_entry(s->streams[pkt.stream_index], pkt.pos, pkt.dts, 0, 0, AVINDEX_KEYFRAME /* FIXME keyframe? */);
+            add_index_entry(s, &batch, &pkt);
             if (pkt.stream_index == stream_index && pkt.pos >= *ppos) {
                 int64_t dts = pkt.dts;
                 *ppos = pkt.pos;
                 av_packet_unref(&pkt);
+                flush_index_batch(s, &batch);
                 return dts;
             }
         }
@@ -3311,6 +3491,7 @@ static int64_t mpegts_get_dts(AVFormatContext *s, int stream_index,
         av_packet_unref(&pkt);
     }
 
+    flush_index_batch(s, &batch);
     return AV_NOPTS_VALUE;
 }
 
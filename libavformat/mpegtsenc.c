@@ -112,8 +112,17 @@ typedef struct MpegTSWrite {
     int64_t last_sdt_ts;
 
     int omit_video_pes_length;
+
+    /* TS packets are assembled here and handed to the AVIOContext in runs */
+    uint8_t *write_buf;
+    int write_buf_len;
+    int write_buf_size;
 } MpegTSWrite;
 
+/* number of TS packets buffered before they are written out, a multiple
+ * of the 7 packets usually carried in one UDP datagram */
+#define WRITE_BUF_PACKETS (7 * 8)
+
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
 #define DEFAULT_PES_HEADER_FREQ  16
 #define DEFAULT_PES_PAYLOAD_SIZE ((DEFAULT_PES_HEADER_FREQ - 1) * 184 + 170)
@@ -241,6 +250,8 @@ typedef struct MpegTSWriteStream {
     int64_t pcr_period; /* PCR period in PCR time base */
     int64_t last_pcr;
 
+    uint32_t ts_header; /* sync byte, transport priority and PID of the TS header */
+
     /* For Opus */
     int opus_queued_samples;
     int opus_pending_trim_start;
@@ -804,21 +815,61 @@ invalid:
 
 static int64_t get_pcr(const MpegTSWrite *ts, AVIOContext *pb)
 {
-    return av_rescale(avio_tell(pb) + 11, 8 * PCR_TIME_BASE, ts->mux_rate) +
+    return av_rescale(avio_tell(pb) + ts->write_buf_len + 11, 8 * PCR_TIME_BASE, ts->mux_rate) +
            ts->first_pcr;
 }
 
-static void write_packet(AVFormatContext *s, const uint8_t *packet)
+static void flush_write_buf(AVFormatContext *s)
 {
     MpegTSWrite *ts = s->priv_data;
+    AVIOContext *pb = s->pb;
+    /* Packet based outputs like UDP or SRT send one datagram per buffer
+     * flush, make each one carry a whole number of TS packets. */
+    int raw_packet_size = TS_PACKET_SIZE + (ts->m2ts_mode ? 4 : 0);
+    int chunk = FFMIN(pb->max_packet_size, pb->buffer_size) / raw_packet_size * raw_packet_size;
+    int pos = 0;
+
+    if (!chunk) {
+        avio_write(pb, ts->write_buf, ts->write_buf_len);
+        ts->write_buf_len = 0;
+        return;
+    }
+    while (pos < ts->write_buf_len) {
+        int len;
+        if (pb->buf_ptr - pb->buffer >= chunk)
+            avio_flush(pb);
+        len = FFMIN(chunk - (pb->buf_ptr - pb->buffer), ts->write_buf_len - pos);
+        avio_write(pb, ts->write_buf + pos, len);
+        pos += len;
+    }
+    if (pb->buf_ptr - pb->buffer >= chunk)
+        avio_flush(pb);
+    ts->write_buf_len = 0;
+}
+
+/* Reserve the next TS packet in the write buffer and return a pointer to it */
+static uint8_t *get_packet_buf(AVFormatContext *s)
+{
+    MpegTSWrite *ts = s->priv_data;
+    uint8_t *q;
+
+    if (ts->write_buf_len + TS_PACKET_SIZE + (ts->m2ts_mode ? 4 : 0) > ts->write_buf_size)
+        flush_write_buf(s);
+
+    q = ts->write_buf + ts->write_buf_len;
     if (ts->m2ts_mode) {
-        int64_t pcr = get_pcr(s->priv_data, s->pb);
-        uint32_t tp_extra_header = pcr % 0x3fffffff;
-        tp_extra_header = AV_RB32(&tp_extra_header);
-        avio_write(s->pb, (unsigned char *) &tp_extra_header,
-                   sizeof(tp_extra_header));
+        int64_t pcr = get_pcr(ts, s->pb);
+        AV_WB32(q, pcr % 0x3fffffff);
+        q += 4;
+        ts->write_buf_len += 4;
     }
-    avio_write(s->pb, packet, TS_PACKET_SIZE);
+    ts->write_buf_len += TS_PACKET_SIZE;
+    return q;
+}
+
+static void write_packet(AVFormatContext *s, const uint8_t *packet)
+{
+    memcpy(get_packet_buf(s), packet, TS_PACKET_SIZE);
 }
 
 static void section_write_packet(MpegTSSection *s, const uint8_t *packet)
@@ -965,6 +1016,11 @@ static int mpegts_init(AVFormatContext *s)
     // round up to a whole number of TS packets
     ts->pes_payload_size = (ts->pes_payload_size + 14 + 183) / 184 * 184 - 14;
 
+    ts->write_buf_size = WRITE_BUF_PACKETS * (TS_PACKET_SIZE + (ts->m2ts_mode ? 4 : 0));
+    ts->write_buf      = av_malloc(ts->write_buf_size);
+    if (!ts->write_buf)
+        return AVERROR(ENOMEM);
+
     if (!s->nb_programs) {
         /* allocate a single DVB service */
         if (!mpegts_add_service(s, ts->service_id, s->metadata, NULL))
@@ -1068,6 +1124,9 @@ static int mpegts_init(AVFormatContext *s)
                 return AVERROR(EINVAL);
             }
         }
+        ts_st->ts_header = 0x47 << 24 | ts_st->pid << 8;
+        if (ts->m2ts_mode && st->codecpar->codec_id == AV_CODEC_ID_AC3)
+            ts_st->ts_header |= 0x20 << 16; /* transport priority */
         ts_st->payload_pts     = AV_NOPTS_VALUE;
         ts_st->payload_dts     = AV_NOPTS_VALUE;
         ts_st->first_pts_check = 1;
@@ -1264,7 +1323,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
 {
     MpegTSWriteStream *ts_st = st->priv_data;
     MpegTSWrite *ts = s->priv_data;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t *buf;
     uint8_t *q;
     int val, is_start, len, header_len, write_pcr, is_dvb_subtitle, is_dvb_teletext, flags;
     int afc_len, stuffing_len;
@@ -1272,7 +1331,6 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     int force_pat = st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && key && !ts_st->prev_payload_key;
     int force_sdt = 0;
 
-    av_assert0(ts_st->payload != buf || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO);
     if (ts->flags & MPEGTS_FLAG_PAT_PMT_AT_FRAMES && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
         force_pat = 1;
     }
@@ -1286,6 +1344,23 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     is_start = 1;
     while (payload_size > 0) {
         int64_t pcr = AV_NOPTS_VALUE;
+
+        /* In VBR mode the PCR is constant within a PES packet, so neither
+         * PSI nor PCR can become due after its first TS packet: emit the run
+         * of full payload-only packets straight from the header template.
+         * The last packet may need stuffing and takes the generic path. */
+        if (!is_start && ts->mux_rate <= 1 &&
+            ts->sdt_period > 0 && ts->pat_period > 0) {
+            while (payload_size > TS_PACKET_SIZE - 4) {
+                buf       = get_packet_buf(s);
+                ts_st->cc = ts_st->cc + 1 & 0xf;
+                AV_WB32(buf, ts_st->ts_header | 0x10 | ts_st->cc);
+                memcpy(buf + 4, payload, TS_PACKET_SIZE - 4);
+                payload      += TS_PACKET_SIZE - 4;
+                payload_size -= TS_PACKET_SIZE - 4;
+            }
+        }
+
         if (ts->mux_rate > 1)
             pcr = get_pcr(ts, s->pb);
         else if (dts != AV_NOPTS_VALUE)
@@ -1339,17 +1414,11 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         }
 
         /* prepare packet header */
-        q    = buf;
-        *q++ = 0x47;
-        val  = ts_st->pid >> 8;
-        if (ts->m2ts_mode && st->codecpar->codec_id == AV_CODEC_ID_AC3)
-            val |= 0x20;
-        if (is_start)
-            val |= 0x40;
-        *q++      = val;
-        *q++      = ts_st->pid;
+        buf       = get_packet_buf(s);
         ts_st->cc = ts_st->cc + 1 & 0xf;
-        *q++      = 0x10 | ts_st->cc; // payload indicator + CC
+        // payload unit start + payload indicator + CC
+        AV_WB32(buf, ts_st->ts_header | (is_start ? 0x400000 : 0) | 0x10 | ts_st->cc);
+        q = buf + 4;
         if (ts_st->discontinuity) {
             set_af_flag(buf, 0x80);
             q = get_ts_payload_start(buf);
@@ -1546,9 +1615,9 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
 
         payload      += len;
         payload_size -= len;
-        write_packet(s, buf);
     }
     ts_st->prev_payload_key = key;
+    flush_write_buf(s);
 }
 
 int ff_check_h264_startcode(AVFormatContext *s, const AVStream *st, const AVPacket *pkt)
@@ -1901,6 +1970,7 @@ static void mpegts_write_flush(AVFormatContext *s)
         int packets = (avio_tell(s->pb) / (TS_PACKET_SIZE + 4)) % 32;
         while (packets++ < 32)
             mpegts_insert_null_packet(s);
+        flush_write_buf(s);
     }
 }
 
@@ -1945,6 +2015,7 @@ static void mpegts_deinit(AVFormatContext *s)
         av_freep(&service);
     }
     av_freep(&ts->services);
+    av_freep(&ts->write_buf);
 }
 
 static int mpegts_check_bitstream(struct AVFormatContext *s, const AVPacket *pkt)
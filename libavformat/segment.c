@@ -38,6 +38,8 @@
 #include "libavutil/avstring.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
 #include "libavutil/time.h"
 #include "libavutil/timecode.h"
 #include "libavutil/time_internal.h"
@@ -63,6 +65,25 @@ typedef enum {
     LIST_TYPE_NB,
 } ListType;
 
+/**
+ * Work on the previous and next segments done by the background thread,
+ * in the order it was queued.
+ */
+typedef struct SegmentJob {
+    AVFormatContext *avf;  ///< muxer of a finished segment, to write the trailer of and free
+    AVIOContext *pb;       ///< finished segment to close, its muxer is reused
+    int write_trailer;
+    uint8_t *list;         ///< new list file contents, or entry to append to list_pb
+    int list_len;
+    int list_append;
+    char *open_url;        ///< segment to open ahead
+} SegmentJob;
+
+typedef struct SegmentOpened {
+    AVIOContext *pb;
+    int ret;
+} SegmentOpened;
+
 #define SEGMENT_LIST_FLAG_CACHE 1
 #define SEGMENT_LIST_FLAG_LIVE  2
 
@@ -123,6 +144,15 @@ typedef struct SegmentContext {
     SegmentListEntry cur_entry;
     SegmentListEntry *segment_list_entries;
     SegmentListEntry *segment_list_entries_end;
+
+    int async;             ///< finish segments and open the next ones on a thread
+#if HAVE_THREADS
+    pthread_t thread;
+    AVThreadMessageQueue *jobs;
+    AVThreadMessageQueue *opened;
+    char *preopen_url;     ///< segment being opened ahead, if any
+    int async_ret;         ///< first error of the thread
+#endif
 } SegmentContext;
 
 static void print_csv_escaped_str(AVIOContext *ctx, const char *str)
@@ -236,6 +266,208 @@ static int set_segment_filename(AVFormatContext *s)
     return 0;
 }
 
+#if HAVE_THREADS
+static void free_job(void *msg)
+{
+    SegmentJob *job = msg;
+
+    if (job->avf) {
+        ff_format_io_close(job->avf, &job->avf->pb);
+        avformat_free_context(job->avf);
+    }
+    if (job->pb)
+        avio_closep(&job->pb);
+    av_freep(&job->list);
+    av_freep(&job->open_url);
+}
+
+static void free_opened(void *msg)
+{
+    SegmentOpened *opened = msg;
+
+    avio_closep(&opened->pb);
+}
+
+static int run_job(AVFormatContext *s, SegmentJob *job)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret = 0;
+
+    if (job->avf) {
+        AVFormatContext *oc = job->avf;
+
+        av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
+        if (job->write_trailer)
+            ret = av_write_trailer(oc);
+        if (ret < 0)
+            av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
+                   oc->url);
+        ff_format_io_close(oc, &oc->pb);
+        avformat_free_context(oc);
+        job->avf = NULL;
+    }
+    if (job->pb)
+        ff_format_io_close(s, &job->pb);
+
+    if (job->list) {
+        if (job->list_append) {
+            avio_write(seg->list_pb, job->list, job->list_len);
+            avio_flush(seg->list_pb);
+        } else {
+            AVIOContext *pb = NULL;
+            int err = s->io_open(s, &pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
+            if (err < 0) {
+                av_log(s, AV_LOG_ERROR, "Failed to open segment list '%s'\n", seg->list);
+                ret = err;
+            } else {
+                avio_write(pb, job->list, job->list_len);
+                ff_format_io_close(s, &pb);
+                if (seg->use_rename)
+                    ff_rename(seg->temp_list_filename, seg->list, s);
+            }
+        }
+        av_freep(&job->list);
+    }
+
+    if (job->open_url) {
+        SegmentOpened opened = { 0 };
+
+        opened.ret = s->io_open(s, &opened.pb, job->open_url, AVIO_FLAG_WRITE, NULL);
+        if (opened.ret < 0)
+            av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", job->open_url);
+        av_freep(&job->open_url);
+        av_thread_message_queue_send(seg->opened, &opened, 0);
+    }
+    return ret;
+}
+
+static void *segment_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    SegmentContext *seg = s->priv_data;
+    SegmentJob job;
+    int ret;
+
+    while (av_thread_message_queue_recv(seg->jobs, &job, 0) >= 0) {
+        if ((ret = run_job(s, &job)) < 0 && !seg->async_ret) {
+            seg->async_ret = ret;
+            av_thread_message_queue_set_err_send(seg->jobs, ret);
+        }
+    }
+    return NULL;
+}
+
+static int segment_thread_start(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    if ((ret = av_thread_message_queue_alloc(&seg->jobs, 4, sizeof(SegmentJob))) < 0 ||
+        (ret = av_thread_message_queue_alloc(&seg->opened, 1, sizeof(SegmentOpened))) < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(seg->jobs, free_job);
+    av_thread_message_queue_set_free_func(seg->opened, free_opened);
+
+    if ((ret = AVERROR(pthread_create(&seg->thread, NULL, segment_thread, s)))) {
+        av_log(s, AV_LOG_ERROR, "Failed to start the segment thread\n");
+        goto fail;
+    }
+    return 0;
+fail:
+    av_thread_message_queue_free(&seg->jobs);
+    av_thread_message_queue_free(&seg->opened);
+    return ret;
+}
+
+/**
+ * Close and delete the segment opened ahead, when it is not used.
+ */
+static void segment_discard_preopened(AVFormatContext *s, SegmentOpened *opened)
+{
+    SegmentContext *seg = s->priv_data;
+
+    if (!opened->pb)
+        return;
+    ff_format_io_close(s, &opened->pb);
+    if (avpriv_io_delete(seg->preopen_url) < 0)
+        av_log(s, AV_LOG_WARNING, "Could not delete unused segment '%s'\n",
+               seg->preopen_url);
+}
+
+/**
+ * Wait for the queued work to be done, and close the segment opened ahead
+ * if it was not used.
+ */
+static void segment_thread_stop(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+
+    if (!seg->jobs)
+        return;
+    av_thread_message_queue_set_err_recv(seg->jobs, AVERROR_EOF);
+    pthread_join(seg->thread, NULL);
+
+    if (seg->preopen_url) {
+        SegmentOpened opened;
+
+        if (av_thread_message_queue_recv(seg->opened, &opened, AV_THREAD_MESSAGE_NONBLOCK) >= 0)
+            segment_discard_preopened(s, &opened);
+        av_freep(&seg->preopen_url);
+    }
+    av_thread_message_queue_free(&seg->jobs);
+    av_thread_message_queue_free(&seg->opened);
+}
+
+/**
+ * Queue the opening of the segment after the current one, when its name
+ * is already known.
+ */
+static int segment_preopen(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    SegmentJob job = { 0 };
+    char buf[1024];
+    int ret;
+
+    if (!seg->jobs || seg->use_strftime || seg->segment_idx_wrap ||
+        av_get_frame_filename(buf, sizeof(buf), s->url, seg->segment_idx + 1) < 0)
+        return 0;
+    if (!(seg->preopen_url = av_strdup(buf)) ||
+        !(job.open_url = av_strdup(buf))) {
+        av_freep(&seg->preopen_url);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = av_thread_message_queue_send(seg->jobs, &job, 0)) < 0) {
+        av_freep(&seg->preopen_url);
+        av_freep(&job.open_url);
+    }
+    return ret;
+}
+
+/**
+ * Get the segment opened ahead, if it is the one to write next.
+ */
+static int segment_take_preopened(AVFormatContext *s, AVIOContext **pb, const char *url)
+{
+    SegmentContext *seg = s->priv_data;
+    SegmentOpened opened;
+    int ret;
+
+    if (!seg->preopen_url)
+        return 0;
+    ret = av_thread_message_queue_recv(seg->opened, &opened, 0);
+    if (ret >= 0 && strcmp(url, seg->preopen_url)) {
+        segment_discard_preopened(s, &opened);
+        ret = 0;
+    } else if (ret >= 0) {
+        *pb = opened.pb;
+        ret = opened.ret;
+    }
+    av_freep(&seg->preopen_url);
+    return ret;
+}
+#endif
+
 static int segment_start(AVFormatContext *s, int write_header)
 {
     SegmentContext *seg = s->priv_data;
@@ -257,7 +489,12 @@ static int segment_start(AVFormatContext *s, int write_header)
     if ((err = set_segment_filename(s)) < 0)
         return err;
 
-    if ((err = s->io_open(s, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0) {
+#if HAVE_THREADS
+    if ((err = segment_take_preopened(s, &oc->pb, oc->url)) < 0)
+        return err;
+#endif
+    if (!oc->pb &&
+        (err = s->io_open(s, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->url);
         return err;
     }
@@ -278,29 +515,25 @@ static int segment_start(AVFormatContext *s, int write_header)
     }
 
     seg->segment_frame_count = 0;
+#if HAVE_THREADS
+    if ((err = segment_preopen(s)) < 0)
+        return err;
+#endif
     return 0;
 }
 
-static int segment_list_open(AVFormatContext *s)
+static void segment_list_write_header(AVFormatContext *s, AVIOContext *pb)
 {
     SegmentContext *seg = s->priv_data;
-    int ret;
-
-    snprintf(seg->temp_list_filename, sizeof(seg->temp_list_filename), seg->use_rename ? "%s.tmp" : "%s", seg->list);
-    ret = s->io_open(s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
-    if (ret < 0) {
-        av_log(s, AV_LOG_ERROR, "Failed to open segment list '%s'\n", seg->list);
-        return ret;
-    }
 
     if (seg->list_type == LIST_TYPE_M3U8 && seg->segment_list_entries) {
         SegmentListEntry *entry;
         double max_duration = 0;
 
-        avio_printf(seg->list_pb, "#EXTM3U\n");
-        avio_printf(seg->list_pb, "#EXT-X-VERSION:3\n");
-        avio_printf(seg->list_pb, "#EXT-X-MEDIA-SEQUENCE:%d\n", seg->segment_list_entries->index);
-        avio_printf(seg->list_pb, "#EXT-X-ALLOW-CACHE:%s\n",
+        avio_printf(pb, "#EXTM3U\n");
+        avio_printf(pb, "#EXT-X-VERSION:3\n");
+        avio_printf(pb, "#EXT-X-MEDIA-SEQUENCE:%d\n", seg->segment_list_entries->index);
+        avio_printf(pb, "#EXT-X-ALLOW-CACHE:%s\n",
                     seg->list_flags & SEGMENT_LIST_FLAG_CACHE ? "YES" : "NO");
 
         av_log(s, AV_LOG_VERBOSE, "EXT-X-MEDIA-SEQUENCE:%d\n",
@@ -308,10 +541,25 @@ static int segment_list_open(AVFormatContext *s)
 
         for (entry = seg->segment_list_entries; entry; entry = entry->next)
             max_duration = FFMAX(max_duration, entry->end_time - entry->start_time);
-        avio_printf(seg->list_pb, "#EXT-X-TARGETDURATION:%"PRId64"\n", (int64_t)ceil(max_duration));
+        avio_printf(pb, "#EXT-X-TARGETDURATION:%"PRId64"\n", (int64_t)ceil(max_duration));
     } else if (seg->list_type == LIST_TYPE_FFCONCAT) {
-        avio_printf(seg->list_pb, "ffconcat version 1.0\n");
+        avio_printf(pb, "ffconcat version 1.0\n");
     }
+}
+
+static int segment_list_open(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    snprintf(seg->temp_list_filename, sizeof(seg->temp_list_filename), seg->use_rename ? "%s.tmp" : "%s", seg->list);
+    ret = s->io_open(s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to open segment list '%s'\n", seg->list);
+        return ret;
+    }
+
+    segment_list_write_header(s, seg->list_pb);
 
     return ret;
 }
@@ -362,10 +610,31 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
     char buf[AV_TIMECODE_STR_SIZE];
     int i;
     int err;
+#if HAVE_THREADS
+    SegmentJob job = { 0 };
+    AVIOContext *dyn = NULL;
+    int async = seg->jobs && !is_last;
+#else
+    const int async = 0;
+#endif
 
     if (!oc || !oc->pb)
         return AVERROR(EINVAL);
 
+#if HAVE_THREADS
+    if (async) {
+        /* the trailer and the closing are done by the thread */
+        if (write_trailer) {
+            job.avf = oc;
+            job.write_trailer = 1;
+        } else {
+            av_write_frame(oc, NULL);
+            job.pb = oc->pb;
+            oc->pb = NULL;
+        }
+    } else
+#endif
+    {
     av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
     if (write_trailer)
         ret = av_write_trailer(oc);
@@ -373,6 +642,7 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
     if (ret < 0)
         av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
                oc->url);
+    }
 
     if (seg->list) {
         if (seg->list_size || seg->list_type == LIST_TYPE_M3U8) {
@@ -399,6 +669,18 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
                 av_freep(&entry);
             }
 
+#if HAVE_THREADS
+            if (async) {
+                /* written by the thread once the segment is complete */
+                if ((ret = avio_open_dyn_buf(&dyn)) < 0)
+                    goto end;
+                segment_list_write_header(s, dyn);
+                for (entry = seg->segment_list_entries; entry; entry = entry->next)
+                    segment_list_print_entry(dyn, seg->list_type, entry, s);
+                job.list_len = avio_close_dyn_buf(dyn, &job.list);
+            } else
+#endif
+            {
             if ((ret = segment_list_open(s)) < 0)
                 goto end;
             for (entry = seg->segment_list_entries; entry; entry = entry->next)
@@ -408,6 +690,15 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
             ff_format_io_close(s, &seg->list_pb);
             if (seg->use_rename)
                 ff_rename(seg->temp_list_filename, seg->list, s);
+            }
+#if HAVE_THREADS
+        } else if (async) {
+            if ((ret = avio_open_dyn_buf(&dyn)) < 0)
+                goto end;
+            segment_list_print_entry(dyn, seg->list_type, &seg->cur_entry, s);
+            job.list_len    = avio_close_dyn_buf(dyn, &job.list);
+            job.list_append = 1;
+#endif
         } else {
             segment_list_print_entry(seg->list_pb, seg->list_type, &seg->cur_entry, s);
             avio_flush(seg->list_pb);
@@ -415,7 +706,7 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
     }
 
     av_log(s, AV_LOG_VERBOSE, "segment:'%s' count:%d ended\n",
-           seg->avf->url, seg->segment_count);
+           oc->url, seg->segment_count);
     seg->segment_count++;
 
     if (seg->increment_tc) {
@@ -458,6 +749,17 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
     }
 
 end:
+#if HAVE_THREADS
+    if (async) {
+        if (job.avf)
+            seg->avf = NULL;
+        if ((err = av_thread_message_queue_send(seg->jobs, &job, 0)) < 0) {
+            free_job(&job);
+            ret = err;
+        }
+        return ret;
+    }
+#endif
     ff_format_io_close(oc, &oc->pb);
 
     return ret;
@@ -660,6 +962,9 @@ static int select_reference_stream(AVFormatContext *s)
 static void seg_free(AVFormatContext *s)
 {
     SegmentContext *seg = s->priv_data;
+#if HAVE_THREADS
+    segment_thread_stop(s);
+#endif
     ff_format_io_close(seg->avf, &seg->list_pb);
     avformat_free_context(seg->avf);
     seg->avf = NULL;
@@ -733,6 +1038,8 @@ static int seg_init(AVFormatContext *s)
         } else {
             const char *proto = avio_find_protocol_name(seg->list);
             seg->use_rename = proto && !strcmp(proto, "file");
+            snprintf(seg->temp_list_filename, sizeof(seg->temp_list_filename),
+                     seg->use_rename ? "%s.tmp" : "%s", seg->list);
         }
     }
 
@@ -810,6 +1117,16 @@ static int seg_init(AVFormatContext *s)
     if (oc->avoid_negative_ts > 0 && s->avoid_negative_ts < 0)
         s->avoid_negative_ts = 1;
 
+    if (seg->async) {
+#if HAVE_THREADS
+        int err = segment_thread_start(s);
+        if (err < 0)
+            return err;
+#else
+        av_log(s, AV_LOG_WARNING, "segment_async requires thread support, ignoring it\n");
+#endif
+    }
+
     return ret;
 }
 
@@ -855,6 +1172,10 @@ static int seg_write_header(AVFormatContext *s)
             oc->pb->seekable = 0;
     }
 
+#if HAVE_THREADS
+    if ((ret = segment_preopen(s)) < 0)
+        return ret;
+#endif
     return 0;
 }
 
@@ -990,6 +1311,9 @@ static int seg_write_trailer(struct AVFormatContext *s)
     SegmentListEntry *cur, *next;
     int ret = 0;
 
+#if HAVE_THREADS
+    segment_thread_stop(s);
+#endif
     if (!oc)
         goto fail;
 
@@ -1003,6 +1327,10 @@ static int seg_write_trailer(struct AVFormatContext *s)
     } else {
         ret = segment_end(s, 1, 1);
     }
+#if HAVE_THREADS
+    if (ret >= 0 && seg->async_ret < 0)
+        ret = seg->async_ret;
+#endif
 fail:
     if (seg->list)
         ff_format_io_close(s, &seg->list_pb);
@@ -1085,6 +1413,7 @@ static const AVOption options[] = {
     { "reset_timestamps", "reset timestamps at the beginning of each segment", OFFSET(reset_timestamps), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { "initial_offset", "set initial timestamp offset", OFFSET(initial_offset), AV_OPT_TYPE_DURATION, {.i64 = 0}, -INT64_MAX, INT64_MAX, E },
     { "write_empty_segments", "allow writing empty 'filler' segments", OFFSET(write_empty), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
+    { "segment_async", "open the next segment ahead and finish the previous one on a thread", OFFSET(async), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { NULL },
 };
 
@@ -0,0 +1,223 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Reads a resource over parallel range requests from a minimal local
+ * HTTP server, seeking inside and outside of the read ahead window, and
+ * checks that a stalled connection does not block the interrupt callback.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+#include "libavformat/network.h"
+#include "libavformat/url.h"
+
+#define FILE_SIZE  (1024 * 1024 + 1234)
+#define CHUNK_SIZE (64 * 1024)
+
+static uint8_t data[FILE_SIZE];
+static int listen_fd, port;
+/* requests for ranges starting at or after this offset are never answered */
+static volatile int64_t stall_offset = INT64_MAX;
+static int64_t deadline;
+
+static int send_all(int fd, const void *buf, int size)
+{
+    const uint8_t *p = buf;
+
+    while (size > 0) {
+        int ret = send(fd, p, size, MSG_NOSIGNAL);
+        if (ret <= 0)
+            return -1;
+        p    += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+static int read_request(int fd, char *buf, int size)
+{
+    int len = 0;
+
+    while (len < size - 1) {
+        if (recv(fd, buf + len, 1, 0) != 1)
+            return -1;
+        buf[++len] = 0;
+        if (len >= 4 && !memcmp(buf + len - 4, "\r\n\r\n", 4))
+            return 0;
+    }
+    return -1;
+}
+
+static void *serve_connection(void *arg)
+{
+    int fd = (intptr_t)arg;
+    char req[4096], reply[256];
+
+    while (!read_request(fd, req, sizeof(req))) {
+        int64_t start = 0, end = FILE_SIZE - 1;
+        const char *range = av_stristr(req, "\r\nRange: bytes=");
+
+        if (range) {
+            char *p;
+            start = strtoll(range + 15, &p, 10);
+            if (*p == '-' && p[1] >= '0' && p[1] <= '9')
+                end = FFMIN(strtoll(p + 1, NULL, 10), FILE_SIZE - 1);
+        }
+        if (start >= stall_offset) {
+            while (stall_offset != INT64_MAX)
+                av_usleep(10000);
+            break;
+        }
+        snprintf(reply, sizeof(reply),
+                 "HTTP/1.1 206 Partial Content\r\n"
+                 "Content-Type: application/octet-stream\r\n"
+                 "Content-Range: bytes %"PRId64"-%"PRId64"/%d\r\n"
+                 "Content-Length: %"PRId64"\r\n"
+                 "\r\n", start, end, FILE_SIZE, end - start + 1);
+        if (send_all(fd, reply, strlen(reply)) ||
+            send_all(fd, data + start, end - start + 1))
+            break;
+    }
+    closesocket(fd);
+    return NULL;
+}
+
+static void *serve(void *arg)
+{
+    int fd;
+
+    while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+        pthread_t thread;
+        if (!pthread_create(&thread, NULL, serve_connection, (void *)(intptr_t)fd))
+            pthread_detach(thread);
+        else
+            closesocket(fd);
+    }
+    return NULL;
+}
+
+static int start_server(void)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t addr_len = sizeof(addr);
+    pthread_t thread;
+
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0 ||
+        bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(listen_fd, 16) ||
+        getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len))
+        return AVERROR(errno);
+    port = ntohs(addr.sin_port);
+    if (pthread_create(&thread, NULL, serve, NULL))
+        return AVERROR(EAGAIN);
+    pthread_detach(thread);
+    return 0;
+}
+
+static int check_interrupt(void *arg)
+{
+    return deadline && av_gettime_relative() > deadline;
+}
+
+static int open_parallel(URLContext **h)
+{
+    const AVIOInterruptCB int_cb = { check_interrupt, NULL };
+    AVDictionary *opts = NULL;
+    char url[64];
+    int ret;
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/file", port);
+    av_dict_set(&opts, "connections", "4", 0);
+    av_dict_set_int(&opts, "chunk_size", CHUNK_SIZE, 0);
+    av_dict_set(&opts, "read_ahead", "4", 0);
+    ret = ffurl_open_whitelist(h, url, AVIO_FLAG_READ, &int_cb, &opts,
+                               NULL, NULL, NULL);
+    av_dict_free(&opts);
+    return ret;
+}
+
+/* Read size bytes at pos, or up to the end, and compare them. */
+static int check_read(URLContext *h, const char *name, int64_t pos, int size)
+{
+    static uint8_t buf[FILE_SIZE];
+    int64_t ret;
+    int len = 0;
+
+    if ((ret = ffurl_seek(h, pos, SEEK_SET)) != pos) {
+        printf("%s: seek returned %"PRId64"\n", name, ret);
+        return ret < 0 ? ret : AVERROR_BUG;
+    }
+    while (len < size) {
+        ret = ffurl_read(h, buf + len, FFMIN(size - len, 10000));
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            return ret;
+        len += ret;
+    }
+    printf("%s: %d bytes, %s\n", name, len,
+           len == FFMIN(size, FILE_SIZE - pos) && !memcmp(buf, data + pos, len) ?
+           "ok" : "differs");
+    return 0;
+}
+
+int main(void)
+{
+    URLContext *h = NULL;
+    int i, ret;
+
+    for (i = 0; i < FILE_SIZE; i++)
+        data[i] = i * 7 + (i >> 13);
+
+    avformat_network_init();
+    if ((ret = start_server()) < 0 || (ret = open_parallel(&h)) < 0)
+        goto end;
+    printf("size: %"PRId64"\n", ffurl_size(h));
+
+    if ((ret = check_read(h, "sequential", 0, FILE_SIZE)) < 0 ||
+        (ret = check_read(h, "backward", 3 * CHUNK_SIZE + 100, CHUNK_SIZE)) < 0 ||
+        (ret = check_read(h, "forward in window", 6 * CHUNK_SIZE + 5, 3 * CHUNK_SIZE)) < 0 ||
+        (ret = check_read(h, "forward past window", 13 * CHUNK_SIZE, CHUNK_SIZE / 2)) < 0 ||
+        (ret = check_read(h, "tail", FILE_SIZE - 10, 100)) < 0)
+        goto end;
+
+    /* the reader must notice the interrupt while a worker is stuck */
+    stall_offset = 8 * CHUNK_SIZE;
+    deadline     = av_gettime_relative() + 300000;
+    ret = check_read(h, "stalled", 8 * CHUNK_SIZE, CHUNK_SIZE);
+    printf("stalled: %s\n", ret == AVERROR_EXIT ? "interrupted" : "not interrupted");
+    ret = 0;
+
+end:
+    stall_offset = INT64_MAX;
+    ffurl_closep(&h);
+    avformat_network_deinit();
+    if (ret < 0)
+        printf("error: %s\n", av_err2str(ret));
+    return ret < 0;
+}
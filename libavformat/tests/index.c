@@ -0,0 +1,124 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Builds the same out of order index one entry at a time with
+ * av_add_index_entry() and in batches with av_add_index_entries(), and
+ * checks that both give the same entries and seek results.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/lfg.h"
+#include "libavformat/avformat.h"
+
+#define NB_ENTRIES 20000
+#define MAX_TS     15000
+
+static int check(const char *name, AVStream *ref, AVStream *st)
+{
+    static const int flags[] = { 0, AVSEEK_FLAG_BACKWARD, AVSEEK_FLAG_ANY,
+                                 AVSEEK_FLAG_ANY | AVSEEK_FLAG_BACKWARD };
+    int i, j, bad_entries = 0, bad_seeks = 0;
+
+    if (ref->nb_index_entries != st->nb_index_entries) {
+        printf("%s: %d entries, expected %d\n", name,
+               st->nb_index_entries, ref->nb_index_entries);
+        return 1;
+    }
+    for (i = 0; i < ref->nb_index_entries; i++) {
+        const AVIndexEntry *a = &ref->index_entries[i], *b = &st->index_entries[i];
+        bad_entries += a->pos != b->pos || a->timestamp != b->timestamp ||
+                       a->size != b->size || a->flags != b->flags ||
+                       a->min_distance != b->min_distance;
+    }
+    for (i = -10; i < MAX_TS * 10 + 20; i += 7)
+        for (j = 0; j < FF_ARRAY_ELEMS(flags); j++)
+            bad_seeks += av_index_search_timestamp(ref, i, flags[j]) !=
+                         av_index_search_timestamp(st,  i, flags[j]);
+    printf("%s: %d entries, %d differ, %d seeks differ\n", name,
+           st->nb_index_entries, bad_entries, bad_seeks);
+    return bad_entries || bad_seeks;
+}
+
+/* Add entries one by one to ref and in batches of the given size to st. */
+static int build(AVStream *ref, AVStream *st, const AVIndexEntry *entries,
+                 int nb_entries, int batch)
+{
+    int i, ret;
+
+    for (i = 0; i < nb_entries; i++) {
+        const AVIndexEntry *e = &entries[i];
+        if ((ret = av_add_index_entry(ref, e->pos, e->timestamp, e->size,
+                                      e->min_distance, e->flags)) < 0)
+            return ret;
+    }
+    for (i = 0; i < nb_entries; i += batch)
+        if ((ret = av_add_index_entries(st, entries + i,
+                                        FFMIN(batch, nb_entries - i))) < 0)
+            return ret;
+    return 0;
+}
+
+int main(void)
+{
+    static const int batches[] = { 1, 7, 1000, NB_ENTRIES };
+    static AVIndexEntry entries[NB_ENTRIES];
+    AVFormatContext *s = avformat_alloc_context();
+    AVLFG lfg;
+    int i, j, ret = 0;
+
+    if (!s)
+        return 1;
+    av_lfg_init(&lfg, 0x1D3A);
+
+    for (j = 0; j < FF_ARRAY_ELEMS(batches); j++) {
+        AVStream *ref, *st;
+        char name[64];
+
+        /* reverse order, then random timestamps overlapping them with
+         * duplicates, the same position for some of them */
+        for (i = 0; i < NB_ENTRIES; i++) {
+            AVIndexEntry *e = &entries[i];
+            int64_t ts = i < NB_ENTRIES / 4 ? (NB_ENTRIES / 4 - i) * 20 :
+                                              av_lfg_get(&lfg) % MAX_TS * 10;
+            e->timestamp    = ts;
+            e->pos          = av_lfg_get(&lfg) & 1 ? ts * 3 : ts * 3 + i;
+            e->size         = av_lfg_get(&lfg) & 0xFFFF;
+            e->min_distance = av_lfg_get(&lfg) % 100;
+            e->flags        = ts % 50 ? 0 : AVINDEX_KEYFRAME;
+        }
+
+        if (!(ref = avformat_new_stream(s, NULL)) ||
+            !(st  = avformat_new_stream(s, NULL))) {
+            ret = 1;
+            break;
+        }
+        snprintf(name, sizeof(name), "batches of %d", batches[j]);
+        if (build(ref, st, entries, NB_ENTRIES, batches[j]) < 0) {
+            printf("%s: failed to add entries\n", name);
+            ret = 1;
+            continue;
+        }
+        ret |= check(name, ref, st);
+    }
+
+    avformat_free_context(s);
+    return ret;
+}
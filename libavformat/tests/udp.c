@@ -0,0 +1,151 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Sends datagrams through batched udp:// output over the loopback
+ * interface and checks when they are flushed and that they arrive intact.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/dict.h"
+#include "libavformat/avformat.h"
+#include "libavformat/network.h"
+#include "libavformat/url.h"
+
+#define PKT_SIZE 1316
+
+static URLContext *input;
+static int port;
+
+static int open_input(void)
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    AVDictionary *opts = NULL;
+    int ret;
+
+    av_dict_set(&opts, "batch", "8", 0);
+    av_dict_set(&opts, "timeout", "300000", 0);
+    ret = ffurl_open_whitelist(&input, "udp://127.0.0.1:0", AVIO_FLAG_READ,
+                               NULL, &opts, NULL, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+    if (getsockname(ffurl_get_file_handle(input), (struct sockaddr *)&addr, &addr_len))
+        return AVERROR(errno);
+    port = ntohs(((struct sockaddr_in *)&addr)->sin_port);
+    return 0;
+}
+
+static int open_output(URLContext **output, const char *batch_delay)
+{
+    AVDictionary *opts = NULL;
+    char url[64];
+    int ret;
+
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d", port);
+    av_dict_set(&opts, "batch", "8", 0);
+    av_dict_set(&opts, "pkt_size", "1316", 0);
+    av_dict_set(&opts, "batch_delay", batch_delay, 0);
+    ret = ffurl_open_whitelist(output, url, AVIO_FLAG_WRITE,
+                               NULL, &opts, NULL, NULL, NULL);
+    av_dict_free(&opts);
+    return ret;
+}
+
+static void fill(uint8_t *buf, int size, int seq)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+        buf[i] = seq * 31 + i;
+}
+
+/* Send datagrams and read back the ones that arrive before the output is
+ * closed, then the ones that arrive after. */
+static int run(const char *name, const char *batch_delay, const int *sizes, int nb)
+{
+    uint8_t buf[PKT_SIZE], ref[PKT_SIZE];
+    URLContext *output = NULL;
+    int i, ret, before = 0, after = 0, bad = 0;
+
+    if ((ret = open_output(&output, batch_delay)) < 0)
+        return ret;
+    for (i = 0; i < nb; i++) {
+        fill(buf, sizes[i], i);
+        if ((ret = ffurl_write(output, buf, sizes[i])) < 0)
+            goto end;
+    }
+
+    for (i = 0; i < nb; i++) {
+        if (i == before) {
+            ret = ffurl_read(input, buf, sizeof(buf));
+            if (ret == AVERROR(EIO)) {
+                ffurl_closep(&output);
+                ret = ffurl_read(input, buf, sizeof(buf));
+            } else {
+                before++;
+            }
+        } else {
+            ret = ffurl_read(input, buf, sizeof(buf));
+        }
+        if (ret < 0)
+            goto end;
+        if (!output && i >= before)
+            after++;
+        fill(ref, sizes[i], i);
+        bad += ret != sizes[i] || memcmp(buf, ref, ret);
+    }
+    printf("%s: %d before close, %d on close, %d corrupt\n", name, before, after, bad);
+    ret = 0;
+end:
+    ffurl_closep(&output);
+    return ret;
+}
+
+int main(void)
+{
+    static const int full[]  = { PKT_SIZE, PKT_SIZE, PKT_SIZE };
+    static const int burst[] = { PKT_SIZE, PKT_SIZE, PKT_SIZE, PKT_SIZE, PKT_SIZE,
+                                 PKT_SIZE, PKT_SIZE, PKT_SIZE, PKT_SIZE, PKT_SIZE,
+                                 PKT_SIZE, 500 };
+    int ret;
+
+    avformat_network_init();
+    if ((ret = open_input()) < 0)
+        goto end;
+
+    /* a partial batch waits for more datagrams or the end */
+    if ((ret = run("queued", "10000000", full, FF_ARRAY_ELEMS(full))) < 0)
+        goto end;
+    /* with no delay allowed every datagram is sent right away */
+    if ((ret = run("no delay", "0", full, FF_ARRAY_ELEMS(full))) < 0)
+        goto end;
+    /* a full batch is sent, a short datagram flushes the rest */
+    if ((ret = run("short datagram", "10000000", burst, FF_ARRAY_ELEMS(burst))) < 0)
+        goto end;
+
+end:
+    ffurl_closep(&input);
+    avformat_network_deinit();
+    if (ret < 0)
+        printf("error: %s\n", av_err2str(ret));
+    return ret < 0;
+}
@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg()/sendmmsg() with glibc */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -70,6 +71,10 @@
 #include "libavutil/thread.h"
 #endif
 
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif
+
 #ifndef IPV6_ADD_MEMBERSHIP
 #define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
 #define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
@@ -79,6 +84,9 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_BATCH 1024
+#define UDP_GSO_MAX_SEGMENTS 64
+#define UDP_GSO_MAX_SIZE 65507
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -117,6 +125,25 @@ typedef struct UDPContext {
     char *sources;
     char *block;
     IPSourceFilters filters;
+
+    /* Batched I/O through recvmmsg()/sendmmsg() and UDP GSO/GRO */
+    int batch;
+    int gso;
+    uint8_t *batch_buf;
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+#endif
+    struct sockaddr_storage *msg_addrs;
+    uint8_t *msg_ctrl;
+    int *msg_seg_size;
+    int nb_msgs;          ///< number of received or queued datagrams
+    int cur_msg;          ///< next received datagram to return / first unsent one
+    int cur_offset;       ///< offset in the current received (GRO) datagram
+    int pending_size;     ///< bytes queued in batch_buf for output
+    int max_pending;      ///< max datagrams queued before flushing output
+    int64_t batch_delay;  ///< max time in microseconds a datagram stays queued
+    int64_t batch_start;  ///< time the oldest queued datagram was queued
 } UDPContext;
 
 #define OFFSET(x) offsetof(UDPContext, x)
@@ -141,6 +168,9 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout (only in read mode)",     OFFSET(timeout),        AV_OPT_TYPE_INT,    { .i64 = 0 },      0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch",          "Number of datagrams to receive or send per system call", OFFSET(batch), AV_OPT_TYPE_INT,   { .i64 = 1 },      1, UDP_MAX_BATCH, D|E },
+    { "gso",            "Use UDP segmentation/receive offload",            OFFSET(gso),            AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       D|E },
+    { "batch_delay",    "Maximum time in microseconds a datagram is queued for batching", OFFSET(batch_delay), AV_OPT_TYPE_INT64, { .i64 = 1000 }, 0, INT64_MAX, E },
     { NULL }
 };
 
@@ -459,7 +489,237 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+#define UDP_CTRL_SIZE CMSG_SPACE(sizeof(int))
+
+static void udp_free_batch(UDPContext *s)
+{
+    av_freep(&s->batch_buf);
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    av_freep(&s->msgs);
+    av_freep(&s->iovs);
+#endif
+    av_freep(&s->msg_addrs);
+    av_freep(&s->msg_ctrl);
+    av_freep(&s->msg_seg_size);
+    s->nb_msgs = s->cur_msg = s->cur_offset = s->pending_size = 0;
+}
+
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+static int udp_alloc_batch(URLContext *h, int is_output)
+{
+    UDPContext *s = h->priv_data;
+    int i, slot_size = UDP_MAX_PKT_SIZE;
+
+    if (is_output) {
+        slot_size      = h->max_packet_size > 0 ? h->max_packet_size : UDP_MAX_PKT_SIZE;
+        s->max_pending = s->gso ? FFMIN(s->batch, UDP_GSO_MAX_SEGMENTS) : s->batch;
+    }
+
+    s->msgs         = av_mallocz_array(s->batch, sizeof(*s->msgs));
+    s->iovs         = av_mallocz_array(s->batch, sizeof(*s->iovs));
+    s->msg_addrs    = av_mallocz_array(s->batch, sizeof(*s->msg_addrs));
+    s->msg_ctrl     = av_mallocz_array(s->batch, UDP_CTRL_SIZE);
+    s->msg_seg_size = av_mallocz_array(s->batch, sizeof(*s->msg_seg_size));
+    s->batch_buf    = av_malloc_array(s->batch, slot_size);
+    if (!s->msgs || !s->iovs || !s->msg_addrs || !s->msg_ctrl ||
+        !s->msg_seg_size || !s->batch_buf) {
+        udp_free_batch(s);
+        return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < s->batch; i++) {
+        struct msghdr *hdr = &s->msgs[i].msg_hdr;
+
+        hdr->msg_iov    = &s->iovs[i];
+        hdr->msg_iovlen = 1;
+        if (!is_output) {
+            s->iovs[i].iov_base = s->batch_buf + (size_t)i * slot_size;
+            s->iovs[i].iov_len  = slot_size;
+            hdr->msg_name       = &s->msg_addrs[i];
+            if (s->gso)
+                hdr->msg_control = s->msg_ctrl + i * UDP_CTRL_SIZE;
+        }
+    }
+    return 0;
+}
+#endif
+
+#if HAVE_RECVMMSG
+/**
+ * Receive up to s->batch datagrams with a single system call.
+ * @return the number of received messages, or a negative value on
+ *         error (use ff_neterrno() to fetch the error code)
+ */
+static int udp_recv_batch(UDPContext *s, int flags)
+{
+    int i, n;
+
+    for (i = 0; i < s->batch; i++) {
+        struct msghdr *hdr = &s->msgs[i].msg_hdr;
+
+        hdr->msg_namelen    = sizeof(s->msg_addrs[i]);
+        hdr->msg_controllen = s->gso ? UDP_CTRL_SIZE : 0;
+        hdr->msg_flags      = 0;
+    }
+
+    n = recvmmsg(s->udp_fd, s->msgs, s->batch, flags, NULL);
+    if (n < 0)
+        return n;
+
+    for (i = 0; i < n; i++) {
+        s->msg_seg_size[i] = s->msgs[i].msg_len;
+#ifdef UDP_GRO
+        if (s->gso) {
+            struct msghdr *hdr = &s->msgs[i].msg_hdr;
+            struct cmsghdr *cmsg;
+
+            /* GRO coalesced several datagrams, remember their size */
+            for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+                if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+                    int seg_size;
+                    memcpy(&seg_size, CMSG_DATA(cmsg), sizeof(seg_size));
+                    if (seg_size > 0)
+                        s->msg_seg_size[i] = seg_size;
+                }
+            }
+        }
+#endif
+    }
+    s->nb_msgs    = n;
+    s->cur_msg    = 0;
+    s->cur_offset = 0;
+    return n;
+}
+
+/**
+ * Fetch the next datagram of the last received batch, skipping the ones
+ * rejected by the source filters and splitting GRO coalesced messages.
+ * @return the datagram size, or 0 once the batch is exhausted
+ */
+static int udp_next_datagram(UDPContext *s, const uint8_t **data)
+{
+    while (s->cur_msg < s->nb_msgs) {
+        int i   = s->cur_msg;
+        int len = s->msgs[i].msg_len - s->cur_offset;
+
+        if (len > 0 &&
+            (s->cur_offset || !ff_ip_check_source_lists(&s->msg_addrs[i], &s->filters))) {
+            len = FFMIN(len, s->msg_seg_size[i]);
+            *data = (const uint8_t *)s->iovs[i].iov_base + s->cur_offset;
+            s->cur_offset += len;
+            return len;
+        }
+        s->cur_msg++;
+        s->cur_offset = 0;
+    }
+    return 0;
+}
+#endif
+
+#if HAVE_SENDMMSG
+static void udp_queue_datagram(UDPContext *s, const uint8_t *buf, int size)
+{
+    struct msghdr *hdr = &s->msgs[s->nb_msgs].msg_hdr;
+    struct iovec  *iov = &s->iovs[s->nb_msgs];
+
+    if (!s->nb_msgs)
+        s->batch_start = av_gettime_relative();
+    memcpy(s->batch_buf + s->pending_size, buf, size);
+    iov->iov_base = s->batch_buf + s->pending_size;
+    iov->iov_len  = size;
+    if (!s->is_connected) {
+        hdr->msg_name    = &s->dest_addr;
+        hdr->msg_namelen = s->dest_addr_len;
+    } else {
+        hdr->msg_name    = NULL;
+        hdr->msg_namelen = 0;
+    }
+    s->pending_size += size;
+    s->nb_msgs++;
+}
+
+/**
+ * Send the datagrams queued by udp_write(), either as a single GSO
+ * buffer or with sendmmsg(). A flush interrupted by EAGAIN resumes
+ * with the first unsent datagram on the next call.
+ */
+static int udp_flush_batch(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+
+    while (s->cur_msg < s->nb_msgs) {
+        int ret;
+
+        if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+            ret = ff_network_wait_fd(s->udp_fd, 1);
+            if (ret < 0)
+                return ret;
+        }
+
+#ifdef UDP_SEGMENT
+        if (s->gso && s->nb_msgs > 1) {
+            struct msghdr *hdr = &s->msgs[0].msg_hdr;
+            struct cmsghdr *cmsg;
+            uint16_t seg_size = s->iovs[0].iov_len;
+
+            hdr->msg_control    = s->msg_ctrl;
+            hdr->msg_controllen = UDP_CTRL_SIZE;
+            cmsg = CMSG_FIRSTHDR(hdr);
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type  = UDP_SEGMENT;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(seg_size));
+            memcpy(CMSG_DATA(cmsg), &seg_size, sizeof(seg_size));
+            hdr->msg_controllen = cmsg->cmsg_len;
+            s->iovs[0].iov_len  = s->pending_size;
+
+            ret = sendmsg(s->udp_fd, hdr, 0);
+            s->iovs[0].iov_len  = seg_size;
+            hdr->msg_control    = NULL;
+            hdr->msg_controllen = 0;
+            if (ret >= 0)
+                ret = s->nb_msgs;
+        } else
+#endif
+            ret = sendmmsg(s->udp_fd, s->msgs + s->cur_msg,
+                           s->nb_msgs - s->cur_msg, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EINTR))
+                return ret;
+            continue;
+        }
+        s->cur_msg += ret;
+    }
+    s->nb_msgs = s->cur_msg = s->pending_size = 0;
+    return 0;
+}
+#endif
+
 #if HAVE_PTHREAD_CANCEL
+static int circular_buffer_put(URLContext *h, const uint8_t *data, int len)
+{
+    UDPContext *s = h->priv_data;
+    uint8_t tmp[4];
+
+    if (av_fifo_space(s->fifo) < len + 4) {
+        /* No Space left */
+        if (s->overrun_nonfatal) {
+            av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                    "Surviving due to overrun_nonfatal option\n");
+            return 0;
+        } else {
+            av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                    "To avoid, increase fifo_size URL option. "
+                    "To survive in such case, use overrun_nonfatal option\n");
+            return AVERROR(EIO);
+        }
+    }
+    AV_WL32(tmp, len);
+    av_fifo_generic_write(s->fifo, tmp, 4, NULL);
+    av_fifo_generic_write(s->fifo, (uint8_t *)data, len, NULL);
+    return 0;
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -474,7 +734,7 @@ static void *circular_buffer_task_rx( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
+        int len, ret;
         struct sockaddr_storage addr;
         socklen_t addr_len = sizeof(addr);
 
@@ -483,6 +743,11 @@ static void *circular_buffer_task_rx( void *_URLContext)
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+#if HAVE_RECVMMSG
+        if (s->msgs)
+            len = udp_recv_batch(s, MSG_WAITFORONE);
+        else
+#endif
         len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
@@ -493,25 +758,26 @@ static void *circular_buffer_task_rx( void *_URLContext)
             }
             continue;
         }
+#if HAVE_RECVMMSG
+        if (s->msgs) {
+            const uint8_t *data;
+
+            while ((len = udp_next_datagram(s, &data)) > 0) {
+                if ((ret = circular_buffer_put(h, data, len)) < 0) {
+                    s->circular_buffer_error = ret;
+                    goto end;
+                }
+            }
+            pthread_cond_signal(&s->cond);
+            continue;
+        }
+#endif
         if (ff_ip_check_source_lists(&addr, &s->filters))
             continue;
-        AV_WL32(s->tmp, len);
-
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
-            }
+        if ((ret = circular_buffer_put(h, s->tmp+4, len)) < 0) {
+            s->circular_buffer_error = ret;
+            goto end;
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
         pthread_cond_signal(&s->cond);
     }
 
@@ -722,6 +988,19 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             if (ff_ip_parse_blocks(h, buf, &s->filters) < 0)
                 goto fail;
         }
+        if (av_find_info_tag(buf, sizeof(buf), "batch", p)) {
+            s->batch = av_clip(strtol(buf, NULL, 10), 1, UDP_MAX_BATCH);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "batch_delay", p)) {
+            s->batch_delay = strtoll(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gso", p)) {
+            char *endptr = NULL;
+            s->gso = strtol(buf, &endptr, 10);
+            /* assume if no digits were found it is a request to enable it */
+            if (buf == endptr)
+                s->gso = 1;
+        }
         if (!is_output && av_find_info_tag(buf, sizeof(buf), "timeout", p))
             s->timeout = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
@@ -878,6 +1157,35 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     s->udp_fd = udp_fd;
 
+    if (s->gso) {
+        int ret = -1;
+#if defined(UDP_SEGMENT) && defined(UDP_GRO)
+        tmp = 0;
+        if (is_output)
+            ret = setsockopt(udp_fd, IPPROTO_UDP, UDP_SEGMENT, &tmp, sizeof(tmp));
+        else {
+            tmp = 1;
+            ret = setsockopt(udp_fd, IPPROTO_UDP, UDP_GRO, &tmp, sizeof(tmp));
+        }
+#endif
+        if (ret < 0) {
+            av_log(h, AV_LOG_WARNING, "UDP %s offload is not available, disabling it\n",
+                   is_output ? "segmentation" : "receive");
+            s->gso = 0;
+        }
+    }
+
+    if ((s->batch > 1 || s->gso) && !(is_output && s->bitrate && s->circular_buffer_size)) {
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+        if (udp_alloc_batch(h, is_output) < 0)
+            goto fail;
+#else
+        av_log(h, AV_LOG_WARNING,
+               "'batch' and 'gso' options were set but they are not supported "
+               "on this build (recvmmsg/sendmmsg support is required)\n");
+#endif
+    }
+
 #if HAVE_PTHREAD_CANCEL
     /*
       Create thread in case of:
@@ -925,6 +1233,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep(&s->fifo);
+    udp_free_batch(s);
     ff_ip_reset_filters(&s->filters);
     return AVERROR(EIO);
 }
@@ -991,6 +1300,28 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     }
 #endif
 
+#if HAVE_RECVMMSG
+    if (s->msgs) {
+        const uint8_t *data;
+
+        while (!(ret = udp_next_datagram(s, &data))) {
+            if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+                ret = ff_network_wait_fd(s->udp_fd, 0);
+                if (ret < 0)
+                    return ret;
+            }
+            if (udp_recv_batch(s, 0) < 0)
+                return ff_neterrno();
+        }
+        if (ret > size) {
+            av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
+            ret = size;
+        }
+        memcpy(buf, data, ret);
+        return ret;
+    }
+#endif
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 0);
         if (ret < 0)
@@ -1037,6 +1368,31 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
         pthread_mutex_unlock(&s->mutex);
         return size;
     }
+#endif
+#if HAVE_SENDMMSG
+    if (s->msgs) {
+        /* With GSO all queued datagrams but the last one must have the
+         * size of the first one, and the total must fit one UDP packet. */
+        if (s->nb_msgs == s->max_pending ||
+            (s->gso && s->nb_msgs &&
+             (size > s->iovs[0].iov_len || s->pending_size + size > UDP_GSO_MAX_SIZE))) {
+            ret = udp_flush_batch(h);
+            if (ret < 0)
+                return ret;
+        }
+        udp_queue_datagram(s, buf, size);
+        /* A datagram shorter than pkt_size means the writer flushed, and
+         * a slow stream must not wait for the batch to fill. */
+        if (s->nb_msgs == s->max_pending ||
+            (s->gso && size < s->iovs[0].iov_len) ||
+            (h->max_packet_size > 0 && size < h->max_packet_size) ||
+            av_gettime_relative() - s->batch_start >= s->batch_delay) {
+            ret = udp_flush_batch(h);
+            if (ret < 0 && ret != AVERROR(EAGAIN))
+                return ret;
+        }
+        return size;
+    }
 #endif
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 1);
@@ -1068,6 +1424,17 @@ static int udp_close(URLContext *h)
     }
 #endif
 
+#if HAVE_SENDMMSG
+    if (s->msgs && !(h->flags & AVIO_FLAG_READ) && s->nb_msgs) {
+        int ret;
+
+        while ((ret = udp_flush_batch(h)) == AVERROR(EAGAIN) &&
+               !ff_check_interrupt(&h->interrupt_callback));
+        if (ret < 0)
+            av_log(h, AV_LOG_ERROR, "Failed to send queued datagrams: %s\n", av_err2str(ret));
+    }
+#endif
+
     if (s->is_multicast && (h->flags & AVIO_FLAG_READ))
         udp_leave_multicast_group(s->udp_fd, (struct sockaddr *)&s->dest_addr,(struct sockaddr *)&s->local_addr_storage);
 #if HAVE_PTHREAD_CANCEL
@@ -1094,6 +1461,7 @@ static int udp_close(URLContext *h)
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep(&s->fifo);
+    udp_free_batch(s);
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
@@ -25,12 +25,14 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/cpu.h"
 #include "libavutil/dict.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/qsort.h"
 #include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/timestamp.h"
@@ -495,6 +497,19 @@ int avformat_queue_attached_pictures(AVFormatContext *s)
     return 0;
 }
 
+#if HAVE_THREADS
+static void probe_stream_wait(struct ProbeThreadContext *p, const AVStream *st);
+#endif
+
+/* wait until no probing thread uses the stream */
+static void wait_stream_probe(AVFormatContext *s, const AVStream *st)
+{
+#if HAVE_THREADS
+    if (s->internal->probe_threads)
+        probe_stream_wait(s->internal->probe_threads, st);
+#endif
+}
+
 static int update_stream_avctx(AVFormatContext *s)
 {
     int i, ret;
@@ -503,6 +518,7 @@ static int update_stream_avctx(AVFormatContext *s)
 
         if (!st->internal->need_context_update)
             continue;
+        wait_stream_probe(s, st);
 
         /* close parser, because it depends on the codec */
         if (st->parser && st->internal->avctx->codec_id != st->codecpar->codec_id) {
@@ -1586,8 +1602,10 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
             /* flush the parsers */
             for (i = 0; i < s->nb_streams; i++) {
                 st = s->streams[i];
-                if (st->parser && st->need_parsing)
+                if (st->parser && st->need_parsing) {
+                    wait_stream_probe(s, st);
                     parse_packet(s, pkt, st->index, 1);
+                }
             }
             /* all remaining packets are now in parse_queue =>
              * really terminate parsing */
@@ -1595,6 +1613,7 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
         }
         ret = 0;
         st  = s->streams[pkt->stream_index];
+        wait_stream_probe(s, st);
 
         /* update context if required */
         if (st->internal->need_context_update) {
@@ -1700,6 +1719,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     if (ret >= 0) {
         AVStream *st = s->streams[pkt->stream_index];
         int discard_padding = 0;
+        wait_stream_probe(s, st);
         if (st->first_discard_sample && pkt->pts != AV_NOPTS_VALUE) {
             int64_t pts = pkt->pts - (is_relative(pkt->pts) ? RELATIVE_TS_BASE : 0);
             int64_t sample = ts_to_samples(st, pts);
@@ -2051,6 +2071,98 @@ int av_add_index_entry(AVStream *st, int64_t pos, int64_t timestamp,
                               timestamp, size, distance, flags);
 }
 
+typedef struct SortedIndexEntry {
+    AVIndexEntry entry;
+    int seq;            ///< position in the caller's array
+    int same_pos;       ///< all entries merged into this one had the same pos
+} SortedIndexEntry;
+
+#define CMP_SORTED_ENTRY(a, b) ((a)->entry.timestamp != (b)->entry.timestamp ? \
+                                FFDIFFSIGN((a)->entry.timestamp, (b)->entry.timestamp) : \
+                                FFDIFFSIGN((a)->seq, (b)->seq))
+
+int av_add_index_entries(AVStream *st, const AVIndexEntry *entries, int nb_entries)
+{
+    SortedIndexEntry *sorted;
+    AVIndexEntry *index;
+    int i, j, w, nb_sorted = 0, nb_index = st->nb_index_entries;
+
+    if (nb_entries <= 0)
+        return 0;
+    if ((unsigned) nb_index + nb_entries >= UINT_MAX / sizeof(AVIndexEntry))
+        return AVERROR(EINVAL);
+
+    sorted = av_malloc_array(nb_entries, sizeof(*sorted));
+    if (!sorted)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < nb_entries; i++) {
+        int64_t timestamp = wrap_timestamp(st, entries[i].timestamp);
+
+        if (timestamp == AV_NOPTS_VALUE) {
+            av_free(sorted);
+            return AVERROR(EINVAL);
+        }
+        if (is_relative(timestamp))
+            timestamp -= RELATIVE_TS_BASE;
+        sorted[i].entry           = entries[i];
+        sorted[i].entry.timestamp = timestamp;
+        sorted[i].seq             = i;
+        sorted[i].same_pos        = 1;
+    }
+    AV_QSORT(sorted, nb_entries, SortedIndexEntry, CMP_SORTED_ENTRY);
+
+    /* Of several entries with the same timestamp the last one added wins,
+     * as if they had been added one by one with av_add_index_entry(). */
+    for (i = 0; i < nb_entries; i++) {
+        AVIndexEntry *ie = &sorted[i].entry;
+        if (nb_sorted && sorted[nb_sorted - 1].entry.timestamp == ie->timestamp) {
+            SortedIndexEntry *prev = &sorted[nb_sorted - 1];
+            if (prev->entry.pos == ie->pos) {
+                if (ie->min_distance < prev->entry.min_distance)
+                    ie->min_distance = prev->entry.min_distance;
+            } else
+                prev->same_pos = 0;
+            prev->entry = *ie;
+        } else
+            sorted[nb_sorted++] = sorted[i];
+    }
+
+    index = av_fast_realloc(st->index_entries, &st->index_entries_allocated_size,
+                            (nb_index + nb_sorted) * sizeof(*index));
+    if (!index) {
+        av_free(sorted);
+        return AVERROR(ENOMEM);
+    }
+    st->index_entries = index;
+
+    /* Merge from the end, so that the index can be updated in place. The
+     * new entries replace existing ones with the same timestamp. */
+    i = nb_index - 1;
+    j = nb_sorted - 1;
+    w = nb_index + nb_sorted;
+    while (j >= 0) {
+        AVIndexEntry *ie = &sorted[j].entry;
+        if (i >= 0 && index[i].timestamp > ie->timestamp) {
+            index[--w] = index[i--];
+            continue;
+        }
+        if (i >= 0 && index[i].timestamp == ie->timestamp) {
+            if (sorted[j].same_pos && index[i].pos == ie->pos &&
+                ie->min_distance < index[i].min_distance)
+                ie->min_distance = index[i].min_distance;
+            i--;
+        }
+        index[--w] = *ie;
+        j--;
+    }
+    if (w > i + 1)
+        memmove(index + i + 1, index + w, (nb_index + nb_sorted - w) * sizeof(*index));
+    st->nb_index_entries = nb_index + nb_sorted - (w - i - 1);
+
+    av_free(sorted);
+    return 0;
+}
+
 int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
                               int64_t wanted_timestamp, int flags)
 {
@@ -2165,6 +2277,31 @@ int av_index_search_timestamp(AVStream *st, int64_t wanted_timestamp, int flags)
                                      wanted_timestamp, flags);
 }
 
+int avformat_index_get_entries_count(AVStream *st)
+{
+    return st->nb_index_entries;
+}
+
+const AVIndexEntry *avformat_index_get_entry(AVStream *st, int idx)
+{
+    if (idx < 0 || idx >= st->nb_index_entries)
+        return NULL;
+
+    return &st->index_entries[idx];
+}
+
+const AVIndexEntry *avformat_index_get_entry_from_timestamp(AVStream *st,
+                                                            int64_t wanted_timestamp,
+                                                            int flags)
+{
+    int idx = av_index_search_timestamp(st, wanted_timestamp, flags);
+
+    if (idx < 0)
+        return NULL;
+
+    return &st->index_entries[idx];
+}
+
 static int64_t ff_read_timestamp(AVFormatContext *s, int stream_index, int64_t *ppos, int64_t pos_limit,
                                  int64_t (*read_timestamp)(struct AVFormatContext *, int , int64_t *, int64_t ))
 {
@@ -3044,21 +3181,13 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
     return 1;
 }
 
-/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
-static int try_decode_frame(AVFormatContext *s, AVStream *st,
-                            const AVPacket *avpkt, AVDictionary **options)
+/* returns 0 if the probing decoder of the stream is open, or a negative error */
+static int open_probe_decoder(AVFormatContext *s, AVStream *st,
+                              AVDictionary **options)
 {
     AVCodecContext *avctx = st->internal->avctx;
     const AVCodec *codec;
-    int got_picture = 1, ret = 0;
-    AVFrame *frame = av_frame_alloc();
-    AVSubtitle subtitle;
-    AVPacket pkt = *avpkt;
-    int do_skip_frame = 0;
-    enum AVDiscard skip_frame;
-
-    if (!frame)
-        return AVERROR(ENOMEM);
+    int ret;
 
     if (!avcodec_is_open(avctx) &&
         st->info->found_decoder <= 0 &&
@@ -3069,8 +3198,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
 
         if (!codec) {
             st->info->found_decoder = -st->codecpar->codec_id;
-            ret                     = -1;
-            goto fail;
+            return -1;
         }
 
         /* Force thread count to 1 since the H.264 decoder will not extract
@@ -3083,16 +3211,40 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
             av_dict_free(&thread_opt);
         if (ret < 0) {
             st->info->found_decoder = -avctx->codec_id;
-            goto fail;
+            return ret;
         }
         st->info->found_decoder = 1;
     } else if (!st->info->found_decoder)
         st->info->found_decoder = 1;
 
-    if (st->info->found_decoder < 0) {
-        ret = -1;
+    return st->info->found_decoder < 0 ? -1 : 0;
+}
+
+/* returns 1 if decoding more frames might still provide information */
+static int probe_decode_needed(AVStream *st)
+{
+    return !has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st) ||
+           (!st->codec_info_nb_frames &&
+            (st->internal->avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF));
+}
+
+/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
+static int try_decode_frame(AVFormatContext *s, AVStream *st,
+                            const AVPacket *avpkt, AVDictionary **options)
+{
+    AVCodecContext *avctx = st->internal->avctx;
+    int got_picture = 1, ret = 0;
+    AVFrame *frame = av_frame_alloc();
+    AVSubtitle subtitle;
+    AVPacket pkt = *avpkt;
+    int do_skip_frame = 0;
+    enum AVDiscard skip_frame;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    if ((ret = open_probe_decoder(s, st, options)) < 0)
         goto fail;
-    }
 
     if (avpriv_codec_get_cap_skip_frame_fill_param(avctx->codec)) {
         do_skip_frame = 1;
@@ -3101,10 +3253,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
     }
 
     while ((pkt.size > 0 || (!pkt.data && got_picture)) &&
-           ret >= 0 &&
-           (!has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st) ||
-            (!st->codec_info_nb_frames &&
-             (avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF)))) {
+           ret >= 0 && probe_decode_needed(st)) {
         got_picture = 0;
         if (avctx->codec_type == AVMEDIA_TYPE_VIDEO ||
             avctx->codec_type == AVMEDIA_TYPE_AUDIO) {
@@ -3145,6 +3294,251 @@ fail:
     return ret;
 }
 
+#if HAVE_THREADS
+/**
+ * Per-stream state of the threaded avformat_find_stream_info().
+ * While a stream has a pending job, its decoder and the AVStream fields
+ * try_decode_frame() uses belong to the worker running the job. The
+ * demuxing thread waits for the job in probe_stream_wait() before it touches
+ * the stream again, so each stream sees the same sequence of parsing and
+ * decoding as without threads.
+ */
+typedef struct ProbeStream {
+    AVStream *st;
+    AVPacket pkt;
+    int pending;  ///< a job is queued or running
+    int busy;     ///< a worker is running the job
+    int flush;    ///< the job flushes the decoder instead of decoding pkt
+    int flush_ret;
+} ProbeStream;
+
+typedef struct ProbeThreadContext {
+    AVFormatContext *ic;
+    pthread_t *threads;
+    int nb_threads;
+    ProbeStream **streams;
+    int nb_streams;
+    int next_stream;
+    int exit;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+} ProbeThreadContext;
+
+static ProbeStream *probe_next_job(ProbeThreadContext *p)
+{
+    int i;
+
+    for (i = 0; i < p->nb_streams; i++) {
+        int idx = (p->next_stream + i) % p->nb_streams;
+        ProbeStream *ps = p->streams[idx];
+        if (ps && ps->pending && !ps->busy) {
+            p->next_stream = idx + 1;
+            return ps;
+        }
+    }
+    return NULL;
+}
+
+static void *probe_worker(void *arg)
+{
+    ProbeThreadContext *p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->exit) {
+        ProbeStream *ps = probe_next_job(p);
+        int ret;
+
+        if (!ps) {
+            pthread_cond_wait(&p->work_cond, &p->lock);
+            continue;
+        }
+        ps->busy = 1;
+        pthread_mutex_unlock(&p->lock);
+
+        /* the decoder was opened by the demuxing thread, so the options
+         * are not needed here */
+        if (ps->flush) {
+            AVPacket empty_pkt = { 0 };
+            av_init_packet(&empty_pkt);
+            do {
+                ret = try_decode_frame(p->ic, ps->st, &empty_pkt, NULL);
+            } while (ret > 0 && !has_codec_parameters(ps->st, NULL));
+            ps->flush_ret = ret;
+        } else {
+            try_decode_frame(p->ic, ps->st, &ps->pkt, NULL);
+            av_packet_unref(&ps->pkt);
+            ps->st->codec_info_nb_frames++;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        ps->busy    = 0;
+        ps->pending = 0;
+        pthread_cond_broadcast(&p->done_cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void probe_stream_free(ProbeStream **pps)
+{
+    ProbeStream *ps = *pps;
+
+    if (!ps)
+        return;
+    av_packet_unref(&ps->pkt);
+    av_freep(pps);
+}
+
+static void probe_threads_free(ProbeThreadContext **pp)
+{
+    ProbeThreadContext *p = *pp;
+    int i;
+
+    if (!p)
+        return;
+    p->ic->internal->probe_threads = NULL;
+    pthread_mutex_lock(&p->lock);
+    p->exit = 1;
+    pthread_cond_broadcast(&p->work_cond);
+    pthread_mutex_unlock(&p->lock);
+    for (i = 0; i < p->nb_threads; i++)
+        pthread_join(p->threads[i], NULL);
+    for (i = 0; i < p->nb_streams; i++)
+        probe_stream_free(&p->streams[i]);
+    pthread_cond_destroy(&p->done_cond);
+    pthread_cond_destroy(&p->work_cond);
+    pthread_mutex_destroy(&p->lock);
+    av_freep(&p->streams);
+    av_freep(&p->threads);
+    av_freep(pp);
+}
+
+static ProbeThreadContext *probe_threads_alloc(AVFormatContext *ic, int nb_threads)
+{
+    ProbeThreadContext *p = av_mallocz(sizeof(*p));
+
+    if (!p)
+        return NULL;
+    p->ic      = ic;
+    p->threads = av_mallocz_array(nb_threads, sizeof(*p->threads));
+    if (!p->threads) {
+        av_free(p);
+        return NULL;
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work_cond, NULL);
+    pthread_cond_init(&p->done_cond, NULL);
+    ic->internal->probe_threads = p;
+    for (; p->nb_threads < nb_threads; p->nb_threads++)
+        if (pthread_create(&p->threads[p->nb_threads], NULL, probe_worker, p))
+            break;
+    if (!p->nb_threads) {
+        probe_threads_free(&p);
+        return NULL;
+    }
+    av_log(ic, AV_LOG_DEBUG, "Probing streams with %d threads\n", p->nb_threads);
+    return p;
+}
+
+static int probe_stream_pending(ProbeThreadContext *p, const AVStream *st)
+{
+    int pending;
+
+    pthread_mutex_lock(&p->lock);
+    pending = st->index < p->nb_streams && p->streams[st->index] &&
+              p->streams[st->index]->pending;
+    pthread_mutex_unlock(&p->lock);
+    return pending;
+}
+
+/**
+ * Wait until the job of the stream is done, or of all streams if st is NULL.
+ */
+static void probe_stream_wait(ProbeThreadContext *p, const AVStream *st)
+{
+    int i;
+
+    pthread_mutex_lock(&p->lock);
+    for (i = 0; i < p->nb_streams; i++) {
+        ProbeStream *ps = p->streams[i];
+        if (!ps || (st && st->index != i))
+            continue;
+        while (ps->pending)
+            pthread_cond_wait(&p->done_cond, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+/* wait until at least one job is done */
+static void probe_threads_wait_any(ProbeThreadContext *p)
+{
+    int i;
+
+    pthread_mutex_lock(&p->lock);
+    for (i = 0; i < p->nb_streams; i++)
+        if (p->streams[i] && p->streams[i]->pending)
+            break;
+    if (i < p->nb_streams)
+        pthread_cond_wait(&p->done_cond, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * Hand a packet of an idle stream to the workers, or a flush of its decoder
+ * if pkt is NULL. The decoder is opened here, so that the options are only
+ * used by the calling thread.
+ *
+ * @return 1 if a job was queued, 0 if no decoding is needed, or a negative
+ *         error
+ */
+static int probe_stream_queue(ProbeThreadContext *p, AVStream *st,
+                              const AVPacket *pkt, AVDictionary **options)
+{
+    ProbeStream *ps;
+    int ret = 0;
+
+    if (pkt && (open_probe_decoder(p->ic, st, options) < 0 ||
+                !probe_decode_needed(st)))
+        return 0;
+
+    pthread_mutex_lock(&p->lock);
+    if (st->index >= p->nb_streams) {
+        ProbeStream **streams = av_realloc_array(p->streams, st->index + 1,
+                                                 sizeof(*streams));
+        if (!streams) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        memset(streams + p->nb_streams, 0,
+               (st->index + 1 - p->nb_streams) * sizeof(*streams));
+        p->streams    = streams;
+        p->nb_streams = st->index + 1;
+    }
+    ps = p->streams[st->index];
+    if (!ps) {
+        ps = av_mallocz(sizeof(*ps));
+        if (!ps) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        av_init_packet(&ps->pkt);
+        p->streams[st->index] = ps;
+    }
+    av_assert1(!ps->pending);
+    ps->st    = st;
+    ps->flush = !pkt;
+    if (pkt && (ret = av_packet_ref(&ps->pkt, pkt)) < 0)
+        goto end;
+    ps->pending = 1;
+    pthread_cond_signal(&p->work_cond);
+    ret = 1;
+end:
+    pthread_mutex_unlock(&p->lock);
+    return ret;
+}
+#endif
+
 unsigned int ff_codec_get_tag(const AVCodecTag *tags, enum AVCodecID id)
 {
     while (tags->id != AV_CODEC_ID_NONE) {
@@ -3612,6 +4006,51 @@ static int add_coded_side_data(AVStream *st, AVCodecContext *avctx)
     return 0;
 }
 
+static int stream_needs_probing(AVFormatContext *ic, AVStream *st)
+{
+    int fps_analyze_framecount = 20;
+    int count;
+
+    if (!has_codec_parameters(st, NULL))
+        return 1;
+    /* If the timebase is coarse (like the usual millisecond precision
+     * of mkv), we need to analyze more frames to reliably arrive at
+     * the correct fps. */
+    if (av_q2d(st->time_base) > 0.0005)
+        fps_analyze_framecount *= 2;
+    if (!tb_unreliable(st->internal->avctx))
+        fps_analyze_framecount = 0;
+    if (ic->fps_probe_size >= 0)
+        fps_analyze_framecount = ic->fps_probe_size;
+    if (st->disposition & AV_DISPOSITION_ATTACHED_PIC)
+        fps_analyze_framecount = 0;
+    /* variable fps and no guess at the real fps */
+    count = (ic->iformat->flags & AVFMT_NOTIMESTAMPS) ?
+               st->info->codec_info_duration_fields/2 :
+               st->info->duration_count;
+    if (!(st->r_frame_rate.num && st->avg_frame_rate.num) &&
+        st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        if (count < fps_analyze_framecount)
+            return 1;
+    }
+    // Look at the first 3 frames if there is evidence of frame delay
+    // but the decoder delay is not set.
+    if (st->info->frame_delay_evidence && count < 2 && st->internal->avctx->has_b_frames == 0)
+        return 1;
+    if (!st->internal->avctx->extradata &&
+        (!st->internal->extract_extradata.inited ||
+         st->internal->extract_extradata.bsf) &&
+        extract_extradata_check(st))
+        return 1;
+    if (st->first_dts == AV_NOPTS_VALUE &&
+        !(ic->iformat->flags & AVFMT_NOTIMESTAMPS) &&
+        st->codec_info_nb_frames < ((st->disposition & AV_DISPOSITION_ATTACHED_PIC) ? 1 : ic->max_ts_probe) &&
+        (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
+         st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO))
+        return 1;
+    return 0;
+}
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
     int i, count = 0, ret = 0, j;
@@ -3629,6 +4068,10 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
     int *missing_streams = av_opt_ptr(ic->iformat->priv_class, ic->priv_data, "missing_streams");
+    int64_t start_time = av_gettime_relative();
+#if HAVE_THREADS
+    ProbeThreadContext *probe = NULL;
+#endif
 
     flush_codecs = probesize > 0;
 
@@ -3735,60 +4178,55 @@ FF_ENABLE_DEPRECATION_WARNINGS
         ic->streams[i]->info->fps_last_dts  = AV_NOPTS_VALUE;
     }
 
+#if HAVE_THREADS
+    if (ic->probe_threads != 1) {
+        int nb_threads = ic->probe_threads ? ic->probe_threads : av_cpu_count();
+        if (nb_threads > 1 && !(probe = probe_threads_alloc(ic, nb_threads)))
+            av_log(ic, AV_LOG_WARNING,
+                   "Could not start probing threads, decoding on the calling thread\n");
+    }
+#endif
+
     read_size = 0;
     for (;;) {
         const AVPacket *pkt;
         int analyzed_all_streams;
+        int decoding = 0, queued = 0;
         if (ff_check_interrupt(&ic->interrupt_callback)) {
             ret = AVERROR_EXIT;
             av_log(ic, AV_LOG_DEBUG, "interrupted\n");
             break;
         }
+        if (ic->analyze_timeout > 0 &&
+            av_gettime_relative() - start_time >= ic->analyze_timeout) {
+            ret = count;
+            av_log(ic, AV_LOG_DEBUG, "Analyze time limit of %"PRId64" microseconds reached\n",
+                   ic->analyze_timeout);
+            break;
+        }
 
         /* check if one codec still needs to be handled */
         for (i = 0; i < ic->nb_streams; i++) {
-            int fps_analyze_framecount = 20;
-            int count;
-
             st = ic->streams[i];
-            if (!has_codec_parameters(st, NULL))
-                break;
-            /* If the timebase is coarse (like the usual millisecond precision
-             * of mkv), we need to analyze more frames to reliably arrive at
-             * the correct fps. */
-            if (av_q2d(st->time_base) > 0.0005)
-                fps_analyze_framecount *= 2;
-            if (!tb_unreliable(st->internal->avctx))
-                fps_analyze_framecount = 0;
-            if (ic->fps_probe_size >= 0)
-                fps_analyze_framecount = ic->fps_probe_size;
-            if (st->disposition & AV_DISPOSITION_ATTACHED_PIC)
-                fps_analyze_framecount = 0;
-            /* variable fps and no guess at the real fps */
-            count = (ic->iformat->flags & AVFMT_NOTIMESTAMPS) ?
-                       st->info->codec_info_duration_fields/2 :
-                       st->info->duration_count;
-            if (!(st->r_frame_rate.num && st->avg_frame_rate.num) &&
-                st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-                if (count < fps_analyze_framecount)
-                    break;
+            if ((ic->flags & AVFMT_FLAG_PROBE_SELECTED) && st->discard == AVDISCARD_ALL)
+                continue;
+#if HAVE_THREADS
+            /* decoding the packet handed to the workers might be enough */
+            if (probe && probe_stream_pending(probe, st)) {
+                decoding = 1;
+                continue;
             }
-            // Look at the first 3 frames if there is evidence of frame delay
-            // but the decoder delay is not set.
-            if (st->info->frame_delay_evidence && count < 2 && st->internal->avctx->has_b_frames == 0)
-                break;
-            if (!st->internal->avctx->extradata &&
-                (!st->internal->extract_extradata.inited ||
-                 st->internal->extract_extradata.bsf) &&
-                extract_extradata_check(st))
-                break;
-            if (st->first_dts == AV_NOPTS_VALUE &&
-                !(ic->iformat->flags & AVFMT_NOTIMESTAMPS) &&
-                st->codec_info_nb_frames < ((st->disposition & AV_DISPOSITION_ATTACHED_PIC) ? 1 : ic->max_ts_probe) &&
-                (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
-                 st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO))
-                break;
+#endif
+            if (!stream_needs_probing(ic, st))
+                continue;
+            break;
         }
+#if HAVE_THREADS
+        if (i == ic->nb_streams && decoding) {
+            probe_threads_wait_any(probe);
+            continue;
+        }
+#endif
         analyzed_all_streams = 0;
         if (!missing_streams || !*missing_streams)
             if (i == ic->nb_streams) {
@@ -3951,16 +4389,36 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if ((ic->flags & AVFMT_FLAG_PROBE_SELECTED) && st->discard == AVDISCARD_ALL) {
+            /* not selected, do not spend time decoding it */
+#if HAVE_THREADS
+        } else if (probe) {
+            /* the worker counts the frame once it is decoded */
+            ret = probe_stream_queue(probe, st, pkt,
+                                     (options && st->index < orig_nb_streams) ?
+                                     &options[st->index] : NULL);
+            if (ret < 0)
+                goto unref_then_goto_end;
+            queued = ret;
+#endif
+        } else
+            try_decode_frame(ic, st, pkt,
+                             (options && st->index < orig_nb_streams) ?
+                             &options[st->index] : NULL);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(&pkt1);
 
-        st->codec_info_nb_frames++;
+        if (!queued)
+            st->codec_info_nb_frames++;
         count++;
     }
 
+#if HAVE_THREADS
+    if (probe)
+        probe_stream_wait(probe, NULL);
+#endif
+
     if (eof_reached) {
         int stream_index;
         for (stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
@@ -3992,6 +4450,24 @@ FF_ENABLE_DEPRECATION_WARNINGS
         int err = 0;
         av_init_packet(&empty_pkt);
 
+#if HAVE_THREADS
+        if (probe) {
+            for (i = 0; i < ic->nb_streams; i++) {
+                if (ic->streams[i]->info->found_decoder == 1 &&
+                    (err = probe_stream_queue(probe, ic->streams[i], NULL, NULL)) < 0)
+                    break;
+            }
+            probe_stream_wait(probe, NULL);
+            if (err < 0) {
+                ret = err;
+                goto find_stream_info_err;
+            }
+            for (i = 0; i < probe->nb_streams; i++)
+                if (probe->streams[i] && probe->streams[i]->flush_ret < 0)
+                    av_log(ic, AV_LOG_INFO,
+                           "decoding for stream %d failed\n", i);
+        } else
+#endif
         for (i = 0; i < ic->nb_streams; i++) {
 
             st = ic->streams[i];
@@ -4127,6 +4603,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
             if (ret < 0)
                 goto find_stream_info_err;
         }
+        if ((ic->flags & AVFMT_FLAG_PROBE_SELECTED) && st->discard == AVDISCARD_ALL)
+            continue;
         if (!has_codec_parameters(st, &errmsg)) {
             char buf[256];
             avcodec_string(buf, sizeof(buf), st->internal->avctx, 0);
@@ -4205,6 +4683,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
     }
 
 find_stream_info_err:
+#if HAVE_THREADS
+    probe_threads_free(&probe);
+#endif
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
         if (st->info)
@@ -87,6 +87,8 @@ static const AVOption options[]={
 {"linear_interp"        , "enable linear interpolation" , OFFSET(linear_interp)  , AV_OPT_TYPE_BOOL , {.i64=1                     }, 0      , 1         , PARAM },
 {"exact_rational"       , "enable exact rational"       , OFFSET(exact_rational) , AV_OPT_TYPE_BOOL , {.i64=1                     }, 0      , 1         , PARAM },
 {"cutoff"               , "set cutoff frequency ratio"  , OFFSET(cutoff)         , AV_OPT_TYPE_DOUBLE,{.dbl=0.                    }, 0      , 1         , PARAM },
+{"threads"              , "set number of resampling threads", OFFSET(nb_threads) , AV_OPT_TYPE_INT  , {.i64=1                     }, 0      , INT_MAX   , PARAM, "threads"},
+{"auto"                 , "automatic number of threads" , 0                      , AV_OPT_TYPE_CONST, {.i64=0                     }, INT_MIN, INT_MAX   , PARAM, "threads"},
 
 /* duplicate option in order to work with avconv */
 {"resample_cutoff"      , "set cutoff frequency ratio"  , OFFSET(cutoff)         , AV_OPT_TYPE_DOUBLE,{.dbl=0.                    }, 0      , 1         , PARAM },
@@ -27,6 +27,8 @@
  */
 
 #include "libavutil/avassert.h"
+#include "libavutil/buffer.h"
+#include "libavutil/thread.h"
 #include "resample.h"
 
 static inline double eval_poly(const double *coeff, int size, double x) {
@@ -276,17 +278,178 @@ fail:
     return ret;
 }
 
+/* Process-wide cache of filter banks, most recently used first. A filter
+ * bank is never written after it is built, so contexts with the same rates
+ * and filter parameters share one reference counted bank. */
+#define FILTER_BANK_CACHE_MAX_SIZE (16 << 20)
+
+typedef struct FilterBankKey {
+    double factor, kaiser_beta;
+    int phase_count, filter_length, filter_alloc, filter_type;
+    enum AVSampleFormat format;
+} FilterBankKey;
+
+typedef struct FilterBankEntry {
+    struct FilterBankEntry *next;
+    FilterBankKey key;
+    AVBufferRef *bank;
+} FilterBankEntry;
+
+static AVMutex filter_bank_mutex = AV_MUTEX_INITIALIZER;
+static FilterBankEntry *filter_bank_cache;
+static size_t filter_bank_cache_size;
+
+/* must be called with filter_bank_mutex held */
+static FilterBankEntry **find_filter_bank(const FilterBankKey *key)
+{
+    FilterBankEntry **e;
+
+    for (e = &filter_bank_cache; *e; e = &(*e)->next)
+        if (!memcmp(&(*e)->key, key, sizeof(*key)))
+            return e;
+    return NULL;
+}
+
+/**
+ * Get a reference to the filter bank of c with phase_count phases, from the
+ * cache or newly built.
+ */
+static int get_filter_bank(ResampleContext *c, int phase_count, AVBufferRef **bank)
+{
+    FilterBankKey key;
+    FilterBankEntry **pe, *e;
+    AVBufferRef *buf;
+    uint8_t *data;
+    int ret;
+
+    /* zeroed so that padding does not take part in the comparison */
+    memset(&key, 0, sizeof(key));
+    key.factor        = c->factor;
+    key.kaiser_beta   = c->kaiser_beta;
+    key.phase_count   = phase_count;
+    key.filter_length = c->filter_length;
+    key.filter_alloc  = c->filter_alloc;
+    key.filter_type   = c->filter_type;
+    key.format        = c->format;
+
+    ff_mutex_lock(&filter_bank_mutex);
+    if ((pe = find_filter_bank(&key))) {
+        e = *pe;
+        *pe     = e->next;
+        e->next = filter_bank_cache;
+        filter_bank_cache = e;
+        *bank = av_buffer_ref(e->bank);
+        ff_mutex_unlock(&filter_bank_mutex);
+        return *bank ? 0 : AVERROR(ENOMEM);
+    }
+    ff_mutex_unlock(&filter_bank_mutex);
+
+    if (c->filter_alloc > INT_MAX / ((phase_count + 1) * c->felem_size))
+        return AVERROR(EINVAL);
+    buf = av_buffer_allocz(c->filter_alloc * (phase_count + 1) * c->felem_size);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    data = buf->data;
+
+    ret = build_filter(c, data, c->factor, c->filter_length, c->filter_alloc,
+                       phase_count, 1 << c->filter_shift, c->filter_type, c->kaiser_beta);
+    if (ret < 0) {
+        av_buffer_unref(&buf);
+        return ret;
+    }
+    memcpy(data + (c->filter_alloc*phase_count+1)*c->felem_size, data, (c->filter_alloc-1)*c->felem_size);
+    memcpy(data + (c->filter_alloc*phase_count  )*c->felem_size, data + (c->filter_alloc - 1)*c->felem_size, c->felem_size);
+
+    *bank = buf;
+    if (buf->size > FILTER_BANK_CACHE_MAX_SIZE / 4)
+        return 0;
+
+    e = av_mallocz(sizeof(*e));
+    if (!e)
+        return 0;
+    e->key  = key;
+    e->bank = av_buffer_ref(buf);
+    if (!e->bank) {
+        av_free(e);
+        return 0;
+    }
+
+    ff_mutex_lock(&filter_bank_mutex);
+    if (find_filter_bank(&key)) {
+        /* built concurrently by another context */
+        ff_mutex_unlock(&filter_bank_mutex);
+        av_buffer_unref(&e->bank);
+        av_free(e);
+        return 0;
+    }
+    e->next = filter_bank_cache;
+    filter_bank_cache = e;
+    filter_bank_cache_size += buf->size;
+    while (filter_bank_cache_size > FILTER_BANK_CACHE_MAX_SIZE) {
+        FilterBankEntry **last = &filter_bank_cache;
+        while ((*last)->next)
+            last = &(*last)->next;
+        filter_bank_cache_size -= (*last)->bank->size;
+        av_buffer_unref(&(*last)->bank);
+        av_freep(last);
+    }
+    ff_mutex_unlock(&filter_bank_mutex);
+
+    return 0;
+}
+
 static void resample_free(ResampleContext **cc){
     ResampleContext *c = *cc;
     if(!c)
         return;
-    av_freep(&c->filter_bank);
+    avpriv_slicethread_free(&c->slicethread);
+    av_buffer_unref(&c->filter_bank_buf);
     av_freep(cc);
 }
 
+static void resample_channels(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    ResampleContext *c = priv;
+    AudioData *dst = c->job_dst, *src = c->job_src;
+    int nb_groups = (dst->ch_count + 3) >> 2;
+    /* jobs start on a multiple of 4 channels, so every channel is resampled
+     * by the same function whatever the number of jobs */
+    int ch     = 4 * (nb_groups * jobnr / nb_jobs);
+    int ch_end = FFMIN(4 * (nb_groups * (jobnr + 1) / nb_jobs), dst->ch_count);
+
+    if (c->job_linear) {
+        for (; ch < ch_end; ch++)
+            c->dsp.resample_linear(c, dst->ch[ch], src->ch[ch], c->job_size, 0);
+        return;
+    }
+
+    if (c->dsp.resample_common_x4)
+        for (; ch + 4 <= ch_end; ch += 4)
+            c->dsp.resample_common_x4(c, dst->ch + ch, src->ch + ch, c->job_size, 0);
+    for (; ch < ch_end; ch++)
+        c->dsp.resample_common(c, dst->ch[ch], src->ch[ch], c->job_size, 0);
+}
+
+/**
+ * Advance index and frac by n output samples, like resample_common() does
+ * with update_ctx set.
+ *
+ * @return number of consumed input samples
+ */
+static int advance_phase(ResampleContext *c, int n)
+{
+    int64_t frac  = c->frac + n * (int64_t)c->dst_incr_mod;
+    int64_t index = c->index + n * (int64_t)c->dst_incr_div + frac / c->src_incr;
+
+    av_assert2(c->index >= 0);
+    c->frac  = frac  % c->src_incr;
+    c->index = index % c->phase_count;
+    return index / c->phase_count;
+}
+
 static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_rate, int filter_size, int phase_shift, int linear,
                                     double cutoff0, enum AVSampleFormat format, enum SwrFilterType filter_type, double kaiser_beta,
-                                    double precision, int cheby, int exact_rational)
+                                    double precision, int cheby, int exact_rational, int nb_threads)
 {
     double cutoff = cutoff0? cutoff0 : 0.97;
     double factor= FFMIN(out_rate * cutoff / in_rate, 1.0);
@@ -310,10 +473,14 @@ static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_r
     if (!c || c->phase_count != phase_count || c->linear!=linear || c->factor != factor
            || c->filter_length != filter_length || c->format != format
            || c->filter_type != filter_type || c->kaiser_beta != kaiser_beta) {
-        resample_free(&c);
-        c = av_mallocz(sizeof(*c));
-        if (!c)
-            return NULL;
+        /* the context and its threads are kept, only the filter changes */
+        if (!c) {
+            c = av_mallocz(sizeof(*c));
+            if (!c)
+                return NULL;
+        }
+        av_buffer_unref(&c->filter_bank_buf);
+        c->filter_bank = NULL;
 
         c->format= format;
 
@@ -345,16 +512,12 @@ static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_r
         c->factor        = factor;
         c->filter_length = filter_length;
         c->filter_alloc  = FFALIGN(c->filter_length, 8);
-        c->filter_bank   = av_calloc(c->filter_alloc, (phase_count+1)*c->felem_size);
         c->filter_type   = filter_type;
         c->kaiser_beta   = kaiser_beta;
         c->phase_count_compensation = phase_count_compensation;
-        if (!c->filter_bank)
+        if (get_filter_bank(c, phase_count, &c->filter_bank_buf) < 0)
             goto error;
-        if (build_filter(c, (void*)c->filter_bank, factor, c->filter_length, c->filter_alloc, phase_count, 1<<c->filter_shift, filter_type, kaiser_beta))
-            goto error;
-        memcpy(c->filter_bank + (c->filter_alloc*phase_count+1)*c->felem_size, c->filter_bank, (c->filter_alloc-1)*c->felem_size);
-        memcpy(c->filter_bank + (c->filter_alloc*phase_count  )*c->felem_size, c->filter_bank + (c->filter_alloc - 1)*c->felem_size, c->felem_size);
+        c->filter_bank   = c->filter_bank_buf->data;
     }
 
     c->compensation_distance= 0;
@@ -373,16 +536,34 @@ static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_r
 
     swri_resample_dsp_init(c);
 
+    if (c->slicethread && c->nb_threads != nb_threads) {
+        avpriv_slicethread_free(&c->slicethread);
+        c->nb_slice_threads = 0;
+    }
+    if (!c->slicethread && nb_threads != 1) {
+        int ret = avpriv_slicethread_create(&c->slicethread, c, resample_channels,
+                                            NULL, nb_threads);
+        if (ret == AVERROR(ENOSYS)) {
+            av_log(NULL, AV_LOG_WARNING, "Threads are not supported, resampling on one thread\n");
+        } else if (ret < 0) {
+            goto error;
+        } else if (ret <= 1) {
+            avpriv_slicethread_free(&c->slicethread);
+        } else {
+            c->nb_slice_threads = ret;
+        }
+    }
+    c->nb_threads = nb_threads;
+
     return c;
 error:
-    av_freep(&c->filter_bank);
-    av_free(c);
+    resample_free(&c);
     return NULL;
 }
 
 static int rebuild_filter_bank_with_compensation(ResampleContext *c)
 {
-    uint8_t *new_filter_bank;
+    AVBufferRef *new_filter_bank;
     int new_src_incr, new_dst_incr;
     int phase_count = c->phase_count_compensation;
     int ret;
@@ -392,23 +573,14 @@ static int rebuild_filter_bank_with_compensation(ResampleContext *c)
 
     av_assert0(!c->frac && !c->dst_incr_mod);
 
-    new_filter_bank = av_calloc(c->filter_alloc, (phase_count + 1) * c->felem_size);
-    if (!new_filter_bank)
-        return AVERROR(ENOMEM);
-
-    ret = build_filter(c, new_filter_bank, c->factor, c->filter_length, c->filter_alloc,
-                       phase_count, 1 << c->filter_shift, c->filter_type, c->kaiser_beta);
-    if (ret < 0) {
-        av_freep(&new_filter_bank);
+    ret = get_filter_bank(c, phase_count, &new_filter_bank);
+    if (ret < 0)
         return ret;
-    }
-    memcpy(new_filter_bank + (c->filter_alloc*phase_count+1)*c->felem_size, new_filter_bank, (c->filter_alloc-1)*c->felem_size);
-    memcpy(new_filter_bank + (c->filter_alloc*phase_count  )*c->felem_size, new_filter_bank + (c->filter_alloc - 1)*c->felem_size, c->felem_size);
 
     if (!av_reduce(&new_src_incr, &new_dst_incr, c->src_incr,
                    c->dst_incr * (int64_t)(phase_count/c->phase_count), INT32_MAX/2))
     {
-        av_freep(&new_filter_bank);
+        av_buffer_unref(&new_filter_bank);
         return AVERROR(EINVAL);
     }
 
@@ -423,8 +595,9 @@ static int rebuild_filter_bank_with_compensation(ResampleContext *c)
     c->dst_incr_mod   = c->dst_incr % c->src_incr;
     c->index         *= phase_count / c->phase_count;
     c->phase_count    = phase_count;
-    av_freep(&c->filter_bank);
-    c->filter_bank = new_filter_bank;
+    av_buffer_unref(&c->filter_bank_buf);
+    c->filter_bank_buf = new_filter_bank;
+    c->filter_bank     = new_filter_bank->data;
     return 0;
 }
 
@@ -485,17 +658,26 @@ static int multiple_resample(ResampleContext *c, AudioData *dst, int dst_size, A
         int64_t end_index = (1LL + src_size - c->filter_length) * c->phase_count;
         int64_t delta_frac = (end_index - c->index) * c->src_incr - c->frac;
         int delta_n = (delta_frac + c->dst_incr - 1) / c->dst_incr;
-        int (*resample_func)(struct ResampleContext *c, void *dst,
-                             const void *src, int n, int update_ctx);
 
         dst_size = FFMAX(FFMIN(dst_size, delta_n), 0);
         if (dst_size > 0) {
+            int nb_jobs = 1;
+
+            c->job_dst    = dst;
+            c->job_src    = src;
+            c->job_size   = dst_size;
             /* resample_linear and resample_common should have same behavior
              * when frac and dst_incr_mod are zero */
-            resample_func = (c->linear && (c->frac || c->dst_incr_mod)) ?
-                            c->dsp.resample_linear : c->dsp.resample_common;
-            for (i = 0; i < dst->ch_count; i++)
-                *consumed = resample_func(c, dst->ch[i], src->ch[i], dst_size, i+1 == dst->ch_count);
+            c->job_linear = c->linear && (c->frac || c->dst_incr_mod);
+
+            if (c->slicethread && !need_emms)
+                nb_jobs = FFMIN(c->nb_slice_threads, (dst->ch_count + 3) >> 2);
+            if (nb_jobs > 1)
+                avpriv_slicethread_execute(c->slicethread, nb_jobs, 0);
+            else
+                resample_channels(c, 0, 0, 1, 1);
+
+            *consumed = advance_phase(c, dst_size);
         }
     }
 
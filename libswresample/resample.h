@@ -22,8 +22,10 @@
 #ifndef SWRESAMPLE_RESAMPLE_H
 #define SWRESAMPLE_RESAMPLE_H
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/slicethread.h"
 
 #include "swresample_internal.h"
 
@@ -57,7 +59,22 @@ typedef struct ResampleContext {
                                const void *src, int n, int update_ctx);
         int (*resample_linear)(struct ResampleContext *c, void *dst,
                                const void *src, int n, int update_ctx);
+        /* same as resample_common() for 4 channels at once, it must give
+         * the same output as resample_common() for each of them */
+        int (*resample_common_x4)(struct ResampleContext *c, uint8_t *const *dst,
+                                  uint8_t *const *src, int n, int update_ctx);
     } dsp;
+
+    AVBufferRef *filter_bank_buf;      /* reference to filter_bank, shared by contexts */
+
+    AVSliceThread *slicethread;
+    int nb_threads;                    /* requested number of threads, 0 for auto */
+    int nb_slice_threads;              /* number of threads of slicethread */
+
+    /* arguments of the channel jobs of the current multiple_resample() call */
+    AudioData *job_dst, *job_src;
+    int job_size;
+    int job_linear;
 } ResampleContext;
 
 void swri_resample_dsp_init(ResampleContext *c);
@@ -45,30 +45,48 @@
 
 void swri_resample_dsp_init(ResampleContext *c)
 {
+    int (*resample_common)(struct ResampleContext *c, void *dst,
+                           const void *src, int n, int update_ctx);
+    int (*resample_common_x4)(struct ResampleContext *c, uint8_t *const *dst,
+                              uint8_t *const *src, int n, int update_ctx);
+
     switch(c->format){
     case AV_SAMPLE_FMT_S16P:
         c->dsp.resample_one = resample_one_int16;
         c->dsp.resample_common = resample_common_int16;
         c->dsp.resample_linear = resample_linear_int16;
+        c->dsp.resample_common_x4 = resample_common_x4_int16;
         break;
     case AV_SAMPLE_FMT_S32P:
         c->dsp.resample_one = resample_one_int32;
         c->dsp.resample_common = resample_common_int32;
         c->dsp.resample_linear = resample_linear_int32;
+        c->dsp.resample_common_x4 = resample_common_x4_int32;
         break;
     case AV_SAMPLE_FMT_FLTP:
         c->dsp.resample_one = resample_one_float;
         c->dsp.resample_common = resample_common_float;
         c->dsp.resample_linear = resample_linear_float;
+        c->dsp.resample_common_x4 = resample_common_x4_float;
         break;
     case AV_SAMPLE_FMT_DBLP:
         c->dsp.resample_one = resample_one_double;
         c->dsp.resample_common = resample_common_double;
         c->dsp.resample_linear = resample_linear_double;
+        c->dsp.resample_common_x4 = resample_common_x4_double;
         break;
     }
 
+    resample_common    = c->dsp.resample_common;
+    resample_common_x4 = c->dsp.resample_common_x4;
+
     if (ARCH_X86) swri_resample_dsp_x86_init(c);
     else if (ARCH_ARM) swri_resample_dsp_arm_init(c);
     else if (ARCH_AARCH64) swri_resample_dsp_aarch64_init(c);
+
+    /* the C multi-channel function does not round like the SIMD
+     * single-channel ones, so the output would depend on the channel count */
+    if (c->dsp.resample_common != resample_common &&
+        c->dsp.resample_common_x4 == resample_common_x4)
+        c->dsp.resample_common_x4 = NULL;
 }
@@ -134,10 +134,81 @@ static void clear_context(SwrContext *s){
     s->flushed = 0;
 }
 
+static void get_kept_temps(SwrContext *s, AudioData *temps[SWR_NB_KEPT_TEMPS]){
+    temps[0] = &s->postin;
+    temps[1] = &s->midbuf;
+    temps[2] = &s->preout;
+    temps[3] = &s->in_buffer;
+    temps[4] = &s->silence;
+    temps[5] = &s->drop_temp;
+    temps[6] = &s->dither.temp;
+}
+
+/**
+ * Take the buffers of the temporaries so that swr_init() can give them back
+ * instead of allocating new ones. The dither noise is generated when its
+ * buffer is allocated, so it is not kept.
+ */
+static void keep_temps(SwrContext *s){
+    AudioData *temps[SWR_NB_KEPT_TEMPS];
+    int i;
+
+    get_kept_temps(s, temps);
+    for (i = 0; i < SWR_NB_KEPT_TEMPS; i++) {
+        AudioData *a = temps[i];
+        if (!a->data)
+            continue;
+        av_free(s->kept[i].data);
+        s->kept[i].data = a->data;
+        s->kept[i].size = FFALIGN(a->count*a->bps, ALIGN) * a->ch_count;
+        a->data = NULL;
+    }
+}
+
+static void reuse_kept_temps(SwrContext *s){
+    AudioData *temps[SWR_NB_KEPT_TEMPS];
+    int i, ch;
+
+    get_kept_temps(s, temps);
+    for (i = 0; i < SWR_NB_KEPT_TEMPS; i++) {
+        AudioData *a = temps[i];
+        uint8_t *data = s->kept[i].data;
+        int size = s->kept[i].size;
+        int stride, count = 0;
+
+        if (!data)
+            continue;
+        s->kept[i].data = NULL;
+
+        if (!a->data && a->bps && a->ch_count) {
+            stride = a->planar ? (size / a->ch_count) & ~(ALIGN-1) : a->bps;
+            count  = a->planar ? stride / a->bps : size / (a->bps * a->ch_count);
+        }
+        if (count <= 0) {
+            av_free(data);
+            continue;
+        }
+
+        memset(data, 0, size);
+        a->data  = data;
+        a->count = count;
+        for (ch = 0; ch < a->ch_count; ch++)
+            a->ch[ch] = data + ch * stride;
+    }
+}
+
+static void free_kept_temps(SwrContext *s){
+    int i;
+
+    for (i = 0; i < SWR_NB_KEPT_TEMPS; i++)
+        av_freep(&s->kept[i].data);
+}
+
 av_cold void swr_free(SwrContext **ss){
     SwrContext *s= *ss;
     if(s){
         clear_context(s);
+        free_kept_temps(s);
         if (s->resampler)
             s->resampler->free(&s->resample);
     }
@@ -147,12 +218,14 @@ av_cold void swr_free(SwrContext **ss){
 
 av_cold void swr_close(SwrContext *s){
     clear_context(s);
+    free_kept_temps(s);
 }
 
 av_cold int swr_init(struct SwrContext *s){
     int ret;
     char l1[1024], l2[1024];
 
+    keep_temps(s);
     clear_context(s);
 
     if(s-> in_sample_fmt >= AV_SAMPLE_FMT_NB){
@@ -272,7 +345,7 @@ av_cold int swr_init(struct SwrContext *s){
     }
 
     if (s->out_sample_rate!=s->in_sample_rate || (s->flags & SWR_FLAG_RESAMPLE)){
-        s->resample = s->resampler->init(s->resample, s->out_sample_rate, s->in_sample_rate, s->filter_size, s->phase_shift, s->linear_interp, s->cutoff, s->int_sample_fmt, s->filter_type, s->kaiser_beta, s->precision, s->cheby, s->exact_rational);
+        s->resample = s->resampler->init(s->resample, s->out_sample_rate, s->in_sample_rate, s->filter_size, s->phase_shift, s->linear_interp, s->cutoff, s->int_sample_fmt, s->filter_type, s->kaiser_beta, s->precision, s->cheby, s->exact_rational, s->nb_threads);
         if (!s->resample) {
             av_log(s, AV_LOG_ERROR, "Failed to initialize resampler\n");
             return AVERROR(ENOMEM);
@@ -338,6 +411,7 @@ av_assert0(s->out.ch_count);
     if(!s->resample && !s->rematrix && !s->channel_map && !s->dither.method){
         s->full_convert = swri_audio_convert_alloc(s->out_sample_fmt,
                                                    s-> in_sample_fmt, s-> in.ch_count, NULL, 0);
+        reuse_kept_temps(s);
         return 0;
     }
 
@@ -390,6 +464,7 @@ av_assert0(s->out.ch_count);
             goto fail;
     }
 
+    reuse_kept_temps(s);
     return 0;
 fail:
     swr_close(s);
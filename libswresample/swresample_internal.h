@@ -42,6 +42,8 @@ typedef void (mix_2_1_func_type)(void *out, const void *in1, const void *in2, vo
 
 typedef void (mix_any_func_type)(uint8_t **out, const uint8_t **in1, void *coeffp, integer len);
 
+#define SWR_NB_KEPT_TEMPS 7
+
 typedef struct AudioData{
     uint8_t *ch[SWR_CH_MAX];    ///< samples buffer per channel
     uint8_t *data;              ///< samples buffer
@@ -69,7 +71,8 @@ struct DitherContext {
 };
 
 typedef struct ResampleContext * (* resample_init_func)(struct ResampleContext *c, int out_rate, int in_rate, int filter_size, int phase_shift, int linear,
-                                    double cutoff, enum AVSampleFormat format, enum SwrFilterType filter_type, double kaiser_beta, double precision, int cheby, int exact_rational);
+                                    double cutoff, enum AVSampleFormat format, enum SwrFilterType filter_type, double kaiser_beta, double precision, int cheby, int exact_rational,
+                                    int nb_threads);
 typedef void    (* resample_free_func)(struct ResampleContext **c);
 typedef int     (* multiple_resample_func)(struct ResampleContext *c, AudioData *dst, int dst_size, AudioData *src, int src_size, int *consumed);
 typedef int     (* resample_flush_func)(struct SwrContext *c);
@@ -133,6 +136,7 @@ struct SwrContext {
     double kaiser_beta;                                /**< swr beta value for Kaiser window (only applicable if filter_type == AV_FILTER_TYPE_KAISER) */
     double precision;                               /**< soxr resampling precision (in bits) */
     int cheby;                                      /**< soxr: if 1 then passband rolloff will be none (Chebyshev) & irrational ratio approximation precision will be higher */
+    int nb_threads;                                 ///< number of threads the channels are resampled on
 
     float min_compensation;                         ///< swr minimum below which no compensation will happen
     float min_hard_compensation;                    ///< swr minimum below which no silence inject / sample drop will happen
@@ -153,6 +157,10 @@ struct SwrContext {
     AudioData in_buffer;                            ///< cached audio data (convert and resample purpose)
     AudioData silence;                              ///< temporary with silence
     AudioData drop_temp;                            ///< temporary used to discard output
+    struct {
+        uint8_t *data;
+        int size;
+    } kept[SWR_NB_KEPT_TEMPS];                      ///< buffers of the temporaries kept by swr_init() for reuse
     int in_buffer_index;                            ///< cached buffer position
     int in_buffer_count;                            ///< cached buffer length
     int resample_in_constraint;                     ///< 1 if the input end was reach before the output end, 0 otherwise
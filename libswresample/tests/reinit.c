@@ -0,0 +1,158 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Checks that reinitialized contexts share filter banks and keep their
+ * buffers, and produce the same output as fresh contexts.
+ * Run with -bench to print the latency of swr_init().
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/channel_layout.h"
+#include "libavutil/lfg.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+
+#include "libswresample/swresample.h"
+#include "libswresample/swresample_internal.h"
+#include "libswresample/resample.h"
+
+#define IN_RATE   48000
+#define SAMPLES   4096
+#define CHANNELS  2
+#define OUT_SIZE  (SAMPLES * 2)
+
+static int16_t in[SAMPLES * CHANNELS];
+static int16_t out_ref[OUT_SIZE * CHANNELS];
+static int16_t out_new[OUT_SIZE * CHANNELS];
+
+static SwrContext *alloc_context(int out_rate)
+{
+    SwrContext *s = swr_alloc_set_opts(NULL,
+                                       AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_S16, out_rate,
+                                       AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_S16, IN_RATE,
+                                       0, NULL);
+    if (s && swr_init(s) < 0)
+        swr_free(&s);
+    return s;
+}
+
+static int reinit(SwrContext *s, int out_rate)
+{
+    av_opt_set_int(s, "osr", out_rate, 0);
+    return swr_init(s);
+}
+
+static int convert(SwrContext *s, int16_t *out)
+{
+    const uint8_t *src = (const uint8_t *)in;
+    uint8_t *dst = (uint8_t *)out;
+    int ret = swr_convert(s, &dst, OUT_SIZE, &src, SAMPLES);
+    int flushed;
+
+    if (ret < 0)
+        return ret;
+    dst = (uint8_t *)(out + ret * CHANNELS);
+    flushed = swr_convert(s, &dst, OUT_SIZE - ret, NULL, 0);
+    return flushed < 0 ? flushed : ret + flushed;
+}
+
+static int count_temps(SwrContext *s, uint8_t *data[SWR_NB_KEPT_TEMPS])
+{
+    const AudioData *temps[SWR_NB_KEPT_TEMPS] = {
+        &s->postin, &s->midbuf, &s->preout, &s->in_buffer,
+        &s->silence, &s->drop_temp, &s->dither.temp,
+    };
+    int i, n = 0;
+
+    for (i = 0; i < SWR_NB_KEPT_TEMPS; i++) {
+        data[i] = temps[i]->data;
+        n += !!data[i];
+    }
+    return n;
+}
+
+static void bench(SwrContext *s)
+{
+    static const int rates[] = { 44100, 32000 };
+    int64_t t;
+    int i, runs = 1000;
+
+    t = av_gettime_relative();
+    for (i = 0; i < runs; i++)
+        reinit(s, rates[i & 1]);
+    t = av_gettime_relative() - t;
+    printf("swr_init() alternating 44100/32000 Hz: %.1f us\n", (double)t / runs);
+
+    t = av_gettime_relative();
+    for (i = 0; i < runs; i++)
+        reinit(s, rates[0]);
+    t = av_gettime_relative() - t;
+    printf("swr_init() unchanged: %.1f us\n", (double)t / runs);
+}
+
+int main(int argc, char **argv)
+{
+    SwrContext *a = NULL, *b = NULL;
+    uint8_t *data[SWR_NB_KEPT_TEMPS], *data2[SWR_NB_KEPT_TEMPS];
+    int i, n, reused, ref_count, new_count, ret = 1;
+    AVLFG rand;
+
+    av_lfg_init(&rand, 1);
+    for (i = 0; i < SAMPLES * CHANNELS; i++)
+        in[i] = av_lfg_get(&rand) >> 17;
+
+    a = alloc_context(44100);
+    b = alloc_context(44100);
+    if (!a || !b)
+        goto end;
+    printf("same rates share the filter bank: %s\n",
+           a->resample->filter_bank == b->resample->filter_bank ? "yes" : "no");
+
+    if ((ref_count = convert(a, out_ref)) < 0)
+        goto end;
+    n = count_temps(a, data);
+
+    if (reinit(a, 32000) < 0 || convert(a, out_new) < 0 ||
+        reinit(a, 44100) < 0)
+        goto end;
+    printf("reinit shares the filter bank: %s\n",
+           a->resample->filter_bank == b->resample->filter_bank ? "yes" : "no");
+
+    if ((new_count = convert(a, out_new)) < 0)
+        goto end;
+    count_temps(a, data2);
+    for (i = reused = 0; i < SWR_NB_KEPT_TEMPS; i++)
+        reused += data[i] && data[i] == data2[i];
+    printf("buffers kept over reinit: %d of %d\n", reused, n);
+
+    printf("output after reinit matches: %s\n",
+           ref_count == new_count &&
+           !memcmp(out_ref, out_new, ref_count * CHANNELS * sizeof(*out_ref)) ? "yes" : "no");
+
+    if (argc > 1 && !strcmp(argv[1], "-bench"))
+        bench(a);
+
+    ret = 0;
+end:
+    swr_free(&a);
+    swr_free(&b);
+    return ret;
+}
@@ -0,0 +1,316 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scaling of one source image to several destinations
+ */
+
+#include "libavutil/avassert.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "swscale.h"
+#include "swscale_internal.h"
+
+typedef struct SwsMultiOutput {
+    SwsContext *sws;
+    int w, h;
+    enum AVPixelFormat format;
+    int src;                    ///< output scaled from, -1 for the source
+} SwsMultiOutput;
+
+struct SwsMultiContext {
+    int srcW, srcH;
+    enum AVPixelFormat srcFormat;
+
+    /* shared input conversion, done once per source image */
+    SwsContext *unpack;
+    enum AVPixelFormat midFormat;
+    uint8_t *mid[4];
+    int midStride[4];
+
+    SwsMultiOutput *outputs;
+    int *order;                 ///< outputs sorted by decreasing size
+    int nb_outputs;
+};
+
+static int max_depth(const AVPixFmtDescriptor *desc)
+{
+    int i, depth = 0;
+    for (i = 0; i < desc->nb_components; i++)
+        depth = FFMAX(depth, desc->comp[i].depth);
+    return depth;
+}
+
+/**
+ * Find the planar format the source is converted to before it is scaled
+ * to the destinations, or AV_PIX_FMT_NONE if the destinations are better
+ * scaled from the source directly.
+ *
+ * The intermediate keeps the depth of the source and the chroma resolution
+ * of the most detailed destination and has the colour family of the
+ * destinations, so the destination scalers only resample planes and no
+ * colour conversion or unpacking is repeated for each of them.
+ */
+static enum AVPixelFormat shared_input_format(enum AVPixelFormat srcFormat,
+                                              const enum AVPixelFormat *dstFormat,
+                                              int nb_dst)
+{
+    const AVPixFmtDescriptor *src = av_pix_fmt_desc_get(srcFormat);
+    const AVPixFmtDescriptor *desc = NULL;
+    enum AVPixelFormat best = AV_PIX_FMT_NONE;
+    int best_depth = INT_MAX, depth = max_depth(src);
+    int rgb = isAnyRGB(dstFormat[0]), alpha = 0;
+    int chr_w = INT_MAX, chr_h = INT_MAX;
+    int i;
+
+    if (src->nb_components < 3 ||
+        (src->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BAYER |
+                       AV_PIX_FMT_FLAG_FLOAT | AV_PIX_FMT_FLAG_HWACCEL)))
+        return AV_PIX_FMT_NONE;
+
+    for (i = 0; i < nb_dst; i++) {
+        const AVPixFmtDescriptor *d = av_pix_fmt_desc_get(dstFormat[i]);
+        if (!!isAnyRGB(dstFormat[i]) != rgb || d->nb_components < 3 ||
+            (d->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BAYER)))
+            return AV_PIX_FMT_NONE;
+        alpha |= !!(d->flags & AV_PIX_FMT_FLAG_ALPHA);
+        chr_w  = FFMIN(chr_w, d->log2_chroma_w);
+        chr_h  = FFMIN(chr_h, d->log2_chroma_h);
+    }
+    alpha &= !!(src->flags & AV_PIX_FMT_FLAG_ALPHA);
+
+    if (rgb) {
+        chr_w = chr_h = 0;
+    } else if (!isAnyRGB(srcFormat)) {
+        chr_w = FFMAX(chr_w, src->log2_chroma_w);
+        chr_h = FFMAX(chr_h, src->log2_chroma_h);
+    }
+
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat fmt = av_pix_fmt_desc_get_id(desc);
+        int d = desc->comp[0].depth;
+
+        if (!(desc->flags & AV_PIX_FMT_FLAG_PLANAR) ||
+            (desc->flags & (AV_PIX_FMT_FLAG_BE | AV_PIX_FMT_FLAG_FLOAT |
+                            AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL)) ||
+            !!(desc->flags & AV_PIX_FMT_FLAG_RGB)   != rgb ||
+            !!(desc->flags & AV_PIX_FMT_FLAG_ALPHA) != alpha ||
+            desc->nb_components != 3 + alpha ||
+            desc->log2_chroma_w != chr_w || desc->log2_chroma_h != chr_h ||
+            desc->comp[1].plane == desc->comp[2].plane ||
+            desc->comp[0].shift || desc->comp[0].step != (d + 7 >> 3) ||
+            max_depth(desc) != d ||
+            d < depth || d >= best_depth ||
+            !sws_isSupportedInput(fmt) || !sws_isSupportedOutput(fmt))
+            continue;
+
+        best       = fmt;
+        best_depth = d;
+    }
+
+    if (best == srcFormat)
+        return AV_PIX_FMT_NONE;
+
+    return best;
+}
+
+void sws_multi_freeContext(struct SwsMultiContext *c)
+{
+    int i;
+
+    if (!c)
+        return;
+
+    for (i = 0; i < c->nb_outputs; i++)
+        sws_freeContext(c->outputs[i].sws);
+    sws_freeContext(c->unpack);
+    av_freep(&c->mid[0]);
+    av_freep(&c->outputs);
+    av_freep(&c->order);
+    av_free(c);
+}
+
+static SwsContext *alloc_scaler(int srcW, int srcH, enum AVPixelFormat srcFormat,
+                                int dstW, int dstH, enum AVPixelFormat dstFormat,
+                                int flags, const double *param, int nb_threads)
+{
+    SwsContext *sws = sws_alloc_set_opts(srcW, srcH, srcFormat,
+                                         dstW, dstH, dstFormat, flags, param);
+    if (!sws)
+        return NULL;
+
+    av_opt_set_int(sws, "threads", nb_threads, 0);
+    if (sws_init_context(sws, NULL, NULL) < 0) {
+        sws_freeContext(sws);
+        return NULL;
+    }
+    return sws;
+}
+
+struct SwsMultiContext *sws_multi_getContext(int srcW, int srcH, enum AVPixelFormat srcFormat,
+                                             int nb_dst, const int *dstW, const int *dstH,
+                                             const enum AVPixelFormat *dstFormat,
+                                             int flags, const double *param,
+                                             int nb_threads, int multi_flags)
+{
+    struct SwsMultiContext *c;
+    enum AVPixelFormat *direct = NULL;
+    int i, j, nb_direct = 0;
+
+    if (nb_dst <= 0 || !sws_isSupportedInput(srcFormat))
+        return NULL;
+    for (i = 0; i < nb_dst; i++)
+        if (!sws_isSupportedOutput(dstFormat[i]))
+            return NULL;
+
+    c = av_mallocz(sizeof(*c));
+    if (!c)
+        return NULL;
+
+    c->srcW       = srcW;
+    c->srcH       = srcH;
+    c->srcFormat  = srcFormat;
+    c->nb_outputs = nb_dst;
+    c->outputs    = av_mallocz_array(nb_dst, sizeof(*c->outputs));
+    c->order      = av_malloc_array(nb_dst, sizeof(*c->order));
+    direct        = av_malloc_array(nb_dst, sizeof(*direct));
+    if (!c->outputs || !c->order || !direct)
+        goto fail;
+
+    /* stable sort by decreasing area, so a destination always comes after
+     * every destination it may be scaled from */
+    for (i = 0; i < nb_dst; i++) {
+        int64_t area = (int64_t)dstW[i] * dstH[i];
+        for (j = i; j > 0; j--) {
+            int k = c->order[j - 1];
+            if ((int64_t)dstW[k] * dstH[k] >= area)
+                break;
+            c->order[j] = k;
+        }
+        c->order[j] = i;
+    }
+
+    for (i = 0; i < nb_dst; i++) {
+        SwsMultiOutput *out = &c->outputs[c->order[i]];
+
+        out->w      = dstW[c->order[i]];
+        out->h      = dstH[c->order[i]];
+        out->format = dstFormat[c->order[i]];
+        out->src    = -1;
+
+        /* the smallest larger destination of the same format is the
+         * cheapest image this one can be derived from */
+        if (multi_flags & SWS_MULTI_CASCADE) {
+            for (j = i - 1; j >= 0; j--) {
+                const SwsMultiOutput *prev = &c->outputs[c->order[j]];
+                if (prev->format == out->format &&
+                    prev->w >= out->w && prev->h >= out->h) {
+                    out->src = c->order[j];
+                    break;
+                }
+            }
+        }
+        if (out->src < 0)
+            direct[nb_direct++] = out->format;
+    }
+
+    /* converting the source only pays off when it is read more than once */
+    c->midFormat = nb_direct > 1 ? shared_input_format(srcFormat, direct, nb_direct)
+                                 : AV_PIX_FMT_NONE;
+    if (c->midFormat != AV_PIX_FMT_NONE) {
+        c->unpack = alloc_scaler(srcW, srcH, srcFormat, srcW, srcH, c->midFormat,
+                                 flags, param, nb_threads);
+        if (!c->unpack ||
+            av_image_alloc(c->mid, c->midStride, srcW, srcH, c->midFormat, 64) < 0)
+            goto fail;
+    }
+
+    for (i = 0; i < nb_dst; i++) {
+        SwsMultiOutput *out = &c->outputs[i];
+
+        if (out->src >= 0) {
+            const SwsMultiOutput *prev = &c->outputs[out->src];
+            out->sws = alloc_scaler(prev->w, prev->h, prev->format,
+                                    out->w, out->h, out->format,
+                                    flags, param, nb_threads);
+        } else {
+            out->sws = alloc_scaler(srcW, srcH, c->unpack ? c->midFormat : srcFormat,
+                                    out->w, out->h, out->format,
+                                    flags, param, nb_threads);
+        }
+        if (!out->sws)
+            goto fail;
+    }
+
+    av_free(direct);
+    return c;
+fail:
+    av_free(direct);
+    sws_multi_freeContext(c);
+    return NULL;
+}
+
+int sws_multi_scale(struct SwsMultiContext *c,
+                    const uint8_t *const src[], const int srcStride[],
+                    uint8_t *const dst[][4], const int dstStride[][4])
+{
+    const uint8_t *const *in = src;
+    const int *in_stride     = srcStride;
+    int i, ret;
+
+    if (c->unpack) {
+        ret = sws_scale(c->unpack, src, srcStride, 0, c->srcH,
+                        c->mid, c->midStride);
+        if (ret < 0)
+            return ret;
+        in        = (const uint8_t *const *)c->mid;
+        in_stride = c->midStride;
+    }
+
+    for (i = 0; i < c->nb_outputs; i++) {
+        int idx = c->order[i];
+        const SwsMultiOutput *out = &c->outputs[idx];
+
+        if (out->src >= 0)
+            ret = sws_scale(out->sws, (const uint8_t *const *)dst[out->src],
+                            dstStride[out->src], 0, c->outputs[out->src].h,
+                            dst[idx], dstStride[idx]);
+        else
+            ret = sws_scale(out->sws, in, in_stride, 0, c->srcH,
+                            dst[idx], dstStride[idx]);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+int sws_multi_get_source(struct SwsMultiContext *c, int idx)
+{
+    av_assert0(idx >= 0 && idx < c->nb_outputs);
+    return c->outputs[idx].src;
+}
+
+enum AVPixelFormat sws_multi_get_shared_format(struct SwsMultiContext *c)
+{
+    return c->midFormat;
+}
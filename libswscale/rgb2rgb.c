@@ -91,6 +91,13 @@ void (*interleaveBytes)(const uint8_t *src1, const uint8_t *src2, uint8_t *dst,
 void (*deinterleaveBytes)(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
                           int width, int height, int srcStride,
                           int dst1Stride, int dst2Stride);
+void (*deinterleaveWords)(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                          int width, int height, int srcStride,
+                          int dst1Stride, int dst2Stride, int shift);
+void (*shiftWords)(const uint8_t *src, uint8_t *dst, int width, int height,
+                   int srcStride, int dstStride, int shift);
+void (*gbr24ptopacked24)(const uint8_t *const src[], const int srcStride[],
+                         uint8_t *dst, int dstStride, int height, int width);
 void (*vu9_to_vu12)(const uint8_t *src1, const uint8_t *src2,
                     uint8_t *dst1, uint8_t *dst2,
                     int width, int height,
@@ -142,6 +142,27 @@ extern void (*deinterleaveBytes)(const uint8_t *src, uint8_t *dst1, uint8_t *dst
                                  int width, int height, int srcStride,
                                  int dst1Stride, int dst2Stride);
 
+/**
+ * Split interleaved native endian 16-bit pairs into two planes and shift
+ * them right by shift bits. Width is in pairs, strides are in bytes.
+ */
+extern void (*deinterleaveWords)(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                                 int width, int height, int srcStride,
+                                 int dst1Stride, int dst2Stride, int shift);
+
+/**
+ * Shift native endian 16-bit samples right by shift bits.
+ * Width is in samples, strides are in bytes.
+ */
+extern void (*shiftWords)(const uint8_t *src, uint8_t *dst, int width, int height,
+                          int srcStride, int dstStride, int shift);
+
+/**
+ * Pack three 8-bit planes into 24-bit pixels, src[0] going to the first byte.
+ */
+extern void (*gbr24ptopacked24)(const uint8_t *const src[], const int srcStride[],
+                                uint8_t *dst, int dstStride, int height, int width);
+
 extern void (*vu9_to_vu12)(const uint8_t *src1, const uint8_t *src2,
                            uint8_t *dst1, uint8_t *dst2,
                            int width, int height,
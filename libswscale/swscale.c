@@ -234,14 +234,20 @@ static void lumRangeFromJpeg16_c(int16_t *_dst, int width)
     if (DEBUG_SWSCALE_BUFFERS)                  \
         av_log(c, AV_LOG_DEBUG, __VA_ARGS__)
 
-static int swscale(SwsContext *c, const uint8_t *src[],
-                   int srcStride[], int srcSliceY,
-                   int srcSliceH, uint8_t *dst[], int dstStride[])
+/**
+ * Scale the output lines dstSliceY to dstSliceY + dstSliceH - 1 that can be
+ * computed from the given source slice.
+ */
+static int swscale_lines(SwsContext *c, const uint8_t *src[],
+                         int srcStride[], int srcSliceY, int srcSliceH,
+                         uint8_t *dst[], int dstStride[],
+                         int dstSliceY, int dstSliceH)
 {
     /* load a few things into local vars to make the code more readable?
      * and faster */
     const int dstW                   = c->dstW;
     const int dstH                   = c->dstH;
+    const int dstSliceEnd            = dstSliceY + dstSliceH;
 
     const enum AVPixelFormat dstFormat = c->dstFormat;
     const int flags                  = c->flags;
@@ -334,7 +340,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
      * will not get executed. This is not really intended but works
      * currently, so people might do it. */
     if (srcSliceY == 0) {
-        dstY         = 0;
+        dstY         = dstSliceY;
         lastInLumBuf = -1;
         lastInChrBuf = -1;
     }
@@ -366,7 +372,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         hout_slice->width = dstW;
     }
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < dstSliceEnd; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
         int use_mmx_vfilter= c->use_mmx_vfilter;
 
@@ -523,6 +529,84 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     return dstY - lastDstY;
 }
 
+static int swscale(SwsContext *c, const uint8_t *src[],
+                   int srcStride[], int srcSliceY,
+                   int srcSliceH, uint8_t *dst[], int dstStride[])
+{
+    return swscale_lines(c, src, srcStride, srcSliceY, srcSliceH,
+                         dst, dstStride, 0, c->dstH);
+}
+
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads)
+{
+    SwsContext *parent = priv;
+    SwsContext *c      = parent->slice_ctx[threadnr];
+    /* keep the bands aligned on the chroma lines */
+    const int align    = 1 << c->chrDstVSubSample;
+    const int start    = c->dstH * (int64_t) jobnr      / nb_jobs & ~(align - 1);
+    const int end      = jobnr + 1 == nb_jobs ? c->dstH :
+                         c->dstH * (int64_t)(jobnr + 1) / nb_jobs & ~(align - 1);
+    const uint8_t *src[4];
+    uint8_t *dst[4];
+    int srcStride[4], dstStride[4];
+
+    if (start >= end)
+        return;
+
+    /* swscale_lines() modifies the pointer and stride arrays */
+    memcpy(src,       parent->slice_src,       sizeof(src));
+    memcpy(srcStride, parent->slice_srcStride, sizeof(srcStride));
+    memcpy(dst,       parent->slice_dst,       sizeof(dst));
+    memcpy(dstStride, parent->slice_dstStride, sizeof(dstStride));
+
+    swscale_lines(c, src, srcStride, 0, c->srcH, dst, dstStride,
+                  start, end - start);
+}
+
+/**
+ * Check that the SIMD output functions, which may write up to 16 pixels
+ * past the end of a line, cannot reach the first line of the next band.
+ */
+static int slice_dst_has_slack(SwsContext *c, const int dstStride[])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->dstFormat);
+    int linesizes[4], i;
+
+    if (av_image_fill_linesizes(linesizes, c->dstFormat,
+                                FFALIGN(c->dstW, 16 << desc->log2_chroma_w)) < 0)
+        return 0;
+    for (i = 0; i < 4; i++)
+        if (FFABS(dstStride[i]) < linesizes[i])
+            return 0;
+    return 1;
+}
+
+/**
+ * Scale a whole frame with the slice threads, each thread computing a band
+ * of output lines.
+ */
+static int swscale_threaded(SwsContext *c, const uint8_t *src[], int srcStride[],
+                            uint8_t *dst[], int dstStride[])
+{
+    int i;
+
+    for (i = 0; i < c->nb_slice_ctx && usePal(c->srcFormat); i++) {
+        memcpy(c->slice_ctx[i]->pal_yuv, c->pal_yuv, sizeof(c->pal_yuv));
+        memcpy(c->slice_ctx[i]->pal_rgb, c->pal_rgb, sizeof(c->pal_rgb));
+    }
+
+    memcpy(c->slice_src,       src,       sizeof(c->slice_src));
+    memcpy(c->slice_srcStride, srcStride, sizeof(c->slice_srcStride));
+    memcpy(c->slice_dst,       dst,       sizeof(c->slice_dst));
+    memcpy(c->slice_dstStride, dstStride, sizeof(c->slice_dstStride));
+
+    avpriv_slicethread_execute(c->slicethread, c->nb_slice_ctx, 0);
+
+    c->dstY = c->dstH;
+    return c->dstH;
+}
+
 av_cold void ff_sws_init_range_convert(SwsContext *c)
 {
     c->lumConvertRange = NULL;
@@ -810,6 +894,48 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
         return ret;
     }
 
+    if (c->cascaded_context[0]) {
+        /* Sliced input: the intermediate lines are passed on to the second
+         * step as soon as a whole chroma line of them is complete. */
+        SwsContext *c1 = c->cascaded_context[1];
+        int tmpH = c->cascaded_context[0]->dstH, end;
+        const uint8_t *tmp[4];
+
+        if (srcSliceY == 0) {
+            c->cascaded_tmpH = c->cascaded_tmpY = 0;
+        } else if (srcSliceY != c->cascaded_srcY) {
+            av_log(c, AV_LOG_ERROR, "Slices of a cascaded scaler must be passed top to bottom\n");
+            return AVERROR(EINVAL);
+        }
+
+        ret = sws_scale(c->cascaded_context[0],
+                        srcSlice, srcStride, srcSliceY, srcSliceH,
+                        c->cascaded_tmp, c->cascaded_tmpStride);
+        if (ret < 0)
+            return ret;
+        c->cascaded_srcY  = srcSliceY + srcSliceH;
+        c->cascaded_tmpH += ret;
+
+        end = c->cascaded_tmpH;
+        if (end < tmpH)
+            end &= ~((1 << c1->chrSrcVSubSample) - 1);
+        if (end <= c->cascaded_tmpY)
+            return 0;
+
+        for (i = 0; i < 4; i++) {
+            int y = i == 1 || i == 2 ? c->cascaded_tmpY >> c1->chrSrcVSubSample
+                                     : c->cascaded_tmpY;
+            tmp[i] = c->cascaded_tmp[i] ? c->cascaded_tmp[i] + y * c->cascaded_tmpStride[i]
+                                        : NULL;
+        }
+        ret = sws_scale(c1, tmp, c->cascaded_tmpStride,
+                        c->cascaded_tmpY, end - c->cascaded_tmpY,
+                        dst, dstStride);
+        if (ret >= 0)
+            c->cascaded_tmpY = end;
+        return ret;
+    }
+
     memcpy(src2, srcSlice, sizeof(src2));
     memcpy(dst2, dst, sizeof(dst2));
 
@@ -966,7 +1092,12 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     /* reset slice direction at end of frame */
     if (srcSliceY_internal + srcSliceH == c->srcH)
         c->sliceDir = 0;
-    ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+    if (c->slicethread && c->swscale == swscale &&
+        srcSliceY_internal == 0 && srcSliceH == c->srcH &&
+        slice_dst_has_slack(c, dstStride2))
+        ret = swscale_threaded(c, src2, srcStride2, dst2, dstStride2);
+    else
+        ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
 
     if (c->dstXYZ && !(c->srcXYZ && c->srcW==c->dstW && c->srcH==c->dstH)) {
         int dstY = c->dstY ? c->dstY : srcSliceY + srcSliceH;
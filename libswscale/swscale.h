@@ -297,6 +297,82 @@ struct SwsContext *sws_getCachedContext(struct SwsContext *context,
                                         int flags, SwsFilter *srcFilter,
                                         SwsFilter *dstFilter, const double *param);
 
+/**
+ * Get the statistics of the process-wide cache of scaler filter
+ * coefficients.
+ *
+ * sws_init_context() takes the filters of a context from this cache when
+ * another context used the same sizes, formats, flags and parameters
+ * before, instead of computing them again. Contexts using custom
+ * SwsFilter vectors do not use the cache.
+ *
+ * @param hits   if not NULL, set to the number of filters taken from the cache
+ * @param misses if not NULL, set to the number of filters computed
+ */
+void sws_get_filter_cache_stats(uint64_t *hits, uint64_t *misses);
+
+struct SwsMultiContext;
+
+/**
+ * Scale every destination from the smallest larger destination of the same
+ * format instead of from the source.
+ */
+#define SWS_MULTI_CASCADE 1
+
+/**
+ * Allocate and return a context scaling one source image to several
+ * destinations, e.g. the renditions of an adaptive streaming ladder.
+ *
+ * Packed and semi-planar sources, and sources of another colour family
+ * than the destinations, are converted once per image to a planar format
+ * at the source resolution; the destinations are then only resampled from
+ * that image.
+ *
+ * @param nb_dst      the number of destinations
+ * @param dstW        the widths of the nb_dst destinations
+ * @param dstH        the heights of the nb_dst destinations
+ * @param dstFormat   the formats of the nb_dst destinations
+ * @param flags       scaler flags, as for sws_getContext()
+ * @param param       extra scaler parameters, as for sws_getContext()
+ * @param nb_threads  the threads option of the underlying scalers
+ * @param multi_flags a combination of SWS_MULTI_* flags
+ * @return a pointer to an allocated context, or NULL in case of error
+ */
+struct SwsMultiContext *sws_multi_getContext(int srcW, int srcH, enum AVPixelFormat srcFormat,
+                                             int nb_dst, const int *dstW, const int *dstH,
+                                             const enum AVPixelFormat *dstFormat,
+                                             int flags, const double *param,
+                                             int nb_threads, int multi_flags);
+
+/**
+ * Free a context allocated with sws_multi_getContext().
+ * If c is NULL, then does nothing.
+ */
+void sws_multi_freeContext(struct SwsMultiContext *c);
+
+/**
+ * Scale a whole source image to all the destinations of c.
+ *
+ * @param dst       the planes of each destination image
+ * @param dstStride the strides of each destination image
+ * @return zero on success, a negative value on error
+ */
+int sws_multi_scale(struct SwsMultiContext *c,
+                    const uint8_t *const src[], const int srcStride[],
+                    uint8_t *const dst[][4], const int dstStride[][4]);
+
+/**
+ * @return the index of the destination that destination idx is scaled from,
+ *         or -1 if it is scaled from the source
+ */
+int sws_multi_get_source(struct SwsMultiContext *c, int idx);
+
+/**
+ * @return the format the source is converted to once per image, or
+ *         AV_PIX_FMT_NONE if the destinations are scaled from the source
+ */
+enum AVPixelFormat sws_multi_get_shared_format(struct SwsMultiContext *c);
+
 /**
  * Convert an 8-bit paletted frame into a frame with a color depth of 32 bits.
  *
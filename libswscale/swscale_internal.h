@@ -31,6 +31,7 @@
 #include "libavutil/log.h"
 #include "libavutil/pixfmt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/ppc/util_altivec.h"
 
 #define STR(s) AV_TOSTRING(s) // AV_STRINGIFY is too long
@@ -320,6 +321,22 @@ typedef struct SwsContext {
     int cascaded1_tmpStride[4];
     uint8_t *cascaded1_tmp[4];
     int cascaded_mainindex;
+    int cascaded_srcY;            ///< First source line expected by the next slice of a cascade.
+    int cascaded_tmpH;            ///< Lines of cascaded_tmp written by the first step so far.
+    int cascaded_tmpY;            ///< Lines of cascaded_tmp passed on to the second step so far.
+
+    /* The slice_* fields split the output lines of a frame into bands that
+     * are scaled in parallel, each by its own context with its own ring
+     * buffers, reading the whole source frame.
+     */
+    int nb_threads;                  ///< Number of scaling threads, 0 for automatic.
+    AVSliceThread *slicethread;
+    struct SwsContext **slice_ctx;
+    int nb_slice_ctx;
+    const uint8_t *slice_src[4];     ///< Source of the frame being scaled by the threads.
+    int slice_srcStride[4];
+    uint8_t *slice_dst[4];           ///< Destination of the frame being scaled by the threads.
+    int slice_dstStride[4];
 
     double gamma_value;
     int gamma_flag;
@@ -862,6 +879,13 @@ void ff_get_unscaled_swscale_aarch64(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+/**
+ * Slice thread function scaling one band of output lines of the frame
+ * set up in the slice_* fields of the SwsContext passed as priv.
+ */
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads);
+
 void ff_sws_init_input_funcs(SwsContext *c);
 void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2planar1_fn *yuv2plane1,
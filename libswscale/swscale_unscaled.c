@@ -221,6 +221,29 @@ static int nv24ToPlanarWrapper(SwsContext *c, const uint8_t *src[],
     return srcSliceH;
 }
 
+static int p01xToPlanarWrapper(SwsContext *c, const uint8_t *src[],
+                               int srcStride[], int srcSliceY,
+                               int srcSliceH, uint8_t *dstParam[],
+                               int dstStride[])
+{
+    const AVPixFmtDescriptor *src_format = av_pix_fmt_desc_get(c->srcFormat);
+    uint8_t *dstY = dstParam[0] + dstStride[0] * srcSliceY;
+    uint8_t *dst1 = dstParam[1] + dstStride[1] * srcSliceY / 2;
+    uint8_t *dst2 = dstParam[2] + dstStride[2] * srcSliceY / 2;
+    /* P01x keeps its samples in the high bits */
+    int shift = src_format->comp[0].shift;
+
+    av_assert0(!(srcStride[0] % 2 || srcStride[1] % 2 ||
+                 dstStride[0] % 2 || dstStride[1] % 2 || dstStride[2] % 2));
+
+    shiftWords(src[0], dstY, c->srcW, srcSliceH,
+               srcStride[0], dstStride[0], shift);
+    deinterleaveWords(src[1], dst1, dst2, c->chrSrcW, (srcSliceH + 1) / 2,
+                      srcStride[1], dstStride[1], dstStride[2], shift);
+
+    return srcSliceH;
+}
+
 static int planarToP01xWrapper(SwsContext *c, const uint8_t *src8[],
                                int srcStride[], int srcSliceY,
                                int srcSliceH, uint8_t *dstParam8[],
@@ -938,24 +961,6 @@ static int planarRgb16ToRgb16Wrapper(SwsContext *c, const uint8_t *src[],
     return srcSliceH;
 }
 
-static void gbr24ptopacked24(const uint8_t *src[], int srcStride[],
-                             uint8_t *dst, int dstStride, int srcSliceH,
-                             int width)
-{
-    int x, h, i;
-    for (h = 0; h < srcSliceH; h++) {
-        uint8_t *dest = dst + dstStride * h;
-        for (x = 0; x < width; x++) {
-            *dest++ = src[0][x];
-            *dest++ = src[1][x];
-            *dest++ = src[2][x];
-        }
-
-        for (i = 0; i < 3; i++)
-            src[i] += srcStride[i];
-    }
-}
-
 static void gbr24ptopacked32(const uint8_t *src[], int srcStride[],
                              uint8_t *dst, int dstStride, int srcSliceH,
                              int alpha_first, int width)
@@ -1924,6 +1929,17 @@ static int planarCopyWrapper(SwsContext *c, const uint8_t *src[],
      (src_fmt == pix_fmt ## LE && dst_fmt == pix_fmt ## BE))
 
 
+/*
+ * Pairs that are common in capture, hwdownload and export chains and whose
+ * converters are built on rgb2rgb kernels:
+ *   NV12/NV21 <-> YUV420P(A), NV24/NV42 <-> YUV444P(A)  interleaveBytes,
+ *                                                        deinterleaveBytes
+ *   P010 -> YUV420P10, P016 -> YUV420P16                 shiftWords,
+ *                                                        deinterleaveWords
+ *   GBRP(A) -> RGB24/BGR24                               gbr24ptopacked24
+ * Only interleaveBytes and deinterleaveBytes have x86 versions, the others
+ * are plain C.
+ */
 void ff_get_unscaled_swscale(SwsContext *c)
 {
     const enum AVPixelFormat srcFormat = c->srcFormat;
@@ -1956,6 +1972,11 @@ void ff_get_unscaled_swscale(SwsContext *c)
         (srcFormat == AV_PIX_FMT_NV24 || srcFormat == AV_PIX_FMT_NV42)) {
         c->swscale = nv24ToPlanarWrapper;
     }
+    /* p01x_to_yuv420p1x */
+    if ((srcFormat == AV_PIX_FMT_P010 && dstFormat == AV_PIX_FMT_YUV420P10) ||
+        (srcFormat == AV_PIX_FMT_P016 && dstFormat == AV_PIX_FMT_YUV420P16)) {
+        c->swscale = p01xToPlanarWrapper;
+    }
     /* yuv2bgr */
     if ((srcFormat == AV_PIX_FMT_YUV420P || srcFormat == AV_PIX_FMT_YUV422P ||
          srcFormat == AV_PIX_FMT_YUVA420P) && isAnyRGB(dstFormat) &&
@@ -0,0 +1,152 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Checks that cascaded scalers (large downscales) accept sliced input
+ * and produce the same output as when they are given whole frames.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+#include "libswscale/swscale_internal.h"
+
+#define SRC_W 960
+#define SRC_H 542
+
+static int scale_slices(struct SwsContext *sws, enum AVPixelFormat fmt,
+                        uint8_t *const src[4], const int src_stride[4],
+                        int slice_h, uint8_t *dst[4], const int dst_stride[4])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+    int y, i, ret, lines = 0;
+
+    for (y = 0; y < SRC_H; y += slice_h) {
+        const uint8_t *slice[4];
+        int h = FFMIN(slice_h, SRC_H - y);
+
+        for (i = 0; i < 4; i++) {
+            int sub = i == 1 || i == 2 ? desc->log2_chroma_h : 0;
+            slice[i] = src[i] ? src[i] + (y >> sub) * src_stride[i] : NULL;
+        }
+        ret = sws_scale(sws, slice, src_stride, y, h, dst, dst_stride);
+        if (ret < 0)
+            return ret;
+        lines += ret;
+    }
+    return lines;
+}
+
+static int same_image(enum AVPixelFormat fmt, int w, int h,
+                      uint8_t *const a[4], const int a_stride[4],
+                      uint8_t *const b[4], const int b_stride[4])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+    int i, y;
+
+    for (i = 0; i < 4 && a[i]; i++) {
+        int bytes = av_image_get_linesize(fmt, w, i);
+        int ph = i == 1 || i == 2 ? AV_CEIL_RSHIFT(h, desc->log2_chroma_h) : h;
+        for (y = 0; y < ph; y++)
+            if (memcmp(a[i] + y * a_stride[i], b[i] + y * b_stride[i], bytes))
+                return 0;
+    }
+    return 1;
+}
+
+static int test(enum AVPixelFormat fmt, int dst_w, int dst_h, int flags,
+                const char *flags_name, uint8_t *const src[4], const int src_stride[4])
+{
+    static const int slice_heights[] = { 2, 16, 64, 100 };
+    uint8_t *ref[4] = { NULL }, *dst[4] = { NULL };
+    int ref_stride[4], dst_stride[4];
+    struct SwsContext *sws = NULL;
+    int i, size, ret = -1;
+
+    size = av_image_alloc(ref, ref_stride, dst_w, dst_h, fmt, 16);
+    if (size < 0 || av_image_alloc(dst, dst_stride, dst_w, dst_h, fmt, 16) < 0)
+        goto end;
+
+    sws = sws_getContext(SRC_W, SRC_H, fmt, dst_w, dst_h, fmt,
+                         flags, NULL, NULL, NULL);
+    if (!sws || sws_scale(sws, (const uint8_t * const *)src, src_stride,
+                          0, SRC_H, ref, ref_stride) != dst_h)
+        goto end;
+
+    printf("%s %dx%d %s cascaded %s:", av_get_pix_fmt_name(fmt), dst_w, dst_h,
+           flags_name, sws->cascaded_context[0] ? "yes" : "no");
+    for (i = 0; i < FF_ARRAY_ELEMS(slice_heights); i++) {
+        int lines;
+
+        memset(dst[0], 0, size);
+        lines = scale_slices(sws, fmt, src, src_stride, slice_heights[i],
+                             dst, dst_stride);
+        printf(" %d:%s", slice_heights[i],
+               lines == dst_h && same_image(fmt, dst_w, dst_h, ref, ref_stride,
+                                            dst, dst_stride) ? "ok" : "differs");
+    }
+    printf("\n");
+    ret = 0;
+end:
+    sws_freeContext(sws);
+    av_freep(&ref[0]);
+    av_freep(&dst[0]);
+    return ret;
+}
+
+int main(void)
+{
+    static const struct {
+        enum AVPixelFormat fmt;
+        int w, h;
+        int flags;
+        const char *name;
+    } tests[] = {
+        { AV_PIX_FMT_YUV420P,   16,  8, SWS_LANCZOS | SWS_ACCURATE_RND | SWS_BITEXACT, "lanczos"   },
+        { AV_PIX_FMT_YUV420P,   16, 10, SWS_BICUBIC | SWS_ACCURATE_RND,                "bicubic"   },
+        { AV_PIX_FMT_YUV422P10, 24, 12, SWS_BICUBIC | SWS_ACCURATE_RND | SWS_BITEXACT, "bicubic"   },
+        { AV_PIX_FMT_YUV444P,    8,  6, SWS_LANCZOS,                                   "lanczos"   },
+        { AV_PIX_FMT_YUV420P,  480, 270, SWS_BILINEAR,                                 "bilinear"  },
+    };
+    uint8_t *src[4];
+    int src_stride[4], i, size, ret = 0;
+    AVLFG rand;
+
+    av_lfg_init(&rand, 1);
+    for (i = 0; i < FF_ARRAY_ELEMS(tests) && !ret; i++) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(tests[i].fmt);
+        int j;
+
+        size = av_image_alloc(src, src_stride, SRC_W, SRC_H, tests[i].fmt, 16);
+        if (size < 0)
+            return 1;
+        /* keep high bit depth samples in range */
+        for (j = 0; j < size; j++)
+            src[0][j] = av_lfg_get(&rand) >> (desc->comp[0].depth > 8 && (j & 1) ? 30 : 24);
+        ret = test(tests[i].fmt, tests[i].w, tests[i].h, tests[i].flags,
+                   tests[i].name, src, src_stride);
+        av_freep(&src[0]);
+    }
+
+    return ret ? 1 : 0;
+}
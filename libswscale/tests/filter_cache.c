@@ -0,0 +1,137 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libswscale/swscale.h"
+
+#define SRC_W 352
+#define SRC_H 288
+
+static uint64_t last_hits, last_misses;
+
+static void print_stats(const char *what)
+{
+    uint64_t hits, misses;
+
+    sws_get_filter_cache_stats(&hits, &misses);
+    printf("%-24s hits %"PRIu64" misses %"PRIu64"\n", what,
+           hits - last_hits, misses - last_misses);
+    last_hits   = hits;
+    last_misses = misses;
+}
+
+static int scale(struct SwsContext *sws, uint8_t *const src[4], const int src_stride[4],
+                 uint8_t *dst[4], int dst_stride[4], int dst_w, int dst_h)
+{
+    int ret = av_image_alloc(dst, dst_stride, dst_w, dst_h, AV_PIX_FMT_YUV420P, 16);
+    if (ret < 0)
+        return ret;
+    return sws_scale(sws, (const uint8_t *const *)src, src_stride, 0, SRC_H,
+                     dst, dst_stride);
+}
+
+static int same_image(uint8_t *const a[4], const int a_stride[4],
+                      uint8_t *const b[4], const int b_stride[4], int w, int h)
+{
+    int i, y;
+
+    for (i = 0; i < 3; i++) {
+        int pw = i ? w >> 1 : w, ph = i ? h >> 1 : h;
+        for (y = 0; y < ph; y++)
+            if (memcmp(a[i] + y * a_stride[i], b[i] + y * b_stride[i], pw))
+                return 0;
+    }
+    return 1;
+}
+
+int main(void)
+{
+    static const int sizes[][2] = { { 176, 144 }, { 640, 360 } };
+    static const int flags[] = { SWS_BICUBIC, SWS_LANCZOS };
+    uint8_t *src[4], *ref[4] = { NULL }, *dst[4] = { NULL };
+    int src_stride[4], ref_stride[4], dst_stride[4];
+    struct SwsContext *sws = NULL;
+    SwsFilter *filter;
+    AVLFG rand;
+    int i, j, ret = 1;
+
+    if (av_image_alloc(src, src_stride, SRC_W, SRC_H, AV_PIX_FMT_YUV420P, 16) < 0)
+        return 1;
+    av_lfg_init(&rand, 1);
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < src_stride[i] * (i ? SRC_H / 2 : SRC_H); j++)
+            src[i][j] = av_lfg_get(&rand);
+
+    print_stats("start");
+
+    for (i = 0; i < FF_ARRAY_ELEMS(flags); i++) {
+        for (j = 0; j < FF_ARRAY_ELEMS(sizes); j++) {
+            int w = sizes[j][0], h = sizes[j][1];
+
+            sws = sws_getContext(SRC_W, SRC_H, AV_PIX_FMT_YUV420P,
+                                 w, h, AV_PIX_FMT_YUV420P,
+                                 flags[i] | SWS_BITEXACT, NULL, NULL, NULL);
+            if (!sws || scale(sws, src, src_stride, ref, ref_stride, w, h) < 0)
+                goto end;
+            sws_freeContext(sws);
+            sws = NULL;
+            print_stats("new configuration");
+
+            sws = sws_getContext(SRC_W, SRC_H, AV_PIX_FMT_YUV420P,
+                                 w, h, AV_PIX_FMT_YUV420P,
+                                 flags[i] | SWS_BITEXACT, NULL, NULL, NULL);
+            if (!sws || scale(sws, src, src_stride, dst, dst_stride, w, h) < 0)
+                goto end;
+            sws_freeContext(sws);
+            sws = NULL;
+            print_stats("same configuration");
+
+            if (!same_image(ref, ref_stride, dst, dst_stride, w, h)) {
+                printf("output of cached filters differs\n");
+                goto end;
+            }
+            av_freep(&ref[0]);
+            av_freep(&dst[0]);
+        }
+    }
+
+    filter = sws_getDefaultFilter(1.0, 0, 0, 0, 0, 0, 0);
+    if (!filter)
+        goto end;
+    sws = sws_getContext(SRC_W, SRC_H, AV_PIX_FMT_YUV420P,
+                         176, 144, AV_PIX_FMT_YUV420P,
+                         SWS_BICUBIC | SWS_BITEXACT, filter, NULL, NULL);
+    sws_freeFilter(filter);
+    if (!sws)
+        goto end;
+    print_stats("custom filter");
+
+    ret = 0;
+end:
+    sws_freeContext(sws);
+    av_freep(&ref[0]);
+    av_freep(&dst[0]);
+    av_freep(&src[0]);
+    return ret;
+}
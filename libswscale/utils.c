@@ -49,6 +49,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 #include "libavutil/aarch64/cpu.h"
 #include "libavutil/ppc/cpu.h"
 #include "libavutil/x86/asm.h"
@@ -333,12 +334,12 @@ static const ScaleAlgorithm scale_algorithms[] = {
     { SWS_X,             "experimental",                    8 },
 };
 
-static av_cold int initFilter(int16_t **outFilter, int32_t **filterPos,
-                              int *outFilterSize, int xInc, int srcW,
-                              int dstW, int filterAlign, int one,
-                              int flags, int cpu_flags,
-                              SwsVector *srcFilter, SwsVector *dstFilter,
-                              double param[2], int srcPos, int dstPos)
+static av_cold int computeFilter(int16_t **outFilter, int32_t **filterPos,
+                                 int *outFilterSize, int xInc, int srcW,
+                                 int dstW, int filterAlign, int one,
+                                 int flags, int cpu_flags,
+                                 SwsVector *srcFilter, SwsVector *dstFilter,
+                                 double param[2], int srcPos, int dstPos)
 {
     int i;
     int filterSize;
@@ -730,6 +731,161 @@ fail:
     return ret;
 }
 
+/* Process-wide cache of the filters computed by computeFilter(), most
+ * recently used first. Contexts created for the same sizes, formats and
+ * flags share all their filters, so creating them again only costs a copy. */
+#define FILTER_CACHE_MAX_SIZE (8 << 20)
+
+typedef struct FilterCacheKey {
+    int xInc, srcW, dstW, filterAlign, one, flags, cpu_flags;
+    int srcPos, dstPos;
+    double param[2];
+} FilterCacheKey;
+
+typedef struct FilterCacheEntry {
+    struct FilterCacheEntry *next;
+    FilterCacheKey key;
+    int16_t *filter;
+    int32_t *filterPos;
+    int filterSize;
+    size_t size;
+} FilterCacheEntry;
+
+static AVMutex filter_cache_mutex = AV_MUTEX_INITIALIZER;
+static FilterCacheEntry *filter_cache;
+static size_t filter_cache_size;
+static uint64_t filter_cache_hits, filter_cache_misses;
+
+static void free_filter_cache_entry(FilterCacheEntry *e)
+{
+    av_free(e->filter);
+    av_free(e->filterPos);
+    av_free(e);
+}
+
+/* must be called with filter_cache_mutex held */
+static FilterCacheEntry **find_filter_cache_entry(const FilterCacheKey *key)
+{
+    FilterCacheEntry **e;
+
+    for (e = &filter_cache; *e; e = &(*e)->next)
+        if (!memcmp(&(*e)->key, key, sizeof(*key)))
+            return e;
+    return NULL;
+}
+
+static av_cold int initFilter(int16_t **outFilter, int32_t **filterPos,
+                              int *outFilterSize, int xInc, int srcW,
+                              int dstW, int filterAlign, int one,
+                              int flags, int cpu_flags,
+                              SwsVector *srcFilter, SwsVector *dstFilter,
+                              double param[2], int srcPos, int dstPos)
+{
+    FilterCacheKey key;
+    FilterCacheEntry **pe, *e;
+    size_t pos_size, filter_size;
+    int ret;
+
+    if (srcFilter || dstFilter)
+        return computeFilter(outFilter, filterPos, outFilterSize, xInc, srcW,
+                             dstW, filterAlign, one, flags, cpu_flags,
+                             srcFilter, dstFilter, param, srcPos, dstPos);
+
+    /* zeroed so that padding does not take part in the comparison */
+    memset(&key, 0, sizeof(key));
+    key.xInc        = xInc;
+    key.srcW        = srcW;
+    key.dstW        = dstW;
+    key.filterAlign = filterAlign;
+    key.one         = one;
+    key.flags       = flags;
+    key.cpu_flags   = cpu_flags;
+    key.srcPos      = srcPos;
+    key.dstPos      = dstPos;
+    key.param[0]    = param[0];
+    key.param[1]    = param[1];
+
+    pos_size = (dstW + 7) * sizeof(**filterPos);
+
+    ff_mutex_lock(&filter_cache_mutex);
+    if ((pe = find_filter_cache_entry(&key))) {
+        e = *pe;
+        *pe     = e->next;
+        e->next = filter_cache;
+        filter_cache = e;
+
+        *outFilterSize = e->filterSize;
+        *filterPos     = av_memdup(e->filterPos, pos_size);
+        *outFilter     = av_memdup(e->filter, e->size - pos_size);
+        filter_cache_hits++;
+        ff_mutex_unlock(&filter_cache_mutex);
+
+        if (!*filterPos || !*outFilter) {
+            av_freep(filterPos);
+            av_freep(outFilter);
+            return AVERROR(ENOMEM);
+        }
+        return 0;
+    }
+    filter_cache_misses++;
+    ff_mutex_unlock(&filter_cache_mutex);
+
+    ret = computeFilter(outFilter, filterPos, outFilterSize, xInc, srcW,
+                        dstW, filterAlign, one, flags, cpu_flags,
+                        NULL, NULL, param, srcPos, dstPos);
+    if (ret < 0)
+        return ret;
+
+    filter_size = (dstW + 7) * *outFilterSize * sizeof(**outFilter);
+    if (pos_size + filter_size > FILTER_CACHE_MAX_SIZE / 4)
+        return ret;
+
+    e = av_mallocz(sizeof(*e));
+    if (!e)
+        return ret;
+    e->key        = key;
+    e->filterSize = *outFilterSize;
+    e->size       = pos_size + filter_size;
+    e->filterPos  = av_memdup(*filterPos, pos_size);
+    e->filter     = av_memdup(*outFilter, filter_size);
+    if (!e->filterPos || !e->filter) {
+        free_filter_cache_entry(e);
+        return ret;
+    }
+
+    ff_mutex_lock(&filter_cache_mutex);
+    if (find_filter_cache_entry(&key)) {
+        /* computed concurrently by another context */
+        ff_mutex_unlock(&filter_cache_mutex);
+        free_filter_cache_entry(e);
+        return ret;
+    }
+    e->next      = filter_cache;
+    filter_cache = e;
+    filter_cache_size += e->size;
+    while (filter_cache_size > FILTER_CACHE_MAX_SIZE) {
+        FilterCacheEntry **last = &filter_cache;
+        while ((*last)->next)
+            last = &(*last)->next;
+        filter_cache_size -= (*last)->size;
+        free_filter_cache_entry(*last);
+        *last = NULL;
+    }
+    ff_mutex_unlock(&filter_cache_mutex);
+
+    return ret;
+}
+
+void sws_get_filter_cache_stats(uint64_t *hits, uint64_t *misses)
+{
+    ff_mutex_lock(&filter_cache_mutex);
+    if (hits)
+        *hits = filter_cache_hits;
+    if (misses)
+        *misses = filter_cache_misses;
+    ff_mutex_unlock(&filter_cache_mutex);
+}
+
 static void fill_rgb2yuv_table(SwsContext *c, const int table[4], int dstRange)
 {
     int64_t W, V, Z, Cy, Cu, Cv;
@@ -860,6 +1016,17 @@ static void fill_xyztables(struct SwsContext *c)
     }
 }
 
+static void free_slice_threads(SwsContext *c)
+{
+    int i;
+
+    avpriv_slicethread_free(&c->slicethread);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    c->nb_slice_ctx = 0;
+}
+
 int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
                              int srcRange, const int table[4], int dstRange,
                              int brightness, int contrast, int saturation)
@@ -867,6 +1034,7 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
     int need_reinit = 0;
+    int i;
 
     handle_formats(c);
     desc_dst = av_pix_fmt_desc_get(c->dstFormat);
@@ -906,6 +1074,10 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     c->dstFormatBpp = av_get_bits_per_pixel(desc_dst);
     c->srcFormatBpp = av_get_bits_per_pixel(desc_src);
 
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_setColorspaceDetails(c->slice_ctx[i], inv_table, srcRange, table,
+                                 dstRange, brightness, contrast, saturation);
+
     if (c->cascaded_context[c->cascaded_mainindex])
         return sws_setColorspaceDetails(c->cascaded_context[c->cascaded_mainindex],inv_table, srcRange,table, dstRange, brightness,  contrast, saturation);
 
@@ -975,6 +1147,8 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
             sws_setColorspaceDetails(c->cascaded_context[1], inv_table,
                                      srcRange, table, dstRange,
                                      0, 1 << 16, 1 << 16);
+            /* the cascade is not threaded */
+            free_slice_threads(c);
             return 0;
         }
         return -1;
@@ -1167,6 +1341,64 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
+static av_cold int init_slice_threads(SwsContext *c, SwsFilter *srcFilter,
+                                      SwsFilter *dstFilter)
+{
+    int i, ret, nb_threads;
+
+    if (c->nb_threads == 1 || c->dither == SWS_DITHER_ED)
+        return 0;
+
+    nb_threads = avpriv_slicethread_create(&c->slicethread, c, ff_sws_slice_worker,
+                                           NULL, c->nb_threads);
+    if (nb_threads == AVERROR(ENOSYS)) {
+        av_log(c, AV_LOG_WARNING, "Slice threading is not supported, scaling on one thread\n");
+        return 0;
+    }
+    if (nb_threads <= 1) {
+        avpriv_slicethread_free(&c->slicethread);
+        return FFMIN(nb_threads, 0);
+    }
+
+    c->slice_ctx = av_mallocz_array(nb_threads, sizeof(*c->slice_ctx));
+    if (!c->slice_ctx) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (i = 0; i < nb_threads; i++) {
+        SwsContext *slice = sws_alloc_context();
+
+        if (!slice) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        c->slice_ctx[c->nb_slice_ctx++] = slice;
+
+        if ((ret = av_opt_copy(slice, c)) < 0)
+            goto fail;
+        slice->nb_threads = 1;
+        slice->flags     &= ~SWS_PRINT_INFO;
+
+        if ((ret = sws_init_context(slice, srcFilter, dstFilter)) < 0)
+            goto fail;
+        sws_setColorspaceDetails(slice, c->srcColorspaceTable, c->srcRange,
+                                 c->dstColorspaceTable, c->dstRange,
+                                 c->brightness, c->contrast, c->saturation);
+        if (slice->swscale != c->swscale) {
+            ret = AVERROR_BUG;
+            goto fail;
+        }
+    }
+
+    av_log(c, AV_LOG_VERBOSE, "Scaling with %d threads\n", nb_threads);
+    return 0;
+
+fail:
+    free_slice_threads(c);
+    return ret;
+}
+
 av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                              SwsFilter *dstFilter)
 {
@@ -1837,7 +2069,9 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
     }
 
     c->swscale = ff_getSwsFunc(c);
-    return ff_init_filters(c);
+    if ((ret = ff_init_filters(c)) < 0)
+        return ret;
+    return init_slice_threads(c, srcFilter, dstFilter);
 fail: // FIXME replace things by appropriate error codes
     if (ret == RETCODE_USE_CASCADE)  {
         int tmpW = sqrt(srcW * (int64_t)dstW);
@@ -2322,6 +2556,8 @@ void sws_freeContext(SwsContext *c)
     if (!c)
         return;
 
+    free_slice_threads(c);
+
     for (i = 0; i < 4; i++)
         av_freep(&c->dither_error[i]);
 
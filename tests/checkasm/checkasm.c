@@ -180,6 +180,12 @@ static const struct {
     #if CONFIG_THRESHOLD_FILTER
         { "vf_threshold", checkasm_check_vf_threshold },
     #endif
+    #if CONFIG_TRANSPOSE_FILTER
+        { "vf_transpose", checkasm_check_vf_transpose },
+    #endif
+#endif
+#if CONFIG_SWRESAMPLE
+    { "sw_resample", checkasm_check_sw_resample },
 #endif
 #if CONFIG_SWSCALE
     { "sw_rgb", checkasm_check_sw_rgb },
@@ -0,0 +1,151 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <float.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/samplefmt.h"
+
+#include "libswresample/resample.h"
+
+#include "checkasm.h"
+
+#define DST_LEN 64
+/* enough input for DST_LEN outputs, the filter and the SIMD overread */
+#define SRC_LEN (DST_LEN * 2 + 64)
+
+static void randomize_buffer(uint8_t *buf, enum AVSampleFormat fmt)
+{
+    int i;
+
+    for (i = 0; i < SRC_LEN; i++) {
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16P:
+            ((int16_t *)buf)[i] = rnd();
+            break;
+        case AV_SAMPLE_FMT_S32P:
+            ((int32_t *)buf)[i] = rnd();
+            break;
+        case AV_SAMPLE_FMT_FLTP:
+            ((float *)buf)[i] = (int32_t)rnd() / (float)INT32_MAX;
+            break;
+        case AV_SAMPLE_FMT_DBLP:
+            ((double *)buf)[i] = (int32_t)rnd() / (double)INT32_MAX;
+            break;
+        }
+    }
+}
+
+static int compare_buffers(const uint8_t *a, const uint8_t *b, enum AVSampleFormat fmt)
+{
+    switch (fmt) {
+    case AV_SAMPLE_FMT_FLTP:
+        return !float_near_abs_eps_array((const float *)a, (const float *)b,
+                                         FLT_EPSILON * 16, DST_LEN);
+    case AV_SAMPLE_FMT_DBLP:
+        return !double_near_abs_eps_array((const double *)a, (const double *)b,
+                                          DBL_EPSILON * 16, DST_LEN);
+    default:
+        return memcmp(a, b, DST_LEN * av_get_bytes_per_sample(fmt));
+    }
+}
+
+static void check_resample(enum AVSampleFormat fmt, int linear)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,  [SRC_LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [DST_LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [DST_LEN * 8]);
+    const char *name = av_get_sample_fmt_name(fmt);
+    ResampleContext *c;
+    int index, frac;
+
+    /* 48 kHz to 44.1 kHz with a filter length that is not a multiple of 8 */
+    c = swri_resampler.init(NULL, 44100, 48000, 16, 10, linear, 0, fmt,
+                            SWR_FILTER_TYPE_KAISER, 9, 0, 0, 1, 1);
+    if (!c) {
+        fail();
+        return;
+    }
+    index = rnd() % c->phase_count;
+    frac  = rnd() % c->src_incr;
+
+    randomize_buffer(src, fmt);
+
+#define RESET_PHASE() do { c->index = index; c->frac = frac; } while (0)
+
+    if (linear) {
+        declare_func(int, ResampleContext *c, void *dst, const void *src,
+                     int n, int update_ctx);
+
+        if (check_func(c->dsp.resample_linear, "resample_linear_%s", name)) {
+            int ref, new, ref_index, ref_frac;
+
+            RESET_PHASE();
+            ref = call_ref(c, dst0, src, DST_LEN, 1);
+            ref_index = c->index;
+            ref_frac  = c->frac;
+            RESET_PHASE();
+            new = call_new(c, dst1, src, DST_LEN, 1);
+            if (ref != new || ref_index != c->index || ref_frac != c->frac ||
+                compare_buffers(dst0, dst1, fmt))
+                fail();
+            RESET_PHASE();
+            bench_new(c, dst1, src, DST_LEN, 0);
+        }
+    } else {
+        declare_func(int, ResampleContext *c, void *dst, const void *src,
+                     int n, int update_ctx);
+
+        if (check_func(c->dsp.resample_common, "resample_common_%s", name)) {
+            int ref, new, ref_index, ref_frac;
+
+            RESET_PHASE();
+            ref = call_ref(c, dst0, src, DST_LEN, 1);
+            ref_index = c->index;
+            ref_frac  = c->frac;
+            RESET_PHASE();
+            new = call_new(c, dst1, src, DST_LEN, 1);
+            if (ref != new || ref_index != c->index || ref_frac != c->frac ||
+                compare_buffers(dst0, dst1, fmt))
+                fail();
+            RESET_PHASE();
+            bench_new(c, dst1, src, DST_LEN, 0);
+        }
+    }
+
+    swri_resampler.free(&c);
+}
+
+void checkasm_check_sw_resample(void)
+{
+    static const enum AVSampleFormat formats[] = {
+        AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32P,
+        AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_DBLP,
+    };
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(formats); i++)
+        check_resample(formats[i], 0);
+    report("resample_common");
+
+    for (i = 0; i < FF_ARRAY_ELEMS(formats); i++)
+        check_resample(formats[i], 1);
+    report("resample_linear");
+}
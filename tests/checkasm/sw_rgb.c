@@ -179,6 +179,46 @@ static void check_interleave_bytes(void)
     }
 }
 
+static void check_deinterleave_bytes(void)
+{
+    LOCAL_ALIGNED_16(uint8_t, src_buf,  [2*MAX_STRIDE*MAX_HEIGHT+2]);
+    LOCAL_ALIGNED_16(uint8_t, dst0_buf, [2*MAX_STRIDE*MAX_HEIGHT+1]);
+    LOCAL_ALIGNED_16(uint8_t, dst1_buf, [2*MAX_STRIDE*MAX_HEIGHT+1]);
+    uint8_t *src  = src_buf + 2;
+    uint8_t *dst0 = dst0_buf + 1;
+    uint8_t *dst1 = dst1_buf + 1;
+    uint8_t *dst0_u = dst0, *dst0_v = dst0 + MAX_STRIDE * MAX_HEIGHT;
+    uint8_t *dst1_u = dst1, *dst1_v = dst1 + MAX_STRIDE * MAX_HEIGHT;
+
+    declare_func_emms(AV_CPU_FLAG_MMX, void, const uint8_t *src, uint8_t *dst1,
+                      uint8_t *dst2, int width, int height, int srcStride,
+                      int dst1Stride, int dst2Stride);
+
+    randomize_buffers(src, 2 * MAX_STRIDE * MAX_HEIGHT);
+
+    if (check_func(deinterleaveBytes, "deinterleave_bytes")) {
+        for (int i = 0; i <= 16; i++) {
+            // Try widths 1-8 and 33-40, and one random width.
+            int w = i > 0 ? i + (i > 8 ? 24 : 0) : 1 + (rnd() % (MAX_STRIDE-2));
+            int h = 1 + (rnd() % (MAX_HEIGHT-2));
+
+            memset(dst0, 0, 2 * MAX_STRIDE * MAX_HEIGHT);
+            memset(dst1, 0, 2 * MAX_STRIDE * MAX_HEIGHT);
+
+            call_ref(src, dst0_u, dst0_v, w, h, 2 * MAX_STRIDE, MAX_STRIDE, MAX_STRIDE);
+            call_new(src, dst1_u, dst1_v, w, h, 2 * MAX_STRIDE, MAX_STRIDE, MAX_STRIDE);
+            // Check one pixel past the end of each row.
+            checkasm_check(uint8_t, dst0_u, MAX_STRIDE, dst1_u, MAX_STRIDE,
+                           w + 1, h, "dst1");
+            checkasm_check(uint8_t, dst0_v, MAX_STRIDE, dst1_v, MAX_STRIDE,
+                           w + 1, h, "dst2");
+        }
+
+        bench_new(src, dst1_u, dst1_v, 128, MAX_HEIGHT,
+                  2 * MAX_STRIDE, MAX_STRIDE, MAX_STRIDE);
+    }
+}
+
 void checkasm_check_sw_rgb(void)
 {
     ff_sws_rgb2rgb_init();
@@ -203,4 +243,7 @@ void checkasm_check_sw_rgb(void)
 
     check_interleave_bytes();
     report("interleave_bytes");
+
+    check_deinterleave_bytes();
+    report("deinterleave_bytes");
 }
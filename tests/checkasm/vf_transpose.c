@@ -0,0 +1,74 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/transpose.h"
+#include "libavutil/mem.h"
+
+#define STRIDE 64
+#define BUF_SIZE (STRIDE * 16)
+
+#define randomize_buffers(buf, size)      \
+    do {                                  \
+        int j;                            \
+        uint8_t *tmp_buf = (uint8_t *)buf;\
+        for (j = 0; j < size; j++)        \
+            tmp_buf[j] = rnd() & 0xFF;    \
+    } while (0)
+
+static void check_transpose(int pixstep)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,     [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [BUF_SIZE]);
+    int bits = pixstep * 8;
+    TransVtable v;
+    int i;
+
+    declare_func(void, uint8_t *src, ptrdiff_t src_linesize,
+                 uint8_t *dst, ptrdiff_t dst_linesize);
+
+    randomize_buffers(src, BUF_SIZE);
+    ff_transpose_init(&v, pixstep);
+
+    /* the filter reads bottom-up for clockwise rotations */
+    for (i = 0; i < 2; i++) {
+        uint8_t *in = i ? src + STRIDE * 15 : src;
+        ptrdiff_t in_linesize = i ? -STRIDE : STRIDE;
+
+        if (check_func(v.transpose_8x8, "transpose_8x8_%d", bits)) {
+            memset(dst_ref, 0, BUF_SIZE);
+            memset(dst_new, 0, BUF_SIZE);
+            call_ref(in, in_linesize, dst_ref, STRIDE);
+            call_new(in, in_linesize, dst_new, STRIDE);
+            if (memcmp(dst_ref, dst_new, BUF_SIZE))
+                fail();
+            bench_new(in, in_linesize, dst_new, STRIDE);
+        }
+    }
+}
+
+void checkasm_check_vf_transpose(void)
+{
+    check_transpose(1);
+    report("transpose_8");
+
+    check_transpose(2);
+    report("transpose_16");
+}
@@ -29,6 +29,18 @@ FATE_FFPROBE-$(CONFIG_AVDEVICE) += fate-ffprobe_xml
 fate-ffprobe_xml: $(FFPROBE_TEST_FILE)
 fate-ffprobe_xml: CMD = run $(FFPROBE_COMMAND) -of xml
 
+FATE_FFPROBE-$(CONFIG_AVDEVICE) += fate-ffprobe_stream_threads
+fate-ffprobe_stream_threads: $(FFPROBE_TEST_FILE)
+fate-ffprobe_stream_threads: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_frames -stream_threads -noflush_output -bitexact $(TARGET_PATH)/$(FFPROBE_TEST_FILE) -of compact
+
+# the stream parameters must not depend on the number of probing threads
+FATE_FFPROBE_PROBE_THREADS-$(call ALLYES, MPEGTS_DEMUXER MPEG2VIDEO_DECODER MP2_DECODER) += fate-ffprobe_probe_threads_1 \
+                                                                                      fate-ffprobe_probe_threads_4
+fate-ffprobe_probe_threads_%: REF = $(SRC_PATH)/tests/ref/fate/ffprobe_probe_threads
+fate-ffprobe_probe_threads_%: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_streams -show_format -bitexact -probe_threads $(@:fate-ffprobe_probe_threads_%=%) $(TARGET_PATH)/tests/data/lavf/lavf.ts -print_filename lavf.ts
+$(FATE_FFPROBE_PROBE_THREADS-yes): fate-lavf-ts
+FATE_FFPROBE-$(HAVE_THREADS) += $(FATE_FFPROBE_PROBE_THREADS-yes)
+
 FATE_FFPROBE += $(FATE_FFPROBE-yes)
 
 fate-ffprobe: $(FATE_FFPROBE)
@@ -132,6 +132,11 @@ fate-filter-boxblur: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf boxblur=2:1
 FATE_FILTER_VSYNTH-$(call ALLYES, COLORCHANNELMIXER_FILTER FORMAT_FILTER PERMS_FILTER) += fate-filter-colorchannelmixer
 fate-filter-colorchannelmixer: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf format=rgb24,perms=random,colorchannelmixer=.31415927:.4:.31415927:0:.27182818:.8:.27182818:0:.2:.6:.2:0 -flags +bitexact -sws_flags +accurate_rnd+bitexact
 
+# SMPTE ST 2084 input with each tone mapping curve
+COLORSPACE_TONEMAPS = none linear gamma clip reinhard hable mobius
+FATE_FILTER_VSYNTH-$(call ALLYES, FORMAT_FILTER COLORSPACE_FILTER) += $(COLORSPACE_TONEMAPS:%=fate-filter-colorspace-pq-%)
+fate-filter-colorspace-pq-%: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf format=yuv420p10,colorspace=all=bt709:iall=bt2020:itrc=smpte2084:irange=tv:range=tv:format=yuv420p:tonemap=$(@:fate-filter-colorspace-pq-%=%) -sws_flags +accurate_rnd+bitexact
+
 FATE_FILTER_VSYNTH-$(CONFIG_DRAWBOX_FILTER) += fate-filter-drawbox
 fate-filter-drawbox: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf drawbox=224:24:88:72:red@0.5
 
@@ -382,6 +387,13 @@ fate-filter-telecine: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf telecine
 FATE_FILTER_VSYNTH-$(CONFIG_TRANSPOSE_FILTER) += fate-filter-transpose
 fate-filter-transpose: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf transpose
 
+FATE_FILTER_VSYNTH-$(call ALLYES, TRANSPOSE_FILTER SWSCALE) += fate-filter-transpose-scale
+fate-filter-transpose-scale: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf transpose=clock:scale_w=200:scale_h=250
+
+# a downscale this large with lanczos goes through a cascaded scaler
+FATE_FILTER_VSYNTH-$(call ALLYES, TRANSPOSE_FILTER SWSCALE) += fate-filter-transpose-scale-cascaded
+fate-filter-transpose-scale-cascaded: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf transpose=clock:scale_w=6:scale_h=8:scale_flags=lanczos+accurate_rnd
+
 FATE_TRIM += fate-filter-trim-duration
 fate-filter-trim-duration: CMD = framecrc -i $(SRC) -vf trim=start=0.4:duration=0.05
 
@@ -485,10 +497,21 @@ fate-filter-scale200: CMD = video_filter "scale=w=200:h=200"
 FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scale500
 fate-filter-scale500: CMD = video_filter "scale=w=500:h=500"
 
+# threaded scaling must give the same output as scale200 and scale500
+FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scale200-threads
+fate-filter-scale200-threads: CMD = video_filter "scale=w=200:h=200:threads=4" -filter_threads 4
+
+FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scale500-threads
+fate-filter-scale500-threads: CMD = video_filter "scale=w=500:h=500:threads=4" -filter_threads 4
+
 FATE_FILTER_VSYNTH-$(CONFIG_SCALE2REF_FILTER) += fate-filter-scale2ref_keep_aspect
 fate-filter-scale2ref_keep_aspect: tests/data/filtergraphs/scale2ref_keep_aspect
 fate-filter-scale2ref_keep_aspect: CMD = framemd5 -frames:v 5 -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/scale2ref_keep_aspect -map "[main]"
 
+FATE_FILTER_VSYNTH-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER MULTISCALE_FILTER) += fate-filter-multiscale
+fate-filter-multiscale: tests/data/filtergraphs/multiscale
+fate-filter-multiscale: CMD = framemd5 -frames:v 5 -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/multiscale -map "[out0]" -map "[out1]" -map "[out2]"
+
 FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scalechroma
 fate-filter-scalechroma: tests/data/vsynth1.yuv
 fate-filter-scalechroma: CMD = framecrc -flags bitexact -s 352x288 -pix_fmt yuv444p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -pix_fmt yuv420p -sws_flags +bitexact -vf scale=out_v_chr_pos=33:out_h_chr_pos=151
@@ -847,10 +870,30 @@ fate-filter-refcmp-ssim-rgb: CMD = refcmp_metadata ssim rgb24 0.015
 FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-refcmp-ssim-yuv
 fate-filter-refcmp-ssim-yuv: CMD = refcmp_metadata ssim yuv422p 0.015
 
+FATE_FILTER-$(call ALLYES, CROP_FILTER FILLBORDERS_FILTER HFLIP_FILTER PAD_FILTER VFLIP_FILTER) += fate-filter-framecopies
+fate-filter-framecopies: libavfilter/tests/framecopies$(EXESUF)
+fate-filter-framecopies: CMD = run libavfilter/tests/framecopies$(EXESUF)
+
+# fused colorspace and scale must match colorspace followed by scale
+COLORSPACE_SCALE_DEPS = FFPROBE AVDEVICE LAVFI_INDEV TESTSRC2_FILTER FORMAT_FILTER SPLIT_FILTER \
+                        COLORSPACE_FILTER SCALE_FILTER PSNR_FILTER SWSCALE
+COLORSPACE_SCALE_GRAPH = "sws_flags=+accurate_rnd+bitexact;testsrc2=s=320x240:r=5:d=1,format=$(1),split[a][b];[a]colorspace=$(2):scale_w=$(3):scale_h=$(4):scale_flags=$(5)[x];[b]colorspace=$(2),scale=$(3):$(4):flags=$(5)[y];[x][y]psnr[out0]"
+FATE_FILTER_FFPROBE-$(call ALLYES, $(COLORSPACE_SCALE_DEPS)) += fate-filter-colorspace-scale-8 fate-filter-colorspace-scale-10 fate-filter-colorspace-scale-12 fate-filter-colorspace-scale-cascade
+fate-filter-colorspace-scale-8:  CMD = run $(FILTER_METADATA_COMMAND) $(call COLORSPACE_SCALE_GRAPH,yuv420p,all=bt709:iall=bt601-6-625:irange=tv:range=tv:format=yuv444p:dither=fsb,176,144,lanczos+accurate_rnd+bitexact)
+fate-filter-colorspace-scale-10: CMD = run $(FILTER_METADATA_COMMAND) $(call COLORSPACE_SCALE_GRAPH,yuv420p10,all=bt709:iall=bt2020:itrc=smpte2084:irange=tv:range=tv:format=yuv420p:tonemap=hable,176,144,bicubic+accurate_rnd+bitexact)
+fate-filter-colorspace-scale-12: CMD = run $(FILTER_METADATA_COMMAND) $(call COLORSPACE_SCALE_GRAPH,yuv422p12,all=bt2020:iall=bt709:irange=tv:range=pc:format=yuv444p12,480,360,bilinear+accurate_rnd+bitexact)
+fate-filter-colorspace-scale-cascade: CMD = run $(FILTER_METADATA_COMMAND) $(call COLORSPACE_SCALE_GRAPH,yuv420p,all=bt709:iall=bt601-6-525:format=yuv420p,16,8,lanczos+accurate_rnd+bitexact)
+
+# the SMPTE ST 2084 transfer functions must round trip
+FATE_FILTER-$(CONFIG_COLORSPACE_FILTER) += fate-filter-colorspace-pq
+fate-filter-colorspace-pq: libavfilter/tests/colorspace$(EXESUF)
+fate-filter-colorspace-pq: CMD = run libavfilter/tests/colorspace$(EXESUF)
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
+FATE_FFPROBE += $(FATE_FILTER_FFPROBE-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
 
-fate-vfilter: $(FATE_FILTER-yes) $(FATE_FILTER_SAMPLES-yes) $(FATE_FILTER_VSYNTH-yes)
+fate-vfilter: $(FATE_FILTER-yes) $(FATE_FILTER_SAMPLES-yes) $(FATE_FILTER_VSYNTH-yes) $(FATE_FILTER_FFPROBE-yes)
 
 fate-filter: fate-afilter fate-vfilter $(FATE_METADATA_FILTER-yes)
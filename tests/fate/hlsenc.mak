@@ -97,5 +97,17 @@ FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILT
 fate-hls-fmp4: tests/data/hls_segment_type_fmp4.m3u8
 fate-hls-fmp4: CMD = framecrc -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_fmp4.m3u8 -vf setpts=N*23
 
+tests/data/hls_fmp4_parts.m3u8: TAG = GEN
+tests/data/hls_fmp4_parts.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=5" -map 0 -codec:a mp2fixed \
+	-flags +bitexact -fflags +bitexact -hls_segment_type fmp4 -hls_fmp4_init_filename hls_fmp4_parts_init.mp4 \
+	-hls_list_size 0 -hls_time 2 -hls_part_time 0.5 -hls_segment_filename "$(TARGET_PATH)/tests/data/hls_fmp4_parts_%d.m4s" \
+	$(TARGET_PATH)/tests/data/hls_fmp4_parts.m3u8 2>/dev/null
+
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MOV_MUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-fmp4-parts
+fate-hls-fmp4-parts: tests/data/hls_fmp4_parts.m3u8
+fate-hls-fmp4-parts: CMD = cat $(TARGET_PATH)/tests/data/hls_fmp4_parts.m3u8
+
 FATE_FFMPEG += $(FATE_HLSENC-yes)
 fate-hlsenc: $(FATE_HLSENC-yes)
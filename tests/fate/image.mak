@@ -482,5 +482,10 @@ fate-xbm: $(FATE_XBM-yes)
 
 FATE_IMAGE += $(FATE_IMAGE-yes)
 
+FATE_IMAGE_FFMPEG-$(call DEMDEC, IMAGE2, PGMYUV) += fate-image2-prefetch
+fate-image2-prefetch: $(VREF)
+fate-image2-prefetch: CMD = framecrc -f image2 -c:v pgmyuv -prefetch 4 -i $(TARGET_PATH)/tests/vsynth1/%02d.pgm
+
 FATE_SAMPLES_FFMPEG += $(FATE_IMAGE)
-fate-image: $(FATE_IMAGE)
+FATE_FFMPEG += $(FATE_IMAGE_FFMPEG-yes)
+fate-image: $(FATE_IMAGE) $(FATE_IMAGE_FFMPEG-yes)
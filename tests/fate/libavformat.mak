@@ -2,6 +2,15 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_LIBAVFORMAT_HTTP-$(HAVE_PTHREADS) += fate-http-parallel
+FATE_LIBAVFORMAT-$(CONFIG_HTTP_PROTOCOL) += $(FATE_LIBAVFORMAT_HTTP-yes)
+fate-http-parallel: libavformat/tests/http_parallel$(EXESUF)
+fate-http-parallel: CMD = run libavformat/tests/http_parallel$(EXESUF)
+
+FATE_LIBAVFORMAT-yes += fate-index
+fate-index: libavformat/tests/index$(EXESUF)
+fate-index: CMD = run libavformat/tests/index$(EXESUF)
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy$(EXESUF)
@@ -14,6 +23,11 @@ FATE_LIBAVFORMAT-$(CONFIG_SRTP) += fate-srtp
 fate-srtp: libavformat/tests/srtp$(EXESUF)
 fate-srtp: CMD = run libavformat/tests/srtp$(EXESUF)
 
+FATE_LIBAVFORMAT_UDP-$(HAVE_SENDMMSG) += fate-udp
+FATE_LIBAVFORMAT-$(CONFIG_UDP_PROTOCOL) += $(FATE_LIBAVFORMAT_UDP-yes)
+fate-udp: libavformat/tests/udp$(EXESUF)
+fate-udp: CMD = run libavformat/tests/udp$(EXESUF)
+
 FATE_LIBAVFORMAT-yes += fate-url
 fate-url: libavformat/tests/url$(EXESUF)
 fate-url: CMD = run libavformat/tests/url$(EXESUF)
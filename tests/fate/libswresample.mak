@@ -1096,3 +1096,10 @@ fate-swr-audioconvert: FUZZ = 0
 FATE_SWR += $(FATE_SWR_AUDIOCONVERT-yes)
 FATE_FFMPEG += $(FATE_SWR)
 fate-swr: $(FATE_SWR)
+
+FATE_SWR_LIB += fate-swr-reinit
+fate-swr-reinit: libswresample/tests/reinit$(EXESUF)
+fate-swr-reinit: CMD = run libswresample/tests/reinit$(EXESUF)
+
+FATE-$(CONFIG_SWRESAMPLE) += $(FATE_SWR_LIB)
+fate-swr: $(FATE_SWR_LIB)
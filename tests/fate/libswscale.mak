@@ -1,3 +1,11 @@
+FATE_LIBSWSCALE += fate-sws-cascade-slices
+fate-sws-cascade-slices: libswscale/tests/cascade_slices$(EXESUF)
+fate-sws-cascade-slices: CMD = run libswscale/tests/cascade_slices$(EXESUF)
+
+FATE_LIBSWSCALE += fate-sws-filter-cache
+fate-sws-filter-cache: libswscale/tests/filter_cache$(EXESUF)
+fate-sws-filter-cache: CMD = run libswscale/tests/filter_cache$(EXESUF)
+
 FATE_LIBSWSCALE += fate-sws-pixdesc-query
 fate-sws-pixdesc-query: libswscale/tests/pixdesc_query$(EXESUF)
 fate-sws-pixdesc-query: CMD = run libswscale/tests/pixdesc_query$(EXESUF)
@@ -60,6 +60,16 @@ fate-webm-dash-chapters: CMD = transcode ogg $(TARGET_SAMPLES)/vorbis/vorbis_cha
 FATE_MATROSKA_FFPROBE-$(call ALLYES, MATROSKA_DEMUXER) += fate-matroska-spherical-mono
 fate-matroska-spherical-mono: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_entries stream_side_data_list -select_streams v -v 0 $(TARGET_SAMPLES)/mkv/spherical.mkv
 
+# Reading clusters ahead must demux and seek the same as parsing them
+# while reading.
+FATE_MATROSKA_CLUSTER_THREADS-$(CONFIG_MATROSKA_DEMUXER) += fate-matroska-cluster-threads
+fate-matroska-cluster-threads: libavformat/tests/seek$(EXESUF) fate-lavf-mkv
+fate-matroska-cluster-threads: REF = $(SRC_PATH)/tests/ref/seek/lavf-mkv
+fate-matroska-cluster-threads: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.mkv -cluster_threads 2
+
+FATE_AVCONV += $(FATE_MATROSKA_CLUSTER_THREADS-yes)
+fate-matroska: $(FATE_MATROSKA_CLUSTER_THREADS-yes)
+
 FATE_SAMPLES_AVCONV += $(FATE_MATROSKA-yes)
 FATE_SAMPLES_FFPROBE += $(FATE_MATROSKA_FFPROBE-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_MATROSKA_FFMPEG_FFPROBE-yes)
@@ -124,3 +124,41 @@ fate-mov-faststart-4gb-overflow: CMP = oneline
 fate-mov-faststart-4gb-overflow: REF = bc875921f151871e787c4b4023269b29
 
 fate-mov-mp4-with-mov-in24-ver: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_entries stream=codec_name -select_streams 1 $(TARGET_SAMPLES)/mov/mp4-with-mov-in24-ver.mp4
+
+# -lazy_index 1 must return the same packets and seek results as the full
+# index, the edit list is applied at read time so that the video track can
+# use the compact index
+FATE_MOV_LAZY_INDEX-$(call ALLYES, MOV_DEMUXER FRAMECRC_MUXER) += fate-mov-lazy-index-off \
+                                                                fate-mov-lazy-index-on
+fate-mov-lazy-index-%: REF = $(SRC_PATH)/tests/ref/fate/mov-lazy-index
+fate-mov-lazy-index-off: CMD = framecrc -advanced_editlist 0 -lazy_index 0 -i $(TARGET_PATH)/tests/data/lavf/lavf.mov -c copy
+fate-mov-lazy-index-on:  CMD = framecrc -advanced_editlist 0 -lazy_index 1 -i $(TARGET_PATH)/tests/data/lavf/lavf.mov -c copy
+
+FATE_MOV_LAZY_INDEX-$(CONFIG_MOV_DEMUXER) += fate-mov-lazy-index-seek-off \
+                                             fate-mov-lazy-index-seek-on
+fate-mov-lazy-index-seek-off fate-mov-lazy-index-seek-on: libavformat/tests/seek$(EXESUF)
+fate-mov-lazy-index-seek-%: REF = $(SRC_PATH)/tests/ref/fate/mov-lazy-index-seek
+fate-mov-lazy-index-seek-off: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.mov -advanced_editlist 0 -lazy_index 0
+fate-mov-lazy-index-seek-on:  CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.mov -advanced_editlist 0 -lazy_index 1
+
+$(FATE_MOV_LAZY_INDEX-yes): fate-lavf-mov
+FATE_FFMPEG += $(FATE_MOV_LAZY_INDEX-yes)
+fate-mov: $(FATE_MOV_LAZY_INDEX-yes)
+
+# -faststart_reserve 1 must put the moov atom in front of the same packets as
+# the plain second pass, both when the reserved space is large enough and when
+# a too small -moov_size forces the data to be moved
+FATE_MOV_FASTSTART_RESERVE-$(call ALLYES, MOV_DEMUXER MOV_MUXER FRAMECRC_MUXER) += fate-mov-faststart-reserve-off \
+                                                                                 fate-mov-faststart-reserve-on \
+                                                                                 fate-mov-faststart-reserve-small
+fate-mov-faststart-reserve-%: REF = $(SRC_PATH)/tests/ref/fate/mov-faststart-reserve
+fate-mov-faststart-reserve-%: OUT = $(TARGET_PATH)/tests/data/fate/$(@:fate-%=%).mov
+fate-mov-faststart-reserve-%: CMD = ffmpeg -i $(TARGET_PATH)/tests/data/lavf/lavf.mov -map 0 -c copy -movflags +faststart $(FASTSTART_OPTS) -f mov -y $(OUT); \
+                                    run ffprobe$(PROGSSUF)$(EXESUF) -v trace $(OUT) 2>&1 | grep -o "type:.m[od][oa][tv]. parent:.root."; \
+                                    framecrc -i $(OUT) -map 0 -c copy
+fate-mov-faststart-reserve-on:    FASTSTART_OPTS = -faststart_reserve 1
+fate-mov-faststart-reserve-small: FASTSTART_OPTS = -faststart_reserve 1 -moov_size 100
+
+$(FATE_MOV_FASTSTART_RESERVE-yes): ffprobe$(PROGSSUF)$(EXESUF) fate-lavf-mov
+FATE_FFMPEG += $(FATE_MOV_FASTSTART_RESERVE-yes)
+fate-mov: $(FATE_MOV_FASTSTART_RESERVE-yes)
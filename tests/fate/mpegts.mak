@@ -22,4 +22,11 @@ fate-mpegts-probe-pmt-merge: CMD = run $(PROBE_CODEC_NAME_COMMAND) -merge_pmt_ve
 
 FATE_SAMPLES_FFPROBE += $(FATE_MPEGTS_PROBE-yes)
 
-fate-mpegts: $(FATE_MPEGTS_PROBE-yes)
+# only the packets of the listed PIDs are returned
+FATE_MPEGTS-$(call ALLYES, MPEGTS_DEMUXER FRAMECRC_MUXER) += fate-mpegts-pids
+fate-mpegts-pids: fate-lavf-ts
+fate-mpegts-pids: CMD = framecrc -pids 0x101 -i $(TARGET_PATH)/tests/data/lavf/lavf.ts -c copy
+
+FATE_FFMPEG += $(FATE_MPEGTS-yes)
+
+fate-mpegts: $(FATE_MPEGTS_PROBE-yes) $(FATE_MPEGTS-yes)
@@ -251,6 +251,8 @@ FATE_SEEK += $(FATE_SEEK_LAVF-yes:%=fate-seek-lavf-%)
 FATE_SEEK_EXTRA-$(CONFIG_MP3_DEMUXER)   += fate-seek-extra-mp3
 FATE_SEEK_EXTRA-$(call ALLYES, CACHE_PROTOCOL PIPE_PROTOCOL MP3_DEMUXER) += fate-seek-cache-pipe
 FATE_SEEK_EXTRA-$(CONFIG_MATROSKA_DEMUXER) += fate-seek-mkv-codec-delay
+FATE_SEEK_CACHE_DIR-$(call ALLYES, CACHE_PROTOCOL FILE_PROTOCOL MATROSKA_DEMUXER) += fate-seek-cache-dir-cold \
+                                                                                  fate-seek-cache-dir-warm
 FATE_SEEK_EXTRA-$(CONFIG_MOV_DEMUXER) += fate-seek-extra-mp4
 FATE_SEEK_EXTRA-$(CONFIG_MOV_DEMUXER) += fate-seek-empty-edit-mp4
 FATE_SEEK_EXTRA-$(CONFIG_MOV_DEMUXER) += fate-seek-test-iibbibb-mp4
@@ -264,14 +266,30 @@ fate-seek-test-iibbibb-neg-ctts-mp4:  CMD = run libavformat/tests/seek$(EXESUF)
 fate-seek-cache-pipe: CMD = cat $(SAMPLES)/gapless/gapless.mp3 | run libavformat/tests/seek$(EXESUF) cache:pipe:0 -read_ahead_limit -1
 fate-seek-mkv-codec-delay:   CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/mkv/codec_delay_opus.mkv
 
+# the persistent cache must return the same data when filling the blocks
+# with prefetching and when reading them back while evicting, and eviction
+# must leave files it did not create alone
+$(FATE_SEEK_CACHE_DIR-yes): SRC = lavf/lavf.mkv
+$(FATE_SEEK_CACHE_DIR-yes): REF = $(SRC_PATH)/tests/ref/seek/lavf-mkv
+$(FATE_SEEK_CACHE_DIR-yes): fate-lavf-mkv
+fate-seek-cache-dir-warm: fate-seek-cache-dir-cold
+fate-seek-cache-dir-cold: CMD = rm -rf tests/data/fate/seek-cache-dir; \
+    run libavformat/tests/seek$(EXESUF) cache:$(TARGET_PATH)/tests/data/$(SRC) \
+    -cache_dir $(TARGET_PATH)/tests/data/fate/seek-cache-dir -block_size 4096 -prefetch 1
+fate-seek-cache-dir-warm: CMD = mkdir -p tests/data/fate/seek-cache-dir/user; \
+    touch -t 200001010000 tests/data/fate/seek-cache-dir/user.txt tests/data/fate/seek-cache-dir/user/0000000000000000; \
+    run libavformat/tests/seek$(EXESUF) cache:$(TARGET_PATH)/tests/data/$(SRC) \
+    -cache_dir $(TARGET_PATH)/tests/data/fate/seek-cache-dir -block_size 4096 -max_cache_size 65536 && \
+    test -f tests/data/fate/seek-cache-dir/user.txt && \
+    test -f tests/data/fate/seek-cache-dir/user/0000000000000000
 FATE_SEEK_EXTRA += $(FATE_SEEK_EXTRA-yes)
 
 
-$(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA): libavformat/tests/seek$(EXESUF)
+$(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_CACHE_DIR-yes): libavformat/tests/seek$(EXESUF)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/$(SRC)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): fate-seek-%: fate-%
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
-FATE_AVCONV += $(FATE_SEEK)
+FATE_AVCONV += $(FATE_SEEK) $(FATE_SEEK_CACHE_DIR-yes)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_CACHE_DIR-yes)
@@ -0,0 +1,210 @@
+/*
+ * HLS muxer publishing latency benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Muxes a synthetic 30 fps video stream, captured in real time, with the
+ * hls muxer and reports how long it takes until each frame is listed in the
+ * media playlist, as a player polling the playlist would see it, e.g.
+ *   tools/hlslatency -o hls_time=2
+ *   tools/hlslatency -o hls_time=2:hls_part_time=0.2
+ * The frames are submitted at their capture time on the media clock and the
+ * outputs are kept in memory, so the numbers only depend on the muxer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavformat/avformat.h"
+
+#define FPS 30
+
+static int64_t nb_frames, nb_published, nb_playlists, output_size;
+static int64_t now; /* frame being submitted */
+static double latency_sum, latency_max;
+
+static int discard_packet(void *opaque, uint8_t *buf, int size)
+{
+    output_size += size;
+    return size;
+}
+
+/* Media duration listed in a playlist, including the parts of the segment in progress. */
+static double published_duration(const char *playlist)
+{
+    double segments = 0, parts = 0;
+    const char *p = playlist;
+
+    while (*p) {
+        if (av_strstart(p, "#EXTINF:", NULL))
+            segments += strtod(p + 8, NULL);
+        else if (av_strstart(p, "#EXT-X-PART:DURATION=", NULL))
+            parts += strtod(p + 21, NULL);
+        else if (*p != '#' && *p != '\n')
+            parts = 0; /* the parts listed so far belong to this segment */
+        p += strcspn(p, "\n");
+        p += *p == '\n';
+    }
+    return segments + parts;
+}
+
+static int io_open(AVFormatContext *s, AVIOContext **pb, const char *url,
+                   int flags, AVDictionary **options)
+{
+    uint8_t *buf;
+
+    if (av_match_ext(url, "m3u8"))
+        return avio_open_dyn_buf(pb);
+    buf = av_malloc(32768);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    *pb = avio_alloc_context(buf, 32768, 1, NULL, NULL, discard_packet, NULL);
+    if (!*pb) {
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static void io_close(AVFormatContext *s, AVIOContext *pb)
+{
+    uint8_t *buf;
+    int64_t published;
+
+    if (pb->write_packet == discard_packet) {
+        avio_flush(pb);
+        av_freep(&pb->buffer);
+        avio_context_free(&pb);
+        return;
+    }
+
+    avio_w8(pb, 0);
+    avio_close_dyn_buf(pb, &buf);
+    nb_playlists++;
+    /* a frame is playable once its end is listed */
+    published = (int64_t)(published_duration(buf) * FPS + 0.001);
+    for (; nb_published < FFMIN(published, nb_frames); nb_published++) {
+        double latency = (double)(now - nb_published) / FPS;
+        latency_sum += latency;
+        latency_max  = FFMAX(latency_max, latency);
+    }
+    av_free(buf);
+}
+
+static int usage(const char *argv0, int ret)
+{
+    fprintf(stderr, "%s [-n seconds] [-g gop] [-b bitrate] [-o <options>]\n", argv0);
+    fprintf(stderr, "<options>: hls muxer AVOptions expressed as key=value, :-separated\n");
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = 60, gop = 2 * FPS, bit_rate = 4000000, frame_size;
+    int ret, i;
+    int64_t published_live;
+    double live_sum, live_max;
+    char errbuf[50];
+    uint8_t *frame = NULL;
+    AVFormatContext *oc = NULL;
+    AVDictionary *opts = NULL;
+    AVStream *st;
+    AVPacket pkt;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-g") && i + 1 < argc) {
+            gop = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+            bit_rate = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            if (av_dict_parse_string(&opts, argv[++i], "=", ":", 0) < 0)
+                return usage(argv[0], 1);
+        } else {
+            return usage(argv[0], 1);
+        }
+    }
+    if (seconds <= 0 || gop <= 0 || bit_rate < 8 * FPS)
+        return usage(argv[0], 1);
+
+    /* no known protocol, so that playlists are not renamed on disk */
+    ret = avformat_alloc_output_context2(&oc, NULL, "hls", "mem:live.m3u8");
+    if (ret < 0)
+        goto fail;
+    oc->io_open  = io_open;
+    oc->io_close = io_close;
+    av_dict_set(&opts, "hls_segment_type", "fmp4", AV_DICT_DONT_OVERWRITE);
+    av_dict_set(&opts, "hls_list_size", "0", AV_DICT_DONT_OVERWRITE);
+
+    frame_size = bit_rate / 8 / FPS;
+    frame = av_mallocz(frame_size);
+    st = avformat_new_stream(oc, NULL);
+    if (!frame || !st) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    st->codecpar->codec_id   = AV_CODEC_ID_MPEG4;
+    st->codecpar->width      = 1280;
+    st->codecpar->height     = 720;
+    st->time_base            = (AVRational){ 1, FPS };
+
+    ret = avformat_write_header(oc, &opts);
+    if (ret < 0)
+        goto fail;
+
+    for (now = 0; now < (int64_t)seconds * FPS; now++) {
+        av_init_packet(&pkt);
+        pkt.data     = frame;
+        pkt.size     = frame_size;
+        pkt.pts      = pkt.dts = av_rescale_q(now, (AVRational){ 1, FPS }, st->time_base);
+        pkt.duration = av_rescale_q(1, (AVRational){ 1, FPS }, st->time_base);
+        pkt.flags    = now % gop ? 0 : AV_PKT_FLAG_KEY;
+        ret = av_write_frame(oc, &pkt);
+        if (ret < 0)
+            goto fail;
+        nb_frames = now + 1;
+    }
+    /* the frames published at the end of the stream are not live */
+    published_live = nb_published;
+    live_sum       = latency_sum;
+    live_max       = latency_max;
+    ret = av_write_trailer(oc);
+    if (ret < 0)
+        goto fail;
+
+    printf("%"PRId64" frames, %"PRId64" bytes, %"PRId64" playlist updates\n",
+           nb_frames, output_size, nb_playlists);
+    if (published_live)
+        printf("publishing latency: mean %.0f ms, max %.0f ms over %"PRId64" frames\n",
+               live_sum / published_live * 1000, live_max * 1000, published_live);
+
+fail:
+    if (ret < 0) {
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        fprintf(stderr, "hlslatency: %s\n", errbuf);
+    }
+    av_dict_free(&opts);
+    avformat_free_context(oc);
+    av_free(frame);
+    return ret < 0;
+}
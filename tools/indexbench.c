@@ -0,0 +1,156 @@
+/*
+ * Stream index insertion benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Adds entries to the index of a stream in a given order, one by one with
+ * av_add_index_entry() or in batches with av_add_index_entries(), checks
+ * the resulting index and reports the insertion rate, e.g.
+ *   tools/indexbench -n 10000000 -m random -b 65536
+ * Modes:
+ *   append   increasing timestamps
+ *   reverse  decreasing timestamps
+ *   fill     every other timestamp, then the ones in between, as when
+ *            reading again after the index was reduced
+ *   random   timestamps in random order
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+static int usage(const char *argv0, int ret)
+{
+    fprintf(stderr, "%s [-n entries] [-m append|reverse|fill|random] [-b batch size]\n", argv0);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *mode = "random";
+    int nb_entries = 10000000, batch = 0, i, ret = 1;
+    int64_t *order = NULL, start_time;
+    AVIndexEntry *entries = NULL;
+    double elapsed;
+    AVFormatContext *s = NULL;
+    AVStream *st;
+    AVLFG lfg;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            nb_entries = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+            batch = atoi(argv[++i]);
+        } else {
+            return usage(argv[0], 1);
+        }
+    }
+    if (nb_entries <= 0 || batch < 0)
+        return usage(argv[0], 1);
+
+    order   = av_malloc_array(nb_entries, sizeof(*order));
+    entries = av_malloc_array(FFMAX(batch, 1), sizeof(*entries));
+    s       = avformat_alloc_context();
+    if (!order || !entries || !s || !(st = avformat_new_stream(s, NULL))) {
+        fprintf(stderr, "indexbench: out of memory\n");
+        goto end;
+    }
+
+    for (i = 0; i < nb_entries; i++)
+        order[i] = i;
+    if (!strcmp(mode, "reverse")) {
+        for (i = 0; i < nb_entries; i++)
+            order[i] = nb_entries - 1 - i;
+    } else if (!strcmp(mode, "fill")) {
+        int half = (nb_entries + 1) / 2;
+        for (i = 0; i < nb_entries; i++)
+            order[i] = i < half ? 2 * i : 2 * (i - half) + 1;
+    } else if (!strcmp(mode, "random")) {
+        av_lfg_init(&lfg, 0xdeadbeef);
+        for (i = nb_entries - 1; i > 0; i--) {
+            int j = av_lfg_get(&lfg) % (i + 1);
+            FFSWAP(int64_t, order[i], order[j]);
+        }
+    } else if (strcmp(mode, "append")) {
+        ret = usage(argv[0], 1);
+        goto end;
+    }
+
+    start_time = av_gettime_relative();
+    for (i = 0; i < nb_entries; i++) {
+        int64_t ts = order[i] * 1000;
+        int flags  = order[i] % 25 ? 0 : AVINDEX_KEYFRAME;
+
+        if (batch) {
+            AVIndexEntry *e = &entries[i % batch];
+            e->pos          = ts * 10;
+            e->timestamp    = ts;
+            e->size         = 1000;
+            e->min_distance = 0;
+            e->flags        = flags;
+            if ((i % batch == batch - 1 || i == nb_entries - 1) &&
+                av_add_index_entries(st, entries, i % batch + 1) < 0) {
+                fprintf(stderr, "indexbench: failed to add entries up to %d\n", i);
+                goto end;
+            }
+        } else if (av_add_index_entry(st, ts * 10, ts, 1000, 0, flags) < 0) {
+            fprintf(stderr, "indexbench: failed to add entry %d\n", i);
+            goto end;
+        }
+    }
+    if (avformat_index_get_entries_count(st) != nb_entries) {
+        fprintf(stderr, "indexbench: %d entries in the index, expected %d\n",
+                avformat_index_get_entries_count(st), nb_entries);
+        goto end;
+    }
+    elapsed = (av_gettime_relative() - start_time) / 1000000.0;
+
+    for (i = 0; i < nb_entries; i++) {
+        const AVIndexEntry *e = avformat_index_get_entry(st, i);
+        if (e->timestamp != i * 1000LL || e->pos != e->timestamp * 10) {
+            fprintf(stderr, "indexbench: wrong entry %d\n", i);
+            goto end;
+        }
+    }
+    for (i = 0; i < 1000; i++) {
+        int64_t ts = (int64_t)i * nb_entries;
+        const AVIndexEntry *e = avformat_index_get_entry_from_timestamp(st, ts,
+                                                                        AVSEEK_FLAG_BACKWARD);
+        if (!e || e->timestamp > ts || ts - e->timestamp >= 25000) {
+            fprintf(stderr, "indexbench: wrong keyframe for %"PRId64"\n", ts);
+            goto end;
+        }
+    }
+
+    printf("%s: %d entries in %.3fs, %.0f entries/s\n",
+           mode, nb_entries, elapsed, nb_entries / elapsed);
+    ret = 0;
+
+end:
+    avformat_free_context(s);
+    av_free(entries);
+    av_free(order);
+    return ret;
+}
@@ -0,0 +1,135 @@
+/*
+ * Demuxer open time and memory benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Opens an input, reads the first packet and reports the time spent in
+ * avformat_open_input() and avformat_find_stream_info() together with the
+ * peak resident set size, e.g.
+ *   tools/openbench long.mp4
+ *   tools/openbench -o lazy_index=1:advanced_editlist=0 long.mp4
+ *   tools/openbench -o probe_threads=0:fflags=+probeselected -p 3 multi.ts
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+static int usage(const char *argv0, int ret)
+{
+    fprintf(stderr, "%s [-o <options>] [-f format] [-p program] [-s] <input>\n", argv0);
+    fprintf(stderr, "<options>: demuxer AVOptions expressed as key=value, :-separated\n");
+    fprintf(stderr, "-p: discard the streams not in the program with the given id\n");
+    fprintf(stderr, "-s: skip avformat_find_stream_info()\n");
+    return ret;
+}
+
+static long max_rss_kb(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename = NULL;
+    AVInputFormat *fmt = NULL;
+    AVFormatContext *ic = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket pkt;
+    int64_t t0, t1, t2, t3, nb_entries = 0;
+    long rss_start;
+    int ret, i, skip_info = 0, program_id = -1;
+    char errbuf[50];
+
+    avformat_network_init();
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            if (av_dict_parse_string(&opts, argv[++i], "=", ":", 0) < 0)
+                return usage(argv[0], 1);
+        } else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+            if (!(fmt = av_find_input_format(argv[++i])))
+                return usage(argv[0], 1);
+        } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+            program_id = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s")) {
+            skip_info = 1;
+        } else if (!filename) {
+            filename = argv[i];
+        } else {
+            return usage(argv[0], 1);
+        }
+    }
+    if (!filename)
+        return usage(argv[0], 1);
+
+    rss_start = max_rss_kb();
+    t0 = av_gettime_relative();
+    ret = avformat_open_input(&ic, filename, fmt, &opts);
+    if (ret < 0)
+        goto fail;
+    if (program_id >= 0) {
+        for (i = 0; i < ic->nb_streams; i++)
+            ic->streams[i]->discard = AVDISCARD_ALL;
+        for (i = 0; i < ic->nb_programs; i++) {
+            AVProgram *program = ic->programs[i];
+            if (program->id == program_id) {
+                unsigned j;
+                for (j = 0; j < program->nb_stream_indexes; j++)
+                    ic->streams[program->stream_index[j]]->discard = AVDISCARD_DEFAULT;
+            }
+        }
+    }
+    t1 = av_gettime_relative();
+    if (!skip_info) {
+        ret = avformat_find_stream_info(ic, NULL);
+        if (ret < 0)
+            goto fail;
+    }
+    t2 = av_gettime_relative();
+    ret = av_read_frame(ic, &pkt);
+    if (ret < 0)
+        goto fail;
+    av_packet_unref(&pkt);
+    t3 = av_gettime_relative();
+
+    for (i = 0; i < ic->nb_streams; i++)
+        nb_entries += ic->streams[i]->nb_index_entries;
+
+    printf("open %.3f ms, find_stream_info %.3f ms, first packet %.3f ms\n",
+           (t1 - t0) / 1000.0, (t2 - t1) / 1000.0, (t3 - t2) / 1000.0);
+    printf("%d streams, %"PRId64" index entries, peak RSS %ld kB (+%ld kB)\n",
+           ic->nb_streams, nb_entries, max_rss_kb(), max_rss_kb() - rss_start);
+
+fail:
+    if (ret < 0) {
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        fprintf(stderr, "openbench: %s: %s\n", filename, errbuf);
+    }
+    av_dict_free(&opts);
+    avformat_close_input(&ic);
+    avformat_network_deinit();
+    return ret < 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * MPEG-TS muxer throughput benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Muxes synthetic video and audio packets for a number of services into
+ * a discarding AVIOContext and reports the muxing throughput, e.g.
+ *   tools/tsmuxbench -s 8 -o muxrate=40000000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+#define VIDEO_PACKET_SIZE 25000 /* 6 Mbit/s at 30 fps */
+#define AUDIO_PACKET_SIZE 576   /* 192 kbit/s MP2 */
+
+static int64_t output_size;
+
+static int discard_packet(void *opaque, uint8_t *buf, int size)
+{
+    output_size += size;
+    return size;
+}
+
+static int usage(const char *argv0, int ret)
+{
+    fprintf(stderr, "%s [-n seconds] [-s services] [-p packet_size] [-o <options>]\n", argv0);
+    fprintf(stderr, "<options>: mpegts muxer AVOptions expressed as key=value, :-separated\n");
+    return ret;
+}
+
+static int add_stream(AVFormatContext *oc, enum AVMediaType type,
+                      enum AVCodecID codec_id, int service)
+{
+    AVStream *st = avformat_new_stream(oc, NULL);
+    if (!st)
+        return AVERROR(ENOMEM);
+    st->codecpar->codec_type = type;
+    st->codecpar->codec_id   = codec_id;
+    if (type == AVMEDIA_TYPE_AUDIO) {
+        st->codecpar->sample_rate    = 48000;
+        st->codecpar->channels       = 2;
+        st->codecpar->channel_layout = AV_CH_LAYOUT_STEREO;
+    } else {
+        st->codecpar->width  = 1920;
+        st->codecpar->height = 1080;
+    }
+    st->time_base = (AVRational){ 1, 90000 };
+    if (oc->nb_programs > service)
+        av_program_add_stream_index(oc, oc->programs[service]->id, st->index);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = 60, nb_services = 1, video_size = VIDEO_PACKET_SIZE;
+    int ret, i;
+    int64_t nb_packets = 0, start_time, frame, j;
+    double elapsed;
+    char errbuf[50];
+    uint8_t *video = NULL, *audio = NULL, *iobuf = NULL;
+    AVFormatContext *oc = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket pkt;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            nb_services = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+            video_size = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            if (av_dict_parse_string(&opts, argv[++i], "=", ":", 0) < 0)
+                return usage(argv[0], 1);
+        } else {
+            return usage(argv[0], 1);
+        }
+    }
+    if (seconds <= 0 || nb_services <= 0 || video_size <= 0)
+        return usage(argv[0], 1);
+
+    ret = avformat_alloc_output_context2(&oc, NULL, "mpegts", NULL);
+    if (ret < 0)
+        goto fail;
+
+    video = av_mallocz(video_size);
+    audio = av_mallocz(AUDIO_PACKET_SIZE);
+    iobuf = av_malloc(32768);
+    if (!video || !audio || !iobuf) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    /* start codes so that the payloads look like MPEG-2 video and MP2 */
+    memcpy(video, "\x00\x00\x01\xb3", 4);
+    memcpy(audio, "\xff\xfd", 2);
+
+    oc->pb = avio_alloc_context(iobuf, 32768, 1, NULL, NULL, discard_packet, NULL);
+    if (!oc->pb) {
+        av_free(iobuf);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (i = 0; i < nb_services; i++) {
+        if (nb_services > 1 && !av_new_program(oc, i + 1)) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        if ((ret = add_stream(oc, AVMEDIA_TYPE_VIDEO, AV_CODEC_ID_MPEG2VIDEO, i)) < 0 ||
+            (ret = add_stream(oc, AVMEDIA_TYPE_AUDIO, AV_CODEC_ID_MP2, i)) < 0)
+            goto fail;
+    }
+
+    oc->max_delay = 700000; /* as set by ffmpeg */
+    ret = avformat_write_header(oc, &opts);
+    if (ret < 0)
+        goto fail;
+
+    start_time = av_gettime_relative();
+    /* 30 fps video and 24 ms audio frames, interleaved per 1/30 s */
+    for (frame = 0; frame < seconds * 30; frame++) {
+        for (i = 0; i < oc->nb_streams; i++) {
+            AVStream *st = oc->streams[i];
+            int video_st = st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO;
+            int64_t first = video_st ? frame : frame * 3000 / 2160;
+            int64_t last  = video_st ? frame + 1 : (frame + 1) * 3000 / 2160;
+
+            for (j = first; j < last; j++) {
+                av_init_packet(&pkt);
+                pkt.stream_index = i;
+                pkt.data  = video_st ? video : audio;
+                pkt.size  = video_st ? video_size : AUDIO_PACKET_SIZE;
+                pkt.pts   = av_rescale_q(video_st ? j * 3000 : j * 2160,
+                                         (AVRational){ 1, 90000 }, st->time_base);
+                pkt.dts   = pkt.pts;
+                pkt.flags = !video_st || j % 30 == 0 ? AV_PKT_FLAG_KEY : 0;
+                ret = av_write_frame(oc, &pkt);
+                if (ret < 0)
+                    goto fail;
+                nb_packets++;
+            }
+        }
+    }
+    ret = av_write_trailer(oc);
+    if (ret < 0)
+        goto fail;
+    elapsed = (av_gettime_relative() - start_time) / 1000000.0;
+
+    printf("muxed %"PRId64" packets, %"PRId64" bytes in %.3fs\n",
+           nb_packets, output_size, elapsed);
+    printf("%.0f TS packets/s, %.1f Mbit/s, %.1fx realtime\n",
+           output_size / 188 / elapsed, output_size * 8 / elapsed / 1e6,
+           seconds / elapsed);
+
+fail:
+    if (ret < 0) {
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        fprintf(stderr, "tsmuxbench: %s\n", errbuf);
+    }
+    av_dict_free(&opts);
+    if (oc) {
+        if (oc->pb)
+            av_freep(&oc->pb->buffer);
+        avio_context_free(&oc->pb);
+        avformat_free_context(oc);
+    }
+    av_free(video);
+    av_free(audio);
+    return ret < 0;
+}
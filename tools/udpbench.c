@@ -0,0 +1,151 @@
+/*
+ * UDP protocol loopback benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Sends datagrams of 7 TS packets through udp:// over the loopback
+ * interface and reads them back, reporting packets per second and
+ * CPU time per Gbit. Compare e.g.
+ *   tools/udpbench
+ *   tools/udpbench -o batch=32:gso=1 -i batch=32:gso=1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+#define PKT_SIZE (7 * 188)
+#define BURST    256
+
+static int usage(const char *argv0, int ret)
+{
+    fprintf(stderr, "%s [-n packets] [-p port] [-i <options>] [-o <options>]\n", argv0);
+    fprintf(stderr, "<options>: udp AVOptions for input/output expressed as key=value, :-separated\n");
+    return ret;
+}
+
+static double cpu_time(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+           (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_packets = 200000, port = 23456, ret, i;
+    int64_t sent = 0, received = 0, lost, start_time;
+    double cpu, elapsed, gbits;
+    char url[256], errbuf[50];
+    uint8_t pkt[PKT_SIZE], buf[65536];
+    AVIOContext *input = NULL, *output = NULL;
+    AVDictionary *in_opts = NULL;
+    AVDictionary *out_opts = NULL;
+
+    avformat_network_init();
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            nb_packets = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            if (av_dict_parse_string(&in_opts, argv[++i], "=", ":", 0) < 0)
+                return usage(argv[0], 1);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            if (av_dict_parse_string(&out_opts, argv[++i], "=", ":", 0) < 0)
+                return usage(argv[0], 1);
+        } else {
+            return usage(argv[0], 1);
+        }
+    }
+
+    av_dict_set_int(&in_opts,  "buffer_size", 8 << 20, AV_DICT_DONT_OVERWRITE);
+    av_dict_set_int(&in_opts,  "fifo_size",   BURST * 4 * PKT_SIZE / 188, AV_DICT_DONT_OVERWRITE);
+    av_dict_set_int(&in_opts,  "timeout",     500000, AV_DICT_DONT_OVERWRITE);
+    av_dict_set_int(&out_opts, "pkt_size",    PKT_SIZE, AV_DICT_DONT_OVERWRITE);
+
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d", port);
+    ret = avio_open2(&input, url, AVIO_FLAG_READ, NULL, &in_opts);
+    if (ret < 0)
+        goto fail;
+    ret = avio_open2(&output, url, AVIO_FLAG_WRITE, NULL, &out_opts);
+    if (ret < 0)
+        goto fail;
+
+    for (i = 0; i < PKT_SIZE; i += 188) {
+        memset(pkt + i, 0xff, 188);
+        pkt[i] = 0x47;
+    }
+
+    cpu        = cpu_time();
+    start_time = av_gettime_relative();
+    while (sent < nb_packets) {
+        int64_t target;
+
+        for (i = 0; i < BURST && sent < nb_packets; i++, sent++)
+            avio_write(output, pkt, PKT_SIZE);
+        avio_flush(output);
+        if (output->error) {
+            ret = output->error;
+            goto fail;
+        }
+        /* datagrams still queued for batching are only sent on close */
+        target = sent - BURST;
+        while (received < target) {
+            int n = avio_read_partial(input, buf, sizeof(buf));
+            if (n <= 0)
+                break;
+            received += n / PKT_SIZE;
+        }
+    }
+    avio_closep(&output);
+    while (received < sent) {
+        int n = avio_read_partial(input, buf, sizeof(buf));
+        if (n <= 0)
+            break;
+        received += n / PKT_SIZE;
+    }
+    elapsed = (av_gettime_relative() - start_time) / 1000000.0;
+    cpu     = cpu_time() - cpu;
+    gbits   = received * PKT_SIZE * 8 / 1e9;
+    lost    = sent - received;
+
+    printf("sent %"PRId64" received %"PRId64" lost %"PRId64" packets in %.3fs\n",
+           sent, received, lost, elapsed);
+    printf("%.0f packets/s, %.3f Gbit/s, %.3f CPU s/Gbit\n",
+           received / elapsed, gbits / elapsed, gbits > 0 ? cpu / gbits : 0.0);
+
+fail:
+    if (ret < 0) {
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        fprintf(stderr, "udpbench: %s\n", errbuf);
+    }
+    av_dict_free(&in_opts);
+    av_dict_free(&out_opts);
+    avio_closep(&output);
+    avio_closep(&input);
+    avformat_network_deinit();
+    return ret < 0;
+}